@@ -0,0 +1,12 @@
+#pragma once
+
+namespace minisql {
+
+    // Keeps a benchmark result alive, so the compiler cannot drop the work
+    // that produced it
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+} // namespace minisql
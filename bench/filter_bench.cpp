@@ -0,0 +1,81 @@
+// Filter kernel microbenchmark: GB/s of column data scanned by the selection
+// kernels at each instruction set level this CPU supports, for a predicate
+// matching about half the rows.
+//
+// usage: filter_bench [rows] [rounds]
+#include "filter.hpp"
+#include "bench.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace minisql;
+
+namespace {
+
+    template <typename Fn>
+    double gbPerSecond(size_t bytes, size_t rounds, Fn fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < rounds; ++i) {
+            doNotOptimize(fn());
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<double>(bytes) * rounds / std::chrono::duration<double>(elapsed).count() / 1e9;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : (1 << 20);
+    size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+    std::mt19937 rng(42);
+    std::vector<int32_t> ints(rows);
+    std::vector<float> floats(rows);
+    std::vector<uint8_t> bools(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        ints[i] = static_cast<int32_t>(rng() % 1000);
+        floats[i] = static_cast<float>(rng() % 1000) / 10.0f;
+        bools[i] = rng() & 1;
+    }
+    // A few nulls and deleted rows, as in a real row group
+    std::vector<uint8_t> nulls((rows + 7) / 8);
+    std::vector<uint8_t> excluded((rows + 7) / 8);
+    for (size_t i = 0; i < rows; i += 97) nulls[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+    for (size_t i = 0; i < rows; i += 61) excluded[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+    std::vector<uint32_t> selection(rows);
+
+    std::vector<SimdLevel> levels = {SimdLevel::SCALAR};
+    if (simdLevel() != SimdLevel::SCALAR) levels.push_back(SimdLevel::SSE2);
+    if (simdLevel() == SimdLevel::AVX2) levels.push_back(SimdLevel::AVX2);
+
+    const char* int_values = reinterpret_cast<const char*>(ints.data());
+    const char* float_values = reinterpret_cast<const char*>(floats.data());
+    const char* bool_values = reinterpret_cast<const char*>(bools.data());
+    std::cout << std::left << std::setw(10) << "level" << std::right << std::setw(12) << "INT GB/s"
+              << std::setw(12) << "FLOAT GB/s" << std::setw(12) << "BOOL GB/s" << std::setw(12) << "selected" << "\n";
+    for (SimdLevel level : levels) {
+        size_t selected = 0;
+        double int_rate = gbPerSecond(rows * 4, rounds, [&] {
+            return selected = selectInt(int_values, rows, CompareOp::LT, 500, nulls.data(), excluded.data(),
+                                        selection.data(), level);
+        });
+        double float_rate = gbPerSecond(rows * 4, rounds, [&] {
+            return selectFloat(float_values, rows, CompareOp::GE, 50.0f, nulls.data(), excluded.data(),
+                               selection.data(), level);
+        });
+        double bool_rate = gbPerSecond(rows, rounds, [&] {
+            return selectBool(bool_values, rows, CompareOp::EQ, true, nulls.data(), excluded.data(),
+                              selection.data(), level);
+        });
+        std::cout << std::left << std::setw(10) << simdLevelName(level) << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(12) << int_rate << std::setw(12) << float_rate
+                  << std::setw(12) << bool_rate << std::setw(12) << selected << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+// Parser microbenchmark: ns per statement for the recursive-descent Parser,
+// against the std::regex approach it replaced (reproduced below as a baseline).
+//
+// usage: parser_bench [iterations]
+#include "parser.hpp"
+#include "bench.hpp"
+#include "utils.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace minisql;
+
+namespace {
+
+    // WHERE field = value, built as the Parser builds it
+    void whereEquals(Query& query, const std::string& field, const std::string& value) {
+        Condition condition;
+        condition.op = "=";
+        condition.operands.push_back({field, std::nullopt});
+        condition.operands.push_back({std::string(), query.where_values.size()});
+        query.where_values.push_back(value);
+        query.where = std::make_shared<const Condition>(std::move(condition));
+    }
+
+    // The previous parser: split into tokens, then one std::regex per statement
+    Query regexParse(const std::string& query_str) {
+        Query query;
+        std::string cleaned = trim(query_str);
+        if (cleaned.empty() || cleaned.back() != ';') {
+            throw std::runtime_error("Query must end with semicolon");
+        }
+        cleaned = cleaned.substr(0, cleaned.size() - 1);
+        std::vector<std::string> tokens = split(cleaned, ' ');
+        std::string cmd = toUpper(tokens[0]);
+        std::smatch match;
+        if (cmd == "INSERT") {
+            query.type = QueryType::INSERT;
+            std::string rest = cleaned.substr(cleaned.find("INTO") + 4);
+            std::regex insert_regex(R"(\s*(\w+)\s*\((.*?)\)\s*VALUES\s*\((.*?)\))");
+            if (!std::regex_match(rest, match, insert_regex)) {
+                throw std::runtime_error("Invalid INSERT syntax");
+            }
+            query.table = match[1];
+            auto fields = split(match[2], ',');
+            auto values = split(match[3], ',');
+            for (size_t i = 0; i < fields.size(); ++i) {
+                query.insert_values.emplace_back(trim(fields[i]), trim(values[i]));
+            }
+        } else if (cmd == "SELECT") {
+            query.type = QueryType::SELECT;
+            std::string rest = cleaned.substr(cleaned.find("FROM"));
+            std::regex select_regex(R"(\s*(.*?)\s*FROM\s*(\w+)(?:\s*WHERE\s*(\w+)\s*=\s*(\S+))?)");
+            if (!std::regex_match(rest, match, select_regex)) {
+                throw std::runtime_error("Invalid SELECT syntax");
+            }
+            query.table = match[2];
+            if (match[3].matched) whereEquals(query, match[3], match[4]);
+        } else if (cmd == "UPDATE") {
+            query.type = QueryType::UPDATE;
+            std::regex update_regex(R"(UPDATE\s+(\w+)\s+SET\s+(\w+)\s*=\s*(\S+)\s*WHERE\s+(\w+)\s*=\s*(\S+))");
+            if (!std::regex_match(cleaned, match, update_regex)) {
+                throw std::runtime_error("Invalid UPDATE syntax");
+            }
+            query.table = match[1];
+            query.update_values.emplace_back(match[2], match[3]);
+            whereEquals(query, match[4], match[5]);
+        }
+        return query;
+    }
+
+    template <typename Fn>
+    double nsPerCall(size_t iterations, Fn fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            doNotOptimize(fn());
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const std::vector<std::pair<const char*, std::string>> statements = {
+        {"INSERT", "INSERT INTO employees (id, name, salary) VALUES (42, 'Alice', 5000.50);"},
+        {"SELECT", "SELECT * FROM employees WHERE id = 42;"},
+        {"UPDATE", "UPDATE employees SET salary = 6000 WHERE id = 42;"},
+    };
+
+    Parser parser;
+    std::cout << std::left << std::setw(10) << "statement" << std::right << std::setw(16) << "parser ns/op"
+              << std::setw(16) << "regex ns/op" << std::setw(10) << "speedup" << "\n";
+    for (const auto& [name, sql] : statements) {
+        // The regex baseline is far slower; fewer iterations keep the run short
+        double fast = nsPerCall(iterations, [&] { return parser.parse(sql); });
+        double slow = nsPerCall(iterations / 20 + 1, [&] { return regexParse(sql); });
+        std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(16) << fast << std::setw(16) << slow << std::setw(9) << slow / fast << "x\n";
+    }
+    return 0;
+}
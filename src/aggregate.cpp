@@ -0,0 +1,213 @@
+#include "aggregate.hpp"
+#include "bytes.hpp"
+#include <charconv>
+#include <cstring>
+
+namespace minisql {
+
+namespace {
+    uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    std::string formatDouble(double value) {
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, result.ptr);
+    }
+
+    bool replacesExtreme(AggregateFunc func, int cmp) {
+        return func == AggregateFunc::MIN ? cmp < 0 : cmp > 0;
+    }
+
+    void update(const AggregateSpec& spec, AggregateState& state, const TupleView& row) {
+        if (spec.field == AggregateSpec::kNoField) {
+            ++state.count;
+            return;
+        }
+        if (row.isNull(spec.field)) return;
+        ++state.count;
+        switch (spec.func) {
+            case AggregateFunc::SUM:
+            case AggregateFunc::AVG:
+                if (spec.type == DataType::INT) {
+                    state.int_sum += row.getInt(spec.field);
+                } else {
+                    state.float_sum += row.getFloat(spec.field);
+                }
+                break;
+            case AggregateFunc::MIN:
+            case AggregateFunc::MAX:
+                if (!state.extreme || replacesExtreme(spec.func, row.compare(spec.field, *state.extreme))) {
+                    state.extreme = row.get(spec.field);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void combine(const AggregateSpec& spec, AggregateState& state, const AggregateState& other) {
+        state.count += other.count;
+        state.int_sum += other.int_sum;
+        state.float_sum += other.float_sum;
+        if (other.extreme && (!state.extreme || replacesExtreme(spec.func, compareValues(*other.extreme, *state.extreme)))) {
+            state.extreme = other.extreme;
+        }
+    }
+}
+
+AggregateTable::AggregateTable(const std::vector<AggregateSpec>& specs) : specs_(&specs) {}
+
+void AggregateTable::add(std::string_view key, uint64_t hash, const TupleView& row) {
+    AggregateState* states = &states_[findOrInsert(key, hash) * specs_->size()];
+    for (size_t i = 0; i < specs_->size(); ++i) {
+        update((*specs_)[i], states[i], row);
+    }
+}
+
+void AggregateTable::merge(const AggregateTable& other) {
+    size_t width = specs_->size();
+    for (size_t group = 0; group < other.size(); ++group) {
+        AggregateState* states = &states_[findOrInsert(other.keys_[group], other.hashes_[group]) * width];
+        for (size_t i = 0; i < width; ++i) {
+            combine((*specs_)[i], states[i], other.states_[group * width + i]);
+        }
+    }
+}
+
+size_t AggregateTable::findOrInsert(std::string_view key, uint64_t hash) {
+    if ((keys_.size() + 1) * 2 > slots_.size()) {
+        grow();
+    }
+    size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        uint32_t entry = slots_[slot];
+        if (entry == 0) {
+            slots_[slot] = static_cast<uint32_t>(keys_.size() + 1);
+            keys_.emplace_back(key);
+            hashes_.push_back(hash);
+            states_.resize(states_.size() + specs_->size());
+            return keys_.size() - 1;
+        }
+        if (hashes_[entry - 1] == hash && keys_[entry - 1] == key) {
+            return entry - 1;
+        }
+    }
+}
+
+void AggregateTable::grow() {
+    slots_.assign(slots_.empty() ? 16 : slots_.size() * 2, 0);
+    size_t mask = slots_.size() - 1;
+    for (size_t group = 0; group < keys_.size(); ++group) {
+        size_t slot = hashes_[group] & mask;
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = static_cast<uint32_t>(group + 1);
+    }
+}
+
+PartialAggregate::PartialAggregate(const TupleLayout& layout, const std::vector<size_t>& group_fields,
+                                   const std::vector<AggregateSpec>& specs)
+    : layout_(&layout), group_fields_(&group_fields), partitions_(kPartitions, AggregateTable(specs)) {}
+
+void PartialAggregate::add(const TupleView& row) {
+    encodeGroupKey(*layout_, row, *group_fields_, key_);
+    uint64_t hash = hashGroupKey(key_);
+    // The top bits pick the partition; the table probes with the low bits
+    partitions_[hash >> 59].add(key_, hash, row);
+}
+
+void encodeGroupKey(const TupleLayout& layout, const TupleView& row, const std::vector<size_t>& fields,
+                    std::string& key) {
+    key.clear();
+    ByteWriter out(key);
+    for (size_t field : fields) {
+        bool is_null = row.isNull(field);
+        out.put<uint8_t>(is_null);
+        if (is_null) continue;
+        switch (layout.fields()[field].type) {
+            case DataType::STRING: out.putBytes32(row.getString(field)); break;
+            case DataType::INT: out.put<int32_t>(row.getInt(field)); break;
+            case DataType::FLOAT: {
+                float value = row.getFloat(field);
+                out.put<float>(value == 0.0f ? 0.0f : value);  // -0 and 0 are one group
+                break;
+            }
+            case DataType::BOOLEAN: out.put<uint8_t>(row.getBool(field)); break;
+        }
+    }
+}
+
+std::vector<FieldValue> decodeGroupKey(std::string_view key, const std::vector<DataType>& types) {
+    ByteReader in(key);
+    std::vector<FieldValue> values;
+    for (DataType type : types) {
+        if (in.get<uint8_t>()) {
+            values.emplace_back();
+            continue;
+        }
+        switch (type) {
+            case DataType::STRING: values.emplace_back(DataValue(std::string(in.getBytes32()))); break;
+            case DataType::INT: values.emplace_back(DataValue(static_cast<int>(in.get<int32_t>()))); break;
+            case DataType::FLOAT: values.emplace_back(DataValue(in.get<float>())); break;
+            case DataType::BOOLEAN: values.emplace_back(DataValue(in.get<uint8_t>() != 0)); break;
+        }
+    }
+    return values;
+}
+
+uint64_t hashGroupKey(std::string_view key) {
+    uint64_t h = key.size() * 0x9e3779b97f4a7c15ULL;
+    size_t i = 0;
+    for (; i + 8 <= key.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, key.data() + i, sizeof(word));
+        h = mix(h ^ word);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, key.data() + i, key.size() - i);
+    return mix(h ^ tail);
+}
+
+std::string aggregateResult(const AggregateSpec& spec, const AggregateState& state) {
+    if (spec.func == AggregateFunc::COUNT) return std::to_string(state.count);
+    if (state.count == 0) return "NULL";
+    switch (spec.func) {
+        case AggregateFunc::SUM:
+            return spec.type == DataType::INT ? std::to_string(state.int_sum) : formatDouble(state.float_sum);
+        case AggregateFunc::AVG: {
+            double sum = spec.type == DataType::INT ? static_cast<double>(state.int_sum) : state.float_sum;
+            return formatDouble(sum / static_cast<double>(state.count));
+        }
+        default:
+            return dataValueToString(*state.extreme);
+    }
+}
+
+int compareAggregates(const AggregateSpec& spec, const AggregateState& a, const AggregateState& b) {
+    auto order = [](auto x, auto y) { return (x > y) - (x < y); };
+    if (spec.func == AggregateFunc::COUNT) return order(a.count, b.count);
+    if (a.count == 0 || b.count == 0) return order(a.count != 0, b.count != 0);
+    switch (spec.func) {
+        case AggregateFunc::SUM:
+            return spec.type == DataType::INT ? order(a.int_sum, b.int_sum) : order(a.float_sum, b.float_sum);
+        case AggregateFunc::AVG: {
+            auto average = [&](const AggregateState& state) {
+                double sum = spec.type == DataType::INT ? static_cast<double>(state.int_sum) : state.float_sum;
+                return sum / static_cast<double>(state.count);
+            };
+            return order(average(a), average(b));
+        }
+        default:
+            return compareValues(*a.extreme, *b.extreme);
+    }
+}
+
+} // namespace minisql
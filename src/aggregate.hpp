@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parser.hpp"
+#include "tuple.hpp"
+
+namespace minisql {
+
+    struct AggregateSpec {
+        static constexpr size_t kNoField = static_cast<size_t>(-1);
+
+        AggregateFunc func;
+        size_t field = kNoField;  // kNoField for COUNT(*)
+        DataType type = DataType::INT;
+    };
+
+    // Running state of one aggregate in one group. NULLs are skipped, so
+    // count is the number of rows for COUNT(*) and of values otherwise.
+    struct AggregateState {
+        int64_t count = 0;
+        int64_t int_sum = 0;
+        double float_sum = 0;
+        FieldValue extreme;  // MIN/MAX so far
+    };
+
+    // Group-by hash table with open addressing: linear probing over a
+    // power-of-two slot array of group numbers, kept at most half full.
+    // Groups are numbered in insertion order and keyed by encodeGroupKey().
+    class AggregateTable {
+    public:
+        explicit AggregateTable(const std::vector<AggregateSpec>& specs);
+
+        // Adds a row to the group with this key
+        void add(std::string_view key, uint64_t hash, const TupleView& row);
+        // Folds the groups of other (built with the same specs) into this table
+        void merge(const AggregateTable& other);
+
+        size_t size() const { return keys_.size(); }
+        const std::string& key(size_t group) const { return keys_[group]; }
+        const AggregateState* states(size_t group) const { return &states_[group * specs_->size()]; }
+
+    private:
+        const std::vector<AggregateSpec>* specs_;
+        std::vector<uint32_t> slots_;  // group number + 1, 0 when empty
+        std::vector<std::string> keys_;
+        std::vector<uint64_t> hashes_;
+        std::vector<AggregateState> states_;  // specs_->size() per group
+
+        size_t findOrInsert(std::string_view key, uint64_t hash);
+        void grow();
+    };
+
+    // One part of a hash aggregation, split by key hash into kPartitions
+    // tables so that the parts built by different threads can be merged one
+    // partition per thread
+    class PartialAggregate {
+    public:
+        static constexpr size_t kPartitions = 32;
+
+        PartialAggregate(const TupleLayout& layout, const std::vector<size_t>& group_fields,
+                         const std::vector<AggregateSpec>& specs);
+
+        void add(const TupleView& row);
+        const AggregateTable& partition(size_t index) const { return partitions_[index]; }
+
+    private:
+        const TupleLayout* layout_;
+        const std::vector<size_t>* group_fields_;
+        std::vector<AggregateTable> partitions_;
+        std::string key_;
+    };
+
+    // Group key: per field a null flag, then the value (4-byte INT/FLOAT,
+    // 1-byte BOOLEAN, or a u32 length and the bytes of a STRING)
+    void encodeGroupKey(const TupleLayout& layout, const TupleView& row, const std::vector<size_t>& fields,
+                        std::string& key);
+    std::vector<FieldValue> decodeGroupKey(std::string_view key, const std::vector<DataType>& types);
+    uint64_t hashGroupKey(std::string_view key);
+
+    // Final value of an aggregate as text, or "NULL"
+    std::string aggregateResult(const AggregateSpec& spec, const AggregateState& state);
+    // Orders two final values of an aggregate (<0, 0, >0); NULL comes first
+    int compareAggregates(const AggregateSpec& spec, const AggregateState& a, const AggregateState& b);
+
+} // namespace minisql
@@ -0,0 +1,154 @@
+#include "batch.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace minisql {
+
+namespace {
+    size_t valueWidth(DataType type) {
+        return type == DataType::BOOLEAN ? 1 : 4;
+    }
+
+    bool testBit(const uint8_t* bitmap, size_t row) {
+        return (bitmap[row / 8] >> (row % 8)) & 1;
+    }
+}
+
+RowBatch::RowBatch(const TupleLayout& layout, std::vector<size_t> fields)
+    : layout_(&layout), fields_(std::move(fields)), columns_(layout.fields().size()), builder_(layout) {
+    for (size_t field = 0; field < columns_.size(); ++field) {
+        columns_[field].vector.type = layout.fields()[field].type;
+    }
+}
+
+RecordId RowBatch::rid(size_t row) const {
+    if (grouped_) return RecordId{page_id_, static_cast<uint16_t>(first_row_ + row)};
+    return rids_[row];
+}
+
+const ColumnVector& RowBatch::column(size_t field) {
+    Column& column = columns_[field];
+    if (!column.ready) {
+        if (grouped_) {
+            decodeChunk(field, column);
+        } else {
+            decodeRecords(field, column);
+        }
+        column.ready = true;
+    }
+    return column.vector;
+}
+
+std::string_view RowBatch::record(size_t row) {
+    if (!grouped_) return records_[row];
+    builder_.reset();
+    for (size_t field : fields_) {
+        const ColumnVector& values = column(field);
+        if (values.nulls && testBit(values.nulls, row)) continue;
+        if (values.type == DataType::STRING) {
+            builder_.setString(field, values.strings[row]);
+        } else {
+            builder_.setFixed(field, values.values + row * valueWidth(values.type));
+        }
+    }
+    return builder_.record();
+}
+
+void RowBatch::exclude(size_t row) {
+    if (excluded_ != own_excluded_.data() || own_excluded_.empty()) {
+        // Padded, since the filters read whole blocks of the bitmap
+        std::vector<uint8_t> bits((size_ + 7) / 8 + 8, 0);
+        if (excluded_) std::copy(excluded_, excluded_ + (size_ + 7) / 8, bits.begin());
+        own_excluded_ = std::move(bits);
+        excluded_ = own_excluded_.data();
+    }
+    own_excluded_[row / 8] |= static_cast<uint8_t>(1u << (row % 8));
+}
+
+void RowBatch::loadRecords(const std::vector<RecordId>& rids, const std::vector<std::string_view>& records) {
+    grouped_ = false;
+    size_ = records.size();
+    excluded_ = nullptr;
+    rids_ = rids;
+    records_ = records;
+    upgraded_.clear();
+    upgraded_.reserve(size_);
+    for (auto& record : records_) {
+        if (TupleLayout::isLegacy(record)) {
+            upgraded_.push_back(layout_->upgrade(record));
+            record = upgraded_.back();
+        }
+    }
+    for (auto& column : columns_) {
+        column.ready = false;
+    }
+}
+
+void RowBatch::loadGroup(PageId page_id, uint32_t first_row, size_t count, const std::vector<ChunkView>& chunks,
+                         uint32_t chunk_row, const uint8_t* deleted) {
+    grouped_ = true;
+    size_ = count;
+    excluded_ = deleted + first_row / 8;
+    page_id_ = page_id;
+    first_row_ = first_row;
+    chunk_offset_ = first_row - chunk_row;
+    chunks_ = &chunks;
+    for (auto& column : columns_) {
+        column.ready = false;
+    }
+}
+
+void RowBatch::decodeRecords(size_t field, Column& column) {
+    DataType type = column.vector.type;
+    size_t width = valueWidth(type);
+    column.nulls.assign((size_ + 7) / 8, 0);
+    if (type == DataType::STRING) {
+        column.strings.assign(size_, std::string_view());
+    } else {
+        column.values.assign(size_ * width, '\0');
+    }
+    for (size_t row = 0; row < size_; ++row) {
+        TupleView view(*layout_, records_[row]);
+        if (view.isNull(field)) {
+            column.nulls[row / 8] = static_cast<uint8_t>(column.nulls[row / 8] | (1 << (row % 8)));
+            continue;
+        }
+        char* out = column.values.data() + row * width;
+        switch (type) {
+            case DataType::INT: {
+                int32_t value = view.getInt(field);
+                std::memcpy(out, &value, sizeof(value));
+                break;
+            }
+            case DataType::FLOAT: {
+                float value = view.getFloat(field);
+                std::memcpy(out, &value, sizeof(value));
+                break;
+            }
+            case DataType::BOOLEAN: *out = view.getBool(field) ? 1 : 0; break;
+            case DataType::STRING: column.strings[row] = view.getString(field); break;
+        }
+    }
+    column.vector.values = column.values.data();
+    column.vector.strings = column.strings.data();
+    column.vector.nulls = column.nulls.data();
+}
+
+void RowBatch::decodeChunk(size_t field, Column& column) {
+    // Batches start on a multiple of 8 rows, so the bitmap is used in place
+    const ChunkView& chunk = (*chunks_)[field];
+    column.vector.nulls = reinterpret_cast<const uint8_t*>(chunk.nulls) + chunk_offset_ / 8;
+    if (column.vector.type != DataType::STRING) {
+        column.vector.values = chunk.values + static_cast<size_t>(chunk_offset_) * valueWidth(column.vector.type);
+        return;
+    }
+    column.strings.resize(size_);
+    for (size_t row = 0; row < size_; ++row) {
+        uint32_t offsets[2];
+        std::memcpy(offsets, chunk.values + (chunk_offset_ + row) * sizeof(uint32_t), sizeof(offsets));
+        column.strings[row] = std::string_view(chunk.strings + offsets[0], offsets[1] - offsets[0]);
+    }
+    column.vector.strings = column.strings.data();
+}
+
+} // namespace minisql
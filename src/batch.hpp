@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "page.hpp"
+#include "tuple.hpp"
+#include "types.hpp"
+
+namespace minisql {
+
+    // One column's values across a batch, in the column chunk format (see
+    // ColumnStore): 4-byte INT/FLOAT or 1-byte BOOLEAN values, with nulls
+    // marked in a bitmap (bit set = null) and holding zero
+    struct ColumnVector {
+        DataType type = DataType::INT;
+        const char* values = nullptr;               // INT/FLOAT/BOOLEAN
+        const std::string_view* strings = nullptr;  // STRING
+        const uint8_t* nulls = nullptr;             // null when no row is null
+    };
+
+    // Where the rows of one column of a row group are in memory, starting at
+    // some row of the group (see ColumnStore for the chunk format): the null
+    // bitmap, the values or, for STRING, the u32 offsets, and the string bytes
+    // those offsets point into
+    struct ChunkView {
+        const char* nulls = nullptr;
+        const char* values = nullptr;
+        const char* strings = nullptr;
+    };
+
+    // A batch of rows handed to a vectorized scan: either the records of one
+    // heap page, or up to kBatchSize rows of a row group, whose columns are
+    // then used straight from the chunks. Only the scanned fields can be read.
+    class RowBatch {
+    public:
+        static constexpr size_t kBatchSize = 1024;
+
+        RowBatch(const TupleLayout& layout, std::vector<size_t> fields);
+        RowBatch(const RowBatch&) = delete;
+        RowBatch& operator=(const RowBatch&) = delete;
+
+        const TupleLayout& layout() const { return *layout_; }
+        const std::vector<size_t>& fields() const { return fields_; }
+
+        size_t size() const { return size_; }
+        RecordId rid(size_t row) const;
+        // Rows to skip, such as deleted group rows (bit set = skip); may be null
+        const uint8_t* excluded() const { return excluded_; }
+        // Skips one more row of the loaded batch
+        void exclude(size_t row);
+        // Heap rows are decoded on first use
+        const ColumnVector& column(size_t field);
+        // Valid until the next call for group rows, which are rebuilt from the
+        // scanned fields
+        std::string_view record(size_t row);
+
+        // Producers
+        void loadRecords(const std::vector<RecordId>& rids, const std::vector<std::string_view>& records);
+        // Rows [first_row, first_row + count) of a row group. chunks[field]
+        // locates, for every scanned field, the rows from chunk_row on; both
+        // first rows are multiples of 8. deleted is the group's delete bitmap.
+        void loadGroup(PageId page_id, uint32_t first_row, size_t count, const std::vector<ChunkView>& chunks,
+                       uint32_t chunk_row, const uint8_t* deleted);
+
+    private:
+        struct Column {
+            bool ready = false;
+            ColumnVector vector;
+            std::string values;
+            std::vector<std::string_view> strings;
+            std::vector<uint8_t> nulls;
+        };
+
+        const TupleLayout* layout_;
+        std::vector<size_t> fields_;
+        std::vector<Column> columns_;  // by field
+        size_t size_ = 0;
+        const uint8_t* excluded_ = nullptr;
+        std::vector<uint8_t> own_excluded_;  // excluded_ once exclude() has been called
+
+        // Heap page
+        std::vector<RecordId> rids_;
+        std::vector<std::string_view> records_;
+        std::vector<std::string> upgraded_;  // legacy records in the current format
+
+        // Row group
+        bool grouped_ = false;
+        PageId page_id_ = 0;
+        uint32_t first_row_ = 0;
+        uint32_t chunk_offset_ = 0;  // of the batch's first row within the chunks
+        const std::vector<ChunkView>* chunks_ = nullptr;
+        TupleBuilder builder_;
+
+        void decodeRecords(size_t field, Column& column);
+        void decodeChunk(size_t field, Column& column);
+    };
+
+} // namespace minisql
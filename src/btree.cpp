@@ -0,0 +1,321 @@
+#include "btree.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace minisql {
+
+namespace {
+    constexpr char kTreeMagic[8] = {'M', 'S', 'Q', 'L', 'B', 'T', 'R', 'E'};
+    constexpr size_t kNodeHeaderSize = 12;
+    // Bulk-loaded nodes are left partly empty so later inserts do not split at once
+    constexpr size_t kBulkFillBytes = kPageSize * 9 / 10;
+
+    template <typename T>
+    T load(const char* data) {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void store(char* data, T value) {
+        std::memcpy(data, &value, sizeof(T));
+    }
+}
+
+BPlusTree::BPlusTree(const std::string& path, BufferPool& pool, uint32_t format_version)
+    : file_(path), pool_(pool), format_version_(format_version), stored_version_(format_version) {
+    if (file_.pageCount() == 0) {
+        initEmpty();
+        return;
+    }
+    auto meta = pool_.fetch(file_, 0);
+    if (std::memcmp(meta.data(), kTreeMagic, sizeof(kTreeMagic)) != 0) {
+        throw std::runtime_error("Not an index file: " + path);
+    }
+    root_ = load<PageId>(meta.data() + 8);
+    page_count_ = load<PageId>(meta.data() + 12);
+    stored_version_ = load<uint32_t>(meta.data() + 16);
+}
+
+BPlusTree::~BPlusTree() {
+    try {
+        pool_.flush(file_);
+    } catch (...) {
+    }
+    pool_.discard(file_);
+}
+
+bool BPlusTree::insert(const std::string& key) {
+    if (key.size() > kMaxKeySize) {
+        throw std::runtime_error("Index key too large (" + std::to_string(key.size()) + " bytes)");
+    }
+    bool inserted = false;
+    auto split = insertInto(root_, key, inserted);
+    if (split) {
+        Node root;
+        root.leaf = false;
+        root.leftmost = root_;
+        root.keys.push_back(split->first);
+        root.children.push_back(split->second);
+        root_ = allocatePage();
+        writeNode(root_, root);
+        writeMeta();
+    }
+    return inserted;
+}
+
+bool BPlusTree::erase(const std::string& key) {
+    PageId leaf_id = findLeaf(key);
+    Node leaf = readNode(leaf_id);
+    auto it = std::lower_bound(leaf.keys.begin(), leaf.keys.end(), key);
+    if (it == leaf.keys.end() || *it != key) {
+        return false;
+    }
+    leaf.keys.erase(it);
+    writeNode(leaf_id, leaf);
+    return true;
+}
+
+void BPlusTree::scanFrom(const std::string& from, const std::function<bool(std::string_view)>& visitor) {
+    PageId leaf_id = findLeaf(from);
+    Node leaf = readNode(leaf_id);
+    size_t pos = std::lower_bound(leaf.keys.begin(), leaf.keys.end(), from) - leaf.keys.begin();
+    while (true) {
+        for (; pos < leaf.keys.size(); ++pos) {
+            if (!visitor(leaf.keys[pos])) return;
+        }
+        if (leaf.next == kInvalidPageId) return;
+        leaf = readNode(leaf.next);
+        pos = 0;
+    }
+}
+
+void BPlusTree::bulkLoad(std::vector<std::string> keys) {
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (const auto& key : keys) {
+        if (key.size() > kMaxKeySize) {
+            throw std::runtime_error("Index key too large (" + std::to_string(key.size()) + " bytes)");
+        }
+    }
+    pool_.discard(file_);
+    file_.truncate(0);
+    page_count_ = 1;
+
+    // Leaf level: (first key, page) of every node built so far
+    std::vector<std::pair<std::string, PageId>> level;
+    Node node;
+    PageId node_id = allocatePage();
+    for (auto& key : keys) {
+        node.keys.push_back(std::move(key));
+        if (encodedSize(node) > kBulkFillBytes && node.keys.size() > 1) {
+            std::string overflow = std::move(node.keys.back());
+            node.keys.pop_back();
+            PageId next_id = allocatePage();
+            node.next = next_id;
+            level.emplace_back(node.keys.front(), node_id);
+            writeNode(node_id, node);
+            node = Node();
+            node.keys.push_back(std::move(overflow));
+            node_id = next_id;
+        }
+    }
+    level.emplace_back(node.keys.empty() ? std::string() : node.keys.front(), node_id);
+    writeNode(node_id, node);
+
+    // Internal levels until a single root remains
+    while (level.size() > 1) {
+        std::vector<std::pair<std::string, PageId>> parents;
+        Node parent;
+        parent.leaf = false;
+        std::string parent_first;
+        for (auto& [first_key, child] : level) {
+            if (parent.leftmost == kInvalidPageId) {
+                parent.leftmost = child;
+                parent_first = first_key;
+                continue;
+            }
+            parent.keys.push_back(first_key);
+            parent.children.push_back(child);
+            if (encodedSize(parent) > kBulkFillBytes) {
+                parent.keys.pop_back();
+                parent.children.pop_back();
+                PageId parent_id = allocatePage();
+                writeNode(parent_id, parent);
+                parents.emplace_back(parent_first, parent_id);
+                parent = Node();
+                parent.leaf = false;
+                parent.leftmost = child;
+                parent_first = first_key;
+            }
+        }
+        PageId parent_id = allocatePage();
+        writeNode(parent_id, parent);
+        parents.emplace_back(parent_first, parent_id);
+        level = std::move(parents);
+    }
+    root_ = level.front().second;
+    writeMeta();
+}
+
+void BPlusTree::clear() {
+    pool_.discard(file_);
+    file_.truncate(0);
+    initEmpty();
+}
+
+void BPlusTree::sync() {
+    pool_.flush(file_);
+    file_.sync();
+}
+
+BPlusTree::Node BPlusTree::readNode(PageId page_id) {
+    auto handle = pool_.fetch(file_, page_id);
+    const char* data = handle.data();
+    Node node;
+    node.leaf = data[0] != 0;
+    uint16_t count = load<uint16_t>(data + 2);
+    node.next = load<PageId>(data + 4);
+    node.leftmost = load<PageId>(data + 8);
+    node.keys.reserve(count);
+    size_t pos = kNodeHeaderSize;
+    for (uint16_t i = 0; i < count; ++i) {
+        uint16_t length = load<uint16_t>(data + pos);
+        node.keys.emplace_back(data + pos + 2, length);
+        pos += 2 + length;
+        if (!node.leaf) {
+            node.children.push_back(load<PageId>(data + pos));
+            pos += sizeof(PageId);
+        }
+    }
+    return node;
+}
+
+void BPlusTree::writeNode(PageId page_id, const Node& node) {
+    if (encodedSize(node) > kPageSize) {
+        throw std::runtime_error("B+tree node overflow in " + file_.path());
+    }
+    auto handle = pool_.fetch(file_, page_id);
+    char* data = handle.data();
+    std::memset(data, 0, kPageSize);
+    data[0] = node.leaf ? 1 : 0;
+    store<uint16_t>(data + 2, static_cast<uint16_t>(node.keys.size()));
+    store<PageId>(data + 4, node.next);
+    store<PageId>(data + 8, node.leftmost);
+    size_t pos = kNodeHeaderSize;
+    for (size_t i = 0; i < node.keys.size(); ++i) {
+        store<uint16_t>(data + pos, static_cast<uint16_t>(node.keys[i].size()));
+        std::memcpy(data + pos + 2, node.keys[i].data(), node.keys[i].size());
+        pos += 2 + node.keys[i].size();
+        if (!node.leaf) {
+            store<PageId>(data + pos, node.children[i]);
+            pos += sizeof(PageId);
+        }
+    }
+    handle.markDirty(0, nullptr);
+}
+
+size_t BPlusTree::encodedSize(const Node& node) {
+    size_t size = kNodeHeaderSize;
+    for (const auto& key : node.keys) {
+        size += 2 + key.size() + (node.leaf ? 0 : sizeof(PageId));
+    }
+    return size;
+}
+
+PageId BPlusTree::allocatePage() {
+    return page_count_++;
+}
+
+void BPlusTree::writeMeta() {
+    auto meta = pool_.fetch(file_, 0);
+    std::memset(meta.data(), 0, kPageSize);
+    std::memcpy(meta.data(), kTreeMagic, sizeof(kTreeMagic));
+    store<PageId>(meta.data() + 8, root_);
+    store<PageId>(meta.data() + 12, page_count_);
+    store<uint32_t>(meta.data() + 16, format_version_);
+    stored_version_ = format_version_;
+    meta.markDirty(0, nullptr);
+}
+
+void BPlusTree::initEmpty() {
+    page_count_ = 1;
+    root_ = allocatePage();
+    writeNode(root_, Node());
+    writeMeta();
+}
+
+PageId BPlusTree::findLeaf(const std::string& key) {
+    PageId page_id = root_;
+    while (true) {
+        Node node = readNode(page_id);
+        if (node.leaf) return page_id;
+        size_t pos = std::upper_bound(node.keys.begin(), node.keys.end(), key) - node.keys.begin();
+        page_id = pos == 0 ? node.leftmost : node.children[pos - 1];
+    }
+}
+
+std::optional<std::pair<std::string, PageId>> BPlusTree::insertInto(PageId page_id, const std::string& key, bool& inserted) {
+    Node node = readNode(page_id);
+    if (node.leaf) {
+        auto it = std::lower_bound(node.keys.begin(), node.keys.end(), key);
+        if (it != node.keys.end() && *it == key) {
+            return std::nullopt;
+        }
+        node.keys.insert(it, key);
+        inserted = true;
+    } else {
+        size_t pos = std::upper_bound(node.keys.begin(), node.keys.end(), key) - node.keys.begin();
+        PageId child = pos == 0 ? node.leftmost : node.children[pos - 1];
+        auto child_split = insertInto(child, key, inserted);
+        if (!child_split) {
+            return std::nullopt;
+        }
+        node.keys.insert(node.keys.begin() + pos, child_split->first);
+        node.children.insert(node.children.begin() + pos, child_split->second);
+    }
+    if (encodedSize(node) <= kPageSize) {
+        writeNode(page_id, node);
+        return std::nullopt;
+    }
+    return split(page_id, node);
+}
+
+std::pair<std::string, PageId> BPlusTree::split(PageId page_id, Node& node) {
+    // Split at the byte midpoint so variable-length keys balance both halves
+    size_t half = encodedSize(node) / 2;
+    size_t size = kNodeHeaderSize;
+    size_t mid = 0;
+    while (mid + 1 < node.keys.size() && size < half) {
+        size += 2 + node.keys[mid].size() + (node.leaf ? 0 : sizeof(PageId));
+        ++mid;
+    }
+    mid = std::max<size_t>(mid, 1);
+
+    Node right;
+    right.leaf = node.leaf;
+    PageId right_id = allocatePage();
+    std::string separator;
+    if (node.leaf) {
+        right.keys.assign(node.keys.begin() + mid, node.keys.end());
+        right.next = node.next;
+        node.next = right_id;
+        separator = right.keys.front();
+    } else {
+        // The middle key moves up; its child becomes the right node's leftmost
+        separator = node.keys[mid];
+        right.leftmost = node.children[mid];
+        right.keys.assign(node.keys.begin() + mid + 1, node.keys.end());
+        right.children.assign(node.children.begin() + mid + 1, node.children.end());
+        node.children.resize(mid);
+    }
+    node.keys.resize(mid);
+    writeNode(page_id, node);
+    writeNode(right_id, right);
+    writeMeta();
+    return {separator, right_id};
+}
+
+} // namespace minisql
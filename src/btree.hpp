@@ -0,0 +1,72 @@
+#pragma once
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "buffer_pool.hpp"
+#include "disk_manager.hpp"
+
+namespace minisql {
+
+    // Disk-based B+tree over unique, memcmp-ordered byte-string keys, stored in
+    // its own file and cached through the BufferPool.
+    //
+    // Page 0 is a meta page (magic, root page id, page count); every other page
+    // is a node. Leaves are chained left to right for range scans. Deletes
+    // simply remove the key from its leaf: under-full nodes are not merged,
+    // which keeps the code small and never changes the tree height.
+    //
+    // Index pages are not WAL-logged. After crash recovery touches a table its
+    // indexes are rebuilt from the heap (see Table::finishRecovery).
+    class BPlusTree {
+    public:
+        static constexpr size_t kMaxKeySize = 512;
+
+        // format_version is an owner-defined tag kept in the meta page; a tree
+        // written with another version reports it through formatVersion()
+        BPlusTree(const std::string& path, BufferPool& pool, uint32_t format_version = 0);
+        ~BPlusTree();
+
+        // Returns false if the key is already present
+        bool insert(const std::string& key);
+        bool erase(const std::string& key);
+        // Visits keys >= from in ascending order until the visitor returns false
+        void scanFrom(const std::string& from, const std::function<bool(std::string_view)>& visitor);
+        // Replaces the contents with the given keys, building the tree bottom-up
+        void bulkLoad(std::vector<std::string> keys);
+        void clear();
+        void sync();
+
+        const std::string& path() const { return file_.path(); }
+        uint32_t formatVersion() const { return stored_version_; }
+
+    private:
+        struct Node {
+            bool leaf = true;
+            PageId next = kInvalidPageId;      // leaf: right sibling
+            PageId leftmost = kInvalidPageId;  // internal: child for keys < keys[0]
+            std::vector<std::string> keys;
+            std::vector<PageId> children;      // internal: children[i] holds keys >= keys[i]
+        };
+
+        DiskManager file_;
+        BufferPool& pool_;
+        PageId root_ = kInvalidPageId;
+        PageId page_count_ = 0;
+        uint32_t format_version_;
+        uint32_t stored_version_;
+
+        Node readNode(PageId page_id);
+        void writeNode(PageId page_id, const Node& node);
+        static size_t encodedSize(const Node& node);
+        PageId allocatePage();
+        void writeMeta();
+        void initEmpty();
+        PageId findLeaf(const std::string& key);
+        std::optional<std::pair<std::string, PageId>> insertInto(PageId page_id, const std::string& key, bool& inserted);
+        std::pair<std::string, PageId> split(PageId page_id, Node& node);
+    };
+
+} // namespace minisql
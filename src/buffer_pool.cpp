@@ -0,0 +1,187 @@
+#include "buffer_pool.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace minisql {
+
+namespace {
+    constexpr size_t kMinFrames = 16;
+}
+
+BufferPool::PageHandle& BufferPool::PageHandle::operator=(PageHandle&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        frame_ = other.frame_;
+        other.pool_ = nullptr;
+        other.frame_ = nullptr;
+    }
+    return *this;
+}
+
+char* BufferPool::PageHandle::data() const {
+    return frame_->data.get();
+}
+
+void BufferPool::PageHandle::markDirty(Lsn lsn, WriteAheadLog* wal) {
+    pool_->markDirty(frame_, lsn, wal);
+}
+
+void BufferPool::PageHandle::release() {
+    if (pool_ && frame_) {
+        pool_->unpin(frame_);
+    }
+    pool_ = nullptr;
+    frame_ = nullptr;
+}
+
+BufferPool::BufferPool(size_t capacity_bytes) {
+    setCapacity(capacity_bytes);
+}
+
+BufferPool::~BufferPool() = default;
+
+BufferPool::PageHandle BufferPool::fetch(DiskManager& file, PageId page_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameKey key{&file, page_id};
+    auto it = frames_.find(key);
+    Frame* frame;
+    if (it != frames_.end()) {
+        frame = it->second.get();
+        if (frame->pin_count == 0) {
+            evictable_.erase({evictionKey(frame), frame});
+        }
+        ++stats_.hits;
+    } else {
+        ++stats_.misses;
+        while (frames_.size() >= capacity_frames_ && evictOne()) {
+        }
+        auto owned = std::make_unique<Frame>();
+        owned->file = &file;
+        owned->page_id = page_id;
+        owned->data = std::make_unique<char[]>(kPageSize);
+        if (page_id < file.pageCount()) {
+            file.readPage(page_id, owned->data.get());
+        } else {
+            std::memset(owned->data.get(), 0, kPageSize);
+        }
+        frame = owned.get();
+        frames_.emplace(key, std::move(owned));
+    }
+    ++frame->pin_count;
+    // Shift the access history; history[0] is the K-th most recent reference
+    std::rotate(frame->history.begin(), frame->history.begin() + 1, frame->history.end());
+    frame->history[kK - 1] = ++clock_;
+    ++frame->references;
+
+    PageHandle handle;
+    handle.pool_ = this;
+    handle.frame_ = frame;
+    return handle;
+}
+
+void BufferPool::flush(DiskManager& file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto dirty = dirty_.find(&file);
+    if (dirty == dirty_.end()) return;
+    std::set<PageId> pages = dirty->second;
+    for (PageId page_id : pages) {
+        Frame* frame = frames_.at(FrameKey{&file, page_id}).get();
+        if (!frame->wal || frame->lsn <= frame->wal->durableLsn()) {
+            writeBack(frame);
+        }
+    }
+}
+
+void BufferPool::discard(DiskManager& file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = frames_.begin(); it != frames_.end();) {
+        if (it->first.file != &file) {
+            ++it;
+            continue;
+        }
+        Frame* frame = it->second.get();
+        if (frame->pin_count > 0) {
+            throw std::runtime_error("Cannot discard pinned page " + std::to_string(frame->page_id));
+        }
+        evictable_.erase({evictionKey(frame), frame});
+        it = frames_.erase(it);
+    }
+    dirty_.erase(&file);
+}
+
+void BufferPool::setCapacity(size_t capacity_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_frames_ = std::max(kMinFrames, capacity_bytes / kPageSize);
+    while (frames_.size() > capacity_frames_ && evictOne()) {
+    }
+}
+
+size_t BufferPool::capacityBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_frames_ * kPageSize;
+}
+
+size_t BufferPool::residentBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frames_.size() * kPageSize;
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BufferPool::unpin(Frame* frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--frame->pin_count == 0) {
+        evictable_.insert({evictionKey(frame), frame});
+        if (frames_.size() > capacity_frames_) {
+            evictOne();
+        }
+    }
+}
+
+void BufferPool::markDirty(Frame* frame, Lsn lsn, WriteAheadLog* wal) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame->dirty = true;
+    frame->lsn = std::max(frame->lsn, lsn);
+    if (wal) frame->wal = wal;
+    dirty_[frame->file].insert(frame->page_id);
+}
+
+std::pair<bool, uint64_t> BufferPool::evictionKey(const Frame* frame) const {
+    // Frames with fewer than K references have an infinite K-distance and sort first
+    return {frame->references >= kK, frame->history[frame->references >= kK ? 0 : kK - frame->references]};
+}
+
+bool BufferPool::evictOne() {
+    for (auto it = evictable_.begin(); it != evictable_.end(); ++it) {
+        Frame* frame = it->second;
+        if (frame->dirty && frame->wal && frame->lsn > frame->wal->durableLsn()) {
+            continue;  // uncommitted change: must stay in memory
+        }
+        if (frame->dirty) {
+            writeBack(frame);
+        }
+        evictable_.erase(it);
+        frames_.erase(FrameKey{frame->file, frame->page_id});
+        ++stats_.evictions;
+        return true;
+    }
+    return false;
+}
+
+void BufferPool::writeBack(Frame* frame) {
+    frame->file->writePage(frame->page_id, frame->data.get());
+    frame->dirty = false;
+    auto dirty = dirty_.find(frame->file);
+    if (dirty != dirty_.end()) {
+        dirty->second.erase(frame->page_id);
+        if (dirty->second.empty()) dirty_.erase(dirty);
+    }
+    ++stats_.writebacks;
+}
+
+} // namespace minisql
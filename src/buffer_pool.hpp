@@ -0,0 +1,118 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include "disk_manager.hpp"
+#include "wal.hpp"
+
+namespace minisql {
+
+    // Shared cache of pages from any number of files, bounded by a byte budget.
+    //
+    // Replacement is LRU-K (K = 2): the victim is the unpinned frame whose K-th
+    // most recent access is oldest, and frames referenced fewer than K times
+    // go first. A table scan touches each page once, so it cycles through the
+    // cold frames and does not push out pages that are used repeatedly.
+    //
+    // Dirty frames remember the WAL and LSN of their last change and are only
+    // written back (on eviction, flush or checkpoint) once that LSN is durable.
+    // Frames whose changes are not yet committed are never evicted; if every
+    // frame is pinned or uncommitted the pool grows past its budget until the
+    // next commit lets it shrink again.
+    class BufferPool {
+    public:
+        static constexpr size_t kK = 2;
+
+        struct Stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            uint64_t writebacks = 0;
+        };
+
+    private:
+        struct Frame {
+            DiskManager* file = nullptr;
+            PageId page_id = kInvalidPageId;
+            std::unique_ptr<char[]> data;
+            int pin_count = 0;
+            bool dirty = false;
+            Lsn lsn = 0;
+            WriteAheadLog* wal = nullptr;
+            std::array<uint64_t, kK> history{};
+            size_t references = 0;
+        };
+
+    public:
+        class PageHandle {
+        public:
+            PageHandle() = default;
+            PageHandle(PageHandle&& other) noexcept { *this = std::move(other); }
+            PageHandle& operator=(PageHandle&& other) noexcept;
+            PageHandle(const PageHandle&) = delete;
+            PageHandle& operator=(const PageHandle&) = delete;
+            ~PageHandle() { release(); }
+
+            char* data() const;
+            // Records a change; wal may be null for unlogged files
+            void markDirty(Lsn lsn, WriteAheadLog* wal);
+            void release();
+
+        private:
+            friend class BufferPool;
+            BufferPool* pool_ = nullptr;
+            Frame* frame_ = nullptr;
+        };
+
+        explicit BufferPool(size_t capacity_bytes);
+        ~BufferPool();
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        // Pins a page, reading it on a miss (pages past end of file read as zeros)
+        PageHandle fetch(DiskManager& file, PageId page_id);
+        // Writes back the file's dirty frames whose changes are durable
+        void flush(DiskManager& file);
+        // Forgets every frame of the file without writing it
+        void discard(DiskManager& file);
+
+        void setCapacity(size_t capacity_bytes);
+        size_t capacityBytes() const;
+        size_t residentBytes() const;
+        Stats stats() const;
+
+    private:
+        struct FrameKey {
+            DiskManager* file;
+            PageId page_id;
+            bool operator==(const FrameKey& other) const {
+                return file == other.file && page_id == other.page_id;
+            }
+        };
+        struct FrameKeyHash {
+            size_t operator()(const FrameKey& key) const {
+                return std::hash<const void*>()(key.file) * 31 + key.page_id;
+            }
+        };
+
+        mutable std::mutex mutex_;
+        size_t capacity_frames_;
+        uint64_t clock_ = 0;
+        std::unordered_map<FrameKey, std::unique_ptr<Frame>, FrameKeyHash> frames_;
+        // Unpinned frames ordered for eviction: (fewer than K refs, oldest kept timestamp)
+        std::set<std::pair<std::pair<bool, uint64_t>, Frame*>> evictable_;
+        std::unordered_map<DiskManager*, std::set<PageId>> dirty_;
+        Stats stats_;
+
+        void unpin(Frame* frame);
+        void markDirty(Frame* frame, Lsn lsn, WriteAheadLog* wal);
+        std::pair<bool, uint64_t> evictionKey(const Frame* frame) const;
+        bool evictOne();
+        void writeBack(Frame* frame);
+    };
+
+} // namespace minisql
@@ -0,0 +1,277 @@
+#include "bulk_load.hpp"
+#include "page.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace minisql {
+
+namespace {
+    [[noreturn]] void fail(size_t line, const std::string& message) {
+        throw std::runtime_error("Line " + std::to_string(line) + ": " + message);
+    }
+
+    bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return std::toupper(static_cast<unsigned char>(x)) == std::toupper(static_cast<unsigned char>(y));
+        });
+    }
+
+    // Sets a field from its text; false if the text is no value of the type
+    bool setText(TupleBuilder& builder, size_t field, DataType type, std::string_view text) {
+        switch (type) {
+            case DataType::STRING:
+                builder.setString(field, text);
+                return true;
+            case DataType::INT: {
+                int32_t value;
+                if (!parseNumber(text, value)) return false;
+                builder.setFixed(field, reinterpret_cast<const char*>(&value));
+                return true;
+            }
+            case DataType::FLOAT: {
+                float value;
+                if (!parseNumber(text, value)) return false;
+                builder.setFixed(field, reinterpret_cast<const char*>(&value));
+                return true;
+            }
+            case DataType::BOOLEAN: {
+                bool is_true = equalsIgnoreCase(text, "true");
+                if (!is_true && !equalsIgnoreCase(text, "false")) return false;
+                char value = is_true ? 1 : 0;
+                builder.setFixed(field, &value);
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+BulkParser::BulkParser(std::string_view text, OutputFormat format, bool header, const TupleLayout& layout)
+    : text_(text), format_(format), layout_(layout) {
+    if (format_ == OutputFormat::TABLE) {
+        throw std::runtime_error("COPY reads CSV, TSV or JSON lines");
+    }
+    // A UTF-8 byte order mark is not part of the data
+    if (text_.substr(0, 3) == "\xEF\xBB\xBF") text_.remove_prefix(3);
+
+    size_t pos = 0;
+    size_t line = 1;
+    if (format_ != OutputFormat::JSON_LINES && header) {
+        std::vector<std::string> names;
+        std::vector<bool> nulls;
+        readFields(pos, line, names, nulls);
+        for (const auto& name : names) {
+            auto field = layout_.findField(name);
+            if (!field) fail(1, "Unknown column in header: " + name);
+            if (std::find(columns_.begin(), columns_.end(), *field) != columns_.end()) {
+                fail(1, "Column named twice in header: " + name);
+            }
+            columns_.push_back(*field);
+        }
+    } else {
+        for (size_t field = 0; field < layout_.fields().size(); ++field) {
+            columns_.push_back(field);
+        }
+    }
+    split(pos, line);
+}
+
+std::vector<std::string> BulkParser::parse(const Chunk& chunk) const {
+    std::vector<std::string> records;
+    TupleBuilder builder(layout_);
+    size_t pos = chunk.begin;
+    size_t line = chunk.first_line;
+    std::vector<std::string> fields;
+    std::vector<bool> nulls;
+    while (pos < chunk.end) {
+        size_t record_line = line;
+        // Blank lines hold no row
+        size_t blank = pos;
+        if (text_[blank] == '\r') ++blank;
+        if (blank < chunk.end && text_[blank] == '\n') {
+            pos = blank + 1;
+            ++line;
+            continue;
+        }
+
+        builder.reset();
+        if (format_ == OutputFormat::JSON_LINES) {
+            size_t end = std::min(text_.find('\n', pos), chunk.end);
+            std::string_view row = text_.substr(pos, end - pos);
+            if (!row.empty() && row.back() == '\r') row.remove_suffix(1);
+            parseJson(row, builder, record_line);
+            pos = end + 1;
+            ++line;
+        } else {
+            readFields(pos, line, fields, nulls);
+            if (fields.size() != columns_.size()) {
+                fail(record_line, "Expected " + std::to_string(columns_.size()) + " values, found " +
+                                      std::to_string(fields.size()));
+            }
+            for (size_t i = 0; i < fields.size(); ++i) {
+                if (nulls[i]) continue;
+                const TableField& field = layout_.fields()[columns_[i]];
+                if (!setText(builder, columns_[i], field.type, fields[i])) {
+                    fail(record_line, "Invalid value for field " + field.name);
+                }
+            }
+        }
+        std::string_view record = builder.record();
+        if (record.size() > SlottedPage::maxRecordSize()) {
+            fail(record_line, "Row too large (" + std::to_string(record.size()) + " bytes)");
+        }
+        records.emplace_back(record);
+    }
+    return records;
+}
+
+void BulkParser::readFields(size_t& pos, size_t& line, std::vector<std::string>& fields,
+                            std::vector<bool>& nulls) const {
+    bool csv = format_ == OutputFormat::CSV;
+    char separator = csv ? ',' : '\t';
+    size_t count = 0;
+    while (true) {
+        if (fields.size() <= count) fields.emplace_back();
+        if (nulls.size() <= count) nulls.push_back(false);
+        std::string& value = fields[count];
+        value.clear();
+        bool is_null = false;
+        if (csv && pos < text_.size() && text_[pos] == '"') {
+            // Quoted: "" stands for a quote, and separators and newlines are text
+            ++pos;
+            while (true) {
+                size_t quote = text_.find('"', pos);
+                if (quote == std::string_view::npos) fail(line, "Unterminated quoted value");
+                std::string_view part = text_.substr(pos, quote - pos);
+                line += static_cast<size_t>(std::count(part.begin(), part.end(), '\n'));
+                value.append(part);
+                pos = quote + 1;
+                if (pos < text_.size() && text_[pos] == '"') {
+                    value += '"';
+                    ++pos;
+                    continue;
+                }
+                break;
+            }
+            if (pos < text_.size() && text_[pos] != ',' && text_[pos] != '\r' && text_[pos] != '\n') {
+                fail(line, "Unexpected text after a quoted value");
+            }
+        } else {
+            size_t end = std::min(text_.find_first_of(csv ? ",\n" : "\t\n", pos), text_.size());
+            std::string_view raw = text_.substr(pos, end - pos);
+            if (!raw.empty() && raw.back() == '\r' && (end == text_.size() || text_[end] == '\n')) {
+                raw.remove_suffix(1);
+            }
+            pos = end;
+            if (csv) {
+                is_null = raw.empty();
+                value.assign(raw);
+            } else if (raw == "\\N") {
+                is_null = true;
+            } else {
+                for (size_t i = 0; i < raw.size(); ++i) {
+                    if (raw[i] != '\\' || i + 1 == raw.size()) {
+                        value += raw[i];
+                        continue;
+                    }
+                    switch (raw[++i]) {
+                        case 't': value += '\t'; break;
+                        case 'n': value += '\n'; break;
+                        case 'r': value += '\r'; break;
+                        default: value += raw[i];
+                    }
+                }
+            }
+        }
+        nulls[count++] = is_null;
+        if (pos < text_.size() && text_[pos] == separator) {
+            ++pos;
+            continue;
+        }
+        if (pos < text_.size() && text_[pos] == '\r') ++pos;
+        if (pos < text_.size() && text_[pos] == '\n') {
+            ++pos;
+            ++line;
+        }
+        fields.resize(count);
+        nulls.resize(count);
+        return;
+    }
+}
+
+void BulkParser::parseJson(std::string_view line, TupleBuilder& builder, size_t line_number) const {
+    json row = json::parse(line.begin(), line.end(), nullptr, false);
+    if (!row.is_object()) fail(line_number, row.is_discarded() ? "Invalid JSON" : "Expected a JSON object");
+    for (const auto& [key, value] : row.items()) {
+        auto field = layout_.findField(key);
+        if (!field) fail(line_number, "Unknown column: " + key);
+        if (value.is_null()) continue;
+        const TableField& column = layout_.fields()[*field];
+        bool valid = false;
+        switch (column.type) {
+            case DataType::STRING:
+                if ((valid = value.is_string())) builder.setString(*field, value.get_ref<const std::string&>());
+                break;
+            case DataType::INT:
+                if (value.is_number_unsigned()) {
+                    valid = value.get<uint64_t>() <= static_cast<uint64_t>(std::numeric_limits<int32_t>::max());
+                } else if (value.is_number_integer()) {
+                    valid = value.get<int64_t>() >= std::numeric_limits<int32_t>::min() &&
+                            value.get<int64_t>() <= std::numeric_limits<int32_t>::max();
+                }
+                if (valid) {
+                    int32_t number = static_cast<int32_t>(value.get<int64_t>());
+                    builder.setFixed(*field, reinterpret_cast<const char*>(&number));
+                }
+                break;
+            case DataType::FLOAT:
+                if ((valid = value.is_number())) {
+                    float number = value.get<float>();
+                    builder.setFixed(*field, reinterpret_cast<const char*>(&number));
+                }
+                break;
+            case DataType::BOOLEAN:
+                if ((valid = value.is_boolean())) {
+                    char flag = value.get<bool>() ? 1 : 0;
+                    builder.setFixed(*field, &flag);
+                }
+                break;
+        }
+        if (!valid) fail(line_number, "Invalid value for field " + column.name);
+    }
+}
+
+void BulkParser::split(size_t begin, size_t line) {
+    size_t pos = begin;
+    while (pos < text_.size()) {
+        Chunk chunk{pos, text_.size(), line};
+        size_t target = std::min(text_.size(), pos + kChunkBytes);
+        if (format_ == OutputFormat::CSV) {
+            // Newlines inside quotes do not end a record
+            bool quoted = false;
+            size_t next = pos;
+            while ((next = text_.find_first_of("\"\n", next)) != std::string_view::npos) {
+                if (text_[next++] == '"') {
+                    quoted = !quoted;
+                    continue;
+                }
+                ++line;
+                if (!quoted && next >= target) {
+                    chunk.end = next;
+                    break;
+                }
+            }
+        } else {
+            size_t newline = text_.find('\n', std::max(target, pos + 1) - 1);
+            if (newline != std::string_view::npos) chunk.end = newline + 1;
+            line += static_cast<size_t>(std::count(text_.begin() + pos, text_.begin() + chunk.end, '\n'));
+        }
+        chunks_.push_back(chunk);
+        pos = chunk.end;
+    }
+}
+
+} // namespace minisql
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "result_sink.hpp"
+#include "tuple.hpp"
+
+namespace minisql {
+
+    // Turns the text of a COPY FROM into records of a table, in any of the
+    // formats SELECT prints except TABLE. The text is cut into chunks of about
+    // kChunkBytes that end on a record boundary (a newline outside CSV
+    // quotes), and every chunk is parsed on its own, so chunks can be parsed
+    // on several threads at once.
+    //
+    // CSV and TSV give the values in table column order, or in the order of a
+    // header line that names the columns. JSON lines give one object per
+    // row, keyed by column name. Columns a row leaves out are NULL. Values are
+    // converted straight into the record format and must have the column's
+    // type: integers for INT, numbers for FLOAT, true or false (any case) for
+    // BOOLEAN.
+    class BulkParser {
+    public:
+        static constexpr size_t kChunkBytes = 1 << 20;
+
+        struct Chunk {
+            size_t begin;
+            size_t end;
+            size_t first_line;  // 1-based
+        };
+
+        // format is CSV, TSV or JSON_LINES; header applies to CSV and TSV
+        BulkParser(std::string_view text, OutputFormat format, bool header, const TupleLayout& layout);
+
+        const std::vector<Chunk>& chunks() const { return chunks_; }
+        // The records of a chunk in input order. Bad input throws
+        // std::runtime_error naming the line.
+        std::vector<std::string> parse(const Chunk& chunk) const;
+
+    private:
+        std::string_view text_;
+        OutputFormat format_;
+        const TupleLayout& layout_;
+        std::vector<size_t> columns_;  // CSV/TSV: the field of each value of a row
+        std::vector<Chunk> chunks_;
+
+        // Reads the CSV/TSV record at pos into fields (null: a NULL value),
+        // moving pos past its line end and counting its newlines in line
+        void readFields(size_t& pos, size_t& line, std::vector<std::string>& fields, std::vector<bool>& nulls) const;
+        void parseJson(std::string_view line, TupleBuilder& builder, size_t line_number) const;
+        void split(size_t begin, size_t line);
+    };
+
+} // namespace minisql
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace minisql {
+
+    // Little helpers for the binary formats (WAL records, row log frames).
+    // Values are stored in host byte order.
+    class ByteWriter {
+    public:
+        explicit ByteWriter(std::string& out) : out_(out) {}
+
+        template <typename T>
+        void put(T value) {
+            out_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+        void putString16(std::string_view value) {
+            put<uint16_t>(static_cast<uint16_t>(value.size()));
+            out_.append(value.data(), value.size());
+        }
+        void putBytes32(std::string_view value) {
+            put<uint32_t>(static_cast<uint32_t>(value.size()));
+            out_.append(value.data(), value.size());
+        }
+        void putRaw(const char* data, size_t size) { out_.append(data, size); }
+
+    private:
+        std::string& out_;
+    };
+
+    class ByteReader {
+    public:
+        explicit ByteReader(std::string_view in) : in_(in) {}
+
+        template <typename T>
+        T get() {
+            T value;
+            std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+            return value;
+        }
+        std::string_view getString16() { return take(get<uint16_t>()); }
+        std::string_view getBytes32() { return take(get<uint32_t>()); }
+        std::string_view take(size_t size) {
+            if (pos_ + size > in_.size()) {
+                throw std::runtime_error("Truncated binary record");
+            }
+            std::string_view out = in_.substr(pos_, size);
+            pos_ += size;
+            return out;
+        }
+        bool done() const { return pos_ >= in_.size(); }
+
+    private:
+        std::string_view in_;
+        size_t pos_ = 0;
+    };
+
+} // namespace minisql
@@ -0,0 +1,54 @@
+#include "client.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace minisql {
+
+Client::Client(const Endpoint& endpoint) : fd_(endpoint.connect()) {}
+
+Client::~Client() {
+    close(fd_);
+}
+
+bool Client::execute(std::string_view sql, std::ostream& output, std::string& error) {
+    std::string request;
+    wire::appendFrame(request, sql);
+    for (size_t sent = 0; sent < request.size();) {
+        ssize_t n = ::send(fd_, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("Connection lost: ") + std::strerror(errno));
+        }
+        sent += static_cast<size_t>(n);
+    }
+
+    char buffer[1 << 16];
+    while (true) {
+        size_t pos = 0;
+        std::optional<std::string_view> frame;
+        while (!(frame = wire::nextFrame(in_, pos))) {
+            ssize_t n = read(fd_, buffer, sizeof(buffer));
+            if (n == 0) throw std::runtime_error("Connection closed by server");
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("Connection lost: ") + std::strerror(errno));
+            }
+            in_.append(buffer, static_cast<size_t>(n));
+        }
+        if (frame->empty()) throw std::runtime_error("Malformed answer from server");
+        uint8_t status = static_cast<uint8_t>(frame->front());
+        std::string_view body = frame->substr(1);
+        if (status == wire::kError) {
+            error.assign(body);
+        } else {
+            output.write(body.data(), static_cast<std::streamsize>(body.size()));
+        }
+        in_.erase(0, pos);
+        if (status != wire::kMore) return status == wire::kOk;
+    }
+}
+
+} // namespace minisql
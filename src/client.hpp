@@ -0,0 +1,27 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "wire.hpp"
+
+namespace minisql {
+
+    // One connection to a server (see wire.hpp for the protocol)
+    class Client {
+    public:
+        explicit Client(const Endpoint& endpoint);
+        ~Client();
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+        // Runs one statement on the server, writing its output to output as
+        // it arrives. False with the server's error message in error; throws
+        // when the connection fails.
+        bool execute(std::string_view sql, std::ostream& output, std::string& error);
+
+    private:
+        int fd_;
+        std::string in_;  // received bytes not yet taken as answers
+    };
+
+} // namespace minisql
@@ -0,0 +1,443 @@
+#include "column_store.hpp"
+#include "bytes.hpp"
+#include "filter.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace minisql {
+
+namespace {
+    constexpr char kDirectoryMagic[8] = {'M', 'S', 'Q', 'L', 'C', 'O', 'L', 'S'};
+    constexpr uint32_t kDirectoryVersion = 1;
+
+    size_t valueWidth(DataType type) {
+        switch (type) {
+            case DataType::INT: return sizeof(int32_t);
+            case DataType::FLOAT: return sizeof(float);
+            case DataType::BOOLEAN: return 1;
+            case DataType::STRING: return sizeof(uint32_t);
+        }
+        return 0;
+    }
+
+    size_t bitmapSize(uint32_t rows) {
+        return (rows + 7) / 8;
+    }
+
+    bool testBit(const char* bitmap, uint32_t row) {
+        return (static_cast<uint8_t>(bitmap[row / 8]) >> (row % 8)) & 1;
+    }
+
+    PageId pagesFor(size_t bytes) {
+        return static_cast<PageId>((bytes + kPageSize - 1) / kPageSize);
+    }
+
+    // Chunk of one column for rows [begin, end) of records
+    std::string buildChunk(const TupleLayout& layout, size_t field, const std::vector<std::string>& records,
+                           size_t begin, size_t end) {
+        uint32_t rows = static_cast<uint32_t>(end - begin);
+        DataType type = layout.fields()[field].type;
+        std::string chunk(bitmapSize(rows), '\0');
+        std::string strings;
+        ByteWriter out(chunk);
+        for (uint32_t row = 0; row < rows; ++row) {
+            TupleView view(layout, records[begin + row]);
+            bool is_null = view.isNull(field);
+            if (is_null) {
+                chunk[row / 8] = static_cast<char>(chunk[row / 8] | (1 << (row % 8)));
+            }
+            switch (type) {
+                case DataType::INT: out.put<int32_t>(is_null ? 0 : view.getInt(field)); break;
+                case DataType::FLOAT: out.put<float>(is_null ? 0.0f : view.getFloat(field)); break;
+                case DataType::BOOLEAN: out.put<uint8_t>(!is_null && view.getBool(field)); break;
+                case DataType::STRING:
+                    out.put<uint32_t>(static_cast<uint32_t>(strings.size()));
+                    if (!is_null) strings.append(view.getString(field));
+                    break;
+            }
+        }
+        if (type == DataType::STRING) {
+            out.put<uint32_t>(static_cast<uint32_t>(strings.size()));
+            chunk.append(strings);
+        }
+        return chunk;
+    }
+
+    FieldValue chunkValue(DataType type, std::string_view chunk, uint32_t rows, uint32_t row) {
+        if (testBit(chunk.data(), row)) return std::nullopt;
+        const char* values = chunk.data() + bitmapSize(rows);
+        switch (type) {
+            case DataType::INT: {
+                int32_t value;
+                std::memcpy(&value, values + row * sizeof(int32_t), sizeof(value));
+                return DataValue(static_cast<int>(value));
+            }
+            case DataType::FLOAT: {
+                float value;
+                std::memcpy(&value, values + row * sizeof(float), sizeof(value));
+                return DataValue(value);
+            }
+            case DataType::BOOLEAN:
+                return DataValue(values[row] != 0);
+            case DataType::STRING: {
+                uint32_t offsets[2];
+                std::memcpy(offsets, values + row * sizeof(uint32_t), sizeof(offsets));
+                const char* bytes = values + (rows + 1) * sizeof(uint32_t);
+                return DataValue(std::string(bytes + offsets[0], offsets[1] - offsets[0]));
+            }
+        }
+        return std::nullopt;
+    }
+
+    void syncPath(const std::string& path, int flags) {
+        int fd = ::open(path.c_str(), flags);
+        if (fd < 0 || ::fsync(fd) != 0) {
+            int error = errno;
+            if (fd >= 0) ::close(fd);
+            throw std::runtime_error("Failed to sync '" + path + "': " + std::strerror(error));
+        }
+        ::close(fd);
+    }
+}
+
+ColumnStore::ColumnStore(const std::string& path, std::shared_ptr<const TupleLayout> layout, BufferPool& pool)
+    : path_(path), layout_(std::move(layout)), pool_(pool) {
+    for (const auto& field : layout_->fields()) {
+        files_.push_back(std::make_unique<DiskManager>(path_ + "." + field.name + ".col"));
+    }
+    loadDirectory();
+    // Chunks past the last group were written by an append that never committed
+    for (size_t field = 0; field < files_.size(); ++field) {
+        PageId end = 0;
+        for (const auto& [id, group] : groups_) {
+            end = std::max(end, group.chunks[field].first_page + pagesFor(group.chunks[field].length));
+        }
+        if (files_[field]->pageCount() > end) {
+            files_[field]->truncate(end);
+        }
+        maps_.push_back(std::make_unique<MappedFile>(files_[field]->path()));
+    }
+}
+
+ColumnStore::~ColumnStore() {
+    for (auto& file : files_) {
+        pool_.discard(*file);
+    }
+}
+
+std::vector<RecordId> ColumnStore::append(const std::vector<std::string>& records, uint64_t epoch) {
+    std::vector<RecordId> rids;
+    if (records.empty()) return rids;
+    rids.reserve(records.size());
+    size_t group_count = (records.size() + kMaxGroupRows - 1) / kMaxGroupRows;
+    size_t begin = 0;
+    for (size_t g = 0; g < group_count; ++g) {
+        // Split evenly rather than leaving a small last group
+        size_t end = begin + (records.size() - begin) / (group_count - g);
+        Group group;
+        group.epoch = epoch;
+        group.rows = static_cast<uint32_t>(end - begin);
+        group.deleted.assign(bitmapSize(group.rows), 0);
+        for (size_t field = 0; field < files_.size(); ++field) {
+            std::string chunk = buildChunk(*layout_, field, records, begin, end);
+            DiskManager& file = *files_[field];
+            Chunk location{file.pageCount(), static_cast<uint32_t>(chunk.size())};
+            chunk.resize(static_cast<size_t>(pagesFor(chunk.size())) * kPageSize, '\0');
+            for (PageId i = 0; i < pagesFor(chunk.size()); ++i) {
+                file.writePage(location.first_page + i, chunk.data() + static_cast<size_t>(i) * kPageSize);
+            }
+            group.chunks.push_back(location);
+        }
+        uint32_t id = next_group_++;
+        for (uint32_t row = 0; row < group.rows; ++row) {
+            rids.push_back({kGroupPageBase + id, static_cast<uint16_t>(row)});
+        }
+        groups_[id] = std::move(group);
+        begin = end;
+    }
+    for (auto& file : files_) {
+        file->sync();
+    }
+    for (auto& map : maps_) {
+        map->remap();
+    }
+    writeDirectory();
+    return rids;
+}
+
+bool ColumnStore::get(const RecordId& rid, std::string& out) {
+    uint32_t row;
+    Group* group = findGroup(rid, row);
+    if (!group) return false;
+    std::vector<FieldValue> values(files_.size());
+    for (size_t field = 0; field < files_.size(); ++field) {
+        values[field] = readValue(field, group->chunks[field], group->rows, row);
+    }
+    out = layout_->encode(values);
+    return true;
+}
+
+bool ColumnStore::erase(const RecordId& rid) {
+    uint32_t row;
+    Group* group = findGroup(rid, row);
+    if (!group) return false;
+    group->deleted[row / 8] = static_cast<uint8_t>(group->deleted[row / 8] | (1 << (row % 8)));
+    dirty_ = true;
+    return true;
+}
+
+void ColumnStore::scan(const std::vector<size_t>& fields, const Visitor& visitor) {
+    RowBatch batch(*layout_, fields);
+    std::vector<uint32_t> selection(RowBatch::kBatchSize);
+    scanBatches(batch, [&](RowBatch& batch) {
+        size_t count = selectAll(batch.size(), batch.excluded(), selection.data());
+        for (size_t i = 0; i < count; ++i) {
+            if (!visitor(batch.rid(selection[i]), batch.record(selection[i]))) return false;
+        }
+        return true;
+    });
+}
+
+bool ColumnStore::scanBatches(RowBatch& batch, const BatchVisitor& visitor) {
+    for (const Slice& slice : slices()) {
+        if (!scanSlice(slice, batch, visitor)) return false;
+    }
+    return true;
+}
+
+std::vector<ColumnStore::Slice> ColumnStore::slices() const {
+    std::vector<Slice> slices;
+    for (const auto& [id, group] : groups_) {
+        for (uint32_t first = 0; first < group.rows; first += kSliceRows) {
+            slices.push_back({id, first, std::min(kSliceRows, group.rows - first)});
+        }
+    }
+    return slices;
+}
+
+bool ColumnStore::scanSlice(const Slice& slice, RowBatch& batch, const BatchVisitor& visitor) {
+    const Group& group = groups_.at(slice.group);
+    std::vector<std::string> buffers(files_.size());
+    std::vector<ChunkView> chunks(files_.size());
+    for (size_t field : batch.fields()) {
+        chunks[field] = readSlice(field, group, slice, buffers[field]);
+    }
+    for (uint32_t first = 0; first < slice.rows; first += RowBatch::kBatchSize) {
+        size_t count = std::min<size_t>(RowBatch::kBatchSize, slice.rows - first);
+        batch.loadGroup(kGroupPageBase + slice.group, slice.first_row + first, count, chunks, slice.first_row,
+                        group.deleted.data());
+        if (!visitor(batch)) return false;
+    }
+    return true;
+}
+
+void ColumnStore::truncateBefore(uint64_t epoch) {
+    size_t before = groups_.size();
+    for (auto it = groups_.begin(); it != groups_.end();) {
+        it = it->second.epoch < epoch ? groups_.erase(it) : std::next(it);
+    }
+    if (groups_.size() == before) return;
+    if (groups_.empty()) {
+        for (size_t field = 0; field < files_.size(); ++field) {
+            pool_.discard(*files_[field]);
+            files_[field]->truncate(0);
+            maps_[field]->remap();
+        }
+    }
+    writeDirectory();
+}
+
+void ColumnStore::sync() {
+    if (dirty_) {
+        writeDirectory();
+    }
+}
+
+uint64_t ColumnStore::lastEpoch() const {
+    return groups_.empty() ? 0 : groups_.rbegin()->second.epoch;
+}
+
+ColumnStore::Group* ColumnStore::findGroup(const RecordId& rid, uint32_t& row) {
+    if (!owns(rid)) return nullptr;
+    auto it = groups_.find(rid.page_id - kGroupPageBase);
+    if (it == groups_.end() || rid.slot >= it->second.rows) return nullptr;
+    row = rid.slot;
+    if (testBit(reinterpret_cast<const char*>(it->second.deleted.data()), row)) return nullptr;
+    return &it->second;
+}
+
+FieldValue ColumnStore::readValue(size_t field, const Chunk& chunk, uint32_t rows, uint32_t row) {
+    uint64_t base = static_cast<uint64_t>(chunk.first_page) * kPageSize;
+    char bits;
+    readBytes(field, base + row / 8, 1, &bits);
+    if ((static_cast<uint8_t>(bits) >> (row % 8)) & 1) return std::nullopt;
+
+    DataType type = layout_->fields()[field].type;
+    uint64_t values = base + bitmapSize(rows);
+    size_t width = valueWidth(type);
+    if (type != DataType::STRING) {
+        // Decode a one-row chunk holding just this value
+        std::string single(1 + width, '\0');
+        readBytes(field, values + static_cast<uint64_t>(row) * width, width, single.data() + 1);
+        return chunkValue(type, single, 1, 0);
+    }
+    uint32_t offsets[2];
+    readBytes(field, values + static_cast<uint64_t>(row) * width, sizeof(offsets), reinterpret_cast<char*>(offsets));
+    std::string value(offsets[1] - offsets[0], '\0');
+    readBytes(field, values + static_cast<uint64_t>(rows + 1) * width + offsets[0], value.size(), value.data());
+    return DataValue(std::move(value));
+}
+
+void ColumnStore::readBytes(size_t field, uint64_t offset, size_t size, char* out) {
+    if (maps_[field]->covers(offset, size)) {
+        std::memcpy(out, maps_[field]->bytes(offset, size).data(), size);
+        return;
+    }
+    while (size > 0) {
+        auto handle = pool_.fetch(*files_[field], static_cast<PageId>(offset / kPageSize));
+        size_t in_page = offset % kPageSize;
+        size_t n = std::min(size, kPageSize - in_page);
+        std::memcpy(out, handle.data() + in_page, n);
+        out += n;
+        offset += n;
+        size -= n;
+    }
+}
+
+ChunkView ColumnStore::readSlice(size_t field, const Group& group, const Slice& slice, std::string& buffer) {
+    uint64_t base = static_cast<uint64_t>(group.chunks[field].first_page) * kPageSize;
+    uint64_t values = base + bitmapSize(group.rows);
+    DataType type = layout_->fields()[field].type;
+    size_t width = valueWidth(type);
+    size_t nulls = bitmapSize(slice.rows);
+    size_t size = nulls + static_cast<size_t>(slice.rows) * width + (type == DataType::STRING ? width : 0);
+
+    const MappedFile& map = *maps_[field];
+    if (map.covers(base, group.chunks[field].length)) {
+        // Slices start on a multiple of 8 rows, so their bitmap starts on a byte
+        uint64_t first_value = values + static_cast<uint64_t>(slice.first_row) * width;
+        map.willNeed(base + slice.first_row / 8, nulls);
+        map.willNeed(first_value, size - nulls);
+        ChunkView view;
+        view.nulls = map.bytes(base + slice.first_row / 8, nulls).data();
+        view.values = map.bytes(first_value, size - nulls).data();
+        if (type == DataType::STRING) {
+            uint64_t strings = values + static_cast<uint64_t>(group.rows + 1) * width;
+            uint32_t first, last;
+            std::memcpy(&first, view.values, sizeof(first));
+            std::memcpy(&last, view.values + static_cast<size_t>(slice.rows) * width, sizeof(last));
+            map.willNeed(strings + first, last - first);
+            view.strings = map.bytes(strings, last).data();
+        }
+        return view;
+    }
+
+    std::string& out = buffer;
+    out.resize(size);
+    // Slices start on a multiple of 8 rows, so their bitmap is a run of bytes
+    readBytes(field, base + slice.first_row / 8, nulls, out.data());
+    readBytes(field, values + static_cast<uint64_t>(slice.first_row) * width, size - nulls, out.data() + nulls);
+    ChunkView view{out.data(), out.data() + nulls, nullptr};
+    if (type != DataType::STRING) return view;
+
+    // Rebase the offsets onto the slice's own string bytes
+    char* offsets = out.data() + nulls;
+    uint32_t first, last;
+    std::memcpy(&first, offsets, sizeof(first));
+    std::memcpy(&last, offsets + static_cast<size_t>(slice.rows) * width, sizeof(last));
+    for (uint32_t row = 0; row <= slice.rows; ++row) {
+        uint32_t offset;
+        std::memcpy(&offset, offsets + static_cast<size_t>(row) * width, sizeof(offset));
+        offset -= first;
+        std::memcpy(offsets + static_cast<size_t>(row) * width, &offset, sizeof(offset));
+    }
+    uint64_t bytes = values + static_cast<uint64_t>(group.rows + 1) * width + first;
+    out.resize(size + (last - first));
+    readBytes(field, bytes, last - first, out.data() + size);
+    // The resize may have moved the buffer
+    return ChunkView{out.data(), out.data() + nulls, out.data() + size};
+}
+
+void ColumnStore::loadDirectory() {
+    std::ifstream file(path_ + ".cols", std::ios::binary);
+    if (!file.is_open()) return;
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(kDirectoryMagic) + sizeof(uint32_t) ||
+        std::memcmp(data.data(), kDirectoryMagic, sizeof(kDirectoryMagic)) != 0) {
+        throw std::runtime_error("Not a column directory: " + path_ + ".cols");
+    }
+    uint32_t crc;
+    std::memcpy(&crc, data.data() + data.size() - sizeof(crc), sizeof(crc));
+    std::string_view body(data.data(), data.size() - sizeof(crc));
+    if (crc32(body.data(), body.size()) != crc) {
+        throw std::runtime_error("Corrupt column directory: " + path_ + ".cols");
+    }
+    ByteReader in(body.substr(sizeof(kDirectoryMagic)));
+    if (in.get<uint32_t>() != kDirectoryVersion) {
+        throw std::runtime_error("Unsupported column directory version: " + path_ + ".cols");
+    }
+    if (in.get<uint32_t>() != files_.size()) {
+        throw std::runtime_error("Column directory does not match the schema: " + path_ + ".cols");
+    }
+    next_group_ = in.get<uint32_t>();
+    uint32_t count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t id = in.get<uint32_t>();
+        Group& group = groups_[id];
+        group.epoch = in.get<uint64_t>();
+        group.rows = in.get<uint32_t>();
+        for (size_t field = 0; field < files_.size(); ++field) {
+            Chunk chunk;
+            chunk.first_page = in.get<PageId>();
+            chunk.length = in.get<uint32_t>();
+            group.chunks.push_back(chunk);
+        }
+        std::string_view deleted = in.take(bitmapSize(group.rows));
+        group.deleted.assign(deleted.begin(), deleted.end());
+    }
+}
+
+void ColumnStore::writeDirectory() {
+    std::string data(kDirectoryMagic, sizeof(kDirectoryMagic));
+    ByteWriter out(data);
+    out.put<uint32_t>(kDirectoryVersion);
+    out.put<uint32_t>(static_cast<uint32_t>(files_.size()));
+    out.put<uint32_t>(next_group_);
+    out.put<uint32_t>(static_cast<uint32_t>(groups_.size()));
+    for (const auto& [id, group] : groups_) {
+        out.put<uint32_t>(id);
+        out.put<uint64_t>(group.epoch);
+        out.put<uint32_t>(group.rows);
+        for (const auto& chunk : group.chunks) {
+            out.put<PageId>(chunk.first_page);
+            out.put<uint32_t>(chunk.length);
+        }
+        out.putRaw(reinterpret_cast<const char*>(group.deleted.data()), group.deleted.size());
+    }
+    out.put<uint32_t>(crc32(data.data(), data.size()));
+
+    // Write a new file and rename it over the old one, so a crash leaves one or the other
+    std::string path = path_ + ".cols";
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            throw std::runtime_error("Failed to write '" + temp + "'");
+        }
+    }
+    syncPath(temp, O_RDONLY);
+    std::filesystem::rename(temp, path);
+    syncPath(std::filesystem::path(path).parent_path().string(), O_RDONLY | O_DIRECTORY);
+    dirty_ = false;
+}
+
+} // namespace minisql
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "batch.hpp"
+#include "buffer_pool.hpp"
+#include "disk_manager.hpp"
+#include "mapped_file.hpp"
+#include "tuple.hpp"
+
+namespace minisql {
+
+    // Column-major part of a columnar table.
+    //
+    // Files:
+    //   <path>.<column>.col  one per column, holding that column's values
+    //   <path>.cols          directory of row groups, replaced atomically on change
+    //
+    // Rows are stored in immutable row groups of up to kMaxGroupRows rows; only
+    // the group's delete bitmap (kept in the directory) changes afterwards. Each
+    // column of a group is one chunk starting on a page of its column file:
+    //
+    //   | null bitmap | values |
+    //
+    // where values are 4-byte INT/FLOAT, 1-byte BOOLEAN, or for STRING n + 1
+    // u32 offsets followed by the string bytes. A scan reads only the chunks
+    // of the columns it needs. Column pages are written directly, and never
+    // change once written: a group's chunks are synced before the directory
+    // that makes them visible is written, so the directory is the commit point.
+    // That lets reads use a read-only mapping of each column file, so scans
+    // work on the page cache without copying; pages the mapping does not
+    // cover (it failed, or the file changed since) are read through the
+    // BufferPool.
+    //
+    // Every group remembers the insert log epoch it was created for (see
+    // Table), which lets redo tell groups older than a truncation apart.
+    class ColumnStore {
+    public:
+        // Rows of group g are addressed as RecordId{kGroupPageBase + g, row}
+        static constexpr PageId kGroupPageBase = 0x80000000;
+        static constexpr size_t kMaxGroupRows = 65535;
+        // Rows per slice: the unit a scan reads and may hand to another thread
+        static constexpr uint32_t kSliceRows = 16384;
+
+        struct Slice {
+            uint32_t group;
+            uint32_t first_row;
+            uint32_t rows;
+        };
+
+        using Visitor = std::function<bool(const RecordId&, std::string_view)>;
+        using BatchVisitor = std::function<bool(RowBatch&)>;
+
+        ColumnStore(const std::string& path, std::shared_ptr<const TupleLayout> layout, BufferPool& pool);
+        ~ColumnStore();
+        ColumnStore(const ColumnStore&) = delete;
+        ColumnStore& operator=(const ColumnStore&) = delete;
+
+        static bool owns(const RecordId& rid) { return rid.page_id >= kGroupPageBase && rid.page_id != kInvalidPageId; }
+
+        // Writes the records as new row groups tagged with epoch and makes them
+        // durable; returns their record ids in order
+        std::vector<RecordId> append(const std::vector<std::string>& records, uint64_t epoch);
+        // Reassembles a full row; false if there is none at rid
+        bool get(const RecordId& rid, std::string& out);
+        // Marks a row deleted (durable with the next sync); false if there is none
+        bool erase(const RecordId& rid);
+        // Visits live rows in group order until the visitor returns false. Rows
+        // are encoded with the table layout but only carry the listed fields.
+        void scan(const std::vector<size_t>& fields, const Visitor& visitor);
+        // Loads each group's rows into batch, RowBatch::kBatchSize at a time,
+        // reading only the chunks of batch.fields(); false if the visitor stopped
+        bool scanBatches(RowBatch& batch, const BatchVisitor& visitor);
+        // The groups in order, cut into slices of up to kSliceRows rows
+        std::vector<Slice> slices() const;
+        // scanBatches() for one slice. Slices can be scanned concurrently as
+        // long as the store is not modified meanwhile.
+        bool scanSlice(const Slice& slice, RowBatch& batch, const BatchVisitor& visitor);
+        // Drops the groups created before epoch
+        void truncateBefore(uint64_t epoch);
+        // Writes the directory if delete marks changed since it was last written
+        void sync();
+
+        // Epoch of the newest group, 0 when empty
+        uint64_t lastEpoch() const;
+        bool empty() const { return groups_.empty(); }
+
+    private:
+        struct Chunk {
+            PageId first_page = 0;
+            uint32_t length = 0;
+        };
+        struct Group {
+            uint64_t epoch = 0;
+            uint32_t rows = 0;
+            std::vector<Chunk> chunks;  // one per field
+            std::vector<uint8_t> deleted;
+        };
+
+        std::string path_;
+        std::shared_ptr<const TupleLayout> layout_;
+        BufferPool& pool_;
+        std::vector<std::unique_ptr<DiskManager>> files_;
+        std::vector<std::unique_ptr<MappedFile>> maps_;  // per field, remapped after every change
+        std::map<uint32_t, Group> groups_;
+        uint32_t next_group_ = 0;
+        bool dirty_ = false;
+
+        Group* findGroup(const RecordId& rid, uint32_t& row);
+        FieldValue readValue(size_t field, const Chunk& chunk, uint32_t rows, uint32_t row);
+        void readBytes(size_t field, uint64_t offset, size_t size, char* out);
+        // Where a slice's rows of a field are: in the mapping, or else copied
+        // into buffer in the chunk format of their own
+        ChunkView readSlice(size_t field, const Group& group, const Slice& slice, std::string& buffer);
+        void loadDirectory();
+        void writeDirectory();
+    };
+
+} // namespace minisql
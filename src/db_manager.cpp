@@ -1,26 +1,295 @@
 #include "db_manager.hpp"
+#include "bulk_load.hpp"
+#include "bytes.hpp"
+#include "join.hpp"
+#include "mapped_file.hpp"
 #include "storage.hpp"
 #include <filesystem>
+#include <fstream>
 #include <iostream>
-#include <iomanip>
+#include <iterator>
+#include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
 
 namespace minisql {
 
-DatabaseManager::DatabaseManager(const std::string& base_path) : base_path_(base_path) {
+namespace {
+    // Largest OFFSET + LIMIT an ORDER BY keeps in a top-N heap rather than sorting
+    constexpr size_t kMaxTopN = 1 << 16;
+
+    // Planner costs, relative to reading one row in a scan
+    constexpr double kIndexLookupCost = 20;  // descending a B+tree
+    constexpr double kHashLookupCost = 2;    // reading the bucket of a unique index
+    constexpr double kIndexRowCost = 3;      // fetching a row by record id: a random page access
+    constexpr double kHashBuildCost = 2;     // adding a row to a join hash table
+    constexpr double kHashProbeCost = 1;
+    constexpr double kSpillRowCost = 4;      // writing a row to a join partition and reading it back
+
+    // Rows an INSERT writes: one per VALUES tuple
+    size_t insertedRows(const Query& query) {
+        return 1 + query.insert_rows.size() / query.insert_values.size();
+    }
+
+    // Approximate memory a row takes in a join hash table
+    double hashRowBytes(const TupleLayout& layout) {
+        double bytes = 64;
+        for (const auto& field : layout.fields()) {
+            bytes += field.type == DataType::STRING ? 16 : 4;
+        }
+        return bytes;
+    }
+
+    std::string formatEstimate(double value) {
+        return std::to_string(std::llround(value));
+    }
+
+    std::string formatMillis(std::chrono::nanoseconds time) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", time.count() / 1e6);
+        return text;
+    }
+
+    std::string formatBytes(uint64_t bytes) {
+        if (bytes < 1024) return std::to_string(bytes) + " B";
+        char text[32];
+        if (bytes < (1u << 20)) {
+            std::snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+        } else {
+            std::snprintf(text, sizeof(text), "%.1f MB", bytes / 1048576.0);
+        }
+        return text;
+    }
+
+    // Rows a match() call passed on: what it returns, or one when it returns nothing
+    template <typename Match, typename... Args>
+    size_t callMatch(Match& match, Args&&... args) {
+        if constexpr (std::is_void_v<std::invoke_result_t<Match&, Args&&...>>) {
+            match(std::forward<Args>(args)...);
+            return 1;
+        } else {
+            return match(std::forward<Args>(args)...);
+        }
+    }
+
+    // NULLs sort first
+    int compareFieldValues(const FieldValue& a, const FieldValue& b) {
+        if (!a || !b) return static_cast<int>(a.has_value()) - static_cast<int>(b.has_value());
+        return compareValues(*a, *b);
+    }
+
+    // Prints the header, then the rows, given in output order, that OFFSET and
+    // LIMIT let through, counting them in output's rows_out if there is a profile
+    class RowWindow {
+    public:
+        RowWindow(std::ostream& out, const RowFormatter& formatter, size_t offset, std::optional<size_t> limit,
+                  QueryProfile* profile)
+            : out_(out), skip_(offset), remaining_(limit.value_or(static_cast<size_t>(-1))),
+              output_(profile ? &profile->statement : nullptr) {
+            std::string header;
+            formatter.header(header);
+            out_.write(header);
+        }
+
+        // False once no more rows are wanted
+        bool print(std::string_view line) {
+            if (skip_ > 0) {
+                --skip_;
+                return true;
+            }
+            if (remaining_ == 0) return false;
+            out_.write(line);
+            if (output_) ++output_->rows_out;
+            return --remaining_ > 0;
+        }
+        // Rows text[0, ends[0]), text[ends[0], ends[1]), ...
+        void print(std::string_view text, const std::vector<size_t>& ends) {
+            if (skip_ == 0 && remaining_ >= ends.size()) {
+                out_.write(text);
+                remaining_ -= ends.size();
+                if (output_) output_->rows_out += ends.size();
+                return;
+            }
+            size_t begin = 0;
+            for (size_t end : ends) {
+                if (!print(text.substr(begin, end - begin))) return;
+                begin = end;
+            }
+        }
+
+    private:
+        ResultWriter out_;
+        size_t skip_;
+        size_t remaining_;
+        StageProfile* output_;
+    };
+
+    // Record ids of the rows a transaction inserts, which have none yet:
+    // past every heap page and row group
+    constexpr PageId kPendingPageBase = 0xF0000000;
+
+    RecordId pendingRid(size_t row) {
+        return {kPendingPageBase + static_cast<PageId>(row >> 16), static_cast<uint16_t>(row & 0xFFFF)};
+    }
+
+    bool isPending(const RecordId& rid) {
+        return rid.page_id >= kPendingPageBase && rid.page_id != kInvalidPageId;
+    }
+
+    size_t pendingRow(const RecordId& rid) {
+        return (static_cast<size_t>(rid.page_id - kPendingPageBase) << 16) | rid.slot;
+    }
+
+    std::vector<std::string_view> views(const std::vector<std::string>& records) {
+        return std::vector<std::string_view>(records.begin(), records.end());
+    }
+
+    // A row COMMIT has stored, replaced or deleted, and how to take it back
+    struct AppliedChange {
+        Table* table;
+        std::optional<RecordId> row;     // where the transaction's row is stored
+        std::optional<std::string> old;  // the row it replaced or deleted
+
+        void undo(uint64_t version) const {
+            if (row && old) {
+                table->update(*row, *old, version);
+            } else if (row) {
+                table->erase(*row, version);
+            } else {
+                table->insertBatch({*old}, version);
+            }
+        }
+    };
+
+    // Points slot at a snapshot of the finished writes for as long as it
+    // lives, unless it points at one already (a transaction's)
+    class SnapshotScope {
+    public:
+        explicit SnapshotScope(const Snapshot*& slot) : slot_(slot) {
+            if (slot_) return;
+            snapshot_ = Storage::versions().snapshot();
+            slot_ = snapshot_.get();
+        }
+        ~SnapshotScope() {
+            if (snapshot_) slot_ = nullptr;
+        }
+        SnapshotScope(const SnapshotScope&) = delete;
+        SnapshotScope& operator=(const SnapshotScope&) = delete;
+
+    private:
+        const Snapshot*& slot_;
+        VersionClock::SnapshotRef snapshot_;
+    };
+
+    // A statement writing to a table: writers of the table take turns, and
+    // the changes carry a version that snapshots only see once commit()
+    // has made them durable (or the statement has ended)
+    class WriteScope {
+    public:
+        WriteScope(Table& table, const std::string& base_path)
+            : table_(table), base_path_(base_path), lock_(table.writeLock()) {
+            // Pages change before their records are logged, so a statement
+            // must not start once the log refuses records
+            Storage::wal(base_path_).checkUsable();
+        }
+        ~WriteScope() {
+            // Once the log has failed, changes not yet committed never become
+            // durable; left running, the version keeps them from every snapshot
+            if (version_ != 0 && Storage::wal(base_path_).failed()) return;
+            end();
+        }
+        WriteScope(const WriteScope&) = delete;
+        WriteScope& operator=(const WriteScope&) = delete;
+
+        // The version of the changes since the last commit()
+        uint64_t version() {
+            if (version_ == 0) version_ = Storage::versions().beginWrite();
+            return version_;
+        }
+        void commit() {
+            Storage::commit(base_path_);
+            end();
+        }
+
+    private:
+        Table& table_;
+        const std::string& base_path_;
+        std::lock_guard<std::mutex> lock_;
+        uint64_t version_ = 0;
+
+        void end() {
+            if (version_ == 0) return;
+            VersionClock& versions = Storage::versions();
+            versions.endWrite(version_);
+            version_ = 0;
+            // Row images kept for snapshots that have ended since
+            table_.collectVersions(versions.horizon());
+        }
+    };
+
+    // Runs format(), adding its time to the profile's formatting time if there is one
+    template <typename Format>
+    void timeFormatting(QueryProfile* profile, Format format) {
+        if (!profile) {
+            format();
+            return;
+        }
+        auto started = std::chrono::steady_clock::now();
+        format();
+        profile->format_ns.fetch_add((std::chrono::steady_clock::now() - started).count(), std::memory_order_relaxed);
+    }
+}
+
+DatabaseManager::Shared::Shared(const std::string& path, size_t threads) : base_path(path), workers(threads) {
     // Ensure the base path (./databases) exists
     try {
-        std::filesystem::create_directories(base_path_);
+        std::filesystem::create_directories(base_path);
     } catch (const std::filesystem::filesystem_error& e) {
-        throw std::runtime_error("Failed to create base directory '" + base_path_ + "': " + e.what());
+        throw std::runtime_error("Failed to create base directory '" + base_path + "': " + e.what());
+    }
+    Storage::recover(base_path);
+}
+
+DatabaseManager::Shared::~Shared() {
+    try {
+        Storage::checkpoint(base_path);
+    } catch (const std::exception& e) {
+        std::cerr << "Checkpoint failed: " << e.what() << "\n";
     }
 }
 
+DatabaseManager::DatabaseManager(const std::string& base_path, size_t threads)
+    : DatabaseManager(std::make_shared<Shared>(base_path, threads)) {}
+
+DatabaseManager::DatabaseManager(std::shared_ptr<Shared> shared)
+    : shared_(std::move(shared)), base_path_(shared_->base_path), workers_(shared_->workers) {}
+
+DatabaseManager::~DatabaseManager() = default;
+
+std::unique_ptr<DatabaseManager> DatabaseManager::newSession() {
+    std::unique_ptr<DatabaseManager> session(new DatabaseManager(shared_));
+    session->work_memory_ = work_memory_;
+    session->output_format_ = output_format_;
+    return session;
+}
+
 void DatabaseManager::setCurrentDatabase(const std::string& db_name) {
     if (!std::filesystem::exists(base_path_ + "/" + db_name)) {
         throw std::runtime_error("Database does not exist: " + db_name);
     }
     current_db_ = db_name;
+    // Only on first use: other sessions may be sorting into run files by now
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    if (shared_->cleaned.insert(db_name).second) {
+        removeStaleRuns(base_path_ + "/" + db_name);
+    }
 }
 
 std::string DatabaseManager::getCurrentDatabase() const {
@@ -29,10 +298,41 @@ std::string DatabaseManager::getCurrentDatabase() const {
 
 void DatabaseManager::executeQuery(const Query& query) {
     if (query.type != QueryType::CREATE_DATABASE && query.type != QueryType::DROP_DATABASE &&
-        query.type != QueryType::USE_DATABASE && current_db_.empty()) {
+        query.type != QueryType::USE_DATABASE && query.type != QueryType::PREPARE &&
+        query.type != QueryType::DEALLOCATE && query.type != QueryType::BEGIN &&
+        query.type != QueryType::COMMIT && query.type != QueryType::ROLLBACK && current_db_.empty()) {
         throw std::runtime_error("No database selected. Use 'USE database;'");
     }
 
+    // Schema changes run alone; the other statements run alongside each
+    // other. No lock is held between statements: a server loop runs the
+    // statements of many sessions, so a schema change must never wait for a
+    // transaction to end. It fails instead on a table that an open
+    // transaction changes (see checkUnchanged()).
+    bool schema_change = false;
+    switch (query.type) {
+        case QueryType::CREATE_DATABASE:
+        case QueryType::DROP_DATABASE:
+        case QueryType::CREATE_TABLE:
+        case QueryType::DROP_TABLE:
+        case QueryType::CREATE_INDEX:
+        case QueryType::DROP_INDEX:
+            schema_change = true;
+            break;
+        default:
+            break;
+    }
+    std::shared_lock<std::shared_mutex> shared_catalog(shared_->catalog, std::defer_lock);
+    std::unique_lock<std::shared_mutex> exclusive_catalog(shared_->catalog, std::defer_lock);
+    if (schema_change) {
+        if (transaction_) {
+            throw std::runtime_error("Schema changes cannot run inside a transaction");
+        }
+        exclusive_catalog.lock();
+    } else {
+        shared_catalog.lock();
+    }
+
     switch (query.type) {
         case QueryType::CREATE_DATABASE:
             createDatabase(query.database);
@@ -49,17 +349,48 @@ void DatabaseManager::executeQuery(const Query& query) {
         case QueryType::DROP_TABLE:
             dropTable(query.table);
             break;
-        case QueryType::INSERT:
-            insert(query);
+        case QueryType::CREATE_INDEX:
+            createIndex(query);
             break;
-        case QueryType::SELECT:
-            select(query);
+        case QueryType::DROP_INDEX:
+            dropIndex(query);
             break;
+        case QueryType::INSERT:
+        case QueryType::SELECT:
         case QueryType::UPDATE:
-            update(query);
+        case QueryType::DELETE: {
+            Plan plan = planQuery(query);
+            runPlan(plan, query, choosePlan(plan, query, false));
             break;
-        case QueryType::DELETE:
-            deleteFrom(query);
+        }
+        case QueryType::PREPARE:
+            prepare(query.statement_name, *query.prepared);
+            *out_ << "Statement " << query.statement_name << " prepared.\n";
+            break;
+        case QueryType::EXECUTE:
+            execute(query.statement_name, query.parameters);
+            break;
+        case QueryType::DEALLOCATE:
+            deallocate(query.statement_name);
+            *out_ << "Statement " << query.statement_name << " deallocated.\n";
+            break;
+        case QueryType::ANALYZE:
+            analyze(query.table);
+            break;
+        case QueryType::EXPLAIN:
+            explain(query);
+            break;
+        case QueryType::COPY:
+            copyFrom(query);
+            break;
+        case QueryType::BEGIN:
+            begin();
+            break;
+        case QueryType::COMMIT:
+            commit();
+            break;
+        case QueryType::ROLLBACK:
+            rollback();
             break;
         default:
             throw std::runtime_error("Unsupported query type");
@@ -69,143 +400,1680 @@ void DatabaseManager::executeQuery(const Query& query) {
 void DatabaseManager::createDatabase(const std::string& db_name) {
     try {
         std::filesystem::create_directory(base_path_ + "/" + db_name);
-        std::cout << "Database " << db_name << " created.\n";
+        *out_ << "Database " << db_name << " created.\n";
     } catch (const std::filesystem::filesystem_error& e) {
         throw std::runtime_error("Failed to create database '" + db_name + "': " + e.what());
     }
 }
 
 void DatabaseManager::dropDatabase(const std::string& db_name) {
+    checkUnchanged(db_name);
+    Storage::closeDatabase(db_name, base_path_);
     std::filesystem::remove_all(base_path_ + "/" + db_name);
+    // Log records of the dropped tables must not replay into a re-created one
+    Storage::checkpoint(base_path_);
+    {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        std::string prefix = db_name + "/";
+        auto& tables = shared_->tables;
+        for (auto it = tables.lower_bound(prefix); it != tables.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+            it = tables.erase(it);
+        }
+        shared_->cleaned.erase(db_name);
+    }
     if (current_db_ == db_name) {
         current_db_.clear();
     }
-    std::cout << "Database " << db_name << " dropped.\n";
+    ++shared_->schema_version;
+    *out_ << "Database " << db_name << " dropped.\n";
 }
 
 void DatabaseManager::createTable(const Query& query) {
+    if (std::filesystem::exists(base_path_ + "/" + current_db_ + "/" + query.table + "_schema.json")) {
+        throw std::runtime_error("Table already exists: " + query.table);
+    }
     TableSchema schema;
     for (const auto& field : query.fields) {
         schema.fields.push_back(field);
         schema.field_types[field.name] = field.type;
     }
+    schema.layout = std::make_shared<TupleLayout>(schema.fields);
+    schema.format = query.table_format;
+    // PRIMARY KEY and UNIQUE columns are backed by unique indexes
+    std::vector<std::pair<std::string, std::string>> keys;  // (index, column)
+    if (!query.primary_key.empty()) {
+        keys.emplace_back(query.table + "_pkey", query.primary_key);
+    }
+    for (const auto& column : query.unique_columns) {
+        if (column == query.primary_key) continue;
+        if (std::find_if(keys.begin(), keys.end(), [&](const auto& key) { return key.second == column; }) == keys.end()) {
+            keys.emplace_back(query.table + "_" + column + "_key", column);
+        }
+    }
+    for (const auto& [index, column] : keys) {
+        if (schema.field_types.find(column) == schema.field_types.end()) {
+            throw std::runtime_error("Unknown field: " + column);
+        }
+        if (!Storage::findIndexTable(current_db_, index, base_path_).empty()) {
+            throw std::runtime_error("Index already exists: " + index);
+        }
+    }
     saveTableSchema(query.table, schema);
-    tables_[query.table] = schema;
-    std::cout << "Table " << query.table << " created.\n";
+    for (const auto& [index, column] : keys) {
+        Storage::createIndex(current_db_, query.table, index, column, base_path_, true, column == query.primary_key);
+    }
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    shared_->tables[schemaKey(query.table)] = schema;
+    *out_ << "Table " << query.table << " created.\n";
 }
 
 void DatabaseManager::dropTable(const std::string& table_name) {
-    std::filesystem::remove(base_path_ + "/" + current_db_ + "/" + table_name + ".json");
-    tables_.erase(table_name);
-    std::cout << "Table " << table_name << " dropped.\n";
+    checkUnchanged(current_db_, table_name);
+    Storage::removeTable(current_db_, table_name, base_path_);
+    Storage::checkpoint(base_path_);
+    {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        shared_->tables.erase(schemaKey(table_name));
+    }
+    ++shared_->schema_version;
+    *out_ << "Table " << table_name << " dropped.\n";
 }
 
-void DatabaseManager::insert(const Query& query) {
+void DatabaseManager::createIndex(const Query& query) {
+    checkUnchanged(current_db_, query.table);
     auto schema = loadTableSchema(query.table);
-    json data = Storage::loadTableData(current_db_, query.table, base_path_);
-    json row;
+    if (schema.field_types.find(query.index_column) == schema.field_types.end()) {
+        throw std::runtime_error("Unknown field: " + query.index_column);
+    }
+    Storage::createIndex(current_db_, query.table, query.index_name, query.index_column, base_path_);
+    *out_ << "Index " << query.index_name << " created.\n";
+}
 
-    for (const auto& [field, value] : query.insert_values) {
-        auto it = schema.field_types.find(field);
-        if (it == schema.field_types.end()) {
-            throw std::runtime_error("Unknown field: " + field);
+void DatabaseManager::dropIndex(const Query& query) {
+    std::string table = query.table.empty() ? Storage::findIndexTable(current_db_, query.index_name, base_path_) : query.table;
+    if (table.empty()) {
+        throw std::runtime_error("Index does not exist: " + query.index_name);
+    }
+    checkUnchanged(current_db_, table);
+    Storage::dropIndex(current_db_, table, query.index_name, base_path_);
+    *out_ << "Index " << query.index_name << " dropped.\n";
+}
+
+void DatabaseManager::prepare(const std::string& name, std::string_view sql) {
+    prepare(name, parser_.parsePrepared(sql));
+}
+
+void DatabaseManager::prepare(const std::string& name, Query query) {
+    PreparedStatement statement;
+    for (const auto& param : query.params) {
+        statement.param_count = std::max(statement.param_count, param.number);
+    }
+    statement.query = std::move(query);
+    prepared_[name] = std::move(statement);
+}
+
+void DatabaseManager::execute(const std::string& name, const std::vector<std::string>& params) {
+    auto it = prepared_.find(name);
+    if (it == prepared_.end()) {
+        throw std::runtime_error("Prepared statement does not exist: " + name);
+    }
+    if (current_db_.empty()) {
+        throw std::runtime_error("No database selected. Use 'USE database;'");
+    }
+    PreparedStatement& statement = it->second;
+    if (params.size() != statement.param_count) {
+        throw std::runtime_error("Statement " + name + " expects " + std::to_string(statement.param_count) +
+                                 " parameters, got " + std::to_string(params.size()));
+    }
+    if (!isCurrent(statement.plan)) {
+        statement.plan = planQuery(statement.query);
+    }
+    Query& query = statement.query;
+    for (const auto& param : query.params) {
+        const std::string& value = params[param.number - 1];
+        switch (param.slot) {
+            case QueryParam::Slot::INSERT_VALUE:
+                if (param.index < query.insert_values.size()) {
+                    query.insert_values[param.index].second = value;
+                } else {
+                    query.insert_rows[param.index - query.insert_values.size()] = value;
+                }
+                break;
+            case QueryParam::Slot::UPDATE_VALUE: query.update_values[param.index].second = value; break;
+            case QueryParam::Slot::WHERE_VALUE: query.where_values[param.index] = value; break;
         }
-        if (!validateValue(value, it->second)) {
-            throw std::runtime_error("Invalid value for field " + field);
+    }
+    runPlan(statement.plan, query, choosePlan(statement.plan, query, false));
+}
+
+void DatabaseManager::deallocate(const std::string& name) {
+    if (prepared_.erase(name) == 0) {
+        throw std::runtime_error("Prepared statement does not exist: " + name);
+    }
+}
+
+DatabaseManager::Transaction::Transaction(Shared& owner) : shared(owner) {}
+
+DatabaseManager::Transaction::~Transaction() {
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for (const auto& entry : tables) {
+        const WalTableRef& ref = entry.first->walRef();
+        auto it = shared.changing.find(ref.db + "/" + ref.table);
+        if (--it->second == 0) shared.changing.erase(it);
+    }
+}
+
+void DatabaseManager::begin() {
+    if (transaction_) {
+        throw std::runtime_error("A transaction is already in progress");
+    }
+    auto transaction = std::make_unique<Transaction>(*shared_);
+    transaction->snapshot = Storage::versions().snapshot();
+    snapshot_ = transaction->snapshot.get();
+    transaction_ = std::move(transaction);
+    *out_ << "Transaction started.\n";
+}
+
+void DatabaseManager::commit() {
+    if (!transaction_) {
+        throw std::runtime_error("No transaction in progress");
+    }
+    // The transaction ends here, committed or not
+    std::unique_ptr<Transaction> transaction = std::move(transaction_);
+    snapshot_ = nullptr;
+    auto& tables = transaction->tables;
+
+    // Every session takes the write locks in the same order, so commits
+    // never wait for each other in a cycle
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (auto& [table, changes] : tables) {
+        locks.emplace_back(table->writeLock());
+    }
+    // Everything is checked before anything is applied; the stored rows
+    // are kept to undo with
+    std::map<Table*, std::map<RecordId, std::string>> stored;
+    for (auto& [table, changes] : tables) {
+        auto& images = stored[table];
+        for (const auto& [rid, record] : changes.changed) {
+            std::string image;
+            if (table->changedSince(rid, *transaction->snapshot) || !table->get(rid, image)) {
+                throw std::runtime_error("Transaction rolled back: a row it changes was changed by another session");
+            }
+            images.emplace(rid, std::move(image));
+        }
+        std::vector<std::string_view> records;
+        for (const auto& [rid, record] : changes.changed) {
+            if (record) records.push_back(*record);
         }
-        row[field] = value;
+        for (const auto& row : changes.inserted) {
+            if (row) records.push_back(*row);
+        }
+        try {
+            for (std::string_view record : records) table->checkRecord(record);
+            table->checkKeys(records, changes.replaced());
+        } catch (const std::exception& e) {
+            throw std::runtime_error(std::string("Transaction rolled back: ") + e.what());
+        }
+        // So that no fold logs anything for the table while the group runs
+        table->foldInsertLog();
     }
 
-    if (!data.is_array()) {
-        data = json::array();
+    // One write, so snapshots see all of it or none, and one group in the
+    // log, so recovery replays all of it or none; one log flush
+    std::vector<WalTableRef> refs;
+    for (const auto& entry : tables) {
+        refs.push_back(entry.first->walRef());
+    }
+    VersionClock& versions = Storage::versions();
+    uint64_t version = versions.beginWrite();
+    WriteAheadLog& log = Storage::wal(base_path_);
+    bool started = false;  // once the tables may hold any of the transaction
+    Lsn end = 0;           // of the group, once it ended
+    std::string failure;   // why applying failed, once undone
+    try {
+        {
+            WriteAheadLog::Group group(log, refs);
+            started = true;
+            std::vector<AppliedChange> applied;
+            try {
+                for (auto& [table, changes] : tables) {
+                    // With unique keys, changed rows are stored again after
+                    // every erase, so that rows may trade key values
+                    bool keyed = table->hasUniqueIndex();
+                    auto& images = stored[table];
+                    std::vector<std::string> rows;
+                    for (auto& [rid, record] : changes.changed) {
+                        std::string& image = images[rid];
+                        if (record && !keyed) {
+                            RecordId row = table->update(rid, *record, version);
+                            applied.push_back({table, row, std::move(image)});
+                            continue;
+                        }
+                        if (table->erase(rid, version)) applied.push_back({table, std::nullopt, std::move(image)});
+                        if (record) rows.push_back(std::move(*record));
+                    }
+                    for (auto& row : changes.inserted) {
+                        if (row) rows.push_back(std::move(*row));
+                    }
+                    if (rows.empty()) continue;
+                    for (const RecordId& row : table->insertBatch(rows, version)) {
+                        applied.push_back({table, row, std::nullopt});
+                    }
+                }
+            } catch (const std::exception& e) {
+                // Undone as part of the same version, so no snapshot sees
+                // any of it. If the undo fails too, the group never ends and
+                // the log refuses further changes until recovery drops it.
+                for (auto it = applied.rbegin(); it != applied.rend(); ++it) {
+                    it->undo(version);
+                }
+                failure = e.what();
+            }
+            end = group.end();
+        }
+        Storage::commit(base_path_);
+        if (!failure.empty()) {
+            throw std::runtime_error("Transaction rolled back: " + failure);
+        }
+    } catch (...) {
+        // The version ends only once the group is durable. Left running, it
+        // keeps changes that recovery would drop from every snapshot; the
+        // log refuses further changes by then.
+        if (!started || (end != 0 && log.isDurable(end))) versions.endWrite(version);
+        throw;
+    }
+    versions.endWrite(version);
+    transaction->snapshot.reset();
+    uint64_t horizon = versions.horizon();
+    for (auto& [table, changes] : tables) {
+        table->collectVersions(horizon);
     }
-    data.push_back(row);
-    Storage::saveTableData(current_db_, query.table, data, base_path_);
-    std::cout << "1 row inserted.\n";
+    *out_ << "Transaction committed.\n";
 }
 
-void DatabaseManager::select(const Query& query) {
-    auto schema = loadTableSchema(query.table);
-    json data = Storage::loadTableData(current_db_, query.table, base_path_);
-    std::vector<std::string> fields;
-    if (query.select_fields.empty()) {
-        fields.reserve(schema.field_types.size());
-        std::transform(schema.field_types.begin(), schema.field_types.end(),
-                       std::back_inserter(fields),
-                       [](const auto& pair) { return pair.first; });
+void DatabaseManager::rollback() {
+    if (!transaction_) {
+        throw std::runtime_error("No transaction in progress");
+    }
+    transaction_.reset();
+    snapshot_ = nullptr;
+    *out_ << "Transaction rolled back.\n";
+}
+
+DatabaseManager::TableChanges* DatabaseManager::pendingChanges(Table& table) {
+    if (!transaction_) return nullptr;
+    auto it = transaction_->tables.find(&table);
+    return it == transaction_->tables.end() ? nullptr : &it->second;
+}
+
+DatabaseManager::TableChanges& DatabaseManager::stageChanges(Table& table) {
+    TableChanges& changes = transaction_->tables[&table];
+    if (!changes.pin) {
+        changes.pin = std::make_unique<Table::Pin>(table);
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        ++shared_->changing[table.walRef().db + "/" + table.walRef().table];
+    }
+    return changes;
+}
+
+void DatabaseManager::checkUnchanged(const std::string& db_name, const std::string& table_name) {
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    std::string key = db_name + "/" + table_name;
+    auto it = shared_->changing.lower_bound(key);
+    bool changing = table_name.empty() ? it != shared_->changing.end() && it->first.compare(0, key.size(), key) == 0
+                                       : it != shared_->changing.end() && it->first == key;
+    if (changing) {
+        std::string what = table_name.empty() ? "database " + db_name : "table " + table_name;
+        throw std::runtime_error("Cannot change the schema of " + what + " while a transaction changes it");
+    }
+}
+
+void DatabaseManager::TableChanges::insert(std::string record) {
+    inserted.emplace_back(std::move(record));
+}
+
+void DatabaseManager::TableChanges::update(const RecordId& rid, std::string record) {
+    if (isPending(rid)) {
+        inserted[pendingRow(rid)] = std::move(record);
     } else {
-        fields = query.select_fields;
+        changed[rid] = std::move(record);
     }
+}
 
-    // Print header
-    for (size_t i = 0; i < fields.size(); ++i) {
-        std::cout << std::setw(15) << fields[i];
-        if (i < fields.size() - 1) std::cout << "|";
+std::set<RecordId> DatabaseManager::TableChanges::replaced() const {
+    std::set<RecordId> rids;
+    for (const auto& entry : changed) {
+        rids.insert(entry.first);
     }
-    std::cout << "\n" << std::string(15 * fields.size() + fields.size() - 1, '-') << "\n";
+    return rids;
+}
 
-    // Print rows
-    for (const auto& row : data) {
-        if (!query.where_field.empty()) {
-            if (row[query.where_field].get<std::string>() != query.where_value) {
-                continue;
+void DatabaseManager::TableChanges::erase(const RecordId& rid) {
+    if (isPending(rid)) {
+        inserted[pendingRow(rid)].reset();
+    } else {
+        changed[rid] = std::nullopt;
+    }
+}
+
+template <typename Visit>
+void DatabaseManager::TableChanges::forEachRow(Visit visit) const {
+    for (const auto& [rid, record] : changed) {
+        if (record && !visit(rid, *record)) return;
+    }
+    for (size_t i = 0; i < inserted.size(); ++i) {
+        if (inserted[i] && !visit(pendingRid(i), *inserted[i])) return;
+    }
+}
+
+std::vector<std::string_view> DatabaseManager::TableChanges::rows(const std::set<RecordId>& skipped) const {
+    std::vector<std::string_view> records;
+    forEachRow([&](const RecordId& rid, const std::string& record) {
+        if (skipped.count(rid) == 0) records.push_back(record);
+        return true;
+    });
+    return records;
+}
+
+void DatabaseManager::copyFrom(const Query& query) {
+    TableSchema schema = loadTableSchema(query.table);
+    Table& table = Storage::openTable(current_db_, query.table, base_path_);
+
+    std::string format_name = query.copy_format;
+    if (format_name.empty()) {
+        std::string extension = std::filesystem::path(query.copy_file).extension().string();
+        format_name = extension.empty() ? "csv" : extension.substr(1);
+    }
+    std::optional<OutputFormat> format = parseOutputFormat(format_name);
+    if (!format || *format == OutputFormat::TABLE) {
+        throw std::runtime_error("Unknown COPY format: " + format_name + " (use FORMAT = CSV, TSV or JSONL)");
+    }
+    if (!std::filesystem::is_regular_file(query.copy_file)) {
+        throw std::runtime_error("Cannot read file: " + query.copy_file);
+    }
+
+    // Parse the mapped file in place; read it only if it cannot be mapped
+    MappedFile input(query.copy_file);
+    std::string copy;
+    std::string_view text = input.bytes(0, input.size());
+    if (input.size() == 0 && std::filesystem::file_size(query.copy_file) > 0) {
+        std::ifstream file(query.copy_file, std::ios::binary);
+        copy.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        text = copy;
+    }
+    input.willNeed(0, input.size());
+
+    BulkParser parser(text, *format, query.copy_header, *schema.layout);
+    const auto& chunks = parser.chunks();
+    std::vector<std::vector<std::string>> records(chunks.size());
+    std::vector<std::string> errors(chunks.size());
+    workers_.run(chunks.size(), [&](size_t i) {
+        try {
+            records[i] = parser.parse(chunks[i]);
+        } catch (const std::exception& e) {
+            errors[i] = e.what();
+        }
+    });
+    for (const auto& error : errors) {
+        if (!error.empty()) throw std::runtime_error(error);
+    }
+
+    size_t rows = 0;
+    if (transaction_) {
+        std::vector<std::string_view> rows_read;
+        for (const auto& chunk : records) {
+            for (const auto& record : chunk) {
+                table.checkRecord(record);
+                rows_read.push_back(record);
             }
         }
-        for (size_t i = 0; i < fields.size(); ++i) {
-            std::cout << std::setw(15) << row[fields[i]].get<std::string>();
-            if (i < fields.size() - 1) std::cout << "|";
+        TableChanges& staged = stageChanges(table);
+        if (table.hasUniqueIndex()) table.checkKeys(rows_read, staged.replaced(), staged.rows());
+        for (auto& chunk : records) {
+            for (auto& record : chunk) staged.insert(std::move(record));
+            rows += chunk.size();
+            chunk = {};
+        }
+    } else {
+        // Committing every chunk lets the buffer pool write back its pages
+        WriteScope write(table, base_path_);
+        for (auto& chunk : records) {
+            table.insertBatch(chunk, write.version());
+            write.commit();
+            rows += chunk.size();
+            chunk = {};
         }
-        std::cout << "\n";
     }
+    *out_ << rows << " rows copied.\n";
 }
 
-void DatabaseManager::update(const Query& query) {
-    auto schema = loadTableSchema(query.table);
-    json data = Storage::loadTableData(current_db_, query.table, base_path_);
-    int updated = 0;
-
-    for (auto& row : data) {
-        if (row[query.where_field].get<std::string>() == query.where_value) {
-            for (const auto& [field, value] : query.update_values) {
-                auto it = schema.field_types.find(field);
-                if (it == schema.field_types.end()) {
-                    throw std::runtime_error("Unknown field: " + field);
+void DatabaseManager::analyze(const std::string& table_name) {
+    SnapshotScope snapshot(snapshot_);
+    std::vector<std::string> names{table_name};
+    if (table_name.empty()) names = Storage::listTables(current_db_, base_path_);
+    for (const auto& name : names) {
+        TableSchema schema = loadTableSchema(name);
+        const TupleLayout& layout = *schema.layout;
+        Table& table = Storage::openTable(current_db_, name, base_path_);
+        std::vector<size_t> fields(layout.fields().size());
+        for (size_t i = 0; i < fields.size(); ++i) fields[i] = i;
+
+        // Every morsel collects on its own; the collectors are merged in table order
+        uint64_t expected_rows = table.estimateRows();
+        StatsCollector collector(layout, expected_rows);
+        using Part = std::optional<StatsCollector>;
+        scanMatches<Part>(table, layout, fields, TableAccess(), [&](Part& part, const RecordId& rid, const TupleView& row) {
+            if (!part) part.emplace(layout, expected_rows);
+            part->add(rid, row);
+        }, [&](Part& part) {
+            if (part) collector.merge(std::move(*part));
+        }, kNoLimit, {});
+        auto stats = std::make_shared<const TableStats>(collector.finish());
+        Storage::saveTableStats(current_db_, name, stats->toJson(layout), base_path_);
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        auto cached = shared_->tables.find(schemaKey(name));
+        if (cached != shared_->tables.end()) cached->second.stats = stats;
+        *out_ << "Table " << name << " analyzed: " << stats->rows << " rows.\n";
+    }
+    // Cached plans hold the old statistics
+    ++shared_->schema_version;
+}
+
+void DatabaseManager::explain(const Query& explain_query) {
+    const Query& query = *explain_query.prepared;
+    QueryProfile profile;
+    bool analyzing = explain_query.explain_analyze;
+    profile.parse = explain_query.parse_time;
+
+    auto planning = std::chrono::steady_clock::now();
+    Plan plan = planQuery(query);
+    if (analyzing) profile_ = &profile;
+    PhysicalPlan physical = choosePlan(plan, query, true);
+    profile.plan = std::chrono::steady_clock::now() - planning;
+
+    if (analyzing) {
+        // Run the statement as usual, results and all, measuring as it goes
+        try {
+            OutputTimer output(*out_, profile);
+            StageTimer timer(&profile.statement, Storage::bufferPool());
+            runPlan(plan, query, physical);
+            timer.stop();
+            out_->flush();
+        } catch (...) {
+            profile_ = nullptr;
+            throw;
+        }
+        profile_ = nullptr;
+    }
+
+    // Rows each profiled step received: a scan counts the rows it visited,
+    // the others what the step below passed on
+    const StageProfile& scanned = plan.join ? profile.join : profile.scans[0];
+    const StageProfile& grouped = plan.aggregated ? profile.aggregate : scanned;
+    auto actual = [&](const StageProfile& stage, uint64_t rows_in) {
+        if (!analyzing) return std::string();
+        if (!stage.ran) return std::string(" (never executed)");
+        std::string text = " (actual in=" + std::to_string(rows_in) + " out=" + std::to_string(stage.rows_out);
+        if (stage.timed) {
+            text += " time=" + formatMillis(stage.time) + " ms read=" + formatBytes(stage.pages * kPageSize) + ", " +
+                    formatBytes(stage.pages_read * kPageSize) + " from disk";
+        }
+        return text + ")";
+    };
+
+    // One line per step, each indented under the step it feeds
+    std::vector<std::string> lines;
+    size_t depth = 0;
+    auto add = [&](const std::string& step, double rows, std::optional<double> cost = std::nullopt,
+                   const std::string& measured = "") {
+        std::string line = depth == 0 ? "" : std::string(depth * 4 - 4, ' ') + "  -> ";
+        line += step + "  (rows=" + formatEstimate(rows);
+        if (cost) line += " cost=" + formatEstimate(*cost);
+        lines.push_back(line + ")" + measured);
+        ++depth;
+    };
+    auto detail = [&](const std::string& text) {
+        lines.push_back(std::string(depth == 1 ? 2 : depth * 4 - 1, ' ') + text);
+    };
+    auto addAccess = [&](const std::string& role, const std::string& table_name, const TableAccess& access,
+                         Table& table, const TupleLayout& layout) {
+        size_t saved = depth;
+        std::string step = role + "Scan " + table_name;
+        if (access.index) {
+            const std::string& column = layout.fields()[access.index->field].name;
+            SecondaryIndex* index = table.findIndex(column, access.index->lower, access.index->upper);
+            step = role + "Index scan " + table_name + " using " + index->def().name;
+            std::string range = Predicate::toString(*access.index, column);
+            step += range.empty() ? " in " + column + " order" : ": " + range;
+        }
+        const StageProfile& stage = profile.scans[&access - physical.access.data()];
+        add(step, access.matches, access.cost, actual(stage, stage.rows_in));
+        lines.back().insert(lines.back().find(" cost="), " of " + formatEstimate(access.rows));
+        if (access.filter) detail("Filter: " + access.filter->toString());
+        depth = saved;
+    };
+
+    const StageProfile& statement = profile.statement;
+    if (query.type == QueryType::INSERT) {
+        double rows = static_cast<double>(insertedRows(query));
+        add("Insert into " + plan.table_name, rows, std::nullopt, actual(statement, statement.rows_out));
+    } else if (query.type == QueryType::UPDATE) {
+        add("Update " + plan.table_name, physical.rows, std::nullopt, actual(statement, scanned.rows_out));
+    } else if (query.type == QueryType::DELETE) {
+        add("Delete from " + plan.table_name, physical.rows, std::nullopt, actual(statement, scanned.rows_out));
+    }
+
+    double rows = physical.rows;
+    if (query.type == QueryType::SELECT) {
+        // Rows each step passes on, from the scan up
+        double groups = rows;
+        if (plan.aggregated) {
+            groups = 1;
+            for (size_t field : plan.group_indexes) {
+                const TableStats* stats = plan.schema.stats.get();
+                if (plan.join) {
+                    size_t side = field >= plan.join->right_offset ? 1 : 0;
+                    stats = plan.join->stats[side].get();
+                    field -= side * plan.join->right_offset;
                 }
-                if (!validateValue(value, it->second)) {
-                    throw std::runtime_error("Invalid value for field " + field);
+                groups *= estimateDistinct(field, rows, stats && stats->rows > 0 ? stats : nullptr);
+            }
+            groups = std::min(groups, std::max(rows, 1.0));
+        }
+        double shown = groups;
+        if (plan.limit) shown = std::min(shown, static_cast<double>(*plan.limit));
+        shown = std::max(0.0, std::min(shown, groups - static_cast<double>(plan.offset)));
+        if (plan.limit || plan.offset > 0) {
+            std::string step = plan.limit ? "Limit " + std::to_string(*plan.limit) : "Limit all";
+            if (plan.offset > 0) step += " offset " + std::to_string(plan.offset);
+            const StageProfile& fed = plan.order_keys.empty() ? grouped : profile.sort;
+            add(step, shown, std::nullopt, actual(statement, fed.rows_out));
+        }
+        if (!plan.order_keys.empty()) {
+            std::string keys;
+            for (const auto& key : plan.order_keys) {
+                if (!keys.empty()) keys += ", ";
+                keys += plan.aggregated ? plan.output_fields[key.field] : plan.schema.fields[key.field].name;
+                if (key.descending) keys += " DESC";
+            }
+            size_t wanted = kNoLimit;
+            if (plan.limit) wanted = plan.offset + std::min(*plan.limit, kNoLimit - plan.offset);
+            bool top = !plan.aggregated && wanted <= kMaxTopN;
+            add((top ? "Top-" + std::to_string(wanted) + " sort by " : "Sort by ") + keys, groups, std::nullopt,
+                actual(profile.sort, grouped.rows_out));
+        }
+        if (plan.aggregated) {
+            std::string step = "Aggregate";
+            for (size_t i = 0; i < plan.group_indexes.size(); ++i) {
+                step += (i == 0 ? " by " : ", ") + plan.schema.fields[plan.group_indexes[i]].name;
+            }
+            add(step, groups, std::nullopt, actual(profile.aggregate, scanned.rows_out));
+        }
+    }
+
+    if (physical.matches_nothing) {
+        add("No rows: the WHERE clause is never true", 0);
+    } else if (query.type != QueryType::INSERT && !plan.join) {
+        addAccess("", plan.table_name, physical.access[0], *plan.table, *plan.schema.layout);
+    } else if (plan.join) {
+        const JoinPlan& join = *plan.join;
+        std::string names[2] = {plan.table_name, query.join_table};
+        std::string on = plan.schema.fields[join.keys[0]].name + " = " +
+                         plan.schema.fields[join.right_offset + join.keys[1]].name;
+        std::string measured = actual(profile.join, profile.scans[0].rows_out + profile.scans[1].rows_out);
+        if (physical.join_method == JoinMethod::MERGE) {
+            add("Merge join on " + on, rows, physical.cost, measured);
+        } else {
+            add("Hash join on " + on + ", building on " + names[physical.build], rows, physical.cost, measured);
+        }
+        if (physical.residual) detail("Filter: " + physical.residual->toString());
+        size_t first = physical.join_method == JoinMethod::MERGE ? 0 : physical.build;
+        for (size_t side : {first, 1 - first}) {
+            std::string role;
+            if (physical.join_method == JoinMethod::HASH) role = side == physical.build ? "Build: " : "Probe: ";
+            addAccess(role, names[side], physical.access[side], *join.tables[side], *join.layouts[side]);
+        }
+    }
+
+    if (analyzing) {
+        std::chrono::nanoseconds formatting(profile.format_ns.load());
+        lines.push_back("Parsing: " + formatMillis(profile.parse) + " ms");
+        lines.push_back("Planning: " + formatMillis(profile.plan) + " ms");
+        lines.push_back("Execution: " + formatMillis(statement.time) + " ms");
+        lines.push_back("Output: " + std::to_string(statement.rows_out) + " rows, " +
+                        formatBytes(profile.output_bytes) + " in " + formatMillis(profile.output) + " ms");
+        if (query.type == QueryType::SELECT) {
+            lines.push_back("Formatting: " + formatMillis(formatting) + " ms, over all threads");
+        }
+    }
+    for (const auto& line : lines) {
+        *out_ << line << "\n";
+    }
+}
+
+DatabaseManager::Plan DatabaseManager::planQuery(const Query& query) {
+    Plan plan;
+    plan.database = current_db_;
+    plan.schema_version = shared_->schema_version;
+    plan.table_name = query.table;
+    plan.schema = loadTableSchema(query.table);
+    plan.table = &Storage::openTable(current_db_, query.table, base_path_);
+    if (!query.join_table.empty()) {
+        planJoin(plan, query);
+    }
+
+    auto fieldIndex = [&](const std::string& name) { return resolveField(plan, name); };
+    for (const auto& [field, value] : query.type == QueryType::INSERT ? query.insert_values : query.update_values) {
+        plan.value_fields.push_back(fieldIndex(field));
+    }
+    if (query.type == QueryType::SELECT) {
+        bool has_aggregates = false;
+        for (const auto& item : query.select_items) {
+            has_aggregates |= item.aggregate != AggregateFunc::NONE;
+        }
+        if (has_aggregates || !query.group_by.empty()) {
+            planAggregate(plan, query);
+        } else if (query.select_items.empty()) {
+            for (const auto& [name, type] : plan.schema.field_types) {
+                plan.output_fields.push_back(name);
+            }
+        } else {
+            for (const auto& item : query.select_items) {
+                plan.output_fields.push_back(item.field);
+            }
+        }
+        if (!plan.aggregated) {
+            for (const auto& field : plan.output_fields) {
+                plan.output_indexes.push_back(fieldIndex(field));
+            }
+        }
+        for (const auto& order : query.order_by) {
+            std::string label = order.item.label();
+            if (plan.aggregated) {
+                auto it = std::find(plan.output_fields.begin(), plan.output_fields.end(), label);
+                if (it == plan.output_fields.end()) {
+                    throw std::runtime_error("ORDER BY " + label + " must be in the SELECT list");
                 }
-                row[field] = value;
+                plan.order_keys.push_back({static_cast<size_t>(it - plan.output_fields.begin()), order.descending});
+            } else if (order.item.aggregate != AggregateFunc::NONE) {
+                throw std::runtime_error("ORDER BY " + label + " needs an aggregate SELECT list");
+            } else {
+                plan.order_keys.push_back({fieldIndex(order.item.field), order.descending});
             }
-            ++updated;
         }
+        plan.limit = query.limit;
+        plan.offset = query.offset;
+    }
+    if (query.where) {
+        plan.where = Predicate::compile(*query.where, *plan.schema.layout,
+                                        [&](const std::string& name) { return findField(plan, name); });
     }
 
-    Storage::saveTableData(current_db_, query.table, data, base_path_);
-    std::cout << updated << " rows updated.\n";
+    // Columnar tables only read these columns
+    if (query.type == QueryType::UPDATE) {
+        for (size_t i = 0; i < plan.schema.fields.size(); ++i) {
+            plan.scan_fields.push_back(i);
+        }
+    } else if (plan.aggregated) {
+        plan.scan_fields = plan.group_indexes;
+        for (const auto& spec : plan.aggregates) {
+            if (spec.field != AggregateSpec::kNoField) plan.scan_fields.push_back(spec.field);
+        }
+    } else {
+        plan.scan_fields = plan.output_indexes;
+        for (const auto& key : plan.order_keys) {
+            plan.scan_fields.push_back(key.field);
+        }
+    }
+    if (plan.where) {
+        for (size_t field : plan.where->fields()) {
+            plan.scan_fields.push_back(field);
+        }
+    }
+    if (plan.join) {
+        // Each table reads its share of the fields and its ON column
+        JoinPlan& join = *plan.join;
+        for (size_t field : plan.scan_fields) {
+            size_t side = field >= join.right_offset ? 1 : 0;
+            join.scan_fields[side].push_back(field - side * join.right_offset);
+        }
+        for (size_t side = 0; side < 2; ++side) {
+            join.scan_fields[side].push_back(join.keys[side]);
+        }
+    }
+    return plan;
 }
 
-void DatabaseManager::deleteFrom(const Query& query) {
-    auto schema = loadTableSchema(query.table);
-    json data = Storage::loadTableData(current_db_, query.table, base_path_);
-    json new_data = json::array();
-    int deleted = 0;
+void DatabaseManager::planJoin(Plan& plan, const Query& query) {
+    if (query.join_table == query.table) {
+        throw std::runtime_error("A table cannot be joined with itself");
+    }
+    JoinPlan join;
+    TableSchema right = loadTableSchema(query.join_table);
+    const TableSchema* schemas[2] = {&plan.schema, &right};
+    const std::string* names[2] = {&query.table, &query.join_table};
+    TableSchema joined;
+    for (size_t side = 0; side < 2; ++side) {
+        join.tables[side] = &Storage::openTable(current_db_, *names[side], base_path_);
+        join.layouts[side] = schemas[side]->layout;
+        join.stats[side] = schemas[side]->stats;
+        for (const auto& field : schemas[side]->fields) {
+            joined.fields.push_back({*names[side] + "." + field.name, field.type});
+            joined.field_types[joined.fields.back().name] = field.type;
+        }
+    }
+    join.right_offset = plan.schema.fields.size();
+    joined.layout = std::make_shared<TupleLayout>(joined.fields);
+    plan.schema = std::move(joined);
+    plan.join = std::move(join);
+
+    // ON compares a column of each table, in either order
+    size_t left_key = resolveField(plan, query.join_left);
+    size_t right_key = resolveField(plan, query.join_right);
+    if (left_key > right_key) std::swap(left_key, right_key);
+    if (left_key >= plan.join->right_offset || right_key < plan.join->right_offset) {
+        throw std::runtime_error("JOIN ON must compare a column of " + query.table + " with one of " + query.join_table);
+    }
+    if (plan.schema.fields[left_key].type != plan.schema.fields[right_key].type) {
+        throw std::runtime_error("Cannot join " + plan.schema.fields[left_key].name + " with " +
+                                 plan.schema.fields[right_key].name + " of another type");
+    }
+    plan.join->keys = {left_key, right_key - plan.join->right_offset};
+}
+
+size_t DatabaseManager::resolveField(const Plan& plan, const std::string& name) const {
+    if (auto field = findField(plan, name)) return *field;
+    throw std::runtime_error("Unknown field: " + name);
+}
+
+std::optional<size_t> DatabaseManager::findField(const Plan& plan, const std::string& name) const {
+    const TupleLayout& layout = *plan.schema.layout;
+    size_t dot = name.find('.');
+    if (!plan.join) {
+        if (dot != std::string::npos && name.compare(0, dot, plan.table_name) == 0) {
+            return layout.findField(name.substr(dot + 1));
+        }
+        return layout.findField(name);
+    }
+    if (dot != std::string::npos) return layout.findField(name);
+    std::optional<size_t> found;
+    const auto& fields = layout.fields();
+    for (size_t i = 0; i < fields.size(); ++i) {
+        const std::string& field = fields[i].name;
+        if (field.size() > name.size() && field.compare(field.size() - name.size(), name.size(), name) == 0 &&
+            field[field.size() - name.size() - 1] == '.') {
+            if (found) {
+                throw std::runtime_error("Ambiguous column: " + name);
+            }
+            found = i;
+        }
+    }
+    return found;
+}
+
+void DatabaseManager::planAggregate(Plan& plan, const Query& query) {
+    if (query.select_items.empty()) {
+        throw std::runtime_error("SELECT * cannot be used with GROUP BY");
+    }
+    const TupleLayout& layout = *plan.schema.layout;
+    plan.aggregated = true;
+    for (const auto& name : query.group_by) {
+        plan.group_indexes.push_back(resolveField(plan, name));
+    }
+    for (const auto& item : query.select_items) {
+        plan.output_fields.push_back(item.label());
+        if (item.aggregate == AggregateFunc::NONE) {
+            size_t field = resolveField(plan, item.field);
+            auto it = std::find(plan.group_indexes.begin(), plan.group_indexes.end(), field);
+            if (it == plan.group_indexes.end()) {
+                throw std::runtime_error("Column " + item.field + " must appear in GROUP BY or in an aggregate");
+            }
+            plan.output_sources.push_back(static_cast<size_t>(it - plan.group_indexes.begin()));
+            continue;
+        }
+        AggregateSpec spec{item.aggregate};
+        if (!item.field.empty()) {
+            spec.field = resolveField(plan, item.field);
+            spec.type = layout.fields()[spec.field].type;
+        }
+        if ((item.aggregate == AggregateFunc::SUM || item.aggregate == AggregateFunc::AVG) &&
+            spec.type != DataType::INT && spec.type != DataType::FLOAT) {
+            throw std::runtime_error(item.label() + " needs an INT or FLOAT column");
+        }
+        plan.output_sources.push_back(plan.group_indexes.size() + plan.aggregates.size());
+        plan.aggregates.push_back(spec);
+    }
+}
 
-    for (const auto& row : data) {
-        if (query.where_field.empty() || row[query.where_field].get<std::string>() != query.where_value) {
-            new_data.push_back(row);
+bool DatabaseManager::isCurrent(const Plan& plan) const {
+    return plan.table && plan.database == current_db_ && plan.schema_version == shared_->schema_version;
+}
+
+DatabaseManager::PhysicalPlan DatabaseManager::choosePlan(const Plan& plan, const Query& query, bool estimate) {
+    PhysicalPlan physical;
+    std::optional<Predicate> filter;
+    if (plan.where) {
+        filter = plan.where->bind(query.where_values);
+        physical.matches_nothing = filter->isFalse();
+        // A WHERE that always holds filters nothing
+        if (filter->isTrue()) filter.reset();
+    }
+    // Statistics of a table that was empty when analyzed say nothing about it now
+    auto usable = [](const std::shared_ptr<const TableStats>& stats) {
+        return stats && stats->rows > 0 ? stats.get() : nullptr;
+    };
+
+    if (profile_) {
+        for (size_t side = 0; side < 2; ++side) {
+            physical.access[side].profile = &profile_->scans[side];
+        }
+    }
+
+    if (!plan.join) {
+        TableAccess& access = physical.access[0];
+        access.filter = std::move(filter);
+        chooseAccess(*plan.table, *plan.schema.layout, usable(plan.schema.stats), access, estimate);
+        physical.rows = access.matches;
+        physical.cost = access.cost;
+        return physical;
+    }
+
+    const JoinPlan& join = *plan.join;
+    auto& access = physical.access;
+    if (filter) {
+        physical.residual = std::move(filter);
+        access[0].filter = physical.residual->extract(0, join.right_offset);
+        access[1].filter = physical.residual->extract(join.right_offset, plan.schema.fields.size());
+        if (physical.residual->isTrue()) physical.residual.reset();
+    }
+    const TableStats* stats[2];
+    for (size_t side = 0; side < 2; ++side) {
+        stats[side] = usable(join.stats[side]);
+        chooseAccess(*join.tables[side], *join.layouts[side], stats[side], access[side], true);
+    }
+
+    // Each key value meets its matches on the other side; without statistics
+    // the keys are taken to be unique
+    double distinct = std::max(estimateDistinct(join.keys[0], access[0].matches, stats[0]),
+                               estimateDistinct(join.keys[1], access[1].matches, stats[1]));
+    physical.rows = access[0].matches * access[1].matches / distinct;
+    if (physical.residual) physical.rows *= estimateSelectivity(*physical.residual, nullptr);
+    // Share of the join a LIMIT without ORDER BY or aggregates needs
+    double needed = 1;
+    if (plan.limit && plan.order_keys.empty() && !plan.aggregated && physical.rows > 0) {
+        needed = std::min(1.0, static_cast<double>(plan.offset + *plan.limit) / physical.rows);
+    }
+
+    // Hash join building on either table. One that spills partitions both
+    // tables completely before joining.
+    physical.cost = std::numeric_limits<double>::infinity();
+    for (size_t build = 0; build < 2; ++build) {
+        const TableAccess& build_side = access[build];
+        const TableAccess& probe_side = access[1 - build];
+        double cost = build_side.cost + build_side.matches * kHashBuildCost;
+        if (build_side.matches * hashRowBytes(*join.layouts[build]) > work_memory_) {
+            cost += probe_side.cost + (build_side.matches + probe_side.matches) * kSpillRowCost +
+                    probe_side.matches * kHashProbeCost;
         } else {
-            ++deleted;
+            cost += (probe_side.cost + probe_side.matches * kHashProbeCost) * needed;
+        }
+        if (cost < physical.cost) {
+            physical.cost = cost;
+            physical.build = build;
+        }
+    }
+    // Sort-merge join, reading every row of both tables in ON column order
+    // through their indexes
+    auto keyName = [&](size_t side) { return join.layouts[side]->fields()[join.keys[side]].name; };
+    auto ordered = [&](size_t side) { return join.tables[side]->findIndex(keyName(side), std::nullopt, std::nullopt); };
+    if (ordered(0) && ordered(1)) {
+        double costs[2];
+        for (size_t side = 0; side < 2; ++side) {
+            costs[side] = kIndexLookupCost + access[side].rows * kIndexRowCost;
+        }
+        double cost = (costs[0] + costs[1]) * needed;
+        if (cost < physical.cost) {
+            physical.cost = cost;
+            physical.join_method = JoinMethod::MERGE;
+            for (size_t side = 0; side < 2; ++side) {
+                access[side].index = Predicate::Range{join.keys[side], std::nullopt, std::nullopt};
+                access[side].cost = costs[side];
+            }
+        }
+    }
+    return physical;
+}
+
+void DatabaseManager::chooseAccess(Table& table, const TupleLayout& layout, const TableStats* stats, TableAccess& access,
+                                   bool estimate) {
+    auto indexFor = [&](const Predicate::Range& range) {
+        return table.findIndex(layout.fields()[range.field].name, range.lower, range.upper);
+    };
+    // A unique index finds at most one row, so it beats any other range
+    std::vector<Predicate::Range> ranges;
+    const Predicate::Range* unique = nullptr;
+    if (access.filter) {
+        for (auto& range : access.filter->indexRanges()) {
+            if (indexFor(range)) ranges.push_back(std::move(range));
+        }
+        for (const auto& range : ranges) {
+            if (!indexFor(range)->ordered()) {
+                unique = &range;
+                break;
+            }
         }
     }
+    if (unique) {
+        access.index = *unique;
+    } else if (!stats && !ranges.empty()) {
+        access.index = ranges.front();
+    }
+    if (!estimate && (!stats || ranges.empty() || unique)) return;
 
-    Storage::saveTableData(current_db_, query.table, new_data, base_path_);
-    std::cout << deleted << " rows deleted.\n";
+    access.rows = stats ? static_cast<double>(stats->rows) : static_cast<double>(table.estimateRows());
+    if (unique) {
+        // The key has at most one row, whatever the histogram says
+        access.matches = std::min(access.rows, 1.0);
+        access.cost = kHashLookupCost + kIndexRowCost;
+        return;
+    }
+    access.matches = access.rows * (access.filter ? estimateSelectivity(*access.filter, stats) : 1);
+    auto rangeCost = [&](const Predicate::Range& range) {
+        return kIndexLookupCost + access.rows * estimateSelectivity(range, stats) * kIndexRowCost;
+    };
+    access.cost = access.rows;
+    if (!stats) {
+        if (access.index) access.cost = rangeCost(*access.index);
+        return;
+    }
+    for (const auto& range : ranges) {
+        double cost = rangeCost(range);
+        if (cost < access.cost) {
+            access.cost = cost;
+            access.index = range;
+        }
+    }
+}
+
+void DatabaseManager::runPlan(const Plan& plan, const Query& query, const PhysicalPlan& physical) {
+    if (query.type == QueryType::SELECT) {
+        SnapshotScope snapshot(snapshot_);
+        if (plan.aggregated) {
+            aggregate(plan, physical);
+        } else {
+            select(plan, physical);
+        }
+        return;
+    }
+    // Outside a transaction, every statement is a write of its own
+    std::optional<WriteScope> write;
+    if (!transaction_) write.emplace(*plan.table, base_path_);
+    uint64_t version = write ? write->version() : 0;
+    switch (query.type) {
+        case QueryType::INSERT:
+            insert(plan, query, version);
+            break;
+        case QueryType::UPDATE:
+            update(plan, query, physical, version);
+            break;
+        case QueryType::DELETE:
+            deleteFrom(plan, physical, version);
+            break;
+        default:
+            throw std::runtime_error("Unsupported query type");
+    }
+    if (write) write->commit();
+}
+
+void DatabaseManager::insert(const Plan& plan, const Query& query, uint64_t version) {
+    // Every value of a column is checked and converted in one pass, before
+    // any row is stored
+    size_t columns = query.insert_values.size();
+    size_t rows = insertedRows(query);
+    std::vector<std::vector<FieldValue>> values(rows, std::vector<FieldValue>(plan.schema.fields.size()));
+    for (size_t i = 0; i < columns; ++i) {
+        const TableField& field = plan.schema.fields[plan.value_fields[i]];
+        for (size_t row = 0; row < rows; ++row) {
+            const std::string& literal =
+                row == 0 ? query.insert_values[i].second : query.insert_rows[(row - 1) * columns + i];
+            if (!validateValue(literal, field.type)) {
+                throw std::runtime_error("Invalid value for field " + field.name);
+            }
+            values[row][plan.value_fields[i]] = stringToDataValue(literal, field.type);
+        }
+    }
+    std::vector<std::string> records;
+    records.reserve(rows);
+    for (const auto& row : values) {
+        records.push_back(plan.schema.layout->encode(row));
+    }
+
+    if (transaction_) {
+        for (const auto& record : records) plan.table->checkRecord(record);
+        TableChanges& staged = stageChanges(*plan.table);
+        if (plan.table->hasUniqueIndex()) {
+            plan.table->checkKeys(views(records), staged.replaced(), staged.rows());
+        }
+        for (auto& record : records) staged.insert(std::move(record));
+    } else if (rows == 1) {
+        plan.table->insert(records[0], version);
+    } else {
+        // One append for the whole statement
+        plan.table->insertBatch(records, version);
+    }
+    if (profile_) profile_->statement.rows_out = rows;
+    if (rows == 1) {
+        *out_ << "1 row inserted.\n";
+    } else {
+        *out_ << rows << " rows inserted.\n";
+    }
+}
+
+void DatabaseManager::select(const Plan& plan, const PhysicalPlan& physical) {
+    const auto& fields = plan.output_fields;
+    const TupleLayout& layout = *plan.schema.layout;
+    RowFormatter formatter(output_format_, fields);
+
+    // Rows are formatted by the morsels in parallel
+    auto format = [&](const TupleView& row, std::string& out) {
+        timeFormatting(profile_, [&] {
+            for (size_t i = 0; i < fields.size(); ++i) {
+                size_t field = plan.output_indexes[i];
+                formatter.cell(out, i, row, field, layout.fields()[field].type);
+            }
+            formatter.endRow(out);
+        });
+    };
+    RowWindow window(*out_, formatter, plan.offset, plan.limit, profile_);
+    size_t wanted = kNoLimit;
+    if (plan.limit) {
+        wanted = plan.offset + std::min(*plan.limit, kNoLimit - plan.offset);
+    }
+
+    if (plan.order_keys.empty()) {
+        // Morsels are printed in table order; the scan stops once LIMIT is met
+        struct Lines {
+            std::string text;
+            std::vector<size_t> ends;
+        };
+        forEachMatch<Lines>(plan, physical, [&](Lines& part, const RecordId&, const TupleView& row) {
+            format(row, part.text);
+            part.ends.push_back(part.text.size());
+        }, [&](Lines& part) {
+            window.print(part.text, part.ends);
+        }, wanted);
+        return;
+    }
+
+    if (wanted <= kMaxTopN) {
+        // Every morsel keeps its first rows in a bounded heap, and the heaps are merged
+        struct TopRows {
+            std::optional<TopN> rows;
+            std::string key;
+        };
+        StageTimer timer(profile_ ? &profile_->sort : nullptr, Storage::bufferPool());
+        TopN top(wanted);
+        forEachMatch<TopRows>(plan, physical, [&](TopRows& part, const RecordId& rid, const TupleView& row) {
+            if (!part.rows) part.rows.emplace(wanted);
+            encodeSortKey(row, plan.order_keys, rid, part.key);
+            if (!part.rows->accepts(part.key)) return;
+            SortEntry entry{part.key, std::string()};
+            format(row, entry.row);
+            part.rows->push(std::move(entry));
+        }, [&](TopRows& part) {
+            if (part.rows) top.merge(std::move(*part.rows));
+        });
+        std::vector<SortEntry> rows = top.take();
+        timer.stop();
+        if (profile_) profile_->sort.rows_out = rows.size();
+        for (const auto& entry : rows) {
+            if (!window.print(entry.row)) break;
+        }
+        return;
+    }
+
+    // Morsels sort their rows in parallel; the sorted runs are merged, through
+    // run files once they outgrow the sort memory
+    StageTimer timer(profile_ ? &profile_->sort : nullptr, Storage::bufferPool());
+    ExternalSorter sorter(base_path_ + "/" + plan.database, work_memory_);
+    forEachMatch<std::vector<SortEntry>>(plan, physical, [&](std::vector<SortEntry>& part, const RecordId& rid,
+                                                           const TupleView& row) {
+        SortEntry entry;
+        encodeSortKey(row, plan.order_keys, rid, entry.key);
+        format(row, entry.row);
+        part.push_back(std::move(entry));
+    }, [&](std::vector<SortEntry>& part) {
+        sorter.add(std::move(part));
+    }, kNoLimit, sortEntries);
+    sorter.finish([&](const SortEntry& entry) {
+        if (profile_) ++profile_->sort.rows_out;
+        return window.print(entry.row);
+    });
+}
+
+void DatabaseManager::aggregate(const Plan& plan, const PhysicalPlan& physical) {
+    const TupleLayout& layout = *plan.schema.layout;
+
+    // Pre-aggregate each morsel into hash partitions, then merge partition by partition
+    StageTimer timer(profile_ ? &profile_->aggregate : nullptr, Storage::bufferPool());
+    using Part = std::optional<PartialAggregate>;
+    std::vector<PartialAggregate> partials;
+    forEachMatch<Part>(plan, physical, [&](Part& part, const RecordId&, const TupleView& row) {
+        if (!part) part.emplace(layout, plan.group_indexes, plan.aggregates);
+        part->add(row);
+    }, [&](Part& part) {
+        if (part) partials.push_back(std::move(*part));
+    });
+    std::vector<AggregateTable> results(PartialAggregate::kPartitions, AggregateTable(plan.aggregates));
+    workers_.run(results.size(), [&](size_t p) {
+        for (const auto& partial : partials) {
+            results[p].merge(partial.partition(p));
+        }
+    });
+    timer.stop();
+
+    const auto& fields = plan.output_fields;
+    RowFormatter formatter(output_format_, fields);
+    RowWindow window(*out_, formatter, plan.offset, plan.limit, profile_);
+
+    std::vector<DataType> group_types;
+    for (size_t field : plan.group_indexes) {
+        group_types.push_back(layout.fields()[field].type);
+    }
+    struct Group {
+        std::vector<FieldValue> keys;
+        const AggregateState* states;
+    };
+    std::vector<Group> groups;
+    for (const auto& table : results) {
+        for (size_t group = 0; group < table.size(); ++group) {
+            groups.push_back({decodeGroupKey(table.key(group), group_types), table.states(group)});
+        }
+    }
+    // Without GROUP BY there is exactly one group, even for no rows
+    std::vector<AggregateState> empty(plan.aggregates.size());
+    if (plan.group_indexes.empty() && partials.empty()) {
+        groups.push_back({{}, empty.data()});
+    }
+    if (profile_) profile_->aggregate.rows_out = groups.size();
+
+    if (!plan.order_keys.empty()) {
+        StageTimer sort_timer(profile_ ? &profile_->sort : nullptr, Storage::bufferPool());
+        if (profile_) profile_->sort.rows_out = groups.size();
+        size_t key_count = plan.group_indexes.size();
+        std::stable_sort(groups.begin(), groups.end(), [&](const Group& a, const Group& b) {
+            for (const auto& key : plan.order_keys) {
+                size_t source = plan.output_sources[key.field];
+                int cmp = source < key_count
+                              ? compareFieldValues(a.keys[source], b.keys[source])
+                              : compareAggregates(plan.aggregates[source - key_count], a.states[source - key_count],
+                                                  b.states[source - key_count]);
+                if (cmp != 0) return key.descending ? cmp > 0 : cmp < 0;
+            }
+            return false;
+        });
+    }
+
+    std::string line;
+    for (const auto& group : groups) {
+        line.clear();
+        timeFormatting(profile_, [&] {
+            for (size_t i = 0; i < fields.size(); ++i) {
+                size_t source = plan.output_sources[i];
+                if (source < group.keys.size()) {
+                    formatter.cell(line, i, group.keys[source]);
+                    continue;
+                }
+                source -= group.keys.size();
+                const AggregateSpec& spec = plan.aggregates[source];
+                const AggregateState& state = group.states[source];
+                if (spec.func != AggregateFunc::COUNT && state.count == 0) {
+                    formatter.cell(line, i, std::nullopt, false);
+                } else {
+                    bool is_string = spec.func != AggregateFunc::COUNT && spec.func != AggregateFunc::SUM &&
+                                     spec.func != AggregateFunc::AVG && spec.type == DataType::STRING;
+                    formatter.cell(line, i, std::string_view(aggregateResult(spec, state)), is_string);
+                }
+            }
+            formatter.endRow(line);
+        });
+        if (!window.print(line)) break;
+    }
+}
+
+void DatabaseManager::update(const Plan& plan, const Query& query, const PhysicalPlan& physical, uint64_t version) {
+    std::vector<DataValue> new_values;
+    for (size_t i = 0; i < query.update_values.size(); ++i) {
+        const TableField& field = plan.schema.fields[plan.value_fields[i]];
+        const std::string& literal = query.update_values[i].second;
+        if (!validateValue(literal, field.type)) {
+            throw std::runtime_error("Invalid value for field " + field.name);
+        }
+        new_values.push_back(stringToDataValue(literal, field.type));
+    }
+
+    // Collect matches first: rewriting a record may move it to a later page.
+    // The record ids stay valid while the table is pinned.
+    Table::Pin pin(*plan.table);
+    using Matches = std::vector<std::pair<RecordId, std::vector<FieldValue>>>;
+    Matches matches;
+    forEachMatch<Matches>(plan, physical, [](Matches& part, const RecordId& rid, const TupleView& row) {
+        part.emplace_back(rid, row.values());
+    }, [&](Matches& part) {
+        std::move(part.begin(), part.end(), std::back_inserter(matches));
+    });
+
+    // Every row is checked before any is changed
+    std::vector<std::string> records;
+    records.reserve(matches.size());
+    for (auto& [rid, values] : matches) {
+        for (size_t i = 0; i < new_values.size(); ++i) {
+            values[plan.value_fields[i]] = new_values[i];
+        }
+        records.push_back(plan.schema.layout->encode(values));
+        plan.table->checkRecord(records.back());
+    }
+    if (plan.table->hasUniqueIndex() && !matches.empty()) {
+        std::set<RecordId> replaced;
+        for (const auto& match : matches) {
+            replaced.insert(match.first);
+        }
+        // Inside a transaction, the rows it already writes count as well
+        std::vector<std::string_view> pending;
+        if (transaction_) {
+            TableChanges& staged = stageChanges(*plan.table);
+            pending = staged.rows(replaced);
+            std::set<RecordId> stored = staged.replaced();
+            replaced.insert(stored.begin(), stored.end());
+        }
+        plan.table->checkKeys(views(records), replaced, pending);
+    }
+
+    if (transaction_) {
+        if (!matches.empty()) {
+            TableChanges& staged = stageChanges(*plan.table);
+            for (size_t i = 0; i < matches.size(); ++i) {
+                staged.update(matches[i].first, std::move(records[i]));
+            }
+        }
+    } else {
+        for (size_t i = 0; i < matches.size(); ++i) {
+            plan.table->update(matches[i].first, records[i], version);
+        }
+    }
+    if (profile_) profile_->statement.rows_out = matches.size();
+    *out_ << matches.size() << " rows updated.\n";
+}
+
+void DatabaseManager::deleteFrom(const Plan& plan, const PhysicalPlan& physical, uint64_t version) {
+    Table::Pin pin(*plan.table);
+    std::vector<RecordId> matches;
+    forEachMatch<std::vector<RecordId>>(plan, physical, [](std::vector<RecordId>& part, const RecordId& rid, const TupleView&) {
+        part.push_back(rid);
+    }, [&](std::vector<RecordId>& part) {
+        matches.insert(matches.end(), part.begin(), part.end());
+    });
+
+    if (transaction_) {
+        if (!matches.empty()) {
+            TableChanges& staged = stageChanges(*plan.table);
+            for (const auto& rid : matches) {
+                staged.erase(rid);
+            }
+        }
+    } else if (!physical.access[0].filter && Storage::versions().holdOffSnapshots(version)) {
+        // Truncating keeps no row images, so only while no snapshot needs them
+        plan.table->clear();
+    } else {
+        for (const auto& rid : matches) {
+            plan.table->erase(rid, version);
+        }
+    }
+    if (profile_) profile_->statement.rows_out = matches.size();
+    *out_ << matches.size() << " rows deleted.\n";
+}
+
+template <typename Part, typename Match, typename Emit>
+void DatabaseManager::forEachMatch(const Plan& plan, const PhysicalPlan& physical, Match match, Emit emit,
+                                   size_t limit, const std::function<void(Part&)>& finish) {
+    if (physical.matches_nothing) return;
+    if (plan.join) {
+        joinMatches<Part>(plan, physical, match, emit, limit, finish);
+    } else {
+        scanMatches<Part>(*plan.table, *plan.schema.layout, plan.scan_fields, physical.access[0], match, emit, limit,
+                          finish);
+    }
+}
+
+template <typename Part, typename Match, typename Emit>
+void DatabaseManager::scanMatches(Table& table, const TupleLayout& layout, const std::vector<size_t>& fields,
+                                  const TableAccess& access, Match match, Emit emit, size_t limit,
+                                  const std::function<void(Part&)>& finish) {
+    const auto& filter = access.filter;
+    Table::Pin pin(table);
+    StageTimer timer(access.profile, Storage::bufferPool());
+    // Stored rows the transaction has rewritten are matched from its write set instead
+    const TableChanges* changes = pendingChanges(table);
+    auto matchStored = [&](Part& part, const RecordId& rid, const TupleView& row) -> size_t {
+        if (changes && changes->changed.count(rid)) return 0;
+        return callMatch(match, part, rid, row);
+    };
+    auto matchWritten = [&](Part& part, size_t& count) {
+        changes->forEachRow([&](const RecordId& rid, const std::string& record) {
+            if (count >= limit) return false;
+            TupleView row(layout, record);
+            if (!filter || filter->matches(row)) count += callMatch(match, part, rid, row);
+            return true;
+        });
+    };
+
+    if (const auto& range = access.index) {
+        if (auto rids = table.indexRange(layout.fields()[range->field].name, range->lower, range->upper, snapshot_)) {
+            Part part;
+            std::string record;
+            size_t count = 0;
+            size_t visited = 0, survivors = 0;
+            for (const auto& rid : *rids) {
+                if (count >= limit) break;
+                if (!table.get(rid, record, snapshot_)) continue;
+                ++visited;
+                TupleView row(layout, record);
+                if (filter && !filter->matches(row)) continue;
+                ++survivors;
+                count += matchStored(part, rid, row);
+            }
+            if (access.profile) {
+                access.profile->rows_in += visited;
+                access.profile->rows_out += survivors;
+            }
+            if (changes) matchWritten(part, count);
+            if (finish) finish(part);
+            emit(part);
+            return;
+        }
+    }
+
+    // Filter a batch at a time into a selection vector, then visit the survivors
+    std::vector<Table::Morsel> morsels = table.morsels();
+    std::vector<Part> parts(morsels.size());
+    std::vector<size_t> counts(morsels.size());
+    std::atomic<bool> stopped{false};  // set once the emitted parts hold limit rows
+    std::atomic<uint64_t> visited{0}, survivors{0};
+    size_t emitted = 0;
+    workers_.run(morsels.size(), [&](size_t i) {
+        if (stopped.load(std::memory_order_relaxed)) return;
+        RowBatch batch(layout, fields);
+        std::vector<uint32_t> selection;
+        table.scanMorsel(morsels[i], batch, [&](RowBatch& batch) {
+            selection.resize(batch.size());
+            size_t count = filter ? filter->select(batch, selection.data())
+                                  : selectAll(batch.size(), batch.excluded(), selection.data());
+            if (access.profile) {
+                size_t live = batch.size();
+                if (const uint8_t* excluded = batch.excluded()) {
+                    for (size_t j = 0; j < batch.size(); ++j) live -= (excluded[j / 8] >> (j % 8)) & 1;
+                }
+                visited.fetch_add(live, std::memory_order_relaxed);
+                survivors.fetch_add(count, std::memory_order_relaxed);
+            }
+            for (size_t j = 0; j < count && counts[i] < limit; ++j) {
+                counts[i] += matchStored(parts[i], batch.rid(selection[j]), TupleView(layout, batch.record(selection[j])));
+            }
+            return counts[i] < limit && !stopped.load(std::memory_order_relaxed);
+        }, snapshot_);
+        if (finish) finish(parts[i]);
+    }, [&](size_t i) {
+        if (emitted < limit) {
+            emit(parts[i]);
+            emitted += counts[i];
+            if (emitted >= limit) stopped = true;
+        }
+        parts[i] = Part();
+    });
+    if (access.profile) {
+        access.profile->rows_in += visited.load();
+        access.profile->rows_out += survivors.load();
+    }
+    if (changes && emitted < limit) {
+        Part part;
+        matchWritten(part, emitted);
+        if (finish) finish(part);
+        emit(part);
+    }
+}
+
+template <typename Part, typename Match, typename Emit>
+void DatabaseManager::joinMatches(const Plan& plan, const PhysicalPlan& physical, Match match, Emit emit,
+                                  size_t limit, const std::function<void(Part&)>& finish) {
+    const JoinPlan& join = *plan.join;
+    const TupleLayout& joined = *plan.schema.layout;
+    const TupleLayout* layouts[2] = {join.layouts[0].get(), join.layouts[1].get()};
+    auto keyName = [&](size_t side) { return layouts[side]->fields()[join.keys[side]].name; };
+
+    // Conditions on one table filter its rows before they are joined; the
+    // rest are tested on the joined rows
+    auto access = physical.access;
+    Table::Pin left_pin(*join.tables[0]);
+    Table::Pin right_pin(*join.tables[1]);
+    const auto& residual = physical.residual;
+    StageTimer timer(profile_ ? &profile_->join : nullptr, Storage::bufferPool());
+    std::atomic<uint64_t> joined_rows{0};
+    struct CountJoined {
+        QueryProfile* profile;
+        std::atomic<uint64_t>& rows;
+        ~CountJoined() {
+            if (profile) profile->join.rows_out += rows.load();
+        }
+    } count_joined{profile_, joined_rows};
+    auto matchJoined = [&](Part& part, const RecordId& rid, const TupleView& row) -> size_t {
+        if (residual && !residual->matches(row)) return 0;
+        if (profile_) joined_rows.fetch_add(1, std::memory_order_relaxed);
+        return callMatch(match, part, rid, row);
+    };
+
+    std::optional<std::vector<RecordId>> ordered[2];
+    if (physical.join_method == JoinMethod::MERGE) {
+        for (size_t side = 0; side < 2; ++side) {
+            if (pendingChanges(*join.tables[side])) continue;
+            ordered[side] = join.tables[side]->indexRange(keyName(side), std::nullopt, std::nullopt, snapshot_);
+        }
+        // A table changed since the snapshot or by the transaction: hash
+        // join the scanned tables instead
+        if (!ordered[0] || !ordered[1]) {
+            for (auto& side : access) side.index.reset();
+        }
+    }
+    if (ordered[0] && ordered[1]) {
+        // Sort-merge join over both indexes, which hold the rows in key order
+        // (rows without a key are not indexed, and join nothing anyway)
+        struct Cursor {
+            std::vector<RecordId> rids;
+            size_t next = 0;
+            RecordId rid;
+            std::string record;
+            std::optional<TupleView> row;
+            DataValue key;
+        };
+        Cursor cursors[2];
+        auto advance = [&](size_t side) {
+            Cursor& cursor = cursors[side];
+            StageProfile* scan = access[side].profile;
+            while (cursor.next < cursor.rids.size()) {
+                cursor.rid = cursor.rids[cursor.next++];
+                if (!join.tables[side]->get(cursor.rid, cursor.record, snapshot_)) continue;
+                cursor.row.emplace(*layouts[side], cursor.record);
+                if (scan) ++scan->rows_in;
+                if (access[side].filter && !access[side].filter->matches(*cursor.row)) continue;
+                if (scan) ++scan->rows_out;
+                cursor.key = *cursor.row->get(join.keys[side]);
+                return true;
+            }
+            return false;
+        };
+        for (size_t side = 0; side < 2; ++side) {
+            cursors[side].rids = std::move(*ordered[side]);
+            if (access[side].profile) access[side].profile->ran = true;
+        }
+
+        Part part;
+        JoinedRowBuilder builder(joined, join.right_offset, join.scan_fields);
+        std::vector<std::string> group;
+        size_t count = 0;
+        bool has_left = advance(0);
+        bool has_right = advance(1);
+        while (has_left && has_right && count < limit) {
+            int cmp = compareValues(cursors[0].key, cursors[1].key);
+            if (cmp != 0) {
+                if (cmp < 0) {
+                    has_left = advance(0);
+                } else {
+                    has_right = advance(1);
+                }
+                continue;
+            }
+            // Every left row with this key meets every right row with it
+            DataValue key = cursors[1].key;
+            group.clear();
+            do {
+                group.push_back(cursors[1].record);
+                has_right = advance(1);
+            } while (has_right && compareValues(cursors[1].key, key) == 0);
+            do {
+                for (const auto& record : group) {
+                    TupleView right(*layouts[1], record);
+                    count += matchJoined(part, cursors[0].rid,
+                                       TupleView(joined, builder.build(*cursors[0].row, right)));
+                }
+                has_left = advance(0);
+            } while (has_left && compareValues(cursors[0].key, key) == 0);
+        }
+        if (finish) finish(part);
+        emit(part);
+        return;
+    }
+
+    // Hash join: load the build table, then probe with the other
+    size_t build = physical.build;
+    size_t probe = 1 - build;
+    auto joinRows = [&](JoinedRowBuilder& builder, const TupleView& probe_row, const TupleView& build_row) {
+        return TupleView(joined, build == 0 ? builder.build(build_row, probe_row) : builder.build(probe_row, build_row));
+    };
+    std::string dir = base_path_ + "/" + plan.database;
+    JoinHashTable hash;
+    std::unique_ptr<JoinPartitions> build_runs;
+    using Rows = std::vector<SortEntry>;
+    scanMatches<Rows>(*join.tables[build], *layouts[build], join.scan_fields[build], access[build],
+                      [&](Rows& part, const RecordId&, const TupleView& row) {
+        SortEntry entry;
+        if (!encodeJoinKey(row, join.keys[build], entry.key)) return;
+        entry.row = std::string(row.record());
+        part.push_back(std::move(entry));
+    }, [&](Rows& part) {
+        for (auto& entry : part) {
+            if (build_runs) {
+                build_runs->add(entry.key, entry.row);
+                continue;
+            }
+            hash.insert(std::move(entry.key), std::move(entry.row));
+            if (hash.bytes() > work_memory_) {
+                // Too big for memory: partition both tables by key instead
+                build_runs = std::make_unique<JoinPartitions>(dir);
+                hash.drain([&](const std::string& key, const std::string& row) { build_runs->add(key, row); });
+            }
+        }
+    }, kNoLimit, {});
+
+    if (!build_runs) {
+        struct Probe {
+            Part part;
+            std::optional<JoinedRowBuilder> builder;
+            std::string key;
+        };
+        scanMatches<Probe>(*join.tables[probe], *layouts[probe], join.scan_fields[probe], access[probe],
+                           [&](Probe& probe_part, const RecordId& rid, const TupleView& row) -> size_t {
+            if (!encodeJoinKey(row, join.keys[probe], probe_part.key)) return 0;
+            const auto* rows = hash.find(probe_part.key);
+            if (!rows) return 0;
+            if (!probe_part.builder) probe_part.builder.emplace(joined, join.right_offset, join.scan_fields);
+            size_t count = 0;
+            for (const auto& record : *rows) {
+                count += matchJoined(probe_part.part, rid,
+                                   joinRows(*probe_part.builder, row, TupleView(*layouts[build], record)));
+            }
+            return count;
+        }, [&](Probe& probe_part) {
+            emit(probe_part.part);
+        }, limit, [&](Probe& probe_part) {
+            if (finish) finish(probe_part.part);
+        });
+        return;
+    }
+
+    build_runs->close();
+    JoinPartitions probe_runs(dir);
+    scanMatches<Rows>(*join.tables[probe], *layouts[probe], join.scan_fields[probe], access[probe],
+                      [&](Rows& part, const RecordId& rid, const TupleView& row) {
+        SortEntry entry;
+        if (!encodeJoinKey(row, join.keys[probe], entry.key)) return;
+        // The record id travels in front of the record
+        ByteWriter out(entry.row);
+        out.put<PageId>(rid.page_id);
+        out.put<uint16_t>(rid.slot);
+        out.putRaw(row.record().data(), row.record().size());
+        part.push_back(std::move(entry));
+    }, [&](Rows& part) {
+        for (const auto& entry : part) {
+            probe_runs.add(entry.key, entry.row);
+        }
+    }, kNoLimit, {});
+    probe_runs.close();
+
+    // Join the partitions in parallel, each with its build rows in memory
+    size_t partitions = JoinPartitions::kPartitions;
+    std::vector<Part> parts(partitions);
+    std::vector<size_t> counts(partitions);
+    std::atomic<bool> stopped{false};
+    size_t emitted = 0;
+    workers_.run(partitions, [&](size_t p) {
+        if (stopped.load(std::memory_order_relaxed)) return;
+        JoinHashTable partition;
+        SortEntry entry;
+        RunReader build_rows(build_runs->path(p));
+        while (build_rows.next(entry)) {
+            partition.insert(std::move(entry.key), std::move(entry.row));
+        }
+        RunReader probe_rows(probe_runs.path(p));
+        JoinedRowBuilder builder(joined, join.right_offset, join.scan_fields);
+        while (counts[p] < limit && !stopped.load(std::memory_order_relaxed) && probe_rows.next(entry)) {
+            const auto* rows = partition.find(entry.key);
+            if (!rows) continue;
+            ByteReader in(entry.row);
+            RecordId rid;
+            rid.page_id = in.get<PageId>();
+            rid.slot = in.get<uint16_t>();
+            TupleView row(*layouts[probe], std::string_view(entry.row).substr(sizeof(PageId) + sizeof(uint16_t)));
+            for (const auto& record : *rows) {
+                counts[p] += matchJoined(parts[p], rid, joinRows(builder, row, TupleView(*layouts[build], record)));
+            }
+        }
+        if (finish) finish(parts[p]);
+    }, [&](size_t p) {
+        if (emitted < limit) {
+            emit(parts[p]);
+            emitted += counts[p];
+            if (emitted >= limit) stopped = true;
+        }
+        parts[p] = Part();
+    });
 }
 
 DatabaseManager::TableSchema DatabaseManager::loadTableSchema(const std::string& table_name) {
-    auto it = tables_.find(table_name);
-    if (it != tables_.end()) {
-        return it->second;
+    {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        auto it = shared_->tables.find(schemaKey(table_name));
+        if (it != shared_->tables.end()) {
+            return it->second;
+        }
     }
     auto schema = Storage::loadTableSchema(current_db_, table_name, base_path_);
     TableSchema result;
@@ -216,7 +2084,16 @@ DatabaseManager::TableSchema DatabaseManager::loadTableSchema(const std::string&
         result.fields.push_back(f);
         result.field_types[f.name] = f.type;
     }
-    tables_[table_name] = result;
+    result.layout = std::make_shared<TupleLayout>(result.fields);
+    result.format = schema.value("format", "row");
+    json stats = Storage::loadTableStats(current_db_, table_name, base_path_);
+    if (!stats.is_null()) {
+        if (auto parsed = TableStats::fromJson(stats, *result.layout)) {
+            result.stats = std::make_shared<const TableStats>(std::move(*parsed));
+        }
+    }
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    shared_->tables[schemaKey(table_name)] = result;
     return result;
 }
 
@@ -229,6 +2106,7 @@ void DatabaseManager::saveTableSchema(const std::string& table_name, const Table
         f["type"] = dataTypeToString(field.type);
         schema_json["fields"].push_back(f);
     }
+    schema_json["format"] = schema.format;
     Storage::saveTableSchema(current_db_, table_name, schema_json, base_path_);
 }
 
@@ -1,40 +1,300 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
 #include "types.hpp"
+#include "aggregate.hpp"
+#include "filter.hpp"
+#include "mvcc.hpp"
 #include "parser.hpp"
+#include "predicate.hpp"
+#include "profile.hpp"
+#include "result_sink.hpp"
+#include "sort.hpp"
+#include "statistics.hpp"
+#include "table.hpp"
+#include "thread_pool.hpp"
+#include "tuple.hpp"
 
 namespace minisql {
 
+    // Runs the statements of one client. Further clients get a session of
+    // their own from newSession(): sessions share the databases, the
+    // schemas and the worker threads, and may run statements at once.
+    // Schema changes wait for the running statements and hold off new ones;
+    // SELECTs read a snapshot, so writers never wait for them (see Table).
+    //
+    // Between BEGIN and COMMIT, a session's changes go to a private write
+    // set that its own statements read on top of the snapshot taken at
+    // BEGIN. COMMIT applies the whole set as one write with one log flush,
+    // unless a row it changes has been changed by another session since.
     class DatabaseManager {
     public:
-        DatabaseManager(const std::string& base_path);
+        // threads: scan parallelism, 0 for one thread per core
+        DatabaseManager(const std::string& base_path, size_t threads = 0);
+        ~DatabaseManager();
         void executeQuery(const Query& query);
         void setCurrentDatabase(const std::string& db_name);
         std::string getCurrentDatabase() const;
 
+        // A session with no database in use and no prepared statements, and
+        // the work memory and output format of this one
+        std::unique_ptr<DatabaseManager> newSession();
+
+        // Prepared statements. sql is one INSERT, SELECT, UPDATE or DELETE whose
+        // values may be parameters ($1, $2, ... or ?). It is parsed and resolved
+        // once; execute() only binds the parameters and runs it.
+        void prepare(const std::string& name, std::string_view sql);
+        void execute(const std::string& name, const std::vector<std::string>& params);
+        void deallocate(const std::string& name);
+
+        // Memory an ORDER BY sort or a hash join build may use before it
+        // spills to disk
+        void setWorkMemory(size_t bytes) { work_memory_ = bytes; }
+        // How SELECT prints its results
+        void setOutputFormat(OutputFormat format) { output_format_ = format; }
+        // Where statements print their results and messages (std::cout unless set)
+        void setOutput(std::ostream& out) { out_ = &out; }
+
     private:
+        static constexpr size_t kNoLimit = static_cast<size_t>(-1);
+
         struct TableSchema {
             std::vector<TableField> fields;
             std::map<std::string, DataType> field_types;
+            std::shared_ptr<const TupleLayout> layout;
+            std::string format = "row";
+            std::shared_ptr<const TableStats> stats;  // from ANALYZE, or null
+        };
+
+        // The tables of a SELECT ... JOIN; index 0 is the FROM table
+        struct JoinPlan {
+            std::array<Table*, 2> tables{};
+            std::array<std::shared_ptr<const TupleLayout>, 2> layouts;
+            std::array<size_t, 2> keys{};  // the ON column of each table
+            std::array<std::vector<size_t>, 2> scan_fields;
+            size_t right_offset = 0;       // first field of the right table in the joined layout
+            std::array<std::shared_ptr<const TableStats>, 2> stats;
+        };
+
+        // Names of a DML statement resolved against the schema. Reusable while
+        // the current database and schema_version_ are unchanged.
+        struct Plan {
+            std::string database;
+            uint64_t schema_version = 0;
+            std::string table_name;
+            TableSchema schema;  // for a join, the joined layout with fields named "table.column"
+            Table* table = nullptr;
+            std::optional<JoinPlan> join;
+            std::vector<size_t> value_fields;        // schema position of each INSERT/UPDATE value
+            std::vector<std::string> output_fields;  // SELECT columns
+            std::vector<size_t> output_indexes;
+            std::optional<Predicate> where;          // unbound; runPlan binds the literals
+            std::vector<size_t> scan_fields;         // fields the statement reads (see Table::scan)
+            // Aggregation (a SELECT with aggregates or GROUP BY)
+            bool aggregated = false;
+            std::vector<size_t> group_indexes;
+            std::vector<AggregateSpec> aggregates;
+            // Per output column: a GROUP BY column k, or group_indexes.size() + aggregate j
+            std::vector<size_t> output_sources;
+            // ORDER BY over table fields, or over output columns when aggregated
+            std::vector<SortKey> order_keys;
+            std::optional<size_t> limit;
+            size_t offset = 0;
+        };
+
+        // How one table of a statement is read
+        struct TableAccess {
+            std::optional<Predicate> filter;        // bound conditions on this table alone
+            std::optional<Predicate::Range> index;  // an index range to read instead of scanning
+            // Estimates, in units of one row read by a scan
+            double rows = 0;     // rows in the table
+            double matches = 0;  // rows that pass the filter
+            double cost = 0;
+            StageProfile* profile = nullptr;  // EXPLAIN ANALYZE: where the scan records what it did
         };
 
-        std::string base_path_;
+        enum class JoinMethod { HASH, MERGE };
+
+        // The physical side of one run of a Plan: access paths and join
+        // strategy, chosen by estimated cost once the WHERE literals are bound
+        struct PhysicalPlan {
+            bool matches_nothing = false;       // the WHERE is never true
+            std::array<TableAccess, 2> access;  // per table; index 0 is the FROM table
+            std::optional<Predicate> residual;  // join: conditions on both tables
+            JoinMethod join_method = JoinMethod::HASH;
+            size_t build = 0;                   // hash join: the table loaded into memory
+            double rows = 0;                    // estimated rows out of the scan or join
+            double cost = 0;
+        };
+
+        struct PreparedStatement {
+            Query query;  // parameters are bound into it in place
+            size_t param_count = 0;
+            Plan plan;
+        };
+
+        // What the sessions share; the last one to go checkpoints
+        struct Shared {
+            Shared(const std::string& base_path, size_t threads);
+            ~Shared();
+
+            std::string base_path;
+            ThreadPool workers;
+            // Held alone by schema changes, shared by every other statement
+            std::shared_mutex catalog;
+            std::mutex mutex;  // guards tables, cleaned and changing
+            std::map<std::string, TableSchema> tables;  // by "database/table"
+            std::set<std::string> cleaned;  // databases whose stale sort runs are removed
+            // Bumped by every schema change; plans from an older version are re-resolved
+            std::atomic<uint64_t> schema_version{0};
+            // Open transactions with changes to a table, by "database/table";
+            // schema changes to the table fail while there are any
+            std::map<std::string, size_t> changing;
+        };
+
+        // The changes of a transaction to one table. Inserted rows have
+        // record ids of their own (see pendingRid), after those of any
+        // stored row.
+        struct TableChanges {
+            std::unique_ptr<Table::Pin> pin;  // keeps the changed record ids valid
+            std::map<RecordId, std::optional<std::string>> changed;  // stored row: new record, or none if deleted
+            std::vector<std::optional<std::string>> inserted;        // none once deleted again
+
+            void insert(std::string record);
+            void update(const RecordId& rid, std::string record);
+            void erase(const RecordId& rid);
+            // Stored rows the transaction changes or deletes
+            std::set<RecordId> replaced() const;
+            // The rows the transaction writes, but those at skipped
+            std::vector<std::string_view> rows(const std::set<RecordId>& skipped = {}) const;
+            // Visits every row the transaction has written, in record id order
+            template <typename Visit>
+            void forEachRow(Visit visit) const;
+        };
+
+        // Counted in Shared::changing for each table it changes, for as long
+        // as it exists
+        struct Transaction {
+            explicit Transaction(Shared& shared);
+            ~Transaction();
+            Transaction(const Transaction&) = delete;
+            Transaction& operator=(const Transaction&) = delete;
+
+            Shared& shared;
+            VersionClock::SnapshotRef snapshot;
+            std::map<Table*, TableChanges> tables;
+        };
+
+        explicit DatabaseManager(std::shared_ptr<Shared> shared);
+
+        std::shared_ptr<Shared> shared_;
+        const std::string& base_path_;
+        ThreadPool& workers_;
+        size_t work_memory_ = 64 << 20;
+        OutputFormat output_format_ = OutputFormat::TABLE;
         std::string current_db_;
-        std::map<std::string, TableSchema> tables_;
+        Parser parser_;
+        std::map<std::string, PreparedStatement> prepared_;
+        // Set while EXPLAIN ANALYZE runs a statement
+        QueryProfile* profile_ = nullptr;
+        // Set while a statement reads as of a snapshot
+        const Snapshot* snapshot_ = nullptr;
+        std::ostream* out_ = &std::cout;
+        std::unique_ptr<Transaction> transaction_;  // between BEGIN and COMMIT or ROLLBACK
 
         void createDatabase(const std::string& db_name);
         void dropDatabase(const std::string& db_name);
         void createTable(const Query& query);
         void dropTable(const std::string& table_name);
-        void insert(const Query& query);
-        void select(const Query& query);
-        void update(const Query& query);
-        void deleteFrom(const Query& query);
+        void createIndex(const Query& query);
+        void dropIndex(const Query& query);
+        void prepare(const std::string& name, Query query);
+        // Collects the statistics of a table, or of every table when table_name is empty
+        void analyze(const std::string& table_name);
+        // COPY FROM: parses the whole file in parallel chunks, then writes the
+        // rows chunk by chunk; bad input stops it before any row is written
+        void copyFrom(const Query& query);
+        // EXPLAIN [ANALYZE]: prints the plan of query.prepared, after running
+        // it and with the measurements for ANALYZE
+        void explain(const Query& query);
+        void begin();
+        void commit();
+        void rollback();
+        // The write set for a table of the running transaction, or null
+        TableChanges* pendingChanges(Table& table);
+        TableChanges& stageChanges(Table& table);
+        // Throws if an open transaction changes the table, or without a
+        // table name, any table of the database
+        void checkUnchanged(const std::string& db_name, const std::string& table_name = "");
+
+        Plan planQuery(const Query& query);
+        void planJoin(Plan& plan, const Query& query);
+        void planAggregate(Plan& plan, const Query& query);
+        // Position of a column in the plan's schema. Columns may be qualified
+        // with their table; in a join, unqualified names must be unambiguous.
+        size_t resolveField(const Plan& plan, const std::string& name) const;
+        // resolveField(), but nullopt for an unknown column
+        std::optional<size_t> findField(const Plan& plan, const std::string& name) const;
+        bool isCurrent(const Plan& plan) const;
+        // Binds the WHERE and picks the access paths. Tables with statistics
+        // read an index range when its estimated cost beats a scan; without
+        // them an indexed range is always used. Joins are costed from the
+        // statistics or, failing them, sampled row counts. Estimates are only
+        // computed where they decide something, unless estimate is set.
+        PhysicalPlan choosePlan(const Plan& plan, const Query& query, bool estimate);
+        void chooseAccess(Table& table, const TupleLayout& layout, const TableStats* stats, TableAccess& access,
+                          bool estimate);
+        // SELECTs read a snapshot; the other statements write as a version of
+        // their own (see VersionClock), or into the transaction's write set
+        void runPlan(const Plan& plan, const Query& query, const PhysicalPlan& physical);
+        void insert(const Plan& plan, const Query& query, uint64_t version);
+        void select(const Plan& plan, const PhysicalPlan& physical);
+        void aggregate(const Plan& plan, const PhysicalPlan& physical);
+        void update(const Plan& plan, const Query& query, const PhysicalPlan& physical, uint64_t version);
+        void deleteFrom(const Plan& plan, const PhysicalPlan& physical, uint64_t version);
+
+        // Finds the rows matching the WHERE along the chosen access paths.
+        // A scan is split into morsels that run on
+        // the worker threads: match(part, rid, row) collects each morsel's
+        // rows into a Part of its own, finish(part) (if given) runs once the
+        // morsel is done, and emit(part) is then called on this thread for
+        // each Part in table order. The scan stops early once the emitted
+        // Parts hold at least limit rows. In a transaction, the rows it has
+        // written are matched last, in a Part of their own.
+        //
+        // For a join, match() sees the joined rows. Internally match() may
+        // also return the number of rows it passed on (see joinMatches).
+        template <typename Part, typename Match, typename Emit>
+        void forEachMatch(const Plan& plan, const PhysicalPlan& physical, Match match, Emit emit,
+                          size_t limit = kNoLimit, const std::function<void(Part&)>& finish = {});
+        // forEachMatch() over one table, reading the given fields
+        template <typename Part, typename Match, typename Emit>
+        void scanMatches(Table& table, const TupleLayout& layout, const std::vector<size_t>& fields,
+                         const TableAccess& access, Match match, Emit emit, size_t limit,
+                         const std::function<void(Part&)>& finish);
+        // forEachMatch() over a join: a sort-merge join over the indexes of
+        // both ON columns, or a hash join that partitions both tables to disk
+        // when the build side outgrows the work memory (or when an index does
+        // not match the snapshot)
+        template <typename Part, typename Match, typename Emit>
+        void joinMatches(const Plan& plan, const PhysicalPlan& physical, Match match, Emit emit, size_t limit,
+                         const std::function<void(Part&)>& finish);
 
+        // Schemas of the current database, cached in shared_
         TableSchema loadTableSchema(const std::string& table_name);
         void saveTableSchema(const std::string& table_name, const TableSchema& schema);
+        std::string schemaKey(const std::string& table_name) const { return current_db_ + "/" + table_name; }
     };
 
 } // namespace minisql
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "disk_manager.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace minisql {
+
+namespace {
+    std::string errnoMessage(const std::string& what, const std::string& path) {
+        return what + " '" + path + "': " + std::strerror(errno);
+    }
+}
+
+DiskManager::DiskManager(const std::string& path) : path_(path) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error(errnoMessage("Failed to open", path));
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        ::close(fd_);
+        throw std::runtime_error(errnoMessage("Failed to stat", path));
+    }
+    page_count_ = static_cast<PageId>(st.st_size / kPageSize);
+}
+
+DiskManager::~DiskManager() {
+    ::close(fd_);
+}
+
+void DiskManager::readPage(PageId page_id, char* out) {
+    if (page_id >= page_count_) {
+        throw std::runtime_error("Page " + std::to_string(page_id) + " out of range in " + path_);
+    }
+    off_t offset = static_cast<off_t>(page_id) * kPageSize;
+    size_t done = 0;
+    while (done < kPageSize) {
+        ssize_t n = ::pread(fd_, out + done, kPageSize - done, offset + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) throw std::runtime_error(errnoMessage("Failed to read", path_));
+        if (n == 0) {
+            // Short file (e.g. crash during extension): treat the rest as zeros
+            std::memset(out + done, 0, kPageSize - done);
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+}
+
+void DiskManager::writePage(PageId page_id, const char* data) {
+    off_t offset = static_cast<off_t>(page_id) * kPageSize;
+    size_t done = 0;
+    while (done < kPageSize) {
+        ssize_t n = ::pwrite(fd_, data + done, kPageSize - done, offset + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) throw std::runtime_error(errnoMessage("Failed to write", path_));
+        done += static_cast<size_t>(n);
+    }
+    if (page_id >= page_count_) {
+        page_count_ = page_id + 1;
+    }
+}
+
+PageId DiskManager::allocatePage() {
+    std::vector<char> zeros(kPageSize, 0);
+    PageId page_id = page_count_;
+    writePage(page_id, zeros.data());
+    return page_id;
+}
+
+void DiskManager::truncate(PageId page_count) {
+    if (::ftruncate(fd_, static_cast<off_t>(page_count) * kPageSize) != 0) {
+        throw std::runtime_error(errnoMessage("Failed to truncate", path_));
+    }
+    page_count_ = page_count;
+}
+
+void DiskManager::sync() {
+    if (::fdatasync(fd_) != 0) {
+        throw std::runtime_error(errnoMessage("Failed to sync", path_));
+    }
+}
+
+} // namespace minisql
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include "page.hpp"
+
+namespace minisql {
+
+    // Page-granular access to a single file. Pages are read and written with
+    // pread/pwrite so a change to one page never touches the rest of the file.
+    class DiskManager {
+    public:
+        explicit DiskManager(const std::string& path);
+        ~DiskManager();
+        DiskManager(const DiskManager&) = delete;
+        DiskManager& operator=(const DiskManager&) = delete;
+
+        void readPage(PageId page_id, char* out);
+        void writePage(PageId page_id, const char* data);
+        PageId allocatePage();
+        PageId pageCount() const { return page_count_; }
+        void truncate(PageId page_count);
+        void sync();
+        const std::string& path() const { return path_; }
+
+    private:
+        std::string path_;
+        int fd_;
+        PageId page_count_;
+    };
+
+} // namespace minisql
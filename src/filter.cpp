@@ -0,0 +1,301 @@
+#include "filter.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MINISQL_HAVE_SSE2 1
+#endif
+
+namespace minisql {
+
+#ifdef MINISQL_HAVE_AVX2
+// Defined in filter_avx2.cpp
+size_t selectIntAvx2(const char* values, size_t count, CompareOp op, int32_t constant, const uint8_t* nulls,
+                     const uint8_t* excluded, uint32_t* selection);
+size_t selectFloatAvx2(const char* values, size_t count, CompareOp op, float constant, const uint8_t* nulls,
+                       const uint8_t* excluded, uint32_t* selection);
+size_t selectBoolAvx2(const char* values, size_t count, CompareOp op, bool constant, const uint8_t* nulls,
+                      const uint8_t* excluded, uint32_t* selection);
+#endif
+
+namespace {
+    // Offsets of the set bits of every 8-bit mask, for writing a block's
+    // selected rows without branching on each bit
+    struct MaskTable {
+        uint8_t offsets[256][8] = {};
+        uint8_t counts[256] = {};
+        constexpr MaskTable() {
+            for (unsigned mask = 0; mask < 256; ++mask) {
+                for (unsigned bit = 0; bit < 8; ++bit) {
+                    if (mask & (1u << bit)) offsets[mask][counts[mask]++] = static_cast<uint8_t>(bit);
+                }
+            }
+        }
+    };
+    constexpr MaskTable kMasks;
+
+    template <CompareOp Op, typename T>
+    bool test(T value, T constant) {
+        if constexpr (Op == CompareOp::EQ) return value == constant;
+        if constexpr (Op == CompareOp::LT) return value < constant;
+        if constexpr (Op == CompareOp::LE) return value <= constant;
+        if constexpr (Op == CompareOp::GT) return value > constant;
+        if constexpr (Op == CompareOp::GE) return value >= constant;
+        return value != constant;
+    }
+
+    template <typename Fn>
+    size_t withOp(CompareOp op, Fn&& fn) {
+        switch (op) {
+            case CompareOp::EQ: return fn(std::integral_constant<CompareOp, CompareOp::EQ>());
+            case CompareOp::LT: return fn(std::integral_constant<CompareOp, CompareOp::LT>());
+            case CompareOp::LE: return fn(std::integral_constant<CompareOp, CompareOp::LE>());
+            case CompareOp::GT: return fn(std::integral_constant<CompareOp, CompareOp::GT>());
+            case CompareOp::GE: return fn(std::integral_constant<CompareOp, CompareOp::GE>());
+            case CompareOp::NE: return fn(std::integral_constant<CompareOp, CompareOp::NE>());
+        }
+        return 0;
+    }
+
+    bool bit(const uint8_t* bitmap, size_t row) {
+        return bitmap && ((bitmap[row / 8] >> (row % 8)) & 1);
+    }
+
+    unsigned skipMask(const uint8_t* nulls, const uint8_t* excluded, size_t block) {
+        return (nulls ? nulls[block] : 0u) | (excluded ? excluded[block] : 0u);
+    }
+
+    size_t emit(unsigned mask, uint32_t base, uint32_t* selection, size_t n) {
+        const uint8_t* offsets = kMasks.offsets[mask];
+        for (int i = 0; i < 8; ++i) {
+            selection[n + i] = base + offsets[i];
+        }
+        return n + kMasks.counts[mask];
+    }
+
+    // Rows [begin, count) one at a time
+    template <CompareOp Op, typename T>
+    size_t scalarKernel(const char* values, size_t begin, size_t count, T constant, const uint8_t* nulls,
+                        const uint8_t* excluded, uint32_t* selection, size_t n) {
+        for (size_t i = begin; i < count; ++i) {
+            T value;
+            std::memcpy(&value, values + i * sizeof(T), sizeof(T));
+            selection[n] = static_cast<uint32_t>(i);
+            n += test<Op>(value, constant) & !bit(nulls, i) & !bit(excluded, i);
+        }
+        return n;
+    }
+
+    // Compares 8 rows at a time; Block returns the match mask of the rows at i
+    template <typename Block>
+    size_t blockKernel(size_t count, const uint8_t* nulls, const uint8_t* excluded, uint32_t* selection, Block block) {
+        size_t n = 0;
+        for (size_t i = 0; i + 8 <= count; i += 8) {
+            unsigned mask = block(i) & ~skipMask(nulls, excluded, i / 8) & 0xFF;
+            n = emit(mask, static_cast<uint32_t>(i), selection, n);
+        }
+        return n;
+    }
+
+#ifdef MINISQL_HAVE_SSE2
+    template <CompareOp Op>
+    unsigned intMask4(__m128i v, __m128i c) {
+        __m128i m;
+        if constexpr (Op == CompareOp::EQ || Op == CompareOp::NE) {
+            m = _mm_cmpeq_epi32(v, c);
+        } else if constexpr (Op == CompareOp::GT || Op == CompareOp::LE) {
+            m = _mm_cmpgt_epi32(v, c);
+        } else {
+            m = _mm_cmpgt_epi32(c, v);
+        }
+        unsigned bits = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m)));
+        return (Op == CompareOp::LE || Op == CompareOp::GE || Op == CompareOp::NE) ? bits ^ 0xF : bits;
+    }
+
+    template <CompareOp Op>
+    unsigned floatMask4(__m128 v, __m128 c) {
+        __m128 m;
+        if constexpr (Op == CompareOp::EQ) m = _mm_cmpeq_ps(v, c);
+        if constexpr (Op == CompareOp::LT) m = _mm_cmplt_ps(v, c);
+        if constexpr (Op == CompareOp::LE) m = _mm_cmple_ps(v, c);
+        if constexpr (Op == CompareOp::GT) m = _mm_cmpgt_ps(v, c);
+        if constexpr (Op == CompareOp::GE) m = _mm_cmpge_ps(v, c);
+        if constexpr (Op == CompareOp::NE) m = _mm_cmpneq_ps(v, c);
+        return static_cast<unsigned>(_mm_movemask_ps(m));
+    }
+
+    template <CompareOp Op>
+    size_t selectIntSse2(const char* values, size_t count, int32_t constant, const uint8_t* nulls,
+                         const uint8_t* excluded, uint32_t* selection) {
+        __m128i c = _mm_set1_epi32(constant);
+        size_t n = blockKernel(count, nulls, excluded, selection, [&](size_t i) {
+            const char* p = values + i * 4;
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+            return intMask4<Op>(lo, c) | (intMask4<Op>(hi, c) << 4);
+        });
+        return scalarKernel<Op>(values, count & ~size_t(7), count, constant, nulls, excluded, selection, n);
+    }
+
+    template <CompareOp Op>
+    size_t selectFloatSse2(const char* values, size_t count, float constant, const uint8_t* nulls,
+                           const uint8_t* excluded, uint32_t* selection) {
+        __m128 c = _mm_set1_ps(constant);
+        size_t n = blockKernel(count, nulls, excluded, selection, [&](size_t i) {
+            const float* p = reinterpret_cast<const float*>(values + i * 4);
+            return floatMask4<Op>(_mm_loadu_ps(p), c) | (floatMask4<Op>(_mm_loadu_ps(p + 4), c) << 4);
+        });
+        return scalarKernel<Op>(values, count & ~size_t(7), count, constant, nulls, excluded, selection, n);
+    }
+
+    template <CompareOp Op>
+    size_t selectBoolSse2(const char* values, size_t count, uint8_t constant, const uint8_t* nulls,
+                          const uint8_t* excluded, uint32_t* selection) {
+        __m128i c = _mm_set1_epi8(static_cast<char>(constant));
+        size_t n = blockKernel(count, nulls, excluded, selection, [&](size_t i) {
+            __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(values + i));
+            __m128i m;
+            if constexpr (Op == CompareOp::EQ || Op == CompareOp::NE) {
+                m = _mm_cmpeq_epi8(v, c);
+            } else if constexpr (Op == CompareOp::GT || Op == CompareOp::LE) {
+                m = _mm_cmpgt_epi8(v, c);
+            } else {
+                m = _mm_cmpgt_epi8(c, v);
+            }
+            unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(m)) & 0xFF;
+            return (Op == CompareOp::LE || Op == CompareOp::GE || Op == CompareOp::NE) ? bits ^ 0xFF : bits;
+        });
+        return scalarKernel<Op>(values, count & ~size_t(7), count, constant, nulls, excluded, selection, n);
+    }
+#endif
+
+    SimdLevel detectSimdLevel() {
+#ifdef MINISQL_HAVE_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+#endif
+#ifdef MINISQL_HAVE_SSE2
+        return SimdLevel::SSE2;
+#else
+        return SimdLevel::SCALAR;
+#endif
+    }
+}
+
+CompareOp parseCompareOp(const std::string& op) {
+    if (op == "=") return CompareOp::EQ;
+    if (op == "<") return CompareOp::LT;
+    if (op == "<=") return CompareOp::LE;
+    if (op == ">") return CompareOp::GT;
+    if (op == ">=") return CompareOp::GE;
+    if (op == "<>" || op == "!=") return CompareOp::NE;
+    throw std::runtime_error("Unknown comparison operator: " + op);
+}
+
+bool compareMatches(int cmp, CompareOp op) {
+    return withOp(op, [&](auto tag) -> size_t { return test<decltype(tag)::value>(cmp, 0); }) != 0;
+}
+
+SimdLevel simdLevel() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::SCALAR: return "scalar";
+        case SimdLevel::SSE2: return "SSE2";
+        case SimdLevel::AVX2: return "AVX2";
+    }
+    return "unknown";
+}
+
+size_t selectInt(const char* values, size_t count, CompareOp op, int32_t constant, const uint8_t* nulls,
+                 const uint8_t* excluded, uint32_t* selection, SimdLevel level) {
+#ifdef MINISQL_HAVE_AVX2
+    if (level == SimdLevel::AVX2) {
+        return selectIntAvx2(values, count, op, constant, nulls, excluded, selection);
+    }
+#endif
+    return withOp(op, [&](auto tag) {
+        constexpr CompareOp Op = decltype(tag)::value;
+#ifdef MINISQL_HAVE_SSE2
+        if (level != SimdLevel::SCALAR) {
+            return selectIntSse2<Op>(values, count, constant, nulls, excluded, selection);
+        }
+#endif
+        return scalarKernel<Op>(values, 0, count, constant, nulls, excluded, selection, 0);
+    });
+}
+
+size_t selectFloat(const char* values, size_t count, CompareOp op, float constant, const uint8_t* nulls,
+                   const uint8_t* excluded, uint32_t* selection, SimdLevel level) {
+#ifdef MINISQL_HAVE_AVX2
+    if (level == SimdLevel::AVX2) {
+        return selectFloatAvx2(values, count, op, constant, nulls, excluded, selection);
+    }
+#endif
+    return withOp(op, [&](auto tag) {
+        constexpr CompareOp Op = decltype(tag)::value;
+#ifdef MINISQL_HAVE_SSE2
+        if (level != SimdLevel::SCALAR) {
+            return selectFloatSse2<Op>(values, count, constant, nulls, excluded, selection);
+        }
+#endif
+        return scalarKernel<Op>(values, 0, count, constant, nulls, excluded, selection, 0);
+    });
+}
+
+size_t selectBool(const char* values, size_t count, CompareOp op, bool constant, const uint8_t* nulls,
+                  const uint8_t* excluded, uint32_t* selection, SimdLevel level) {
+#ifdef MINISQL_HAVE_AVX2
+    if (level == SimdLevel::AVX2) {
+        return selectBoolAvx2(values, count, op, constant, nulls, excluded, selection);
+    }
+#endif
+    uint8_t byte = constant ? 1 : 0;
+    return withOp(op, [&](auto tag) {
+        constexpr CompareOp Op = decltype(tag)::value;
+#ifdef MINISQL_HAVE_SSE2
+        if (level != SimdLevel::SCALAR) {
+            return selectBoolSse2<Op>(values, count, byte, nulls, excluded, selection);
+        }
+#endif
+        return scalarKernel<Op>(values, 0, count, byte, nulls, excluded, selection, 0);
+    });
+}
+
+size_t selectRows(const ColumnVector& column, size_t count, CompareOp op, const DataValue& value,
+                  const uint8_t* excluded, uint32_t* selection) {
+    switch (column.type) {
+        case DataType::INT:
+            return selectInt(column.values, count, op, std::get<int>(value), column.nulls, excluded, selection);
+        case DataType::FLOAT:
+            return selectFloat(column.values, count, op, std::get<float>(value), column.nulls, excluded, selection);
+        case DataType::BOOLEAN:
+            return selectBool(column.values, count, op, std::get<bool>(value), column.nulls, excluded, selection);
+        case DataType::STRING:
+            break;
+    }
+    std::string_view constant = std::get<std::string>(value);
+    return withOp(op, [&](auto tag) {
+        size_t n = 0;
+        for (size_t i = 0; i < count; ++i) {
+            selection[n] = static_cast<uint32_t>(i);
+            n += !bit(column.nulls, i) && !bit(excluded, i) && test<decltype(tag)::value>(column.strings[i], constant);
+        }
+        return n;
+    });
+}
+
+size_t selectAll(size_t count, const uint8_t* excluded, uint32_t* selection) {
+    size_t n = blockKernel(count, nullptr, excluded, selection, [](size_t) { return 0xFFu; });
+    for (size_t i = count & ~size_t(7); i < count; ++i) {
+        selection[n] = static_cast<uint32_t>(i);
+        n += !bit(excluded, i);
+    }
+    return n;
+}
+
+} // namespace minisql
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "batch.hpp"
+#include "types.hpp"
+
+namespace minisql {
+
+    enum class CompareOp { EQ, LT, LE, GT, GE, NE };
+
+    // "=", "<", "<=", ">", ">=", "<>" or "!="
+    CompareOp parseCompareOp(const std::string& op);
+    bool compareMatches(int cmp, CompareOp op);
+
+    // Instruction set used by the selection kernels. SSE2 is the baseline on
+    // x86-64; AVX2 kernels live in filter_avx2.cpp, which is the only file
+    // built with -mavx2, and are picked at runtime when the CPU has them.
+    enum class SimdLevel { SCALAR, SSE2, AVX2 };
+    SimdLevel simdLevel();
+    const char* simdLevelName(SimdLevel level);
+
+    // Selection kernels: write to selection the indexes i < count, in order,
+    // of rows whose value satisfies `value op constant` and whose bit is clear
+    // in both nulls and excluded (either may be null), and return how many
+    // were written. selection must have room for count entries. values need
+    // not be aligned; BOOLEANs are one byte, 0 or 1.
+    size_t selectInt(const char* values, size_t count, CompareOp op, int32_t constant, const uint8_t* nulls,
+                     const uint8_t* excluded, uint32_t* selection, SimdLevel level = simdLevel());
+    size_t selectFloat(const char* values, size_t count, CompareOp op, float constant, const uint8_t* nulls,
+                       const uint8_t* excluded, uint32_t* selection, SimdLevel level = simdLevel());
+    size_t selectBool(const char* values, size_t count, CompareOp op, bool constant, const uint8_t* nulls,
+                      const uint8_t* excluded, uint32_t* selection, SimdLevel level = simdLevel());
+
+    // Filters one column of a batch with the kernel for its type (strings
+    // are compared one by one); value must have the column's type
+    size_t selectRows(const ColumnVector& column, size_t count, CompareOp op, const DataValue& value,
+                      const uint8_t* excluded, uint32_t* selection);
+    // Rows not marked in excluded
+    size_t selectAll(size_t count, const uint8_t* excluded, uint32_t* selection);
+
+} // namespace minisql
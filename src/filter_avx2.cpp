@@ -0,0 +1,175 @@
+// AVX2 selection kernels. This is the only file built with -mavx2 (see
+// CMakeLists.txt), so nothing here may be shared with other files: the
+// helpers are repeated rather than inlined from a header, where the linker
+// could pick their AVX2 copies for callers running on older CPUs.
+#include "filter.hpp"
+#ifdef MINISQL_HAVE_AVX2
+#include <immintrin.h>
+#include <cstring>
+#include <type_traits>
+
+namespace minisql {
+
+namespace {
+    struct MaskTable {
+        uint8_t offsets[256][8] = {};
+        uint8_t counts[256] = {};
+        constexpr MaskTable() {
+            for (unsigned mask = 0; mask < 256; ++mask) {
+                for (unsigned bit = 0; bit < 8; ++bit) {
+                    if (mask & (1u << bit)) offsets[mask][counts[mask]++] = static_cast<uint8_t>(bit);
+                }
+            }
+        }
+    };
+    constexpr MaskTable kMasks;
+
+    template <CompareOp Op, typename T>
+    bool test(T value, T constant) {
+        if constexpr (Op == CompareOp::EQ) return value == constant;
+        if constexpr (Op == CompareOp::LT) return value < constant;
+        if constexpr (Op == CompareOp::LE) return value <= constant;
+        if constexpr (Op == CompareOp::GT) return value > constant;
+        if constexpr (Op == CompareOp::GE) return value >= constant;
+        return value != constant;
+    }
+
+    template <typename Fn>
+    size_t withOp(CompareOp op, Fn&& fn) {
+        switch (op) {
+            case CompareOp::EQ: return fn(std::integral_constant<CompareOp, CompareOp::EQ>());
+            case CompareOp::LT: return fn(std::integral_constant<CompareOp, CompareOp::LT>());
+            case CompareOp::LE: return fn(std::integral_constant<CompareOp, CompareOp::LE>());
+            case CompareOp::GT: return fn(std::integral_constant<CompareOp, CompareOp::GT>());
+            case CompareOp::GE: return fn(std::integral_constant<CompareOp, CompareOp::GE>());
+            case CompareOp::NE: return fn(std::integral_constant<CompareOp, CompareOp::NE>());
+        }
+        return 0;
+    }
+
+    bool bit(const uint8_t* bitmap, size_t row) {
+        return bitmap && ((bitmap[row / 8] >> (row % 8)) & 1);
+    }
+
+    // Stores all 8 candidate indexes at once and keeps the selected ones.
+    // Blocks are whole, so the store stays below the block's own end.
+    size_t emit(unsigned mask, uint32_t base, uint32_t* selection, size_t n) {
+        __m128i offsets = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(kMasks.offsets[mask]));
+        __m256i rows = _mm256_add_epi32(_mm256_cvtepu8_epi32(offsets), _mm256_set1_epi32(static_cast<int>(base)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(selection + n), rows);
+        return n + kMasks.counts[mask];
+    }
+
+    template <CompareOp Op, typename T>
+    size_t scalarTail(const char* values, size_t begin, size_t count, T constant, const uint8_t* nulls,
+                      const uint8_t* excluded, uint32_t* selection, size_t n) {
+        for (size_t i = begin; i < count; ++i) {
+            T value;
+            std::memcpy(&value, values + i * sizeof(T), sizeof(T));
+            selection[n] = static_cast<uint32_t>(i);
+            n += test<Op>(value, constant) & !bit(nulls, i) & !bit(excluded, i);
+        }
+        return n;
+    }
+
+    // Block returns the match mask of the 8 rows at i
+    template <typename Block>
+    size_t blockKernel(size_t count, const uint8_t* nulls, const uint8_t* excluded, uint32_t* selection, Block block) {
+        size_t n = 0;
+        for (size_t i = 0; i + 8 <= count; i += 8) {
+            unsigned skip = (nulls ? nulls[i / 8] : 0u) | (excluded ? excluded[i / 8] : 0u);
+            n = emit(block(i) & ~skip & 0xFF, static_cast<uint32_t>(i), selection, n);
+        }
+        return n;
+    }
+
+    template <CompareOp Op>
+    size_t selectInt(const char* values, size_t count, int32_t constant, const uint8_t* nulls,
+                     const uint8_t* excluded, uint32_t* selection) {
+        __m256i c = _mm256_set1_epi32(constant);
+        size_t n = blockKernel(count, nulls, excluded, selection, [&](size_t i) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i * 4));
+            __m256i m;
+            if constexpr (Op == CompareOp::EQ || Op == CompareOp::NE) {
+                m = _mm256_cmpeq_epi32(v, c);
+            } else if constexpr (Op == CompareOp::GT || Op == CompareOp::LE) {
+                m = _mm256_cmpgt_epi32(v, c);
+            } else {
+                m = _mm256_cmpgt_epi32(c, v);
+            }
+            unsigned bits = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+            return (Op == CompareOp::LE || Op == CompareOp::GE || Op == CompareOp::NE) ? bits ^ 0xFF : bits;
+        });
+        return scalarTail<Op>(values, count & ~size_t(7), count, constant, nulls, excluded, selection, n);
+    }
+
+    template <CompareOp Op>
+    size_t selectFloat(const char* values, size_t count, float constant, const uint8_t* nulls,
+                       const uint8_t* excluded, uint32_t* selection) {
+        __m256 c = _mm256_set1_ps(constant);
+        size_t n = blockKernel(count, nulls, excluded, selection, [&](size_t i) {
+            __m256 v = _mm256_loadu_ps(reinterpret_cast<const float*>(values + i * 4));
+            __m256 m;
+            if constexpr (Op == CompareOp::EQ) m = _mm256_cmp_ps(v, c, _CMP_EQ_OQ);
+            if constexpr (Op == CompareOp::LT) m = _mm256_cmp_ps(v, c, _CMP_LT_OQ);
+            if constexpr (Op == CompareOp::LE) m = _mm256_cmp_ps(v, c, _CMP_LE_OQ);
+            if constexpr (Op == CompareOp::GT) m = _mm256_cmp_ps(v, c, _CMP_GT_OQ);
+            if constexpr (Op == CompareOp::GE) m = _mm256_cmp_ps(v, c, _CMP_GE_OQ);
+            if constexpr (Op == CompareOp::NE) m = _mm256_cmp_ps(v, c, _CMP_NEQ_UQ);
+            return static_cast<unsigned>(_mm256_movemask_ps(m));
+        });
+        return scalarTail<Op>(values, count & ~size_t(7), count, constant, nulls, excluded, selection, n);
+    }
+
+    // 32 rows per compare, emitted 8 at a time
+    template <CompareOp Op>
+    size_t selectBool(const char* values, size_t count, uint8_t constant, const uint8_t* nulls,
+                      const uint8_t* excluded, uint32_t* selection) {
+        __m256i c = _mm256_set1_epi8(static_cast<char>(constant));
+        size_t n = 0;
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            __m256i m;
+            if constexpr (Op == CompareOp::EQ || Op == CompareOp::NE) {
+                m = _mm256_cmpeq_epi8(v, c);
+            } else if constexpr (Op == CompareOp::GT || Op == CompareOp::LE) {
+                m = _mm256_cmpgt_epi8(v, c);
+            } else {
+                m = _mm256_cmpgt_epi8(c, v);
+            }
+            uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(m));
+            if constexpr (Op == CompareOp::LE || Op == CompareOp::GE || Op == CompareOp::NE) bits = ~bits;
+            for (size_t b = 0; b < 4; ++b) {
+                size_t block = i / 8 + b;
+                unsigned skip = (nulls ? nulls[block] : 0u) | (excluded ? excluded[block] : 0u);
+                n = emit((bits >> (8 * b)) & ~skip & 0xFF, static_cast<uint32_t>(i + 8 * b), selection, n);
+            }
+        }
+        return scalarTail<Op>(values, i, count, constant, nulls, excluded, selection, n);
+    }
+}
+
+size_t selectIntAvx2(const char* values, size_t count, CompareOp op, int32_t constant, const uint8_t* nulls,
+                     const uint8_t* excluded, uint32_t* selection) {
+    return withOp(op, [&](auto tag) {
+        return selectInt<decltype(tag)::value>(values, count, constant, nulls, excluded, selection);
+    });
+}
+
+size_t selectFloatAvx2(const char* values, size_t count, CompareOp op, float constant, const uint8_t* nulls,
+                       const uint8_t* excluded, uint32_t* selection) {
+    return withOp(op, [&](auto tag) {
+        return selectFloat<decltype(tag)::value>(values, count, constant, nulls, excluded, selection);
+    });
+}
+
+size_t selectBoolAvx2(const char* values, size_t count, CompareOp op, bool constant, const uint8_t* nulls,
+                      const uint8_t* excluded, uint32_t* selection) {
+    return withOp(op, [&](auto tag) {
+        return selectBool<decltype(tag)::value>(values, count, constant ? 1 : 0, nulls, excluded, selection);
+    });
+}
+
+} // namespace minisql
+#endif
@@ -0,0 +1,322 @@
+#include "hash_index.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace minisql {
+
+namespace {
+    constexpr char kHashMagic[8] = {'M', 'S', 'Q', 'L', 'H', 'A', 'S', 'H'};
+    constexpr size_t kMetaHeaderSize = 24;
+    constexpr size_t kMaxDirectoryPages = (kPageSize - kMetaHeaderSize) / sizeof(PageId);
+    constexpr size_t kSlotsPerPage = kPageSize / sizeof(PageId);
+    constexpr size_t kBucketHeaderSize = 12;
+    constexpr size_t kRidSize = 6;
+
+    static_assert((size_t(1) << HashIndex::kMaxDepth) <= kMaxDirectoryPages * kSlotsPerPage,
+                  "the deepest directory must fit in the meta page's list");
+
+    template <typename T>
+    T load(const char* data) {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void store(char* data, T value) {
+        std::memcpy(data, &value, sizeof(T));
+    }
+}
+
+HashIndex::HashIndex(const std::string& path, BufferPool& pool, uint32_t format_version)
+    : file_(path), pool_(pool), format_version_(format_version), stored_version_(format_version) {
+    if (file_.pageCount() == 0) {
+        initEmpty();
+        return;
+    }
+    auto meta = pool_.fetch(file_, 0);
+    if (std::memcmp(meta.data(), kHashMagic, sizeof(kHashMagic)) != 0) {
+        throw std::runtime_error("Not a hash index file: " + path);
+    }
+    depth_ = load<uint32_t>(meta.data() + 8);
+    page_count_ = load<PageId>(meta.data() + 12);
+    stored_version_ = load<uint32_t>(meta.data() + 16);
+    uint32_t directory_pages = load<uint32_t>(meta.data() + 20);
+    for (uint32_t i = 0; i < directory_pages; ++i) {
+        directory_pages_.push_back(load<PageId>(meta.data() + kMetaHeaderSize + i * sizeof(PageId)));
+    }
+    meta.release();
+    readDirectory();
+}
+
+HashIndex::~HashIndex() {
+    try {
+        pool_.flush(file_);
+    } catch (...) {
+    }
+    pool_.discard(file_);
+}
+
+bool HashIndex::insert(std::string_view key, const RecordId& rid) {
+    if (key.size() > kMaxKeySize) {
+        throw std::runtime_error("Index key too large (" + std::to_string(key.size()) + " bytes)");
+    }
+    uint64_t key_hash = hash(key);
+    size_t needed = 2 + key.size() + kRidSize;
+    while (true) {
+        size_t slot = key_hash & ((size_t(1) << depth_) - 1);
+        PageId first_id = directory_[slot];
+        PageId room = kInvalidPageId;  // first page of the chain with space left
+        size_t room_end = 0;
+        PageId last_id = first_id;
+        for (PageId page_id = first_id; page_id != kInvalidPageId;) {
+            // Searched in place, as in lookup()
+            auto handle = pool_.fetch(file_, page_id);
+            const char* data = handle.data();
+            uint16_t count = load<uint16_t>(data + 4);
+            size_t pos = kBucketHeaderSize;
+            for (uint16_t i = 0; i < count; ++i) {
+                uint16_t length = load<uint16_t>(data + pos);
+                if (std::string_view(data + pos + 2, length) == key &&
+                    load<PageId>(data + pos + 2 + length) == rid.page_id &&
+                    load<uint16_t>(data + pos + 2 + length + sizeof(PageId)) == rid.slot) {
+                    return false;
+                }
+                pos += 2 + length + kRidSize;
+            }
+            if (room == kInvalidPageId && pos + needed <= kPageSize) {
+                room = page_id;
+                room_end = pos;
+            }
+            last_id = page_id;
+            page_id = load<PageId>(data + 8);
+        }
+        if (room != kInvalidPageId) {
+            auto handle = pool_.fetch(file_, room);
+            char* data = handle.data();
+            store<uint16_t>(data + 4, static_cast<uint16_t>(load<uint16_t>(data + 4) + 1));
+            store<uint16_t>(data + room_end, static_cast<uint16_t>(key.size()));
+            std::memcpy(data + room_end + 2, key.data(), key.size());
+            store<PageId>(data + room_end + 2 + key.size(), rid.page_id);
+            store<uint16_t>(data + room_end + 2 + key.size() + sizeof(PageId), rid.slot);
+            handle.markDirty(0, nullptr);
+            return true;
+        }
+
+        // Splitting only helps if some entry lands on the other side
+        Bucket bucket = readBucket(first_id);
+        uint64_t mask = (uint64_t(1) << kMaxDepth) - 1;
+        bool separable = false;
+        for (const auto& entry : bucket.entries) {
+            separable = separable || ((hash(entry.key) ^ key_hash) & mask) != 0;
+        }
+        if (bucket.next == kInvalidPageId && bucket.depth < kMaxDepth && separable) {
+            split(slot, first_id, bucket);
+            continue;
+        }
+        PageId overflow_id = allocatePage();
+        Bucket overflow;
+        overflow.depth = bucket.depth;
+        overflow.entries.push_back({std::string(key), rid});
+        writeBucket(overflow_id, overflow);
+        Bucket last = readBucket(last_id);
+        last.next = overflow_id;
+        writeBucket(last_id, last);
+        writeDirectory(0, 0);
+        return true;
+    }
+}
+
+bool HashIndex::erase(std::string_view key, const RecordId& rid) {
+    PageId page_id = directory_[hash(key) & ((size_t(1) << depth_) - 1)];
+    while (page_id != kInvalidPageId) {
+        Bucket bucket = readBucket(page_id);
+        for (auto it = bucket.entries.begin(); it != bucket.entries.end(); ++it) {
+            if (it->key == key && it->rid == rid) {
+                bucket.entries.erase(it);
+                writeBucket(page_id, bucket);
+                return true;
+            }
+        }
+        page_id = bucket.next;
+    }
+    return false;
+}
+
+std::vector<RecordId> HashIndex::lookup(std::string_view key) {
+    std::vector<RecordId> rids;
+    PageId page_id = directory_[hash(key) & ((size_t(1) << depth_) - 1)];
+    while (page_id != kInvalidPageId) {
+        // Compared in place, without decoding the bucket
+        auto handle = pool_.fetch(file_, page_id);
+        const char* data = handle.data();
+        uint16_t count = load<uint16_t>(data + 4);
+        size_t pos = kBucketHeaderSize;
+        for (uint16_t i = 0; i < count; ++i) {
+            uint16_t length = load<uint16_t>(data + pos);
+            if (std::string_view(data + pos + 2, length) == key) {
+                RecordId rid;
+                rid.page_id = load<PageId>(data + pos + 2 + length);
+                rid.slot = load<uint16_t>(data + pos + 2 + length + sizeof(PageId));
+                rids.push_back(rid);
+            }
+            pos += 2 + length + kRidSize;
+        }
+        page_id = load<PageId>(data + 8);
+    }
+    return rids;
+}
+
+void HashIndex::clear() {
+    pool_.discard(file_);
+    file_.truncate(0);
+    initEmpty();
+}
+
+void HashIndex::sync() {
+    pool_.flush(file_);
+    file_.sync();
+}
+
+uint64_t HashIndex::hash(std::string_view key) {
+    // FNV-1a, then a finalizer so that the low bits (the directory slot)
+    // depend on every byte
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (char c : key) {
+        h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+HashIndex::Bucket HashIndex::readBucket(PageId page_id) {
+    auto handle = pool_.fetch(file_, page_id);
+    const char* data = handle.data();
+    Bucket bucket;
+    bucket.depth = load<uint32_t>(data);
+    uint16_t count = load<uint16_t>(data + 4);
+    bucket.next = load<PageId>(data + 8);
+    bucket.entries.reserve(count);
+    size_t pos = kBucketHeaderSize;
+    for (uint16_t i = 0; i < count; ++i) {
+        uint16_t length = load<uint16_t>(data + pos);
+        Entry entry;
+        entry.key.assign(data + pos + 2, length);
+        entry.rid.page_id = load<PageId>(data + pos + 2 + length);
+        entry.rid.slot = load<uint16_t>(data + pos + 2 + length + sizeof(PageId));
+        bucket.entries.push_back(std::move(entry));
+        pos += 2 + length + kRidSize;
+    }
+    return bucket;
+}
+
+void HashIndex::writeBucket(PageId page_id, const Bucket& bucket) {
+    if (encodedSize(bucket) > kPageSize) {
+        throw std::runtime_error("Hash bucket overflow in " + file_.path());
+    }
+    auto handle = pool_.fetch(file_, page_id);
+    char* data = handle.data();
+    std::memset(data, 0, kPageSize);
+    store<uint32_t>(data, bucket.depth);
+    store<uint16_t>(data + 4, static_cast<uint16_t>(bucket.entries.size()));
+    store<PageId>(data + 8, bucket.next);
+    size_t pos = kBucketHeaderSize;
+    for (const auto& entry : bucket.entries) {
+        store<uint16_t>(data + pos, static_cast<uint16_t>(entry.key.size()));
+        std::memcpy(data + pos + 2, entry.key.data(), entry.key.size());
+        store<PageId>(data + pos + 2 + entry.key.size(), entry.rid.page_id);
+        store<uint16_t>(data + pos + 2 + entry.key.size() + sizeof(PageId), entry.rid.slot);
+        pos += 2 + entry.key.size() + kRidSize;
+    }
+    handle.markDirty(0, nullptr);
+}
+
+size_t HashIndex::encodedSize(const Bucket& bucket) {
+    size_t size = kBucketHeaderSize;
+    for (const auto& entry : bucket.entries) {
+        size += 2 + entry.key.size() + kRidSize;
+    }
+    return size;
+}
+
+PageId HashIndex::allocatePage() {
+    return page_count_++;
+}
+
+void HashIndex::readDirectory() {
+    directory_.resize(size_t(1) << depth_);
+    for (size_t first = 0; first < directory_.size(); first += kSlotsPerPage) {
+        auto handle = pool_.fetch(file_, directory_pages_[first / kSlotsPerPage]);
+        size_t count = std::min(kSlotsPerPage, directory_.size() - first);
+        std::memcpy(directory_.data() + first, handle.data(), count * sizeof(PageId));
+    }
+}
+
+void HashIndex::writeDirectory(size_t first, size_t last) {
+    while (directory_pages_.size() * kSlotsPerPage < directory_.size()) {
+        directory_pages_.push_back(allocatePage());
+    }
+    for (size_t page = first / kSlotsPerPage; page * kSlotsPerPage < last; ++page) {
+        auto handle = pool_.fetch(file_, directory_pages_[page]);
+        size_t begin = page * kSlotsPerPage;
+        size_t count = std::min(kSlotsPerPage, directory_.size() - begin);
+        std::memset(handle.data(), 0, kPageSize);
+        std::memcpy(handle.data(), directory_.data() + begin, count * sizeof(PageId));
+        handle.markDirty(0, nullptr);
+    }
+
+    auto meta = pool_.fetch(file_, 0);
+    char* data = meta.data();
+    std::memset(data, 0, kPageSize);
+    std::memcpy(data, kHashMagic, sizeof(kHashMagic));
+    store<uint32_t>(data + 8, depth_);
+    store<PageId>(data + 12, page_count_);
+    store<uint32_t>(data + 16, format_version_);
+    store<uint32_t>(data + 20, static_cast<uint32_t>(directory_pages_.size()));
+    for (size_t i = 0; i < directory_pages_.size(); ++i) {
+        store<PageId>(data + kMetaHeaderSize + i * sizeof(PageId), directory_pages_[i]);
+    }
+    stored_version_ = format_version_;
+    meta.markDirty(0, nullptr);
+}
+
+void HashIndex::initEmpty() {
+    page_count_ = 1;
+    depth_ = 0;
+    directory_pages_.clear();
+    PageId bucket_id = allocatePage();
+    writeBucket(bucket_id, Bucket());
+    directory_.assign(1, bucket_id);
+    writeDirectory(0, directory_.size());
+}
+
+void HashIndex::split(size_t slot, PageId page_id, Bucket& bucket) {
+    if (bucket.depth == depth_) {
+        // Every bucket gets a second directory entry
+        size_t size = directory_.size();
+        directory_.resize(size * 2);
+        std::copy(directory_.begin(), directory_.begin() + size, directory_.begin() + size);
+        ++depth_;
+    }
+    // The entries whose hash has the next bit set move to a new bucket
+    size_t bit = size_t(1) << bucket.depth;
+    Bucket low;
+    Bucket high;
+    low.depth = high.depth = bucket.depth + 1;
+    for (auto& entry : bucket.entries) {
+        (hash(entry.key) & bit ? high : low).entries.push_back(std::move(entry));
+    }
+    PageId high_id = allocatePage();
+    writeBucket(page_id, low);
+    writeBucket(high_id, high);
+    size_t first = (slot & (bit - 1)) | bit;
+    for (size_t i = first; i < directory_.size(); i += bit * 2) {
+        directory_[i] = high_id;
+    }
+    writeDirectory(first, directory_.size());
+}
+
+} // namespace minisql
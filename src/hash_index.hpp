@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "buffer_pool.hpp"
+#include "disk_manager.hpp"
+
+namespace minisql {
+
+    // Disk-based extendible hash table mapping byte-string keys to record ids,
+    // stored in its own file and cached through the BufferPool.
+    //
+    // Page 0 is a meta page (magic, global depth, page count and the pages
+    // holding the directory). The directory has 2^depth entries, each the
+    // bucket page for the keys whose hash ends in its index; a bucket with a
+    // smaller local depth is shared by several entries. A full bucket splits
+    // in two, doubling the directory when it is already as deep as the
+    // bucket. Buckets that cannot split (at kMaxDepth, or holding a single
+    // hash) continue in overflow pages. Emptied buckets are not merged.
+    //
+    // A lookup reads one directory page and one bucket. Like the B+tree,
+    // index pages are not WAL-logged and are rebuilt after crash recovery.
+    class HashIndex {
+    public:
+        static constexpr size_t kMaxKeySize = 512;
+        static constexpr uint32_t kMaxDepth = 19;
+
+        // format_version is an owner-defined tag kept in the meta page (see
+        // BPlusTree)
+        HashIndex(const std::string& path, BufferPool& pool, uint32_t format_version = 0);
+        ~HashIndex();
+
+        // Returns false if the entry is already present
+        bool insert(std::string_view key, const RecordId& rid);
+        bool erase(std::string_view key, const RecordId& rid);
+        // Record ids stored under the key, in no particular order
+        std::vector<RecordId> lookup(std::string_view key);
+        void clear();
+        void sync();
+
+        const std::string& path() const { return file_.path(); }
+        uint32_t formatVersion() const { return stored_version_; }
+
+    private:
+        struct Entry {
+            std::string key;
+            RecordId rid;
+        };
+        struct Bucket {
+            uint32_t depth = 0;
+            PageId next = kInvalidPageId;  // overflow page
+            std::vector<Entry> entries;
+        };
+
+        DiskManager file_;
+        BufferPool& pool_;
+        uint32_t depth_ = 0;
+        PageId page_count_ = 0;
+        std::vector<PageId> directory_;
+        std::vector<PageId> directory_pages_;
+        uint32_t format_version_;
+        uint32_t stored_version_;
+
+        static uint64_t hash(std::string_view key);
+        Bucket readBucket(PageId page_id);
+        void writeBucket(PageId page_id, const Bucket& bucket);
+        static size_t encodedSize(const Bucket& bucket);
+        PageId allocatePage();
+        void readDirectory();
+        // Writes the directory pages holding entries [first, last) and the meta page
+        void writeDirectory(size_t first, size_t last);
+        void initEmpty();
+        void split(size_t slot, PageId page_id, Bucket& bucket);
+    };
+
+} // namespace minisql
@@ -0,0 +1,169 @@
+#include "index.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace minisql {
+
+namespace {
+    constexpr size_t kRidSize = 6;
+
+    void appendBigEndian(std::string& out, uint64_t value, size_t bytes) {
+        for (size_t i = bytes; i-- > 0;) {
+            out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+        }
+    }
+
+    RecordId ridFromKey(std::string_view key) {
+        const auto* p = reinterpret_cast<const unsigned char*>(key.data() + key.size() - kRidSize);
+        RecordId rid;
+        rid.page_id = (PageId(p[0]) << 24) | (PageId(p[1]) << 16) | (PageId(p[2]) << 8) | PageId(p[3]);
+        rid.slot = static_cast<uint16_t>((p[4] << 8) | p[5]);
+        return rid;
+    }
+}
+
+bool isSingleValue(const std::optional<IndexBound>& lower, const std::optional<IndexBound>& upper) {
+    return lower && upper && lower->inclusive && upper->inclusive && compareValues(lower->value, upper->value) == 0;
+}
+
+SecondaryIndex::SecondaryIndex(IndexDef def, const std::string& path, BufferPool& pool) : def_(std::move(def)) {
+    if (def_.unique) {
+        hash_ = std::make_unique<HashIndex>(path, pool, kFormatVersion);
+    } else {
+        tree_ = std::make_unique<BPlusTree>(path, pool, kFormatVersion);
+    }
+}
+
+std::string SecondaryIndex::encodeValue(const DataValue& value) {
+    std::string out;
+    std::visit([&](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, int>) {
+            // Flipping the sign bit makes two's complement sort as unsigned
+            appendBigEndian(out, static_cast<uint32_t>(v) ^ 0x80000000u, 4);
+        } else if constexpr (std::is_same_v<T, float>) {
+            float number = v == 0.0f ? 0.0f : v;  // -0 and 0 are the same key
+            uint32_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            // Negative floats sort in reverse bit order, positive ones above them
+            bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+            appendBigEndian(out, bits, 4);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            out.push_back(v ? 1 : 0);
+        } else {
+            // 0x00 is escaped as 0x00 0xFF and the value ends with 0x00 0x00,
+            // so a string always sorts before any longer string it prefixes
+            for (char c : v) {
+                out.push_back(c);
+                if (c == '\0') out.push_back(static_cast<char>(0xFF));
+            }
+            out.push_back('\0');
+            out.push_back('\0');
+        }
+    }, value);
+    return out;
+}
+
+void SecondaryIndex::checkValue(const DataValue& value) const {
+    size_t limit = tree_ ? BPlusTree::kMaxKeySize - kRidSize : HashIndex::kMaxKeySize;
+    if (encodeValue(value).size() > limit) {
+        throw std::runtime_error("Value too long for index " + def_.name);
+    }
+}
+
+void SecondaryIndex::insert(const DataValue& value, const RecordId& rid) {
+    if (hash_) {
+        hash_->insert(encodeValue(value), rid);
+    } else {
+        tree_->insert(makeKey(value, rid));
+    }
+}
+
+void SecondaryIndex::erase(const DataValue& value, const RecordId& rid) {
+    if (hash_) {
+        hash_->erase(encodeValue(value), rid);
+    } else {
+        tree_->erase(makeKey(value, rid));
+    }
+}
+
+std::vector<RecordId> SecondaryIndex::lookup(const DataValue& value) {
+    if (hash_) return hash_->lookup(encodeValue(value));
+    return range(IndexBound{value, true}, IndexBound{value, true});
+}
+
+std::vector<RecordId> SecondaryIndex::range(const std::optional<IndexBound>& lower, const std::optional<IndexBound>& upper) {
+    if (hash_) {
+        if (!isSingleValue(lower, upper)) {
+            throw std::runtime_error("Index " + def_.name + " only finds single values");
+        }
+        return hash_->lookup(encodeValue(lower->value));
+    }
+    std::string start;
+    std::string lower_key;
+    std::string upper_key;
+    if (lower) {
+        lower_key = encodeValue(lower->value);
+        start = lower_key;
+    }
+    if (upper) {
+        upper_key = encodeValue(upper->value);
+    }
+    std::vector<RecordId> rids;
+    tree_->scanFrom(start, [&](std::string_view key) {
+        std::string_view value = key.substr(0, key.size() - kRidSize);
+        if (lower && !lower->inclusive && value == lower_key) {
+            return true;
+        }
+        if (upper) {
+            int cmp = value.compare(upper_key);
+            if (cmp > 0 || (cmp == 0 && !upper->inclusive)) {
+                return false;
+            }
+        }
+        rids.push_back(ridFromKey(key));
+        return true;
+    });
+    return rids;
+}
+
+void SecondaryIndex::rebuild(const std::vector<std::pair<DataValue, RecordId>>& entries) {
+    if (hash_) {
+        hash_->clear();
+        for (const auto& [value, rid] : entries) {
+            hash_->insert(encodeValue(value), rid);
+        }
+        return;
+    }
+    std::vector<std::string> keys;
+    keys.reserve(entries.size());
+    for (const auto& [value, rid] : entries) {
+        keys.push_back(makeKey(value, rid));
+    }
+    tree_->bulkLoad(std::move(keys));
+}
+
+void SecondaryIndex::clear() {
+    if (hash_) {
+        hash_->clear();
+    } else {
+        tree_->clear();
+    }
+}
+
+void SecondaryIndex::sync() {
+    if (hash_) {
+        hash_->sync();
+    } else {
+        tree_->sync();
+    }
+}
+
+std::string SecondaryIndex::makeKey(const DataValue& value, const RecordId& rid) const {
+    std::string key = encodeValue(value);
+    appendBigEndian(key, rid.page_id, 4);
+    appendBigEndian(key, rid.slot, 2);
+    return key;
+}
+
+} // namespace minisql
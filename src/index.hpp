@@ -0,0 +1,78 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "btree.hpp"
+#include "hash_index.hpp"
+#include "page.hpp"
+#include "types.hpp"
+
+namespace minisql {
+
+    struct IndexDef {
+        std::string name;
+        std::string column;
+        size_t field_index = 0;  // position of the column in the row record
+        DataType type = DataType::STRING;
+        bool unique = false;   // UNIQUE or PRIMARY KEY: no two rows share a value
+        bool primary = false;  // PRIMARY KEY: every row has a value
+    };
+
+    struct IndexBound {
+        DataValue value;
+        bool inclusive = true;
+    };
+
+    // Whether the bounds admit exactly one value
+    bool isSingleValue(const std::optional<IndexBound>& lower, const std::optional<IndexBound>& upper);
+
+    // Secondary index on one column, stored in <table>.<name>.idx.
+    //
+    // An ordinary index is a B+tree. Tree keys are the column value in an
+    // order-preserving byte encoding followed by the big-endian record id, so
+    // duplicate values stay unique keys and a value's entries are contiguous.
+    // A unique index is a HashIndex from the encoded value to the record id:
+    // it only finds single values, but in one bucket read. Rows without a
+    // value for the column are not indexed. The index does not enforce
+    // uniqueness itself (see Table::checkKeys).
+    class SecondaryIndex {
+    public:
+        // Bumped when the key encoding changes; older files are rebuilt
+        static constexpr uint32_t kFormatVersion = 2;
+
+        SecondaryIndex(IndexDef def, const std::string& path, BufferPool& pool);
+
+        const IndexDef& def() const { return def_; }
+        const std::string& path() const { return tree_ ? tree_->path() : hash_->path(); }
+        // True when the file predates kFormatVersion and must be rebuilt
+        bool isStale() const { return (tree_ ? tree_->formatVersion() : hash_->formatVersion()) != kFormatVersion; }
+        // Whether range() accepts bounds other than a single value
+        bool ordered() const { return tree_ != nullptr; }
+
+        // Encoding whose memcmp order matches the order of the values
+        static std::string encodeValue(const DataValue& value);
+        // Throws if the value cannot be indexed (e.g. too long)
+        void checkValue(const DataValue& value) const;
+
+        void insert(const DataValue& value, const RecordId& rid);
+        void erase(const DataValue& value, const RecordId& rid);
+        std::vector<RecordId> lookup(const DataValue& value);
+        // Record ids of rows within the bounds (a missing bound is open), in
+        // value order; for an unordered index, the bounds must be one value
+        std::vector<RecordId> range(const std::optional<IndexBound>& lower, const std::optional<IndexBound>& upper);
+        // Replaces the contents with the given (value, rid) entries
+        void rebuild(const std::vector<std::pair<DataValue, RecordId>>& entries);
+        void clear();
+        void sync();
+
+    private:
+        IndexDef def_;
+        std::unique_ptr<BPlusTree> tree_;  // one of the two
+        std::unique_ptr<HashIndex> hash_;
+
+        std::string makeKey(const DataValue& value, const RecordId& rid) const;
+    };
+
+} // namespace minisql
@@ -0,0 +1,96 @@
+#include "join.hpp"
+#include "index.hpp"
+#include <filesystem>
+
+namespace minisql {
+
+bool encodeJoinKey(const TupleView& row, size_t field, std::string& key) {
+    FieldValue value = row.get(field);
+    if (!value) return false;
+    key = SecondaryIndex::encodeValue(*value);
+    return true;
+}
+
+void JoinHashTable::insert(std::string key, std::string row) {
+    bytes_ += key.size() + row.size() + sizeof(std::string) * 2;
+    rows_[std::move(key)].push_back(std::move(row));
+}
+
+const std::vector<std::string>* JoinHashTable::find(const std::string& key) const {
+    auto it = rows_.find(key);
+    return it == rows_.end() ? nullptr : &it->second;
+}
+
+void JoinHashTable::drain(const std::function<void(const std::string& key, const std::string& row)>& visit) {
+    for (const auto& [key, rows] : rows_) {
+        for (const auto& row : rows) {
+            visit(key, row);
+        }
+    }
+    rows_.clear();
+    bytes_ = 0;
+}
+
+JoinPartitions::JoinPartitions(const std::string& dir) {
+    for (size_t i = 0; i < kPartitions; ++i) {
+        paths_.push_back(newRunPath(dir, "join"));
+        writers_.push_back(std::make_unique<RunWriter>(paths_.back()));
+    }
+}
+
+JoinPartitions::~JoinPartitions() {
+    writers_.clear();
+    for (const auto& path : paths_) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+}
+
+void JoinPartitions::add(std::string_view key, std::string_view row) {
+    writers_[std::hash<std::string_view>()(key) % kPartitions]->write(key, row);
+}
+
+void JoinPartitions::close() {
+    for (auto& writer : writers_) {
+        writer->close();
+    }
+}
+
+JoinedRowBuilder::JoinedRowBuilder(const TupleLayout& joined, size_t right_offset,
+                                   std::array<std::vector<size_t>, 2> fields)
+    : joined_(&joined), right_offset_(right_offset), fields_(std::move(fields)), builder_(joined) {}
+
+std::string_view JoinedRowBuilder::build(const TupleView& left, const TupleView& right) {
+    builder_.reset();
+    for (size_t field : fields_[0]) {
+        copy(left, field, field);
+    }
+    for (size_t field : fields_[1]) {
+        copy(right, field, right_offset_ + field);
+    }
+    return builder_.record();
+}
+
+void JoinedRowBuilder::copy(const TupleView& row, size_t field, size_t to) {
+    if (row.isNull(field)) return;
+    switch (joined_->fields()[to].type) {
+        case DataType::INT: {
+            int32_t value = row.getInt(field);
+            builder_.setFixed(to, reinterpret_cast<const char*>(&value));
+            break;
+        }
+        case DataType::FLOAT: {
+            float value = row.getFloat(field);
+            builder_.setFixed(to, reinterpret_cast<const char*>(&value));
+            break;
+        }
+        case DataType::BOOLEAN: {
+            char value = row.getBool(field) ? 1 : 0;
+            builder_.setFixed(to, &value);
+            break;
+        }
+        case DataType::STRING: builder_.setString(to, row.getString(field)); break;
+    }
+}
+
+} // namespace minisql
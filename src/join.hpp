@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "sort.hpp"
+#include "tuple.hpp"
+
+namespace minisql {
+
+    // Join key of a row: the join column in SecondaryIndex::encodeValue form,
+    // so equal values of a type have equal keys. False for NULL, which joins nothing.
+    bool encodeJoinKey(const TupleView& row, size_t field, std::string& key);
+
+    // Build side of a hash join: rows grouped by join key
+    class JoinHashTable {
+    public:
+        void insert(std::string key, std::string row);
+        // Rows with this key in insertion order, or null
+        const std::vector<std::string>* find(const std::string& key) const;
+        // Memory held by the keys and rows
+        size_t bytes() const { return bytes_; }
+        // Hands every row to visit and empties the table
+        void drain(const std::function<void(const std::string& key, const std::string& row)>& visit);
+
+    private:
+        std::unordered_map<std::string, std::vector<std::string>> rows_;
+        size_t bytes_ = 0;
+    };
+
+    // One join input hashed by key into kPartitions run files, so that a
+    // build side too large for memory can be joined a partition at a time.
+    // The files are removed by the destructor.
+    class JoinPartitions {
+    public:
+        static constexpr size_t kPartitions = 32;
+
+        explicit JoinPartitions(const std::string& dir);
+        ~JoinPartitions();
+        JoinPartitions(const JoinPartitions&) = delete;
+        JoinPartitions& operator=(const JoinPartitions&) = delete;
+
+        void add(std::string_view key, std::string_view row);
+        // Flushes the files; call before reading them back
+        void close();
+        const std::string& path(size_t partition) const { return paths_[partition]; }
+
+    private:
+        std::vector<std::string> paths_;
+        std::vector<std::unique_ptr<RunWriter>> writers_;
+    };
+
+    // Assembles the rows of a join in the joined layout: the left table's
+    // fields, then the right table's from right_offset on. Only the listed
+    // fields of each side are copied.
+    class JoinedRowBuilder {
+    public:
+        JoinedRowBuilder(const TupleLayout& joined, size_t right_offset, std::array<std::vector<size_t>, 2> fields);
+
+        // Valid until the next call
+        std::string_view build(const TupleView& left, const TupleView& right);
+
+    private:
+        const TupleLayout* joined_;
+        size_t right_offset_;
+        std::array<std::vector<size_t>, 2> fields_;
+        TupleBuilder builder_;
+
+        void copy(const TupleView& row, size_t field, size_t to);
+    };
+
+} // namespace minisql
@@ -0,0 +1,114 @@
+#include "lexer.hpp"
+#include <stdexcept>
+#include <string>
+
+namespace minisql {
+
+namespace {
+    bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    bool isIdentStart(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+    bool isIdentChar(char c) { return isIdentStart(c) || isDigit(c); }
+    bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+}
+
+bool Lexer::matches(const Token& token, std::string_view keyword) {
+    if (token.type != TokenType::IDENTIFIER || token.text.size() != keyword.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < keyword.size(); ++i) {
+        char c = token.text[i];
+        if (c >= 'a' && c <= 'z') c = static_cast<char>(c - 'a' + 'A');
+        if (c != keyword[i]) return false;
+    }
+    return true;
+}
+
+Token Lexer::scan() {
+    while (pos_ < input_.size() && isSpace(input_[pos_])) ++pos_;
+    size_t start = pos_;
+    if (pos_ >= input_.size()) {
+        return {TokenType::END, input_.substr(start, 0), start};
+    }
+    auto make = [&](TokenType type) {
+        return Token{type, input_.substr(start, pos_ - start), start};
+    };
+
+    char c = input_[pos_];
+    if (isIdentStart(c)) {
+        while (pos_ < input_.size() && isIdentChar(input_[pos_])) ++pos_;
+        return make(TokenType::IDENTIFIER);
+    }
+
+    bool signed_number = (c == '-' || c == '+') && pos_ + 1 < input_.size() &&
+                         (isDigit(input_[pos_ + 1]) || input_[pos_ + 1] == '.');
+    if (isDigit(c) || signed_number || (c == '.' && pos_ + 1 < input_.size() && isDigit(input_[pos_ + 1]))) {
+        if (signed_number) ++pos_;
+        while (pos_ < input_.size() && isDigit(input_[pos_])) ++pos_;
+        if (pos_ < input_.size() && input_[pos_] == '.') {
+            ++pos_;
+            while (pos_ < input_.size() && isDigit(input_[pos_])) ++pos_;
+        }
+        if (pos_ < input_.size() && (input_[pos_] == 'e' || input_[pos_] == 'E')) {
+            size_t exp = pos_ + 1;
+            if (exp < input_.size() && (input_[exp] == '+' || input_[exp] == '-')) ++exp;
+            if (exp < input_.size() && isDigit(input_[exp])) {
+                pos_ = exp;
+                while (pos_ < input_.size() && isDigit(input_[pos_])) ++pos_;
+            }
+        }
+        if (pos_ < input_.size() && isIdentChar(input_[pos_])) {
+            throw std::runtime_error("Invalid number at position " + std::to_string(start));
+        }
+        return make(TokenType::NUMBER);
+    }
+
+    if (c == '\'' || c == '"') {
+        ++pos_;
+        while (true) {
+            if (pos_ >= input_.size()) {
+                throw std::runtime_error("Unterminated string literal at position " + std::to_string(start));
+            }
+            if (input_[pos_] == c) {
+                // A doubled quote is an escaped quote inside the literal
+                if (pos_ + 1 < input_.size() && input_[pos_ + 1] == c) {
+                    pos_ += 2;
+                    continue;
+                }
+                ++pos_;
+                break;
+            }
+            ++pos_;
+        }
+        return make(TokenType::STRING);
+    }
+
+    if (c == '$' && pos_ + 1 < input_.size() && isDigit(input_[pos_ + 1])) {
+        ++pos_;
+        while (pos_ < input_.size() && isDigit(input_[pos_])) ++pos_;
+        return make(TokenType::PARAMETER);
+    }
+
+    ++pos_;
+    if (c == '?') {
+        return make(TokenType::PARAMETER);
+    }
+    switch (c) {
+        case '(': case ')': case ',': case ';': case '*': case '=': case '.':
+            return make(TokenType::SYMBOL);
+        case '<':
+            if (pos_ < input_.size() && (input_[pos_] == '=' || input_[pos_] == '>')) ++pos_;
+            return make(TokenType::SYMBOL);
+        case '>':
+            if (pos_ < input_.size() && input_[pos_] == '=') ++pos_;
+            return make(TokenType::SYMBOL);
+        case '!':
+            if (pos_ < input_.size() && input_[pos_] == '=') {
+                ++pos_;
+                return make(TokenType::SYMBOL);
+            }
+            break;
+    }
+    throw std::runtime_error("Unexpected character '" + std::string(1, c) + "' at position " + std::to_string(start));
+}
+
+} // namespace minisql
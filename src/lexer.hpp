@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+namespace minisql {
+
+    enum class TokenType { IDENTIFIER, NUMBER, STRING, PARAMETER, SYMBOL, END };
+
+    // Tokens are views into the statement text; nothing is copied
+    struct Token {
+        TokenType type = TokenType::END;
+        std::string_view text;  // string literals keep their quotes
+        size_t offset = 0;
+    };
+
+    // Single-pass SQL tokenizer with one token of lookahead.
+    //
+    //   identifiers  [A-Za-z_][A-Za-z0-9_]*   (keywords are identifiers too)
+    //   numbers      [+-]digits[.digits][e[+-]digits]
+    //   strings      '...' or "..." with a doubled quote as escape
+    //   parameters   $digits or ?
+    //   symbols      ( ) , ; * = < > <= >= <> != .
+    class Lexer {
+    public:
+        explicit Lexer(std::string_view input) : input_(input) { current_ = scan(); }
+
+        const Token& peek() const { return current_; }
+        Token next() {
+            Token token = current_;
+            current_ = scan();
+            return token;
+        }
+
+        // Case-insensitive comparison against an upper-case keyword
+        static bool matches(const Token& token, std::string_view keyword);
+
+    private:
+        std::string_view input_;
+        size_t pos_ = 0;
+        Token current_;
+
+        Token scan();
+    };
+
+} // namespace minisql
@@ -1,29 +1,126 @@
 #include "parser.hpp"
+#include "client.hpp"
 #include "db_manager.hpp"
+#include "server.hpp"
+#include "storage.hpp"
+#include <csignal>
 #include <iostream>
+#include <optional>
 #include <string>
 
-int main() {
-    minisql::DatabaseManager db_manager("./databases");
-    minisql::Parser parser;
-    std::string input;
+namespace {
+
+    minisql::Server* running_server = nullptr;
+
+    void stopServer(int) {
+        if (running_server) running_server->stop();
+    }
+
+    // Reads statements from stdin, one per line, until 'exit'
+    template <typename Run>
+    void repl(Run run) {
+        std::string input;
+        std::cout << "MyMiniSQL REPL (type 'exit' to quit)\n> ";
+        while (std::getline(std::cin, input)) {
+            if (input == "exit") break;
+            if (input.empty()) {
+                std::cout << "> ";
+                continue;
+            }
+            try {
+                run(input);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+            }
 
-    std::cout << "MyMiniSQL REPL (type 'exit' to quit)\n> ";
-    while (std::getline(std::cin, input)) {
-        if (input == "exit") break;
-        if (input.empty()) {
             std::cout << "> ";
-            continue;
         }
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t threads = 0;
+    size_t work_memory_mb = 0;
+    minisql::OutputFormat output = minisql::OutputFormat::TABLE;
+    std::optional<std::string> listen;
+    std::optional<std::string> connect;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const std::string pool_flag = "--buffer-pool-mb=";
+        const std::string threads_flag = "--threads=";
+        const std::string work_flag = "--work-memory-mb=";
+        const std::string output_flag = "--output=";
+        const std::string listen_flag = "--listen";
+        const std::string connect_flag = "--connect";
+        std::optional<minisql::OutputFormat> format;
+        if (arg.compare(0, pool_flag.size(), pool_flag) == 0) {
+            minisql::Storage::bufferPool().setCapacity(std::stoul(arg.substr(pool_flag.size())) << 20);
+        } else if (arg.compare(0, threads_flag.size(), threads_flag) == 0) {
+            threads = std::stoul(arg.substr(threads_flag.size()));
+        } else if (arg.compare(0, work_flag.size(), work_flag) == 0) {
+            work_memory_mb = std::stoul(arg.substr(work_flag.size()));
+        } else if (arg.compare(0, output_flag.size(), output_flag) == 0 &&
+                   (format = minisql::parseOutputFormat(arg.substr(output_flag.size())))) {
+            output = *format;
+        } else if (arg == listen_flag || arg.compare(0, listen_flag.size() + 1, listen_flag + "=") == 0) {
+            listen = arg == listen_flag ? minisql::Endpoint::kDefault : arg.substr(listen_flag.size() + 1);
+        } else if (arg == connect_flag || arg.compare(0, connect_flag.size() + 1, connect_flag + "=") == 0) {
+            connect = arg == connect_flag ? minisql::Endpoint::kDefault : arg.substr(connect_flag.size() + 1);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--buffer-pool-mb=N] [--threads=N] [--work-memory-mb=N] [--output=table|csv|tsv|jsonl]"
+                      << " [--listen[=ADDRESS] | --connect[=ADDRESS]]\n"
+                      << "ADDRESS is HOST:PORT, PORT or unix:PATH (default " << minisql::Endpoint::kDefault << ")\n";
+            return 1;
+        }
+    }
+
+    if (connect) {
+        // The statements run on the server; only their results come back
         try {
-            auto query = parser.parse(input);
-            db_manager.executeQuery(query);
+            minisql::Client client(minisql::Endpoint::parse(*connect));
+            repl([&](const std::string& input) {
+                std::string error;
+                if (!client.execute(input, std::cout, error)) {
+                    std::cerr << "Error: " << error << "\n";
+                }
+            });
         } catch (const std::exception& e) {
             std::cerr << "Error: " << e.what() << "\n";
+            return 1;
         }
+        return 0;
+    }
 
-        std::cout << "> ";
+    minisql::DatabaseManager db_manager("./databases", threads);
+    if (work_memory_mb > 0) {
+        db_manager.setWorkMemory(work_memory_mb << 20);
     }
+    db_manager.setOutputFormat(output);
+    if (listen) {
+        try {
+            minisql::Endpoint endpoint = minisql::Endpoint::parse(*listen);
+            minisql::Server server(db_manager, endpoint);
+            running_server = &server;
+            std::signal(SIGINT, stopServer);
+            std::signal(SIGTERM, stopServer);
+            std::cout << "MyMiniSQL listening on " << endpoint.toString() << std::endl;
+            server.run();
+            running_server = nullptr;
+        } catch (const std::exception& e) {
+            running_server = nullptr;
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    minisql::Parser parser;
+    repl([&](const std::string& input) {
+        auto query = parser.parse(input);
+        db_manager.executeQuery(query);
+    });
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,51 @@
+#include "mapped_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace minisql {
+
+MappedFile::MappedFile(const std::string& path) : path_(path) {
+    remap();
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+void MappedFile::remap() {
+    unmap();
+    int fd = ::open(path_.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        size_t size = static_cast<size_t>(st.st_size);
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            // Mostly read by scans: let the kernel read ahead aggressively
+            ::madvise(data, size, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(data);
+            size_ = size;
+        }
+    }
+    ::close(fd);
+}
+
+void MappedFile::willNeed(uint64_t offset, size_t size) const {
+    if (size == 0 || !covers(offset, size)) return;
+    // madvise wants a page-aligned start
+    uint64_t page = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+    uint64_t start = offset / page * page;
+    ::madvise(const_cast<char*>(data_) + start, offset + size - start, MADV_WILLNEED);
+}
+
+void MappedFile::unmap() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+} // namespace minisql
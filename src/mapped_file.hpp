@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace minisql {
+
+    // Read-only shared mapping of a whole file, so readers use the page cache
+    // in place instead of copying pages out of it. The mapping covers the file
+    // as it was when mapped; call remap() after the file grows or shrinks, and
+    // never while views into the old mapping are in use. A file that is empty
+    // or cannot be mapped gives an empty mapping, and callers read it another way.
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        void remap();
+        size_t size() const { return size_; }
+        // True if [offset, offset + size) lies within the mapping
+        bool covers(uint64_t offset, size_t size) const { return offset + size <= size_; }
+        std::string_view bytes(uint64_t offset, size_t size) const { return {data_ + offset, size}; }
+        // Hints that [offset, offset + size) is about to be read
+        void willNeed(uint64_t offset, size_t size) const;
+
+    private:
+        std::string path_;
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+
+        void unmap();
+    };
+
+} // namespace minisql
@@ -0,0 +1,129 @@
+#include "mvcc.hpp"
+#include <algorithm>
+#include "table.hpp"
+
+namespace minisql {
+
+void SharedLatch::lock() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++writers_waiting_;
+    changed_.wait(lock, [&] { return !writing_ && readers_ == 0; });
+    --writers_waiting_;
+    writing_ = true;
+}
+
+bool SharedLatch::try_lock() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (writing_ || readers_ > 0) return false;
+    writing_ = true;
+    return true;
+}
+
+void SharedLatch::unlock() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        writing_ = false;
+    }
+    changed_.notify_all();
+}
+
+void SharedLatch::lock_shared() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return !writing_ && writers_waiting_ == 0; });
+    ++readers_;
+}
+
+void SharedLatch::unlock_shared() {
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last = --readers_ == 0;
+    }
+    if (last) changed_.notify_all();
+}
+
+bool Snapshot::sees(uint64_t version) const {
+    if (version < low) return true;
+    if (version > high) return false;
+    return !std::binary_search(running.begin(), running.end(), version);
+}
+
+uint64_t VersionClock::beginWrite() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t version = next_++;
+    running_.insert(version);
+    return version;
+}
+
+bool VersionClock::holdOffSnapshots(uint64_t version) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!held_.empty() || exclusive_ != 0) return false;
+    exclusive_ = version;
+    return true;
+}
+
+void VersionClock::endWrite(uint64_t version) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_.erase(version);
+    if (exclusive_ == version) {
+        exclusive_ = 0;
+        exclusive_done_.notify_all();
+    }
+}
+
+VersionClock::SnapshotRef VersionClock::snapshot() {
+    auto snapshot = std::make_unique<Snapshot>();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        exclusive_done_.wait(lock, [&] { return exclusive_ == 0; });
+        snapshot->high = next_ - 1;
+        snapshot->running.assign(running_.begin(), running_.end());
+        snapshot->low = running_.empty() ? next_ : *running_.begin();
+        held_.insert(snapshot->low);
+    }
+    return SnapshotRef(snapshot.release(), [this](const Snapshot* snapshot) {
+        release(snapshot);
+        delete snapshot;
+    });
+}
+
+uint64_t VersionClock::horizon() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return horizonLocked();
+}
+
+uint64_t VersionClock::horizonLocked() const {
+    uint64_t horizon = next_;
+    if (!running_.empty()) horizon = std::min(horizon, *running_.begin());
+    if (!held_.empty()) horizon = std::min(horizon, *held_.begin());
+    return horizon;
+}
+
+void VersionClock::track(Table* table) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tracked_.insert(table);
+}
+
+void VersionClock::untrack(Table* table) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tracked_.erase(table);
+}
+
+void VersionClock::release(const Snapshot* snapshot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t before = horizonLocked();
+    held_.erase(held_.find(snapshot->low));
+    if (horizonLocked() == before) return;
+    // Tables busy with a statement are skipped; they collect their own
+    // versions when their next write ends
+    uint64_t horizon = horizonLocked();
+    for (auto it = tracked_.begin(); it != tracked_.end();) {
+        if ((*it)->collectVersions(horizon, false)) {
+            ++it;
+        } else {
+            it = tracked_.erase(it);
+        }
+    }
+}
+
+} // namespace minisql
@@ -0,0 +1,83 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace minisql {
+
+    class Table;
+
+    // Shared/exclusive lock that lets a waiting writer in ahead of new
+    // readers, so that a stream of short reads cannot hold a change off
+    class SharedLatch {
+    public:
+        void lock();
+        bool try_lock();
+        void unlock();
+        void lock_shared();
+        void unlock_shared();
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        size_t readers_ = 0;
+        size_t writers_waiting_ = 0;
+        bool writing_ = false;
+    };
+
+    // Which writes a reader sees. Every write statement gets a version when
+    // it starts; a snapshot sees the versions up to high that had finished
+    // when it was taken. Version 0 stands for everything written before the
+    // process started (or by recovery) and is seen by all snapshots.
+    struct Snapshot {
+        uint64_t high = 0;
+        uint64_t low = 0;               // every version below is seen
+        std::vector<uint64_t> running;  // sorted; unseen although <= high
+
+        bool sees(uint64_t version) const;
+    };
+
+    // Hands out write versions and snapshots, and reclaims old row versions
+    // in epochs: a table keeps the images of rows replaced by version v for
+    // as long as some snapshot does not see v (see Table), and drops them
+    // once horizon() has passed v. Tables with old images are collected when
+    // the snapshot holding the horizon back is released.
+    class VersionClock {
+    public:
+        using SnapshotRef = std::shared_ptr<const Snapshot>;
+
+        uint64_t beginWrite();
+        void endWrite(uint64_t version);
+        // For a running write that cannot keep old row images (such as
+        // truncating a table): false while any snapshot is held; otherwise
+        // new snapshots wait until the write ends
+        bool holdOffSnapshots(uint64_t version);
+
+        // A snapshot of the writes finished so far, held until the last
+        // reference is dropped
+        SnapshotRef snapshot();
+
+        // Every version below is seen by every snapshot, held now or taken later
+        uint64_t horizon() const;
+
+        // Tables holding old row images, collected when the horizon moves
+        void track(Table* table);
+        void untrack(Table* table);
+
+    private:
+        mutable std::mutex mutex_;
+        std::condition_variable exclusive_done_;
+        uint64_t next_ = 1;
+        std::set<uint64_t> running_;
+        std::multiset<uint64_t> held_;  // low of every snapshot held
+        uint64_t exclusive_ = 0;        // a running exclusive write
+        std::set<Table*> tracked_;
+
+        uint64_t horizonLocked() const;
+        void release(const Snapshot* snapshot);
+    };
+
+} // namespace minisql
@@ -0,0 +1,207 @@
+#include "page.hpp"
+#include <cstring>
+#include <vector>
+
+namespace minisql {
+
+namespace {
+    constexpr size_t kPageIdOffset = 0;
+    constexpr size_t kSlotCountOffset = 4;
+    constexpr size_t kFreeStartOffset = 6;
+    constexpr size_t kFreeEndOffset = 8;
+    constexpr size_t kLsnOffset = 12;
+}
+
+void SlottedPage::init(PageId page_id) {
+    std::memset(data_, 0, kPageSize);
+    std::memcpy(data_ + kPageIdOffset, &page_id, sizeof(page_id));
+    setSlotCount(0);
+    setFreeStart(kHeaderSize);
+    setFreeEnd(static_cast<uint16_t>(kPageSize));
+}
+
+bool SlottedPage::isInitialized() const {
+    return freeEnd() != 0;
+}
+
+PageId SlottedPage::pageId() const {
+    PageId id;
+    std::memcpy(&id, data_ + kPageIdOffset, sizeof(id));
+    return id;
+}
+
+uint16_t SlottedPage::slotCount() const {
+    return readU16(kSlotCountOffset);
+}
+
+Lsn SlottedPage::lsn() const {
+    Lsn lsn;
+    std::memcpy(&lsn, data_ + kLsnOffset, sizeof(lsn));
+    return lsn;
+}
+
+void SlottedPage::setLsn(Lsn lsn) {
+    std::memcpy(data_ + kLsnOffset, &lsn, sizeof(lsn));
+}
+
+size_t SlottedPage::availableSpace() const {
+    // A reusable slot means a new record does not need to grow the directory
+    size_t free = freeBytes();
+    if (findEmptySlot() != kInvalidSlot) return free;
+    return free > kSlotSize ? free - kSlotSize : 0;
+}
+
+uint16_t SlottedPage::insert(std::string_view record) {
+    if (record.size() > availableSpace()) {
+        return kInvalidSlot;
+    }
+    uint16_t slot = findEmptySlot();
+    size_t needed = record.size() + (slot == kInvalidSlot ? kSlotSize : 0);
+    if (static_cast<size_t>(freeEnd() - freeStart()) < needed) {
+        compact();
+    }
+    if (slot == kInvalidSlot) {
+        slot = slotCount();
+        setSlotCount(slot + 1);
+        setFreeStart(static_cast<uint16_t>(freeStart() + kSlotSize));
+    }
+    uint16_t offset = static_cast<uint16_t>(freeEnd() - record.size());
+    std::memcpy(data_ + offset, record.data(), record.size());
+    setFreeEnd(offset);
+    setSlot(slot, offset, static_cast<uint16_t>(record.size()));
+    return slot;
+}
+
+bool SlottedPage::insertAt(uint16_t slot, std::string_view record) {
+    if (slot < slotCount() && slotOffset(slot) != 0) {
+        return false;
+    }
+    size_t new_slots = slot < slotCount() ? 0 : slot + 1 - slotCount();
+    if (record.size() + new_slots * kSlotSize > freeBytes()) {
+        return false;
+    }
+    if (static_cast<size_t>(freeEnd() - freeStart()) < record.size() + new_slots * kSlotSize) {
+        compact();
+    }
+    if (new_slots > 0) {
+        for (uint16_t i = slotCount(); i <= slot; ++i) {
+            setSlot(i, 0, 0);
+        }
+        setSlotCount(static_cast<uint16_t>(slot + 1));
+        setFreeStart(static_cast<uint16_t>(kHeaderSize + (slot + 1) * kSlotSize));
+    }
+    uint16_t offset = static_cast<uint16_t>(freeEnd() - record.size());
+    std::memcpy(data_ + offset, record.data(), record.size());
+    setFreeEnd(offset);
+    setSlot(slot, offset, static_cast<uint16_t>(record.size()));
+    return true;
+}
+
+bool SlottedPage::get(uint16_t slot, std::string_view& out) const {
+    if (slot >= slotCount() || slotOffset(slot) == 0) {
+        return false;
+    }
+    out = std::string_view(data_ + slotOffset(slot), slotLength(slot));
+    return true;
+}
+
+bool SlottedPage::erase(uint16_t slot) {
+    if (slot >= slotCount() || slotOffset(slot) == 0) {
+        return false;
+    }
+    setSlot(slot, 0, 0);
+    // Trailing empty slots are dropped so the directory can shrink again
+    uint16_t count = slotCount();
+    while (count > 0 && slotOffset(count - 1) == 0) {
+        --count;
+    }
+    setSlotCount(count);
+    setFreeStart(static_cast<uint16_t>(kHeaderSize + count * kSlotSize));
+    return true;
+}
+
+bool SlottedPage::update(uint16_t slot, std::string_view record) {
+    if (slot >= slotCount() || slotOffset(slot) == 0) {
+        return false;
+    }
+    uint16_t old_length = slotLength(slot);
+    if (record.size() <= old_length) {
+        std::memcpy(data_ + slotOffset(slot), record.data(), record.size());
+        setSlot(slot, slotOffset(slot), static_cast<uint16_t>(record.size()));
+        return true;
+    }
+    // The old body is released before checking, since it will be replaced
+    if (freeBytes() + old_length < record.size()) {
+        return false;
+    }
+    setSlot(slot, 0, 0);
+    if (static_cast<size_t>(freeEnd() - freeStart()) < record.size()) {
+        compact();
+    }
+    uint16_t offset = static_cast<uint16_t>(freeEnd() - record.size());
+    std::memcpy(data_ + offset, record.data(), record.size());
+    setFreeEnd(offset);
+    setSlot(slot, offset, static_cast<uint16_t>(record.size()));
+    return true;
+}
+
+uint16_t SlottedPage::readU16(size_t offset) const {
+    uint16_t value;
+    std::memcpy(&value, data_ + offset, sizeof(value));
+    return value;
+}
+
+void SlottedPage::writeU16(size_t offset, uint16_t value) {
+    std::memcpy(data_ + offset, &value, sizeof(value));
+}
+
+uint16_t SlottedPage::freeStart() const { return readU16(kFreeStartOffset); }
+uint16_t SlottedPage::freeEnd() const { return readU16(kFreeEndOffset); }
+void SlottedPage::setSlotCount(uint16_t count) { writeU16(kSlotCountOffset, count); }
+void SlottedPage::setFreeStart(uint16_t offset) { writeU16(kFreeStartOffset, offset); }
+void SlottedPage::setFreeEnd(uint16_t offset) { writeU16(kFreeEndOffset, offset); }
+
+uint16_t SlottedPage::slotOffset(uint16_t slot) const {
+    return readU16(kHeaderSize + slot * kSlotSize);
+}
+
+uint16_t SlottedPage::slotLength(uint16_t slot) const {
+    return readU16(kHeaderSize + slot * kSlotSize + 2);
+}
+
+void SlottedPage::setSlot(uint16_t slot, uint16_t offset, uint16_t length) {
+    writeU16(kHeaderSize + slot * kSlotSize, offset);
+    writeU16(kHeaderSize + slot * kSlotSize + 2, length);
+}
+
+size_t SlottedPage::freeBytes() const {
+    size_t used = kHeaderSize + slotCount() * kSlotSize;
+    for (uint16_t i = 0; i < slotCount(); ++i) {
+        if (slotOffset(i) != 0) used += slotLength(i);
+    }
+    return kPageSize - used;
+}
+
+uint16_t SlottedPage::findEmptySlot() const {
+    for (uint16_t i = 0; i < slotCount(); ++i) {
+        if (slotOffset(i) == 0) return i;
+    }
+    return kInvalidSlot;
+}
+
+void SlottedPage::compact() {
+    std::vector<char> scratch(kPageSize);
+    uint16_t end = static_cast<uint16_t>(kPageSize);
+    for (uint16_t i = 0; i < slotCount(); ++i) {
+        uint16_t offset = slotOffset(i);
+        if (offset == 0) continue;
+        uint16_t length = slotLength(i);
+        end = static_cast<uint16_t>(end - length);
+        std::memcpy(scratch.data() + end, data_ + offset, length);
+        setSlot(i, end, length);
+    }
+    std::memcpy(data_ + end, scratch.data() + end, kPageSize - end);
+    setFreeEnd(end);
+}
+
+} // namespace minisql
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace minisql {
+
+    constexpr size_t kPageSize = 4096;
+
+    using PageId = uint32_t;
+    using Lsn = uint64_t;
+    constexpr PageId kInvalidPageId = 0xFFFFFFFF;
+
+    // Physical address of a record inside a table heap
+    struct RecordId {
+        PageId page_id = kInvalidPageId;
+        uint16_t slot = 0;
+
+        bool operator==(const RecordId& other) const {
+            return page_id == other.page_id && slot == other.slot;
+        }
+        bool operator<(const RecordId& other) const {
+            return page_id != other.page_id ? page_id < other.page_id : slot < other.slot;
+        }
+    };
+
+    // View over a kPageSize buffer laid out as a slotted page:
+    //
+    //   | header | slot 0 | slot 1 | ... -> free space <- ... | record 1 | record 0 |
+    //
+    // The slot directory grows forward from the header and record bodies grow
+    // backward from the end of the page. A slot with offset 0 is empty and can
+    // be reused by the next insert. The header also carries the LSN of the last
+    // logged change so redo can skip records the page already reflects.
+    class SlottedPage {
+    public:
+        static constexpr uint16_t kInvalidSlot = 0xFFFF;
+        static constexpr size_t kHeaderSize = 20;
+        static constexpr size_t kSlotSize = 4;
+
+        explicit SlottedPage(char* data) : data_(data) {}
+
+        void init(PageId page_id);
+        // False for an all-zero page (allocated but never written)
+        bool isInitialized() const;
+        PageId pageId() const;
+        uint16_t slotCount() const;
+        Lsn lsn() const;
+        void setLsn(Lsn lsn);
+
+        // Largest record that fits after compaction, accounting for its slot
+        size_t availableSpace() const;
+
+        uint16_t insert(std::string_view record);
+        // Places a record in a specific (empty) slot, used when replaying the WAL
+        bool insertAt(uint16_t slot, std::string_view record);
+        bool get(uint16_t slot, std::string_view& out) const;
+        bool erase(uint16_t slot);
+        bool update(uint16_t slot, std::string_view record);
+
+        static size_t maxRecordSize() { return kPageSize - kHeaderSize - kSlotSize; }
+
+    private:
+        char* data_;
+
+        uint16_t readU16(size_t offset) const;
+        void writeU16(size_t offset, uint16_t value);
+        uint16_t freeStart() const;
+        uint16_t freeEnd() const;
+        void setSlotCount(uint16_t count);
+        void setFreeStart(uint16_t offset);
+        void setFreeEnd(uint16_t offset);
+        uint16_t slotOffset(uint16_t slot) const;
+        uint16_t slotLength(uint16_t slot) const;
+        void setSlot(uint16_t slot, uint16_t offset, uint16_t length);
+        size_t freeBytes() const;
+        uint16_t findEmptySlot() const;
+        void compact();
+    };
+
+} // namespace minisql
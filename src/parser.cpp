@@ -1,143 +1,635 @@
 #include "parser.hpp"
+#include "lexer.hpp"
 #include "utils.hpp"
 #include <stdexcept>
-#include <regex>
 
 namespace minisql {
 
-Query Parser::parse(const std::string& query_str) {
-    Query query;
-    std::string cleaned = trim(query_str);
-    if (cleaned.empty() || cleaned.back() != ';') {
-        throw std::runtime_error("Query must end with semicolon");
-    }
-    cleaned = cleaned.substr(0, cleaned.size() - 1); // Remove semicolon
-    std::vector<std::string> tokens = split(cleaned, ' ');
-    if (tokens.empty()) {
-        throw std::runtime_error("Empty query");
-    }
+namespace {
+
+    // Grammar (keywords case-insensitive):
+    //
+    //   statement := CREATE DATABASE name
+    //              | CREATE TABLE name '(' element { ',' element } ')' [ WITH '(' option { ',' option } ')' ]
+    //              | CREATE INDEX name ON name '(' name ')'
+    //              | DROP DATABASE name | DROP TABLE name | DROP INDEX name [ON name]
+    //              | USE name
+    //              | INSERT INTO name '(' name { ',' name } ')' VALUES tuple { ',' tuple }
+    //              | SELECT ( '*' | item { ',' item } ) FROM name [[INNER] JOIN name ON column '=' column]
+    //                [where] [GROUP BY column { ',' column }]
+    //                [ORDER BY item [ASC | DESC] { ',' item [ASC | DESC] }] [LIMIT count [OFFSET count]]
+    //              | UPDATE name SET name '=' value { ',' name '=' value } [where]
+    //              | DELETE FROM name [where]
+    //              | PREPARE name AS statement
+    //              | EXECUTE name [ '(' value { ',' value } ')' ]
+    //              | DEALLOCATE [PREPARE] name
+    //              | ANALYZE [name]
+    //              | EXPLAIN [ANALYZE] statement
+    //              | COPY name FROM string [ WITH '(' copy_opt { ',' copy_opt } ')' ]
+    //              | ( BEGIN | COMMIT | ROLLBACK ) [TRANSACTION]
+    //   element   := name type [ PRIMARY KEY | UNIQUE ] | ( PRIMARY KEY | UNIQUE ) '(' name ')'
+    //   tuple     := '(' value { ',' value } ')'
+    //   item      := column | ( COUNT | SUM | AVG | MIN | MAX ) '(' column ')' | COUNT '(' '*' ')'
+    //   column    := name | name '.' name
+    //   option    := FORMAT '=' ( ROW | COLUMNAR )
+    //   copy_opt  := FORMAT '=' ( CSV | TSV | JSONL ) | HEADER '=' ( TRUE | FALSE )
+    //   where     := WHERE condition
+    //   condition := conjunct { OR conjunct }
+    //   conjunct  := negation { AND negation }
+    //   negation  := NOT negation | '(' condition ')' | predicate
+    //   predicate := operand ( '=' | '<>' | '!=' | '<' | '<=' | '>' | '>=' ) operand
+    //              | column [NOT] ( BETWEEN value AND value | IN '(' value { ',' value } ')' | LIKE value )
+    //   operand   := column | value
+    //   value     := number | string | name | parameter
+    //   count     := non-negative integer
+    //
+    // Parameters ($1, $2, ... or ?, numbered left to right) are only accepted
+    // inside PREPARE.
+    class StatementParser {
+    public:
+        explicit StatementParser(std::string_view input, bool in_prepare = false)
+            : lexer_(input), in_prepare_(in_prepare) {}
+
+        void parse(Query& query) {
+            const Token& first = lexer_.peek();
+            if (first.type == TokenType::END || isSymbol(first, ";")) {
+                throw std::runtime_error(first.type == TokenType::END ? "Query must end with semicolon" : "Empty query");
+            }
+            parseStatement(query);
+            if (!acceptSymbol(";")) {
+                if (lexer_.peek().type == TokenType::END) {
+                    throw std::runtime_error("Query must end with semicolon");
+                }
+                fail("';'");
+            }
+            if (lexer_.peek().type != TokenType::END) {
+                fail("end of statement");
+            }
+        }
+
+        void parsePrepared(Query& query) {
+            parseStatement(query);
+            acceptSymbol(";");
+            if (lexer_.peek().type != TokenType::END) {
+                fail("end of statement");
+            }
+        }
+
+    private:
+        Lexer lexer_;
+        bool in_prepare_;
+        size_t positional_params_ = 0;
+
+        void parseStatement(Query& query) {
+            const Token& first = lexer_.peek();
+            if (acceptKeyword("CREATE")) {
+                parseCreate(query);
+            } else if (acceptKeyword("DROP")) {
+                parseDrop(query);
+            } else if (acceptKeyword("USE")) {
+                query.type = QueryType::USE_DATABASE;
+                query.database = expectIdentifier();
+            } else if (acceptKeyword("INSERT")) {
+                parseInsert(query);
+            } else if (acceptKeyword("SELECT")) {
+                parseSelect(query);
+            } else if (acceptKeyword("UPDATE")) {
+                parseUpdate(query);
+            } else if (acceptKeyword("DELETE")) {
+                query.type = QueryType::DELETE;
+                expectKeyword("FROM");
+                query.table = expectIdentifier();
+                parseWhere(query);
+            } else if (!in_prepare_ && acceptKeyword("PREPARE")) {
+                query.type = QueryType::PREPARE;
+                query.statement_name = expectIdentifier();
+                expectKeyword("AS");
+                query.prepared = std::make_shared<Query>();
+                query.prepared->type = QueryType::UNKNOWN;
+                in_prepare_ = true;
+                parseStatement(*query.prepared);
+                in_prepare_ = false;
+            } else if (!in_prepare_ && acceptKeyword("EXECUTE")) {
+                query.type = QueryType::EXECUTE;
+                query.statement_name = expectIdentifier();
+                if (acceptSymbol("(")) {
+                    do {
+                        query.parameters.push_back(parseValue(query, QueryParam::Slot::WHERE_VALUE, 0));
+                    } while (acceptSymbol(","));
+                    expectSymbol(")");
+                }
+            } else if (!in_prepare_ && acceptKeyword("DEALLOCATE")) {
+                query.type = QueryType::DEALLOCATE;
+                acceptKeyword("PREPARE");
+                query.statement_name = expectIdentifier();
+            } else if (!in_prepare_ && acceptKeyword("ANALYZE")) {
+                query.type = QueryType::ANALYZE;
+                if (lexer_.peek().type == TokenType::IDENTIFIER) {
+                    query.table = expectIdentifier();
+                }
+            } else if (!in_prepare_ && acceptKeyword("EXPLAIN")) {
+                query.type = QueryType::EXPLAIN;
+                query.explain_analyze = acceptKeyword("ANALYZE");
+                query.prepared = std::make_shared<Query>();
+                query.prepared->type = QueryType::UNKNOWN;
+                parseStatement(*query.prepared);
+                QueryType type = query.prepared->type;
+                if (type != QueryType::INSERT && type != QueryType::SELECT && type != QueryType::UPDATE &&
+                    type != QueryType::DELETE) {
+                    throw std::runtime_error("Only INSERT, SELECT, UPDATE and DELETE can be explained");
+                }
+            } else if (!in_prepare_ && acceptKeyword("COPY")) {
+                parseCopy(query);
+            } else if (!in_prepare_ && acceptKeyword("BEGIN")) {
+                query.type = QueryType::BEGIN;
+                acceptKeyword("TRANSACTION");
+            } else if (!in_prepare_ && acceptKeyword("COMMIT")) {
+                query.type = QueryType::COMMIT;
+                acceptKeyword("TRANSACTION");
+            } else if (!in_prepare_ && acceptKeyword("ROLLBACK")) {
+                query.type = QueryType::ROLLBACK;
+                acceptKeyword("TRANSACTION");
+            } else {
+                query.type = QueryType::UNKNOWN;
+                throw std::runtime_error("Unknown command: " + std::string(first.text));
+            }
+        }
+
+        static bool isSymbol(const Token& token, std::string_view symbol) {
+            return token.type == TokenType::SYMBOL && token.text == symbol;
+        }
+
+        [[noreturn]] void fail(std::string_view expected) {
+            const Token& token = lexer_.peek();
+            std::string found = token.type == TokenType::END ? "end of input" : "'" + std::string(token.text) + "'";
+            throw std::runtime_error("Syntax error at " + found + ": expected " + std::string(expected));
+        }
+
+        bool acceptKeyword(std::string_view keyword) {
+            if (!Lexer::matches(lexer_.peek(), keyword)) return false;
+            lexer_.next();
+            return true;
+        }
+
+        void expectKeyword(std::string_view keyword) {
+            if (!acceptKeyword(keyword)) fail(keyword);
+        }
+
+        bool acceptSymbol(std::string_view symbol) {
+            if (!isSymbol(lexer_.peek(), symbol)) return false;
+            lexer_.next();
+            return true;
+        }
 
-    std::string cmd = toUpper(tokens[0]);
-
-    if (cmd == "CREATE") {
-        if (tokens.size() < 3) throw std::runtime_error("Invalid CREATE syntax");
-        if (toUpper(tokens[1]) == "DATABASE") {
-            query.type = QueryType::CREATE_DATABASE;
-            query.database = tokens[2];
-            if (!isValidIdentifier(query.database)) {
-                throw std::runtime_error("Invalid database name");
-            }
-        } else if (toUpper(tokens[1]) == "TABLE") {
-            query.type = QueryType::CREATE_TABLE;
-            std::string rest = cleaned.substr(cleaned.find("TABLE") + 5);
-            std::regex table_regex(R"(\s*(\w+)\s*\((.*)\))");
-            std::smatch match;
-            if (!std::regex_match(rest, match, table_regex)) {
-                throw std::runtime_error("Invalid CREATE TABLE syntax");
-            }
-            query.table = match[1];
-            if (!isValidIdentifier(query.table)) {
-                throw std::runtime_error("Invalid table name");
-            }
-            std::string fields_str = match[2];
-            std::vector<std::string> field_pairs = split(fields_str, ',');
-            for (auto& pair : field_pairs) {
-                auto parts = split(trim(pair), ' ');
-                if (parts.size() != 2) {
-                    throw std::runtime_error("Invalid field definition");
+        void expectSymbol(std::string_view symbol) {
+            if (!acceptSymbol(symbol)) fail("'" + std::string(symbol) + "'");
+        }
+
+        std::string expectIdentifier() {
+            if (lexer_.peek().type != TokenType::IDENTIFIER) fail("a name");
+            return std::string(lexer_.next().text);
+        }
+
+        // A column name, optionally qualified with its table as "table.column"
+        std::string expectColumn() {
+            std::string name = expectIdentifier();
+            if (acceptSymbol(".")) {
+                name += "." + expectIdentifier();
+            }
+            return name;
+        }
+
+        // A literal, or a placeholder recorded in query.params (left empty until bound)
+        std::string parseValue(Query& query, QueryParam::Slot slot, size_t index) {
+            const Token& token = lexer_.peek();
+            if (token.type == TokenType::PARAMETER) {
+                if (!in_prepare_) {
+                    throw std::runtime_error("Parameters are only allowed in PREPARE");
+                }
+                size_t number = token.text == "?" ? ++positional_params_
+                                                  : std::stoul(std::string(token.text.substr(1)));
+                if (number == 0) {
+                    throw std::runtime_error("Parameter numbers start at $1");
+                }
+                query.params.push_back({slot, index, number});
+                lexer_.next();
+                return std::string();
+            }
+            if (token.type != TokenType::NUMBER && token.type != TokenType::STRING && token.type != TokenType::IDENTIFIER) {
+                fail("a value");
+            }
+            return std::string(lexer_.next().text);
+        }
+
+        void parseCreate(Query& query) {
+            if (acceptKeyword("DATABASE")) {
+                query.type = QueryType::CREATE_DATABASE;
+                query.database = expectIdentifier();
+            } else if (acceptKeyword("TABLE")) {
+                query.type = QueryType::CREATE_TABLE;
+                query.table = expectIdentifier();
+                expectSymbol("(");
+                do {
+                    bool primary = acceptKeyword("PRIMARY");
+                    if (primary) expectKeyword("KEY");
+                    if (primary || acceptKeyword("UNIQUE")) {
+                        expectSymbol("(");
+                        addKey(query, expectIdentifier(), primary);
+                        expectSymbol(")");
+                        continue;
+                    }
+                    TableField field;
+                    field.name = expectIdentifier();
+                    if (lexer_.peek().type != TokenType::IDENTIFIER) fail("a data type");
+                    field.type = stringToDataType(std::string(lexer_.next().text));
+                    if (acceptKeyword("PRIMARY")) {
+                        expectKeyword("KEY");
+                        addKey(query, field.name, true);
+                    } else if (acceptKeyword("UNIQUE")) {
+                        addKey(query, field.name, false);
+                    }
+                    query.fields.push_back(std::move(field));
+                } while (acceptSymbol(","));
+                expectSymbol(")");
+                if (acceptKeyword("WITH")) {
+                    parseTableOptions(query);
+                }
+            } else if (acceptKeyword("INDEX")) {
+                query.type = QueryType::CREATE_INDEX;
+                query.index_name = expectIdentifier();
+                expectKeyword("ON");
+                query.table = expectIdentifier();
+                expectSymbol("(");
+                query.index_column = expectIdentifier();
+                expectSymbol(")");
+            } else {
+                fail("DATABASE, TABLE or INDEX");
+            }
+        }
+
+        static void addKey(Query& query, const std::string& column, bool primary) {
+            if (!primary) {
+                query.unique_columns.push_back(column);
+            } else if (query.primary_key.empty()) {
+                query.primary_key = column;
+            } else {
+                throw std::runtime_error("Multiple primary keys for table " + query.table);
+            }
+        }
+
+        void parseTableOptions(Query& query) {
+            expectSymbol("(");
+            do {
+                if (!acceptKeyword("FORMAT")) fail("a table option");
+                expectSymbol("=");
+                if (acceptKeyword("ROW")) {
+                    query.table_format = "row";
+                } else if (acceptKeyword("COLUMNAR")) {
+                    query.table_format = "columnar";
+                } else {
+                    fail("ROW or COLUMNAR");
                 }
-                TableField field;
-                field.name = parts[0];
-                field.type = stringToDataType(parts[1]);
-                if (!isValidIdentifier(field.name)) {
-                    throw std::runtime_error("Invalid field name: " + field.name);
+            } while (acceptSymbol(","));
+            expectSymbol(")");
+        }
+
+        void parseCopy(Query& query) {
+            query.type = QueryType::COPY;
+            query.table = expectIdentifier();
+            expectKeyword("FROM");
+            if (lexer_.peek().type != TokenType::STRING) fail("a file name");
+            query.copy_file = std::get<std::string>(stringToDataValue(std::string(lexer_.next().text), DataType::STRING));
+            if (!acceptKeyword("WITH")) return;
+            expectSymbol("(");
+            do {
+                if (acceptKeyword("FORMAT")) {
+                    expectSymbol("=");
+                    if (acceptKeyword("CSV")) {
+                        query.copy_format = "csv";
+                    } else if (acceptKeyword("TSV")) {
+                        query.copy_format = "tsv";
+                    } else if (acceptKeyword("JSONL")) {
+                        query.copy_format = "jsonl";
+                    } else {
+                        fail("CSV, TSV or JSONL");
+                    }
+                } else if (acceptKeyword("HEADER")) {
+                    expectSymbol("=");
+                    if (acceptKeyword("TRUE")) {
+                        query.copy_header = true;
+                    } else if (acceptKeyword("FALSE")) {
+                        query.copy_header = false;
+                    } else {
+                        fail("TRUE or FALSE");
+                    }
+                } else {
+                    fail("FORMAT or HEADER");
                 }
-                query.fields.push_back(field);
-            }
-        } else {
-            throw std::runtime_error("Invalid CREATE command");
-        }
-    } else if (cmd == "DROP") {
-        if (tokens.size() != 3) throw std::runtime_error("Invalid DROP syntax");
-        if (toUpper(tokens[1]) == "DATABASE") {
-            query.type = QueryType::DROP_DATABASE;
-            query.database = tokens[2];
-        } else if (toUpper(tokens[1]) == "TABLE") {
-            query.type = QueryType::DROP_TABLE;
-            query.table = tokens[2];
-        } else {
-            throw std::runtime_error("Invalid DROP command");
-        }
-    } else if (cmd == "USE") {
-        if (tokens.size() != 2) throw std::runtime_error("Invalid USE syntax");
-        query.type = QueryType::USE_DATABASE;
-        query.database = tokens[1];
-    } else if (cmd == "INSERT") {
-        query.type = QueryType::INSERT;
-        std::string rest = cleaned.substr(cleaned.find("INTO") + 4);
-        std::regex insert_regex(R"(\s*(\w+)\s*\((.*?)\)\s*VALUES\s*\((.*?)\))");
-        std::smatch match;
-        if (!std::regex_match(rest, match, insert_regex)) {
-            throw std::runtime_error("Invalid INSERT syntax");
-        }
-        query.table = match[1];
-        auto fields = split(match[2], ',');
-        auto values = split(match[3], ',');
-        if (fields.size() != values.size()) {
-            throw std::runtime_error("Field and value count mismatch");
-        }
-        for (size_t i = 0; i < fields.size(); ++i) {
-            query.insert_values.emplace_back(trim(fields[i]), trim(values[i]));
-        }
-    } else if (cmd == "SELECT") {
-        query.type = QueryType::SELECT;
-        std::string rest = cleaned.substr(cleaned.find("FROM"));
-        std::regex select_regex(R"(\s*(.*?)\s*FROM\s*(\w+)(?:\s*WHERE\s*(\w+)\s*=\s*(\S+))?)");
-        std::smatch match;
-        if (!std::regex_match(rest, match, select_regex)) {
-            throw std::runtime_error("Invalid SELECT syntax");
-        }
-        std::string fields_str = match[1];
-        query.table = match[2];
-        if (fields_str != "*") {
-            query.select_fields = split(fields_str, ',');
-        }
-        if (match.size() > 3) {
-            query.where_field = match[3];
-            query.where_value = match[4];
-        }
-    } else if (cmd == "UPDATE") {
-        query.type = QueryType::UPDATE;
-        std::regex update_regex(R"(UPDATE\s+(\w+)\s+SET\s+(\w+)\s*=\s*(\S+)\s*WHERE\s+(\w+)\s*=\s*(\S+))");
-        std::smatch match;
-        if (!std::regex_match(cleaned, match, update_regex)) {
-            throw std::runtime_error("Invalid UPDATE syntax");
-        }
-        query.table = match[1];
-        query.update_values.emplace_back(match[2], match[3]);
-        query.where_field = match[4];
-        query.where_value = match[5];
-    } else if (cmd == "DELETE") {
-        query.type = QueryType::DELETE;
-        std::regex delete_regex(R"(DELETE\s+FROM\s+(\w+)(?:\s*WHERE\s+(\w+)\s*=\s*(\S+))?)");
-        std::smatch match;
-        if (!std::regex_match(cleaned, match, delete_regex)) {
-            throw std::runtime_error("Invalid DELETE syntax");
-        }
-        query.table = match[1];
-        if (match.size() > 2) {
-            query.where_field = match[2];
-            query.where_value = match[3];
-        }
-    } else {
-        query.type = QueryType::UNKNOWN;
-        throw std::runtime_error("Unknown command: " + cmd);
+            } while (acceptSymbol(","));
+            expectSymbol(")");
+        }
+
+        void parseDrop(Query& query) {
+            if (acceptKeyword("DATABASE")) {
+                query.type = QueryType::DROP_DATABASE;
+                query.database = expectIdentifier();
+            } else if (acceptKeyword("TABLE")) {
+                query.type = QueryType::DROP_TABLE;
+                query.table = expectIdentifier();
+            } else if (acceptKeyword("INDEX")) {
+                query.type = QueryType::DROP_INDEX;
+                query.index_name = expectIdentifier();
+                if (acceptKeyword("ON")) {
+                    query.table = expectIdentifier();
+                }
+            } else {
+                fail("DATABASE, TABLE or INDEX");
+            }
+        }
+
+        void parseInsert(Query& query) {
+            query.type = QueryType::INSERT;
+            expectKeyword("INTO");
+            query.table = expectIdentifier();
+            expectSymbol("(");
+            query.insert_values.reserve(8);
+            do {
+                query.insert_values.emplace_back(expectIdentifier(), std::string());
+            } while (acceptSymbol(","));
+            expectSymbol(")");
+            expectKeyword("VALUES");
+            size_t columns = query.insert_values.size();
+            size_t tuple = 0;
+            do {
+                expectSymbol("(");
+                size_t count = 0;
+                do {
+                    std::string value = parseValue(query, QueryParam::Slot::INSERT_VALUE, tuple * columns + count);
+                    if (count < columns) {
+                        if (tuple == 0) {
+                            query.insert_values[count].second = std::move(value);
+                        } else {
+                            query.insert_rows.push_back(std::move(value));
+                        }
+                    }
+                    ++count;
+                } while (acceptSymbol(","));
+                expectSymbol(")");
+                if (count != columns) {
+                    throw std::runtime_error("Field and value count mismatch");
+                }
+                ++tuple;
+            } while (acceptSymbol(","));
+        }
+
+        void parseSelect(Query& query) {
+            query.type = QueryType::SELECT;
+            if (!acceptSymbol("*")) {
+                do {
+                    query.select_items.push_back(parseSelectItem());
+                } while (acceptSymbol(","));
+            }
+            expectKeyword("FROM");
+            query.table = expectIdentifier();
+            bool inner = acceptKeyword("INNER");
+            if (inner) expectKeyword("JOIN");
+            if (inner || acceptKeyword("JOIN")) {
+                query.join_table = expectIdentifier();
+                expectKeyword("ON");
+                query.join_left = expectColumn();
+                expectSymbol("=");
+                query.join_right = expectColumn();
+            }
+            parseWhere(query);
+            if (acceptKeyword("GROUP")) {
+                expectKeyword("BY");
+                do {
+                    query.group_by.push_back(expectColumn());
+                } while (acceptSymbol(","));
+            }
+            if (acceptKeyword("ORDER")) {
+                expectKeyword("BY");
+                do {
+                    OrderItem order{parseSelectItem()};
+                    if (acceptKeyword("DESC")) {
+                        order.descending = true;
+                    } else {
+                        acceptKeyword("ASC");
+                    }
+                    query.order_by.push_back(std::move(order));
+                } while (acceptSymbol(","));
+            }
+            if (acceptKeyword("LIMIT")) {
+                query.limit = parseCount();
+                if (acceptKeyword("OFFSET")) {
+                    query.offset = parseCount();
+                }
+            }
+        }
+
+        size_t parseCount() {
+            const Token& token = lexer_.peek();
+            if (token.type != TokenType::NUMBER ||
+                token.text.find_first_not_of("0123456789") != std::string_view::npos) {
+                fail("a row count");
+            }
+            std::string text(lexer_.next().text);
+            try {
+                return std::stoull(text);
+            } catch (const std::out_of_range&) {
+                throw std::runtime_error("Row count out of range: " + text);
+            }
+        }
+
+        SelectItem parseSelectItem() {
+            SelectItem item;
+            item.field = expectIdentifier();
+            if (acceptSymbol(".")) {
+                item.field += "." + expectIdentifier();
+                return item;
+            }
+            if (!acceptSymbol("(")) return item;
+            static const std::pair<const char*, AggregateFunc> kFunctions[] = {
+                {"COUNT", AggregateFunc::COUNT}, {"SUM", AggregateFunc::SUM}, {"AVG", AggregateFunc::AVG},
+                {"MIN", AggregateFunc::MIN}, {"MAX", AggregateFunc::MAX},
+            };
+            for (const auto& [name, func] : kFunctions) {
+                if (toUpper(item.field) == name) item.aggregate = func;
+            }
+            if (item.aggregate == AggregateFunc::NONE) {
+                throw std::runtime_error("Unknown function: " + item.field);
+            }
+            if (item.aggregate == AggregateFunc::COUNT && acceptSymbol("*")) {
+                item.field.clear();
+            } else {
+                item.field = expectColumn();
+            }
+            expectSymbol(")");
+            return item;
+        }
+
+        void parseUpdate(Query& query) {
+            query.type = QueryType::UPDATE;
+            query.table = expectIdentifier();
+            expectKeyword("SET");
+            do {
+                std::string field = expectIdentifier();
+                expectSymbol("=");
+                std::string value = parseValue(query, QueryParam::Slot::UPDATE_VALUE, query.update_values.size());
+                query.update_values.emplace_back(std::move(field), std::move(value));
+            } while (acceptSymbol(","));
+            parseWhere(query);
+        }
+
+        void parseWhere(Query& query) {
+            if (!acceptKeyword("WHERE")) return;
+            query.where = std::make_shared<const Condition>(parseCondition(query));
+        }
+
+        Condition parseCondition(Query& query) {
+            return parseChain(query, "OR", Condition::Kind::OR, &StatementParser::parseConjunct);
+        }
+
+        Condition parseConjunct(Query& query) {
+            return parseChain(query, "AND", Condition::Kind::AND, &StatementParser::parseNegation);
+        }
+
+        // term { keyword term }, as one node when there is more than one term
+        Condition parseChain(Query& query, std::string_view keyword, Condition::Kind kind,
+                             Condition (StatementParser::*term)(Query&)) {
+            Condition first = (this->*term)(query);
+            if (!Lexer::matches(lexer_.peek(), keyword)) return first;
+            Condition chain;
+            chain.kind = kind;
+            chain.children.push_back(std::move(first));
+            while (acceptKeyword(keyword)) {
+                chain.children.push_back((this->*term)(query));
+            }
+            return chain;
+        }
+
+        Condition parseNegation(Query& query) {
+            if (acceptKeyword("NOT")) {
+                Condition negation;
+                negation.kind = Condition::Kind::NOT;
+                negation.children.push_back(parseNegation(query));
+                return negation;
+            }
+            if (acceptSymbol("(")) {
+                Condition condition = parseCondition(query);
+                expectSymbol(")");
+                return condition;
+            }
+            return parsePredicate(query);
+        }
+
+        Condition parsePredicate(Query& query) {
+            Condition predicate;
+            predicate.operands.push_back(parseOperand(query));
+            predicate.negated = acceptKeyword("NOT");
+            if (acceptKeyword("BETWEEN")) {
+                predicate.kind = Condition::Kind::BETWEEN;
+                predicate.operands.push_back(parseWhereValue(query));
+                expectKeyword("AND");
+                predicate.operands.push_back(parseWhereValue(query));
+            } else if (acceptKeyword("IN")) {
+                predicate.kind = Condition::Kind::IN;
+                expectSymbol("(");
+                do {
+                    predicate.operands.push_back(parseWhereValue(query));
+                } while (acceptSymbol(","));
+                expectSymbol(")");
+            } else if (acceptKeyword("LIKE")) {
+                predicate.kind = Condition::Kind::LIKE;
+                predicate.operands.push_back(parseWhereValue(query));
+            } else if (predicate.negated) {
+                fail("BETWEEN, IN or LIKE");
+            } else {
+                const Token& op = lexer_.peek();
+                if (!isSymbol(op, "=") && !isSymbol(op, "<>") && !isSymbol(op, "!=") && !isSymbol(op, "<") &&
+                    !isSymbol(op, "<=") && !isSymbol(op, ">") && !isSymbol(op, ">=")) {
+                    fail("a comparison operator");
+                }
+                predicate.op = std::string(lexer_.next().text);
+                predicate.operands.push_back(parseOperand(query));
+            }
+            if (predicate.kind != Condition::Kind::COMPARE && predicate.operands[0].column.empty()) {
+                throw std::runtime_error("BETWEEN, IN and LIKE need a column on the left");
+            }
+            return predicate;
+        }
+
+        // A name is kept as a column and as a literal; the planner picks one
+        Operand parseOperand(Query& query) {
+            if (lexer_.peek().type != TokenType::IDENTIFIER) return parseWhereValue(query);
+            Operand operand;
+            operand.column = expectIdentifier();
+            if (acceptSymbol(".")) {
+                operand.column += "." + expectIdentifier();
+            } else {
+                operand.value = query.where_values.size();
+                query.where_values.push_back(operand.column);
+            }
+            return operand;
+        }
+
+        Operand parseWhereValue(Query& query) {
+            Operand operand;
+            operand.value = query.where_values.size();
+            query.where_values.push_back(parseValue(query, QueryParam::Slot::WHERE_VALUE, *operand.value));
+            return operand;
+        }
+    };
+
+    bool isPreparable(const Query& query) {
+        switch (query.type) {
+            case QueryType::INSERT:
+            case QueryType::SELECT:
+            case QueryType::UPDATE:
+            case QueryType::DELETE:
+                return true;
+            default:
+                throw std::runtime_error("Only INSERT, SELECT, UPDATE and DELETE can be prepared");
+        }
     }
 
+} // namespace
+
+std::string SelectItem::label() const {
+    switch (aggregate) {
+        case AggregateFunc::NONE: return field;
+        case AggregateFunc::COUNT: return "COUNT(" + (field.empty() ? "*" : field) + ")";
+        case AggregateFunc::SUM: return "SUM(" + field + ")";
+        case AggregateFunc::AVG: return "AVG(" + field + ")";
+        case AggregateFunc::MIN: return "MIN(" + field + ")";
+        case AggregateFunc::MAX: return "MAX(" + field + ")";
+    }
+    return field;
+}
+
+Query Parser::parse(std::string_view query_str) {
+    auto started = std::chrono::steady_clock::now();
+    Query query;
+    query.type = QueryType::UNKNOWN;
+    StatementParser(query_str).parse(query);
+
     if (!validateQuerySyntax(query)) {
         throw std::runtime_error("Invalid query syntax");
     }
 
+    query.parse_time = std::chrono::steady_clock::now() - started;
+    return query;
+}
+
+Query Parser::parsePrepared(std::string_view statement) {
+    Query query;
+    query.type = QueryType::UNKNOWN;
+    StatementParser(statement, true).parsePrepared(query);
+
+    if (!validateQuerySyntax(query) || !isPreparable(query)) {
+        throw std::runtime_error("Invalid query syntax");
+    }
+
     return query;
 }
 
@@ -150,6 +642,27 @@ bool Parser::validateQuerySyntax(const Query& query) {
         case QueryType::CREATE_TABLE:
             return !query.table.empty() && isValidIdentifier(query.table) &&
                    !query.fields.empty();
+        case QueryType::CREATE_INDEX:
+            return !query.table.empty() && isValidIdentifier(query.index_name) &&
+                   isValidIdentifier(query.index_column);
+        case QueryType::DROP_INDEX:
+            return isValidIdentifier(query.index_name);
+        case QueryType::PREPARE:
+            return query.prepared && validateQuerySyntax(*query.prepared) &&
+                   isPreparable(*query.prepared) && isValidIdentifier(query.statement_name);
+        case QueryType::EXECUTE:
+        case QueryType::DEALLOCATE:
+            return isValidIdentifier(query.statement_name);
+        case QueryType::ANALYZE:
+            return query.table.empty() || isValidIdentifier(query.table);
+        case QueryType::EXPLAIN:
+            return query.prepared && validateQuerySyntax(*query.prepared);
+        case QueryType::COPY:
+            return !query.table.empty() && isValidIdentifier(query.table) && !query.copy_file.empty();
+        case QueryType::BEGIN:
+        case QueryType::COMMIT:
+        case QueryType::ROLLBACK:
+            return true;
         case QueryType::DROP_TABLE:
         case QueryType::INSERT:
         case QueryType::SELECT:
@@ -161,4 +674,4 @@ bool Parser::validateQuerySyntax(const Query& query) {
     }
 }
 
-} // namespace minisql
\ No newline at end of file
+} // namespace minisql
@@ -1,5 +1,9 @@
 #pragma once
+#include <chrono>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "types.hpp"
 
@@ -11,33 +15,109 @@ namespace minisql {
         USE_DATABASE,
         CREATE_TABLE,
         DROP_TABLE,
+        CREATE_INDEX,
+        DROP_INDEX,
         INSERT,
         SELECT,
         UPDATE,
         DELETE,
+        PREPARE,
+        EXECUTE,
+        DEALLOCATE,
+        ANALYZE,
+        EXPLAIN,
+        COPY,
+        BEGIN,
+        COMMIT,
+        ROLLBACK,
         UNKNOWN
     };
 
-    struct TableField {
-        std::string name;
-        DataType type;
+    // A $n or ? placeholder in a prepared statement and the value it stands for
+    struct QueryParam {
+        enum class Slot { INSERT_VALUE, UPDATE_VALUE, WHERE_VALUE };
+        Slot slot;
+        size_t index;   // position in insert_values (then insert_rows) / update_values / where_values
+        size_t number;  // 1-based parameter number
+    };
+
+    enum class AggregateFunc { NONE, COUNT, SUM, AVG, MIN, MAX };
+
+    // An entry of a SELECT list: a column, or an aggregate over one (COUNT(*)
+    // has an empty field)
+    struct SelectItem {
+        std::string field;
+        AggregateFunc aggregate = AggregateFunc::NONE;
+
+        // Column heading: the field name, or e.g. "SUM(amount)"
+        std::string label() const;
+    };
+
+    // A side of a WHERE comparison: a column, a literal (a position in
+    // Query::where_values), or both for a bare name, which is a column if the
+    // table has one and a literal otherwise
+    struct Operand {
+        std::string column;
+        std::optional<size_t> value;
+    };
+
+    // A WHERE condition as parsed; Predicate resolves and types it
+    struct Condition {
+        enum class Kind { AND, OR, NOT, COMPARE, BETWEEN, IN, LIKE };
+        Kind kind = Kind::COMPARE;
+        std::vector<Condition> children;  // AND, OR, NOT
+        // COMPARE: left, right; BETWEEN: column, low, high; IN: column, values...; LIKE: column, pattern
+        std::vector<Operand> operands;
+        std::string op;                   // COMPARE: =, <>, !=, <, <=, > or >=
+        bool negated = false;             // NOT BETWEEN, NOT IN, NOT LIKE
+    };
+
+    struct OrderItem {
+        SelectItem item;
+        bool descending = false;
     };
 
     struct Query {
         QueryType type;
         std::string database;
-        std::string table;
+        std::string table; // empty for ANALYZE of every table
         std::vector<TableField> fields; // For CREATE TABLE
-        std::vector<std::string> select_fields; // For SELECT
+        std::string table_format = "row"; // For CREATE TABLE: row or columnar
+        std::string primary_key; // For CREATE TABLE: the PRIMARY KEY column, if any
+        std::vector<std::string> unique_columns; // For CREATE TABLE: the UNIQUE columns
+        std::vector<SelectItem> select_items; // For SELECT; empty for *
+        std::string join_table; // For SELECT ... JOIN
+        std::string join_left; // ON join_left = join_right
+        std::string join_right;
+        std::vector<std::string> group_by;
+        std::vector<OrderItem> order_by;
+        std::optional<size_t> limit;
+        size_t offset = 0;
         std::vector<std::pair<std::string, std::string>> insert_values; // For INSERT
+        std::vector<std::string> insert_rows; // For INSERT: the values of the rows after the first, row by row
         std::vector<std::pair<std::string, std::string>> update_values; // For UPDATE
-        std::string where_field;
-        std::string where_value;
+        std::shared_ptr<const Condition> where;
+        std::vector<std::string> where_values; // WHERE literals, as Operand::value refers to them
+        std::string index_name; // For CREATE/DROP INDEX
+        std::string index_column;
+        std::vector<QueryParam> params; // Placeholders (prepared statements only)
+        std::string statement_name; // For PREPARE/EXECUTE/DEALLOCATE
+        std::shared_ptr<Query> prepared; // For PREPARE and EXPLAIN: the statement
+        bool explain_analyze = false; // EXPLAIN ANALYZE: run the statement and measure it
+        std::vector<std::string> parameters; // For EXECUTE
+        std::chrono::nanoseconds parse_time{0}; // how long Parser::parse took
+        std::string copy_file; // For COPY FROM
+        std::string copy_format; // csv, tsv or jsonl; empty: from the file name
+        bool copy_header = true; // CSV/TSV: the first line names the columns
     };
 
+    // Recursive-descent parser over the Lexer's tokens. Keywords are
+    // case-insensitive; every statement ends with a semicolon.
     class Parser {
     public:
-        Query parse(const std::string& query_str);
+        Query parse(std::string_view query_str);
+        // Parses the statement of a PREPARE (parameters allowed, semicolon optional)
+        Query parsePrepared(std::string_view statement);
 
     private:
         bool validateQuerySyntax(const Query& query);
@@ -0,0 +1,684 @@
+#include "predicate.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+namespace minisql {
+
+namespace {
+    using Node = Predicate::Node;
+    using Kind = Predicate::Node::Kind;
+
+    Node constant(bool value) {
+        Node node;
+        node.value = value;
+        return node;
+    }
+
+    // NOT (a op b) is a (negated op) b
+    CompareOp negateOp(CompareOp op) {
+        switch (op) {
+            case CompareOp::EQ: return CompareOp::NE;
+            case CompareOp::NE: return CompareOp::EQ;
+            case CompareOp::LT: return CompareOp::GE;
+            case CompareOp::GE: return CompareOp::LT;
+            case CompareOp::LE: return CompareOp::GT;
+            case CompareOp::GT: return CompareOp::LE;
+        }
+        return op;
+    }
+
+    // a op b is b (mirrored op) a
+    CompareOp mirrorOp(CompareOp op) {
+        switch (op) {
+            case CompareOp::LT: return CompareOp::GT;
+            case CompareOp::GT: return CompareOp::LT;
+            case CompareOp::LE: return CompareOp::GE;
+            case CompareOp::GE: return CompareOp::LE;
+            default: return op;
+        }
+    }
+
+    void setField(Node& node, size_t field, const TupleLayout& layout) {
+        node.field = field;
+        node.name = layout.fields()[field].name;
+        node.type = layout.fields()[field].type;
+    }
+
+    // negate: the condition is under an odd number of NOTs
+    Node compileNode(const Condition& condition, bool negate, const TupleLayout& layout,
+                     const Predicate::FieldLookup& lookup) {
+        Node node;
+        switch (condition.kind) {
+            case Condition::Kind::NOT:
+                return compileNode(condition.children[0], !negate, layout, lookup);
+            case Condition::Kind::AND:
+            case Condition::Kind::OR:
+                // NOT (a AND b) is NOT a OR NOT b, and the other way round
+                node.kind = (condition.kind == Condition::Kind::AND) != negate ? Kind::AND : Kind::OR;
+                for (const auto& child : condition.children) {
+                    node.children.push_back(compileNode(child, negate, layout, lookup));
+                }
+                return node;
+            case Condition::Kind::COMPARE: {
+                node.kind = Kind::COMPARE;
+                node.op = parseCompareOp(condition.op);
+                if (negate) node.op = negateOp(node.op);
+                std::optional<size_t> fields[2];
+                for (size_t i = 0; i < 2; ++i) {
+                    const Operand& operand = condition.operands[i];
+                    if (!operand.column.empty()) fields[i] = lookup(operand.column);
+                    if (!fields[i] && !operand.value) {
+                        throw std::runtime_error("Unknown field: " + operand.column);
+                    }
+                }
+                if (!fields[0] && !fields[1]) {
+                    // A name that is no column is only taken as a literal next to a column
+                    for (const auto& operand : condition.operands) {
+                        if (!operand.column.empty()) throw std::runtime_error("Unknown field: " + operand.column);
+                    }
+                    node.kind = Kind::LITERALS;
+                    node.literals = {*condition.operands[0].value, *condition.operands[1].value};
+                    return node;
+                }
+                // The column goes on the left
+                size_t left = fields[0] ? 0 : 1;
+                if (left == 1) node.op = mirrorOp(node.op);
+                setField(node, *fields[left], layout);
+                if (const auto& other = fields[1 - left]) {
+                    const TableField& field = layout.fields()[*other];
+                    if (field.type != node.type) {
+                        throw std::runtime_error("Cannot compare " + node.name + " with " + field.name +
+                                                 " of another type");
+                    }
+                    node.other_field = other;
+                    node.other_name = field.name;
+                } else {
+                    node.literals = {*condition.operands[1 - left].value};
+                }
+                return node;
+            }
+            case Condition::Kind::BETWEEN:
+            case Condition::Kind::IN:
+            case Condition::Kind::LIKE: {
+                node.kind = condition.kind == Condition::Kind::BETWEEN ? Kind::BETWEEN
+                            : condition.kind == Condition::Kind::IN    ? Kind::IN
+                                                                       : Kind::LIKE;
+                const std::string& column = condition.operands[0].column;
+                auto field = lookup(column);
+                if (!field) throw std::runtime_error("Unknown field: " + column);
+                setField(node, *field, layout);
+                if (node.kind == Kind::LIKE && node.type != DataType::STRING) {
+                    throw std::runtime_error("LIKE needs a STRING column: " + node.name);
+                }
+                node.negated = condition.negated != negate;
+                for (size_t i = 1; i < condition.operands.size(); ++i) {
+                    node.literals.push_back(*condition.operands[i].value);
+                }
+                return node;
+            }
+        }
+        return node;
+    }
+
+    // Rough cost of testing a node, for ordering AND and OR: comparisons with
+    // a constant first (the first of them can run as a selection kernel),
+    // and equality, the most selective, ahead of those
+    int cost(const Node& node) {
+        switch (node.kind) {
+            case Kind::COMPARE: return node.other_field ? 2 : (node.op == CompareOp::EQ ? 0 : 1);
+            case Kind::BETWEEN:
+            case Kind::IN: return 2;
+            case Kind::LIKE: return 3;
+            default: return 4;
+        }
+    }
+
+    // AND or OR of bound children. Constants decide the result or drop out,
+    // and children of the same kind are flattened into this node.
+    Node combine(Kind kind, std::vector<Node> children) {
+        bool decisive = kind == Kind::OR;  // FALSE decides an AND, TRUE an OR
+        Node node;
+        node.kind = kind;
+        for (auto& child : children) {
+            if (child.kind == Kind::CONSTANT) {
+                if (child.value == decisive) return constant(decisive);
+            } else if (child.kind == kind) {
+                std::move(child.children.begin(), child.children.end(), std::back_inserter(node.children));
+            } else {
+                node.children.push_back(std::move(child));
+            }
+        }
+        if (node.children.empty()) return constant(!decisive);
+        if (node.children.size() == 1) return std::move(node.children[0]);
+        std::stable_sort(node.children.begin(), node.children.end(),
+                         [](const Node& a, const Node& b) { return cost(a) < cost(b); });
+        return node;
+    }
+
+    // A literal compared with a column, as a value of the column's type
+    DataValue convert(const std::string& literal, const Node& node) {
+        if (!validateValue(literal, node.type)) {
+            throw std::runtime_error("Invalid value for field " + node.name);
+        }
+        return stringToDataValue(literal, node.type);
+    }
+
+    // Binds the literals of an INT column. A number that is no INT value
+    // (1.5, or out of range) gives way to the INT values around it: < 1.5
+    // tests <= 1, BETWEEN 0.5 AND 9e9 tests BETWEEN 1 AND the largest INT,
+    // and it drops out of an IN. False if no row can match.
+    bool bindInts(Node& bound, const std::vector<std::string>& literals) {
+        if (bound.literals.empty()) return true;
+        const double lowest = std::numeric_limits<int>::min();
+        const double highest = std::numeric_limits<int>::max();
+        // A test every value passes; only rows without one fail it
+        auto anyValue = [&] {
+            bound.kind = Kind::COMPARE;
+            bound.op = CompareOp::GE;
+            bound.negated = false;
+            bound.values = {std::numeric_limits<int>::min()};
+            return true;
+        };
+        std::vector<std::optional<double>> inexact;
+        for (size_t literal : bound.literals) {
+            const std::string& text = literals[literal];
+            int exact;
+            double number;
+            if (parseNumber(text, exact) || !parseNumber(text, number) || std::isnan(number)) {
+                bound.values.push_back(convert(text, bound));
+                inexact.emplace_back();
+            } else if (number == std::floor(number) && number >= lowest && number <= highest) {
+                bound.values.push_back(static_cast<int>(number));  // such as 2.0
+                inexact.emplace_back();
+            } else {
+                bound.values.push_back(0);
+                inexact.emplace_back(number);
+            }
+        }
+        switch (bound.kind) {
+            case Kind::COMPARE: {
+                if (!inexact[0]) return true;
+                if (bound.op == CompareOp::EQ) return false;
+                if (bound.op == CompareOp::NE) return anyValue();
+                bool below = bound.op == CompareOp::LT || bound.op == CompareOp::LE;
+                double limit = below ? std::floor(*inexact[0]) : std::ceil(*inexact[0]);
+                if (below ? limit < lowest : limit > highest) return false;
+                if (below ? limit >= highest : limit <= lowest) return anyValue();
+                bound.op = below ? CompareOp::LE : CompareOp::GE;
+                bound.values[0] = static_cast<int>(limit);
+                return true;
+            }
+            case Kind::BETWEEN: {
+                if (!inexact[0] && !inexact[1]) return true;
+                double low = inexact[0] ? std::max(std::ceil(*inexact[0]), lowest) : std::get<int>(bound.values[0]);
+                double high = inexact[1] ? std::min(std::floor(*inexact[1]), highest) : std::get<int>(bound.values[1]);
+                if (low > high) return bound.negated && anyValue();
+                bound.values = {static_cast<int>(low), static_cast<int>(high)};
+                return true;
+            }
+            case Kind::IN: {
+                std::vector<DataValue> values;
+                for (size_t i = 0; i < inexact.size(); ++i) {
+                    if (!inexact[i]) values.push_back(std::move(bound.values[i]));
+                }
+                if (values.empty()) return bound.negated && anyValue();
+                bound.values = std::move(values);
+                return true;
+            }
+            default:
+                return true;
+        }
+    }
+
+    // Two literals compare as numbers when both are, else as strings
+    int compareLiterals(const std::string& a, const std::string& b) {
+        auto number = [](const std::string& text) -> std::optional<double> {
+            if (text.empty()) return std::nullopt;
+            char* end = nullptr;
+            double value = std::strtod(text.c_str(), &end);
+            if (end != text.c_str() + text.size()) return std::nullopt;
+            return value;
+        };
+        auto x = number(a);
+        auto y = number(b);
+        if (x && y) return (*x > *y) - (*x < *y);
+        if (x || y) throw std::runtime_error("Cannot compare " + a + " with " + b);
+        return compareValues(stringToDataValue(a, DataType::STRING), stringToDataValue(b, DataType::STRING));
+    }
+
+    // node as field op values[0]; a NOT BETWEEN, NOT IN or NOT LIKE negates op
+    Node asComparison(Node node, CompareOp op) {
+        node.kind = Kind::COMPARE;
+        node.op = node.negated ? negateOp(op) : op;
+        node.negated = false;
+        node.values.resize(1);
+        return node;
+    }
+
+    Node bindNode(const Node& node, const std::vector<std::string>& literals) {
+        switch (node.kind) {
+            case Kind::CONSTANT:
+                return node;
+            case Kind::AND:
+            case Kind::OR: {
+                std::vector<Node> children;
+                for (const auto& child : node.children) {
+                    children.push_back(bindNode(child, literals));
+                }
+                return combine(node.kind, std::move(children));
+            }
+            case Kind::LITERALS:
+                return constant(compareMatches(
+                    compareLiterals(literals[node.literals[0]], literals[node.literals[1]]), node.op));
+            default:
+                break;
+        }
+        Node bound = node;
+        if (node.type == DataType::INT) {
+            if (!bindInts(bound, literals)) return constant(false);
+        } else {
+            for (size_t literal : node.literals) {
+                bound.values.push_back(convert(literals[literal], node));
+            }
+        }
+        switch (bound.kind) {
+            case Kind::BETWEEN: {
+                int order = compareValues(bound.values[0], bound.values[1]);
+                if (order == 0) return asComparison(std::move(bound), CompareOp::EQ);
+                if (order > 0 && !bound.negated) return constant(false);
+                break;
+            }
+            case Kind::IN: {
+                auto less = [](const DataValue& a, const DataValue& b) { return compareValues(a, b) < 0; };
+                auto equal = [](const DataValue& a, const DataValue& b) { return compareValues(a, b) == 0; };
+                std::sort(bound.values.begin(), bound.values.end(), less);
+                bound.values.erase(std::unique(bound.values.begin(), bound.values.end(), equal), bound.values.end());
+                if (bound.values.size() == 1) return asComparison(std::move(bound), CompareOp::EQ);
+                break;
+            }
+            case Kind::LIKE:
+                if (std::get<std::string>(bound.values[0]).find_first_of("%_") == std::string::npos) {
+                    return asComparison(std::move(bound), CompareOp::EQ);
+                }
+                break;
+            default:
+                break;
+        }
+        return bound;
+    }
+
+    void collectFields(const Node& node, std::vector<size_t>& fields) {
+        if (node.kind == Kind::AND || node.kind == Kind::OR) {
+            for (const auto& child : node.children) collectFields(child, fields);
+            return;
+        }
+        if (node.kind == Kind::CONSTANT || node.kind == Kind::LITERALS) return;
+        for (const auto& field : {std::optional<size_t>(node.field), node.other_field}) {
+            if (field && std::find(fields.begin(), fields.end(), *field) == fields.end()) {
+                fields.push_back(*field);
+            }
+        }
+    }
+
+    void renumber(Node& node, size_t first) {
+        node.field -= first;
+        if (node.other_field) *node.other_field -= first;
+        for (auto& child : node.children) renumber(child, first);
+    }
+
+    // Typed reads of the row being tested, from a TupleView...
+    struct RowReader {
+        const TupleView& row;
+
+        bool isNull(size_t field) const { return row.isNull(field); }
+        int32_t getInt(size_t field) const { return row.getInt(field); }
+        float getFloat(size_t field) const { return row.getFloat(field); }
+        bool getBool(size_t field) const { return row.getBool(field); }
+        std::string_view getString(size_t field) const { return row.getString(field); }
+    };
+
+    // ...or from the columns of a batch
+    struct BatchReader {
+        RowBatch& batch;
+        uint32_t row;
+
+        bool isNull(size_t field) const {
+            const uint8_t* nulls = batch.column(field).nulls;
+            return nulls && ((nulls[row / 8] >> (row % 8)) & 1);
+        }
+        int32_t getInt(size_t field) const {
+            int32_t value;
+            std::memcpy(&value, batch.column(field).values + row * sizeof(value), sizeof(value));
+            return value;
+        }
+        float getFloat(size_t field) const {
+            float value;
+            std::memcpy(&value, batch.column(field).values + row * sizeof(value), sizeof(value));
+            return value;
+        }
+        bool getBool(size_t field) const { return batch.column(field).values[row] != 0; }
+        std::string_view getString(size_t field) const { return batch.column(field).strings[row]; }
+    };
+
+    template <typename T>
+    int order(const T& a, const T& b) {
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+
+    // Orders the node's (non-null) field against a value of its type
+    template <typename Reader>
+    int compareField(const Reader& reader, const Node& node, const DataValue& value) {
+        switch (node.type) {
+            case DataType::INT: return order(reader.getInt(node.field), std::get<int>(value));
+            case DataType::FLOAT: return order(reader.getFloat(node.field), std::get<float>(value));
+            case DataType::BOOLEAN: return order(reader.getBool(node.field), std::get<bool>(value));
+            case DataType::STRING:
+                return order(reader.getString(node.field), std::string_view(std::get<std::string>(value)));
+        }
+        return 0;
+    }
+
+    template <typename Reader>
+    int compareFields(const Reader& reader, const Node& node) {
+        size_t a = node.field;
+        size_t b = *node.other_field;
+        switch (node.type) {
+            case DataType::INT: return order(reader.getInt(a), reader.getInt(b));
+            case DataType::FLOAT: return order(reader.getFloat(a), reader.getFloat(b));
+            case DataType::BOOLEAN: return order(reader.getBool(a), reader.getBool(b));
+            case DataType::STRING: return order(reader.getString(a), reader.getString(b));
+        }
+        return 0;
+    }
+
+    // Binary search of the sorted IN list
+    template <typename Reader>
+    bool contains(const Reader& reader, const Node& node) {
+        size_t low = 0;
+        size_t high = node.values.size();
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            int cmp = compareField(reader, node, node.values[middle]);
+            if (cmp == 0) return true;
+            if (cmp > 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return false;
+    }
+
+    // % matches any run of characters and _ any one character. Greedy, going
+    // back to the last % on a mismatch.
+    bool likeMatches(std::string_view text, std::string_view pattern) {
+        size_t t = 0;
+        size_t p = 0;
+        size_t star = std::string_view::npos;
+        size_t resume = 0;
+        while (t < text.size()) {
+            if (p < pattern.size() && pattern[p] == '%') {
+                star = p++;
+                resume = t;
+            } else if (p < pattern.size() && (pattern[p] == '_' || pattern[p] == text[t])) {
+                ++t;
+                ++p;
+            } else if (star != std::string_view::npos) {
+                p = star + 1;
+                t = ++resume;
+            } else {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '%') ++p;
+        return p == pattern.size();
+    }
+
+    template <typename Reader>
+    bool test(const Node& node, const Reader& reader) {
+        switch (node.kind) {
+            case Kind::CONSTANT:
+                return node.value;
+            case Kind::AND:
+                for (const auto& child : node.children) {
+                    if (!test(child, reader)) return false;
+                }
+                return true;
+            case Kind::OR:
+                for (const auto& child : node.children) {
+                    if (test(child, reader)) return true;
+                }
+                return false;
+            case Kind::COMPARE:
+                if (reader.isNull(node.field)) return false;
+                if (node.other_field) {
+                    return !reader.isNull(*node.other_field) && compareMatches(compareFields(reader, node), node.op);
+                }
+                return compareMatches(compareField(reader, node, node.values[0]), node.op);
+            case Kind::BETWEEN:
+                if (reader.isNull(node.field)) return false;
+                return (compareField(reader, node, node.values[0]) >= 0 &&
+                        compareField(reader, node, node.values[1]) <= 0) != node.negated;
+            case Kind::IN:
+                if (reader.isNull(node.field)) return false;
+                return contains(reader, node) != node.negated;
+            case Kind::LIKE:
+                if (reader.isNull(node.field)) return false;
+                return likeMatches(reader.getString(node.field), std::get<std::string>(node.values[0])) != node.negated;
+            case Kind::LITERALS:
+                break;
+        }
+        throw std::runtime_error("WHERE clause evaluated before binding");
+    }
+
+    const char* opSymbol(CompareOp op) {
+        switch (op) {
+            case CompareOp::EQ: return "=";
+            case CompareOp::NE: return "<>";
+            case CompareOp::LT: return "<";
+            case CompareOp::LE: return "<=";
+            case CompareOp::GT: return ">";
+            case CompareOp::GE: return ">=";
+        }
+        return "?";
+    }
+
+    std::string literalText(const DataValue& value) {
+        if (const auto* text = std::get_if<std::string>(&value)) {
+            std::string quoted = "'";
+            for (char c : *text) {
+                quoted += c;
+                if (c == '\'') quoted += c;
+            }
+            return quoted + "'";
+        }
+        return dataValueToString(value);
+    }
+
+    // SQL text of a bound node; nested ORs are parenthesized
+    void describe(const Node& node, std::string& out, bool nested) {
+        switch (node.kind) {
+            case Kind::CONSTANT:
+                out += node.value ? "TRUE" : "FALSE";
+                return;
+            case Kind::AND:
+            case Kind::OR: {
+                bool parens = nested && node.kind == Kind::OR;
+                if (parens) out += '(';
+                for (size_t i = 0; i < node.children.size(); ++i) {
+                    if (i > 0) out += node.kind == Kind::AND ? " AND " : " OR ";
+                    describe(node.children[i], out, true);
+                }
+                if (parens) out += ')';
+                return;
+            }
+            case Kind::COMPARE:
+                out += node.name + " " + opSymbol(node.op) + " ";
+                out += node.other_field ? node.other_name : literalText(node.values[0]);
+                return;
+            default:
+                break;
+        }
+        out += node.name + (node.negated ? " NOT " : " ");
+        if (node.kind == Kind::BETWEEN) {
+            out += "BETWEEN " + literalText(node.values[0]) + " AND " + literalText(node.values[1]);
+        } else if (node.kind == Kind::IN) {
+            out += "IN (";
+            for (size_t i = 0; i < node.values.size(); ++i) {
+                if (i > 0) out += ", ";
+                out += literalText(node.values[i]);
+            }
+            out += ')';
+        } else {
+            out += "LIKE " + literalText(node.values[0]);
+        }
+    }
+
+    bool isKernel(const Node& node) {
+        return node.kind == Kind::COMPARE && !node.other_field;
+    }
+}
+
+Predicate Predicate::compile(const Condition& where, const TupleLayout& layout, const FieldLookup& lookup) {
+    Predicate predicate;
+    predicate.root_ = compileNode(where, false, layout, lookup);
+    return predicate;
+}
+
+Predicate Predicate::bind(const std::vector<std::string>& literals) const {
+    Predicate bound;
+    bound.root_ = bindNode(root_, literals);
+    return bound;
+}
+
+std::vector<size_t> Predicate::fields() const {
+    std::vector<size_t> fields;
+    collectFields(root_, fields);
+    return fields;
+}
+
+std::vector<Predicate::Range> Predicate::indexRanges() const {
+    std::vector<Range> ranges;
+    auto add = [&](const Node& node) {
+        if (node.kind == Kind::COMPARE && !node.other_field && node.op != CompareOp::NE) {
+            Range range{node.field, std::nullopt, std::nullopt};
+            CompareOp op = node.op;
+            if (op == CompareOp::EQ || op == CompareOp::GT || op == CompareOp::GE) {
+                range.lower = IndexBound{node.values[0], op != CompareOp::GT};
+            }
+            if (op == CompareOp::EQ || op == CompareOp::LT || op == CompareOp::LE) {
+                range.upper = IndexBound{node.values[0], op != CompareOp::LT};
+            }
+            ranges.push_back(std::move(range));
+        } else if (node.kind == Kind::BETWEEN && !node.negated) {
+            ranges.push_back({node.field, IndexBound{node.values[0], true}, IndexBound{node.values[1], true}});
+        }
+    };
+    if (root_.kind == Kind::AND) {
+        for (const auto& child : root_.children) add(child);
+    } else {
+        add(root_);
+    }
+    // Bounded on both sides first
+    std::stable_sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+        return (a.lower && a.upper) > (b.lower && b.upper);
+    });
+    return ranges;
+}
+
+std::optional<Predicate> Predicate::extract(size_t begin, size_t end) {
+    std::vector<Node> conjuncts;
+    if (root_.kind == Kind::AND) {
+        conjuncts = std::move(root_.children);
+    } else {
+        conjuncts.push_back(std::move(root_));
+    }
+    std::vector<Node> taken;
+    std::vector<Node> kept;
+    for (auto& node : conjuncts) {
+        std::vector<size_t> used;
+        collectFields(node, used);
+        bool inside = !used.empty() && std::all_of(used.begin(), used.end(), [&](size_t field) {
+            return field >= begin && field < end;
+        });
+        if (inside) {
+            renumber(node, begin);
+            taken.push_back(std::move(node));
+        } else {
+            kept.push_back(std::move(node));
+        }
+    }
+    root_ = combine(Kind::AND, std::move(kept));
+    if (taken.empty()) return std::nullopt;
+    Predicate part;
+    part.root_ = combine(Kind::AND, std::move(taken));
+    return part;
+}
+
+std::string Predicate::toString() const {
+    std::string text;
+    describe(root_, text, false);
+    return text;
+}
+
+std::string Predicate::toString(const Range& range, const std::string& column) {
+    if (range.lower && range.upper && range.lower->inclusive && range.upper->inclusive &&
+        compareValues(range.lower->value, range.upper->value) == 0) {
+        return column + " = " + literalText(range.lower->value);
+    }
+    std::string text;
+    if (range.lower) {
+        text = column + (range.lower->inclusive ? " >= " : " > ") + literalText(range.lower->value);
+    }
+    if (range.upper) {
+        if (!text.empty()) text += " AND ";
+        text += column + (range.upper->inclusive ? " <= " : " < ") + literalText(range.upper->value);
+    }
+    return text;
+}
+
+bool Predicate::matches(const TupleView& row) const {
+    return test(root_, RowReader{row});
+}
+
+size_t Predicate::select(RowBatch& batch, uint32_t* selection) const {
+    auto kernel = [&](const Node& node) {
+        return selectRows(batch.column(node.field), batch.size(), node.op, node.values[0], batch.excluded(), selection);
+    };
+    if (isKernel(root_)) return kernel(root_);
+
+    bool conjunction = root_.kind == Kind::AND;
+    size_t first = 0;
+    size_t count;
+    if (conjunction && isKernel(root_.children[0])) {
+        count = kernel(root_.children[0]);
+        first = 1;
+    } else {
+        count = selectAll(batch.size(), batch.excluded(), selection);
+    }
+    // Every other conjunct drops rows from the selection in turn
+    auto refine = [&](const Node& node) {
+        size_t kept = 0;
+        for (size_t i = 0; i < count; ++i) {
+            selection[kept] = selection[i];
+            kept += test(node, BatchReader{batch, selection[i]});
+        }
+        count = kept;
+    };
+    if (conjunction) {
+        for (size_t i = first; i < root_.children.size() && count > 0; ++i) {
+            refine(root_.children[i]);
+        }
+    } else {
+        refine(root_);
+    }
+    return count;
+}
+
+} // namespace minisql
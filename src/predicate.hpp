@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include "batch.hpp"
+#include "filter.hpp"
+#include "index.hpp"
+#include "parser.hpp"
+#include "tuple.hpp"
+#include "types.hpp"
+
+namespace minisql {
+
+    // A WHERE clause as a typed expression tree over the fields of one layout.
+    //
+    // compile() resolves a parsed Condition once per plan: names become field
+    // indexes and NOTs are pushed down into the comparisons, so the tree has
+    // no negations left and a comparison with a NULL simply fails, as in SQL.
+    // Literals are still references into the statement's where_values then.
+    // bind() converts them to the column types and folds everything constant,
+    // which gives the predicate rows are tested against.
+    class Predicate {
+    public:
+        struct Node {
+            enum class Kind {
+                CONSTANT,  // value
+                AND,       // children, cheapest first once bound
+                OR,        // children
+                COMPARE,   // field op values[0], or field op other_field
+                BETWEEN,   // values[0] <= field <= values[1]
+                IN,        // field is one of values (sorted, without duplicates)
+                LIKE,      // field matches the pattern values[0] (% and _)
+                LITERALS   // unbound only: literals[0] op literals[1]
+            };
+            Kind kind = Kind::CONSTANT;
+            bool value = true;
+            std::vector<Node> children;
+            size_t field = 0;
+            std::string name;                   // of field
+            DataType type = DataType::INT;      // of field
+            CompareOp op = CompareOp::EQ;
+            std::optional<size_t> other_field;
+            std::string other_name;             // of other_field
+            bool negated = false;               // NOT BETWEEN, NOT IN, NOT LIKE
+            std::vector<size_t> literals;       // positions in the statement's where_values
+            std::vector<DataValue> values;      // the literals as values of type, once bound
+        };
+
+        // A range of one column that all matching rows lie in, for an index
+        struct Range {
+            size_t field;
+            std::optional<IndexBound> lower;
+            std::optional<IndexBound> upper;
+        };
+
+        // Finds a column by name: its field index, or nullopt if there is none
+        using FieldLookup = std::function<std::optional<size_t>(const std::string& name)>;
+
+        static Predicate compile(const Condition& where, const TupleLayout& layout, const FieldLookup& lookup);
+        Predicate bind(const std::vector<std::string>& literals) const;
+
+        const Node& root() const { return root_; }
+        bool isTrue() const { return root_.kind == Node::Kind::CONSTANT && root_.value; }
+        bool isFalse() const { return root_.kind == Node::Kind::CONSTANT && !root_.value; }
+        // Fields the predicate reads, in order of first use
+        std::vector<size_t> fields() const;
+        // Ranges implied by the top-level conjuncts, equality first
+        std::vector<Range> indexRanges() const;
+
+        // Moves the top-level conjuncts that read only fields [begin, end)
+        // into a predicate of their own, with those fields renumbered from 0.
+        // nullopt when there are none.
+        std::optional<Predicate> extract(size_t begin, size_t end);
+
+        // SQL text of the bound predicate, or of a range over column, for EXPLAIN
+        std::string toString() const;
+        static std::string toString(const Range& range, const std::string& column);
+
+        // Evaluation; the predicate must be bound
+        bool matches(const TupleView& row) const;
+        // Writes the indexes of the batch rows that match to selection, which
+        // has room for batch.size() entries, and returns how many there are
+        // (see selectRows). The first comparison with a constant runs as a
+        // selection kernel and the rest of the tree only sees its survivors.
+        size_t select(RowBatch& batch, uint32_t* selection) const;
+
+    private:
+        Node root_;
+    };
+
+} // namespace minisql
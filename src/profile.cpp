@@ -0,0 +1,53 @@
+#include "profile.hpp"
+
+namespace minisql {
+
+using Clock = std::chrono::steady_clock;
+
+StageTimer::StageTimer(StageProfile* stage, const BufferPool& pool) : stage_(stage), pool_(pool) {
+    if (stage_) {
+        before_ = pool_.stats();
+        started_ = Clock::now();
+    }
+}
+
+void StageTimer::stop() {
+    if (!stage_) return;
+    stage_->time += Clock::now() - started_;
+    BufferPool::Stats after = pool_.stats();
+    stage_->pages += (after.hits + after.misses) - (before_.hits + before_.misses);
+    stage_->pages_read += after.misses - before_.misses;
+    stage_->ran = true;
+    stage_->timed = true;
+    stage_ = nullptr;
+}
+
+OutputTimer::OutputTimer(std::ostream& stream, QueryProfile& profile)
+    : stream_(stream), target_(stream.rdbuf(this)), profile_(profile) {}
+
+OutputTimer::~OutputTimer() {
+    stream_.rdbuf(target_);
+}
+
+OutputTimer::int_type OutputTimer::overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+    char ch = traits_type::to_char_type(c);
+    return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+}
+
+std::streamsize OutputTimer::xsputn(const char* s, std::streamsize n) {
+    auto started = Clock::now();
+    std::streamsize written = target_->sputn(s, n);
+    profile_.output += Clock::now() - started;
+    profile_.output_bytes += static_cast<uint64_t>(written);
+    return written;
+}
+
+int OutputTimer::sync() {
+    auto started = Clock::now();
+    int result = target_->pubsync();
+    profile_.output += Clock::now() - started;
+    return result;
+}
+
+} // namespace minisql
@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include "buffer_pool.hpp"
+
+namespace minisql {
+
+    // What one step of a statement did, as measured by EXPLAIN ANALYZE
+    struct StageProfile {
+        bool ran = false;
+        bool timed = false;       // time and pages were measured (see StageTimer)
+        uint64_t rows_in = 0;
+        uint64_t rows_out = 0;
+        uint64_t pages = 0;       // pages requested from the buffer pool
+        uint64_t pages_read = 0;  // of those, the ones read from disk
+        std::chrono::nanoseconds time{0};
+    };
+
+    // Measurements of one statement run under EXPLAIN ANALYZE. The time of a
+    // stage includes the stages that feed it.
+    struct QueryProfile {
+        std::array<StageProfile, 2> scans;  // per table, as in the physical plan
+        StageProfile join;
+        StageProfile aggregate;
+        StageProfile sort;
+        StageProfile statement;             // the whole run; rows_out is rows printed or changed
+        std::chrono::nanoseconds parse{0};
+        std::chrono::nanoseconds plan{0};
+        std::chrono::nanoseconds output{0}; // writing to std::cout
+        uint64_t output_bytes = 0;
+        std::atomic<int64_t> format_ns{0};  // turning result rows into text, summed over threads
+    };
+
+    // Adds the time and buffer pool traffic from construction to stop() (or
+    // destruction) to a stage. Does nothing for a null stage.
+    class StageTimer {
+    public:
+        StageTimer(StageProfile* stage, const BufferPool& pool);
+        ~StageTimer() { stop(); }
+        StageTimer(const StageTimer&) = delete;
+        StageTimer& operator=(const StageTimer&) = delete;
+
+        void stop();
+
+    private:
+        StageProfile* stage_;
+        const BufferPool& pool_;
+        std::chrono::steady_clock::time_point started_;
+        BufferPool::Stats before_;
+    };
+
+    // Sits between a stream and its buffer for as long as it lives, adding
+    // the bytes written and the time spent writing them to a profile
+    class OutputTimer : public std::streambuf {
+    public:
+        OutputTimer(std::ostream& stream, QueryProfile& profile);
+        ~OutputTimer() override;
+        OutputTimer(const OutputTimer&) = delete;
+        OutputTimer& operator=(const OutputTimer&) = delete;
+
+    protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char* s, std::streamsize n) override;
+        int sync() override;
+
+    private:
+        std::ostream& stream_;
+        std::streambuf* target_;
+        QueryProfile& profile_;
+    };
+
+} // namespace minisql
@@ -0,0 +1,214 @@
+#include "result_sink.hpp"
+#include <charconv>
+#include <cmath>
+
+namespace minisql {
+
+namespace {
+    constexpr size_t kColumnWidth = 15;
+
+    void appendJsonString(std::string& out, std::string_view value) {
+        static const char kHex[] = "0123456789abcdef";
+        out += '"';
+        for (char c : value) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        out += "\\u00";
+                        out += kHex[(c >> 4) & 0xF];
+                        out += kHex[c & 0xF];
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        out += '"';
+    }
+
+    template <typename T>
+    void appendChars(std::string& out, T value) {
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+}
+
+std::optional<OutputFormat> parseOutputFormat(std::string_view name) {
+    if (name == "table") return OutputFormat::TABLE;
+    if (name == "csv") return OutputFormat::CSV;
+    if (name == "tsv") return OutputFormat::TSV;
+    if (name == "jsonl") return OutputFormat::JSON_LINES;
+    return std::nullopt;
+}
+
+RowFormatter::RowFormatter(OutputFormat format, std::vector<std::string> columns)
+    : format_(format), columns_(std::move(columns)) {
+    if (format_ == OutputFormat::JSON_LINES) {
+        for (const auto& column : columns_) {
+            std::string key;
+            appendJsonString(key, column);
+            keys_.push_back(key + ":");
+        }
+    }
+}
+
+void RowFormatter::header(std::string& out) const {
+    if (format_ == OutputFormat::JSON_LINES) return;
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        cell(out, i, std::string_view(columns_[i]), true);
+    }
+    endRow(out);
+    if (format_ == OutputFormat::TABLE) {
+        out.append(kColumnWidth * columns_.size() + columns_.size() - 1, '-');
+        out += '\n';
+    }
+}
+
+void RowFormatter::cell(std::string& out, size_t column, const TupleView& row, size_t field, DataType type) const {
+    size_t start = begin(out, column);
+    if (row.isNull(field)) {
+        appendNull(out);
+    } else {
+        switch (type) {
+            case DataType::INT: appendChars(out, row.getInt(field)); break;
+            case DataType::FLOAT: {
+                float value = row.getFloat(field);
+                if (format_ == OutputFormat::JSON_LINES && !std::isfinite(value)) {
+                    out += "null";
+                } else {
+                    appendChars(out, value);
+                }
+                break;
+            }
+            case DataType::BOOLEAN: out += row.getBool(field) ? "true" : "false"; break;
+            case DataType::STRING: appendString(out, row.getString(field)); break;
+        }
+    }
+    end(out, start);
+}
+
+void RowFormatter::cell(std::string& out, size_t column, const FieldValue& value) const {
+    if (!value) {
+        cell(out, column, std::nullopt, false);
+    } else if (const auto* text = std::get_if<std::string>(&*value)) {
+        cell(out, column, std::string_view(*text), true);
+    } else {
+        cell(out, column, std::string_view(dataValueToString(*value)), false);
+    }
+}
+
+void RowFormatter::cell(std::string& out, size_t column, std::optional<std::string_view> text, bool is_string) const {
+    size_t start = begin(out, column);
+    if (!text) {
+        appendNull(out);
+    } else if (is_string) {
+        appendString(out, *text);
+    } else {
+        appendNumber(out, *text);
+    }
+    end(out, start);
+}
+
+void RowFormatter::endRow(std::string& out) const {
+    if (format_ == OutputFormat::JSON_LINES) out += '}';
+    out += '\n';
+}
+
+size_t RowFormatter::begin(std::string& out, size_t column) const {
+    switch (format_) {
+        case OutputFormat::TABLE: if (column > 0) out += '|'; break;
+        case OutputFormat::CSV: if (column > 0) out += ','; break;
+        case OutputFormat::TSV: if (column > 0) out += '\t'; break;
+        case OutputFormat::JSON_LINES:
+            out += column > 0 ? ',' : '{';
+            out += keys_[column];
+            break;
+    }
+    return out.size();
+}
+
+void RowFormatter::end(std::string& out, size_t start) const {
+    // Right-align, as std::setw(kColumnWidth) does
+    size_t width = out.size() - start;
+    if (format_ == OutputFormat::TABLE && width < kColumnWidth) {
+        out.insert(start, kColumnWidth - width, ' ');
+    }
+}
+
+void RowFormatter::appendNull(std::string& out) const {
+    switch (format_) {
+        case OutputFormat::TABLE: out += "NULL"; break;
+        case OutputFormat::CSV: break;
+        case OutputFormat::TSV: out += "\\N"; break;
+        case OutputFormat::JSON_LINES: out += "null"; break;
+    }
+}
+
+void RowFormatter::appendString(std::string& out, std::string_view value) const {
+    switch (format_) {
+        case OutputFormat::TABLE:
+            out.append(value);
+            break;
+        case OutputFormat::CSV:
+            // Quoted when needed, and always when empty so that it differs from NULL
+            if (!value.empty() && value.find_first_of(",\"\r\n") == std::string_view::npos) {
+                out.append(value);
+                break;
+            }
+            out += '"';
+            for (char c : value) {
+                if (c == '"') out += '"';
+                out += c;
+            }
+            out += '"';
+            break;
+        case OutputFormat::TSV:
+            for (char c : value) {
+                switch (c) {
+                    case '\t': out += "\\t"; break;
+                    case '\n': out += "\\n"; break;
+                    case '\r': out += "\\r"; break;
+                    case '\\': out += "\\\\"; break;
+                    default: out += c;
+                }
+            }
+            break;
+        case OutputFormat::JSON_LINES:
+            appendJsonString(out, value);
+            break;
+    }
+}
+
+void RowFormatter::appendNumber(std::string& out, std::string_view text) const {
+    // JSON has no infinities or NaN
+    if (format_ == OutputFormat::JSON_LINES && (text.find("inf") != std::string_view::npos ||
+                                                text.find("nan") != std::string_view::npos)) {
+        out += "null";
+        return;
+    }
+    out.append(text);
+}
+
+void ResultWriter::write(std::string_view text) {
+    if (buffer_.size() + text.size() > kBufferSize) {
+        flush();
+        if (text.size() >= kBufferSize) {
+            out_.write(text.data(), static_cast<std::streamsize>(text.size()));
+            return;
+        }
+    }
+    buffer_.append(text);
+}
+
+void ResultWriter::flush() {
+    if (buffer_.empty()) return;
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+}
+
+} // namespace minisql
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "tuple.hpp"
+#include "types.hpp"
+
+namespace minisql {
+
+    // How SELECT results are printed:
+    //   TABLE       right-aligned columns separated by '|', under a header
+    //   CSV         RFC 4180, with a header line; NULL is an empty field
+    //   TSV         tab-separated, with a header line; NULL is \N and tabs,
+    //               newlines and backslashes in strings are escaped
+    //   JSON_LINES  one JSON object per row, keyed by column name
+    enum class OutputFormat { TABLE, CSV, TSV, JSON_LINES };
+
+    // "table", "csv", "tsv" or "jsonl"
+    std::optional<OutputFormat> parseOutputFormat(std::string_view name);
+
+    // Appends result rows as text in one output format. It keeps no state
+    // between calls, so morsels can format rows into buffers of their own in
+    // parallel. A row is its cells in column order, then endRow().
+    class RowFormatter {
+    public:
+        RowFormatter(OutputFormat format, std::vector<std::string> columns);
+
+        // The header lines, if the format has any
+        void header(std::string& out) const;
+        // A field of a row, read in place
+        void cell(std::string& out, size_t column, const TupleView& row, size_t field, DataType type) const;
+        void cell(std::string& out, size_t column, const FieldValue& value) const;
+        // A value already turned into text: a string, or else a number
+        void cell(std::string& out, size_t column, std::optional<std::string_view> text, bool is_string) const;
+        void endRow(std::string& out) const;
+
+    private:
+        OutputFormat format_;
+        std::vector<std::string> columns_;
+        std::vector<std::string> keys_;  // JSON_LINES: "name": per column
+
+        // Separator before the cell; returns where the cell's text starts
+        size_t begin(std::string& out, size_t column) const;
+        void end(std::string& out, size_t start) const;
+        void appendNull(std::string& out) const;
+        void appendString(std::string& out, std::string_view value) const;
+        void appendNumber(std::string& out, std::string_view text) const;
+    };
+
+    // Collects result text and writes it to a stream in large blocks, rather
+    // than a write per row. Whatever is left is written on destruction.
+    class ResultWriter {
+    public:
+        static constexpr size_t kBufferSize = 1 << 16;
+
+        explicit ResultWriter(std::ostream& out) : out_(out) {}
+        ~ResultWriter() { flush(); }
+        ResultWriter(const ResultWriter&) = delete;
+        ResultWriter& operator=(const ResultWriter&) = delete;
+
+        void write(std::string_view text);
+        void flush();
+
+    private:
+        std::ostream& out_;
+        std::string buffer_;
+    };
+
+} // namespace minisql
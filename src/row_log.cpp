@@ -0,0 +1,143 @@
+#include "row_log.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace minisql {
+
+namespace {
+    constexpr size_t kFileHeader = 8;
+    constexpr size_t kFrameHeader = 16;
+
+    void writeAll(int fd, const char* data, size_t size, const std::string& path) {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error("Failed to append to '" + path + "': " + std::strerror(errno));
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+    std::vector<char> readFile(int fd, size_t size, const std::string& path) {
+        std::vector<char> buffer(size);
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::pread(fd, buffer.data() + done, size - done, static_cast<off_t>(done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error("Failed to read '" + path + "': " + std::strerror(errno));
+            if (n == 0) break;
+            done += static_cast<size_t>(n);
+        }
+        buffer.resize(done);
+        return buffer;
+    }
+}
+
+RowLog::RowLog(const std::string& path) : path_(path) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open '" + path + "': " + std::strerror(errno));
+    }
+    recover();
+    last_sync_ = std::chrono::steady_clock::now();
+}
+
+RowLog::~RowLog() {
+    if (unsynced_bytes_ > 0) {
+        ::fdatasync(fd_);
+    }
+    ::close(fd_);
+}
+
+void RowLog::append(std::string_view record, Lsn lsn) {
+    uint32_t length = static_cast<uint32_t>(record.size());
+    frame_.resize(kFrameHeader + record.size());
+    std::memcpy(frame_.data(), &length, 4);
+    std::memcpy(frame_.data() + 8, &lsn, 8);
+    std::memcpy(frame_.data() + kFrameHeader, record.data(), record.size());
+    uint32_t crc = crc32(frame_.data() + 8, frame_.size() - 8);
+    std::memcpy(frame_.data() + 4, &crc, 4);
+    writeAll(fd_, frame_.data(), frame_.size(), path_);
+    size_ += frame_.size();
+    unsynced_bytes_ += frame_.size();
+    ++record_count_;
+    max_lsn_ = std::max(max_lsn_, lsn);
+
+    if (unsynced_bytes_ >= policy_.max_unsynced_bytes ||
+        std::chrono::steady_clock::now() - last_sync_ >= policy_.max_unsynced_delay) {
+        sync();
+    }
+}
+
+void RowLog::forEach(const std::function<void(std::string_view)>& visitor) const {
+    if (record_count_ == 0) return;
+    std::vector<char> buffer = readFile(fd_, size_, path_);
+    size_t pos = kFileHeader;
+    while (pos + kFrameHeader <= buffer.size()) {
+        uint32_t length;
+        std::memcpy(&length, buffer.data() + pos, 4);
+        visitor(std::string_view(buffer.data() + pos + kFrameHeader, length));
+        pos += kFrameHeader + length;
+    }
+}
+
+void RowLog::reset(uint64_t epoch) {
+    if (::ftruncate(fd_, 0) != 0) {
+        throw std::runtime_error("Failed to truncate '" + path_ + "': " + std::strerror(errno));
+    }
+    writeAll(fd_, reinterpret_cast<const char*>(&epoch), kFileHeader, path_);
+    epoch_ = epoch;
+    size_ = kFileHeader;
+    record_count_ = 0;
+    max_lsn_ = 0;
+    sync();
+}
+
+void RowLog::sync() {
+    if (::fdatasync(fd_) != 0) {
+        throw std::runtime_error("Failed to sync '" + path_ + "': " + std::strerror(errno));
+    }
+    unsynced_bytes_ = 0;
+    last_sync_ = std::chrono::steady_clock::now();
+}
+
+void RowLog::recover() {
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        throw std::runtime_error("Failed to stat '" + path_ + "': " + std::strerror(errno));
+    }
+    std::vector<char> buffer = readFile(fd_, static_cast<size_t>(st.st_size), path_);
+    if (buffer.size() < kFileHeader) {
+        reset(0);
+        return;
+    }
+    std::memcpy(&epoch_, buffer.data(), kFileHeader);
+    size_t pos = kFileHeader;
+    while (pos + kFrameHeader <= buffer.size()) {
+        uint32_t length, crc;
+        Lsn lsn;
+        std::memcpy(&length, buffer.data() + pos, 4);
+        std::memcpy(&crc, buffer.data() + pos + 4, 4);
+        if (pos + kFrameHeader + length > buffer.size() ||
+            crc32(buffer.data() + pos + 8, length + 8) != crc) {
+            break;
+        }
+        std::memcpy(&lsn, buffer.data() + pos + 8, 8);
+        max_lsn_ = std::max(max_lsn_, lsn);
+        pos += kFrameHeader + length;
+        ++record_count_;
+    }
+    size_ = pos;
+    if (pos != buffer.size() && ::ftruncate(fd_, static_cast<off_t>(pos)) != 0) {
+        throw std::runtime_error("Failed to truncate '" + path_ + "': " + std::strerror(errno));
+    }
+}
+
+} // namespace minisql
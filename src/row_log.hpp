@@ -0,0 +1,59 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include "page.hpp"
+
+namespace minisql {
+
+    // Append-only file of encoded rows waiting to be folded into the table heap.
+    // The file starts with a u64 epoch that is bumped every time the log is
+    // reset, followed by entries framed as [u32 length][u32 crc32][u64 lsn][payload];
+    // a torn tail left by a crash is detected by the checksum and cut off when
+    // the log is opened. The LSN ties an entry to its WAL record (0 if unlogged).
+    //
+    // Appends go straight to the OS with write(2). fdatasync is amortized: it
+    // runs only once enough bytes or time have accumulated since the last sync.
+    class RowLog {
+    public:
+        struct SyncPolicy {
+            size_t max_unsynced_bytes = 1 << 20;
+            std::chrono::milliseconds max_unsynced_delay{100};
+        };
+
+        explicit RowLog(const std::string& path);
+        ~RowLog();
+        RowLog(const RowLog&) = delete;
+        RowLog& operator=(const RowLog&) = delete;
+
+        void append(std::string_view record, Lsn lsn = 0);
+        void forEach(const std::function<void(std::string_view)>& visitor) const;
+        // Drops all entries and starts the given epoch
+        void reset(uint64_t epoch);
+        void sync();
+
+        uint64_t epoch() const { return epoch_; }
+        // Highest LSN appended in the current epoch
+        Lsn maxLsn() const { return max_lsn_; }
+        size_t recordCount() const { return record_count_; }
+        size_t sizeBytes() const { return size_; }
+        void setSyncPolicy(const SyncPolicy& policy) { policy_ = policy; }
+
+    private:
+        std::string path_;
+        int fd_;
+        uint64_t epoch_ = 0;
+        Lsn max_lsn_ = 0;
+        size_t size_ = 0;
+        size_t record_count_ = 0;
+        size_t unsynced_bytes_ = 0;
+        std::chrono::steady_clock::time_point last_sync_;
+        SyncPolicy policy_;
+        std::string frame_;
+
+        void recover();
+    };
+
+} // namespace minisql
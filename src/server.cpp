@@ -0,0 +1,416 @@
+#include "server.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace minisql {
+
+// The event loop of a thread. Statement threads post the connections they
+// have news for (see Connection::answer) and wake it.
+struct Server::Loop {
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    std::mutex mutex;
+    std::vector<Connection*> woken;  // guarded by mutex
+
+    void post(Connection& connection) {
+        std::lock_guard<std::mutex> lock(mutex);
+        woken.push_back(&connection);
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd, &one, sizeof(one));
+        (void)written;
+    }
+};
+
+// A client. Its loop reads its requests and sends its answers; a statement
+// thread runs its statements, and writes their output (the stream it is
+// the buffer of) into the answers. Members under mutex are shared by both.
+struct Server::Connection : private std::streambuf {
+    Connection(int socket, std::unique_ptr<DatabaseManager> db, Loop& owner)
+        : fd(socket), loop(owner), session(std::move(db)), output(this) {
+        session->setOutput(output);
+    }
+    ~Connection() { close(fd); }
+
+    int fd;
+    Loop& loop;
+    std::string in;        // received bytes not yet taken as requests
+    bool closing = false;  // the client has stopped sending
+    uint32_t events = 0;   // what epoll watches for
+
+    std::mutex mutex;
+    std::condition_variable drained;  // pending() fell below kMaxPending, or dropped
+    std::string out;       // answers not yet sent, from out_pos on
+    size_t out_pos = 0;
+    bool running = false;  // a statement is queued or runs
+    bool dropped = false;  // the client is gone; answers are discarded
+
+    // For the statement thread
+    std::string request;
+    Parser parser;
+    std::unique_ptr<DatabaseManager> session;
+    std::string part;  // output not yet in out
+    std::ostream output;
+
+    size_t pending() const { return out.size() - out_pos; }
+
+    // Adds an answer, or with kMore a part of one, and wakes the loop. Once
+    // an answer is complete the connection may be gone; a part waits while
+    // the client is kMaxPending behind.
+    void answer(uint8_t status, std::string_view body) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!dropped) wire::appendResponse(out, status, body);
+        if (status != wire::kMore) running = false;
+        loop.post(*this);
+        if (status == wire::kMore) {
+            drained.wait(lock, [&] { return dropped || pending() < kMaxPending; });
+        }
+    }
+
+private:
+    int overflow(int c) override {
+        if (c != traits_type::eof()) {
+            part.push_back(traits_type::to_char_type(c));
+            if (part.size() >= kPartSize) sendPart();
+        }
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char* text, std::streamsize count) override {
+        part.append(text, static_cast<size_t>(count));
+        if (part.size() >= kPartSize) sendPart();
+        return count;
+    }
+    void sendPart() {
+        answer(wire::kMore, part);
+        part.clear();
+    }
+};
+
+Server::Server(DatabaseManager& db, const Endpoint& endpoint, size_t loops)
+    : db_(db), endpoint_(endpoint), loops_(loops) {
+    if (loops_ == 0) {
+        loops_ = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    listen_fd_ = endpoint_.listen();
+    stop_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_fd_ < 0) {
+        close(listen_fd_);
+        throw std::runtime_error(std::string("Cannot create eventfd: ") + std::strerror(errno));
+    }
+}
+
+Server::~Server() {
+    close(stop_fd_);
+    close(listen_fd_);
+    if (!endpoint_.path.empty()) unlink(endpoint_.path.c_str());
+}
+
+void Server::run() {
+    std::vector<std::exception_ptr> errors(loops_);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < loops_; ++i) {
+        threads.emplace_back([this, &errors, i] {
+            try {
+                loop();
+            } catch (...) {
+                errors[i] = std::current_exception();
+                stop();
+            }
+        });
+    }
+    try {
+        loop();
+    } catch (...) {
+        errors[0] = std::current_exception();
+        stop();
+    }
+    for (auto& thread : threads) thread.join();
+    // Every statement has finished by now
+    {
+        std::lock_guard<std::mutex> lock(statements_mutex_);
+        stopping_ = true;
+    }
+    statement_queued_.notify_all();
+    for (auto& thread : statement_threads_) thread.join();
+    statement_threads_.clear();
+    for (auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+void Server::stop() {
+    // The counter stays readable, so every loop sees it
+    uint64_t one = 1;
+    ssize_t written = write(stop_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+void Server::loop() {
+    Loop loop;
+    loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop.epoll_fd < 0) {
+        throw std::runtime_error(std::string("Cannot create epoll instance: ") + std::strerror(errno));
+    }
+    loop.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    // Only one loop wakes up for each connection to accept
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = &listen_fd_;
+    bool watching = loop.wake_fd >= 0 && epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, listen_fd_, &event) == 0;
+    event.events = EPOLLIN;
+    event.data.ptr = &stop_fd_;
+    watching = watching && epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, stop_fd_, &event) == 0;
+    event.data.ptr = &loop.wake_fd;
+    watching = watching && epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.wake_fd, &event) == 0;
+    if (!watching) {
+        int error = errno;
+        if (loop.wake_fd >= 0) close(loop.wake_fd);
+        close(loop.epoll_fd);
+        throw std::runtime_error(std::string("Cannot watch the listening socket: ") + std::strerror(error));
+    }
+
+    Connections connections;
+    std::array<epoll_event, 64> events;
+    bool running = true;
+    // Once stopped, only until the statements still running have finished
+    while (running || !connections.empty()) {
+        int ready = epoll_wait(loop.epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            int error = errno;
+            connections.clear();
+            close(loop.wake_fd);
+            close(loop.epoll_fd);
+            throw std::runtime_error(std::string("epoll_wait failed: ") + std::strerror(error));
+        }
+        for (int i = 0; i < ready; ++i) {
+            void* source = events[i].data.ptr;
+            if (source == &stop_fd_) {
+                if (!running) continue;
+                running = false;
+                epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, stop_fd_, nullptr);
+                epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, listen_fd_, nullptr);
+                std::vector<Connection*> all;
+                for (auto& entry : connections) all.push_back(entry.first);
+                for (Connection* connection : all) drop(loop, connections, *connection);
+                continue;
+            }
+            if (source == &listen_fd_) {
+                if (running) accept(loop, connections);
+                continue;
+            }
+            if (source == &loop.wake_fd) {
+                uint64_t count;
+                ssize_t got = read(loop.wake_fd, &count, sizeof(count));
+                (void)got;
+                std::vector<Connection*> woken;
+                {
+                    std::lock_guard<std::mutex> lock(loop.mutex);
+                    woken.swap(loop.woken);
+                }
+                std::sort(woken.begin(), woken.end());
+                woken.erase(std::unique(woken.begin(), woken.end()), woken.end());
+                for (Connection* connection : woken) {
+                    // It may have gone since it was posted
+                    if (connections.count(connection) == 0) continue;
+                    bool dropped;
+                    {
+                        std::lock_guard<std::mutex> lock(connection->mutex);
+                        dropped = connection->dropped;
+                    }
+                    if (dropped) {
+                        drop(loop, connections, *connection);
+                    } else if (!respond(*connection) || !watch(loop, *connection)) {
+                        drop(loop, connections, *connection);
+                    }
+                }
+                continue;
+            }
+            Connection& connection = *static_cast<Connection*>(source);
+            bool open = (events[i].events & EPOLLERR) == 0;
+            if (open && (events[i].events & (EPOLLIN | EPOLLHUP))) open = receive(connection);
+            if (open) open = respond(connection);
+            if (open) open = watch(loop, connection);
+            if (!open) drop(loop, connections, connection);
+        }
+    }
+    close(loop.wake_fd);
+    close(loop.epoll_fd);
+}
+
+void Server::accept(Loop& loop, Connections& connections) {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;  // none left, or out of descriptors until a connection closes
+        }
+        auto connection = std::make_unique<Connection>(fd, db_.newSession(), loop);
+        if (endpoint_.path.empty()) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        connection->events = EPOLLIN;
+        epoll_event event{};
+        event.events = connection->events;
+        event.data.ptr = connection.get();
+        if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0) {
+            Connection* key = connection.get();
+            connections.emplace(key, std::move(connection));
+        }
+    }
+}
+
+bool Server::receive(Connection& connection) {
+    char buffer[1 << 16];
+    while (!connection.closing) {
+        ssize_t got = read(connection.fd, buffer, sizeof(buffer));
+        if (got > 0) {
+            connection.in.append(buffer, static_cast<size_t>(got));
+            if (static_cast<size_t>(got) < sizeof(buffer)) break;
+        } else if (got == 0) {
+            connection.closing = true;
+        } else if (errno != EINTR) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Server::respond(Connection& connection) {
+    std::unique_lock<std::mutex> lock(connection.mutex);
+    if (!send(connection)) return false;
+    if (connection.pending() < kMaxPending) connection.drained.notify_all();
+    if (!connection.running && connection.pending() < kMaxPending) {
+        size_t pos = 0;
+        auto length = wire::frameLength(connection.in, pos);
+        if (length && *length > wire::kMaxRequest) {
+            wire::appendResponse(connection.out, wire::kError, "Request too large");
+            connection.closing = true;
+            connection.in.clear();
+            if (!send(connection)) return false;
+        } else if (auto frame = wire::nextFrame(connection.in, pos)) {
+            connection.request.assign(*frame);
+            connection.in.erase(0, pos);
+            connection.running = true;
+            lock.unlock();
+            startStatement(connection);
+            return true;
+        }
+    }
+    size_t next = 0;
+    bool more = wire::nextFrame(connection.in, next).has_value();
+    return !(connection.closing && !connection.running && connection.pending() == 0 && !more);
+}
+
+bool Server::send(Connection& connection) {
+    while (connection.pending() > 0) {
+        ssize_t sent = ::send(connection.fd, connection.out.data() + connection.out_pos, connection.pending(),
+                              MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection.out_pos += static_cast<size_t>(sent);
+        } else if (errno != EINTR) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+    }
+    if (connection.pending() == 0) {
+        connection.out.clear();
+        connection.out_pos = 0;
+    } else if (connection.out_pos > connection.out.size() / 2) {
+        connection.out.erase(0, connection.out_pos);
+        connection.out_pos = 0;
+    }
+    return true;
+}
+
+bool Server::watch(Loop& loop, Connection& connection) {
+    uint32_t wanted = 0;
+    {
+        std::lock_guard<std::mutex> lock(connection.mutex);
+        // Reading stops at a whole request waiting behind a running statement
+        size_t next = 0;
+        bool waiting = connection.running && wire::nextFrame(connection.in, next).has_value();
+        if (!connection.closing && connection.pending() < kMaxPending && !waiting) wanted |= EPOLLIN;
+        if (connection.pending() > 0) wanted |= EPOLLOUT;
+    }
+    if (wanted == connection.events) return true;
+    epoll_event change{};
+    change.events = wanted;
+    change.data.ptr = &connection;
+    connection.events = wanted;
+    return epoll_ctl(loop.epoll_fd, EPOLL_CTL_MOD, connection.fd, &change) == 0;
+}
+
+void Server::drop(Loop& loop, Connections& connections, Connection& connection) {
+    if (connection.events != 0) {
+        epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+        connection.events = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(connection.mutex);
+        connection.dropped = true;
+        connection.drained.notify_all();
+        // Its statement still uses it; the loop is woken once that is done
+        if (connection.running) return;
+    }
+    connections.erase(&connection);
+}
+
+void Server::startStatement(Connection& connection) {
+    std::lock_guard<std::mutex> lock(statements_mutex_);
+    statements_.push_back(&connection);
+    if (statements_.size() > idle_threads_) {
+        statement_threads_.emplace_back([this] { statementLoop(); });
+    } else {
+        statement_queued_.notify_one();
+    }
+}
+
+void Server::statementLoop() {
+    std::unique_lock<std::mutex> lock(statements_mutex_);
+    while (true) {
+        ++idle_threads_;
+        statement_queued_.wait(lock, [&] { return stopping_ || !statements_.empty(); });
+        --idle_threads_;
+        if (statements_.empty()) return;
+        Connection* connection = statements_.front();
+        statements_.pop_front();
+        lock.unlock();
+        execute(*connection);
+        lock.lock();
+    }
+}
+
+void Server::execute(Connection& connection) {
+    std::string error;
+    try {
+        connection.session->executeQuery(connection.parser.parse(connection.request));
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    std::string rest = std::move(connection.part);
+    connection.part.clear();
+    if (error.empty()) {
+        connection.answer(wire::kOk, rest);
+    } else {
+        // What the statement printed before it failed has been sent or is dropped
+        connection.answer(wire::kError, error);
+    }
+}
+
+} // namespace minisql
@@ -0,0 +1,81 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "db_manager.hpp"
+#include "wire.hpp"
+
+namespace minisql {
+
+    // Serves the wire protocol to any number of clients. Every event loop
+    // runs on a thread of its own with an epoll instance of its own; the
+    // loops share the listening socket, and a connection stays with the loop
+    // that accepted it. The loops only move bytes. Every client has a
+    // session of the DatabaseManager (see DatabaseManager::newSession), and
+    // its statements run one at a time on a statement thread, so a long
+    // statement holds up no other client. Statement threads are started as
+    // statements need them and kept for later ones. A statement's output is
+    // sent in parts while it runs; a statement whose client falls behind
+    // waits for it.
+    class Server {
+    public:
+        // loops: event loops, 0 for one per core
+        Server(DatabaseManager& db, const Endpoint& endpoint, size_t loops = 0);
+        ~Server();
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        // Serves clients until stop() is called
+        void run();
+        // Makes run() return; safe to call from a signal handler
+        void stop();
+
+    private:
+        // Most bytes of answers a connection may have waiting before the
+        // server stops reading its requests, and its statement waits
+        static constexpr size_t kMaxPending = 4 << 20;
+        // Output of a running statement is sent in parts of about this size
+        static constexpr size_t kPartSize = 64 << 10;
+
+        struct Loop;
+        struct Connection;
+        using Connections = std::unordered_map<Connection*, std::unique_ptr<Connection>>;
+
+        void loop();
+        void accept(Loop& loop, Connections& connections);
+        // These return false once the connection is to be closed
+        bool receive(Connection& connection);
+        // Sends what the socket takes and, once the last statement is done,
+        // starts the next complete request
+        bool respond(Connection& connection);
+        bool send(Connection& connection);
+        // Sets what epoll watches the connection for
+        bool watch(Loop& loop, Connection& connection);
+        // Stops serving the client; the connection goes once no statement runs
+        void drop(Loop& loop, Connections& connections, Connection& connection);
+
+        void startStatement(Connection& connection);
+        void statementLoop();
+        void execute(Connection& connection);
+
+        DatabaseManager& db_;
+        Endpoint endpoint_;
+        size_t loops_;
+        int listen_fd_;
+        int stop_fd_;
+
+        std::mutex statements_mutex_;
+        std::condition_variable statement_queued_;
+        std::deque<Connection*> statements_;  // connections whose statement is to run
+        std::vector<std::thread> statement_threads_;
+        size_t idle_threads_ = 0;
+        bool stopping_ = false;
+    };
+
+} // namespace minisql
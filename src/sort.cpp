@@ -0,0 +1,223 @@
+#include "sort.hpp"
+#include "column_store.hpp"
+#include "index.hpp"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+
+namespace minisql {
+
+namespace {
+    constexpr const char* kRunSuffix = ".run";
+    constexpr size_t kFileBufferSize = 1 << 16;
+
+    std::atomic<uint64_t> run_serial{0};
+
+    bool keyLess(const SortEntry& a, const SortEntry& b) {
+        return a.key < b.key;
+    }
+
+    size_t footprint(const SortEntry& entry) {
+        return sizeof(SortEntry) + entry.key.size() + entry.row.size();
+    }
+
+    // Position in one run of a merge: an in-memory run or a run file
+    struct Cursor {
+        const std::vector<SortEntry>* run = nullptr;
+        size_t next = 0;
+        std::unique_ptr<RunReader> file;
+        SortEntry loaded;
+        const SortEntry* current = nullptr;
+
+        bool advance() {
+            if (run) {
+                current = next < run->size() ? &(*run)[next++] : nullptr;
+            } else {
+                current = file->next(loaded) ? &loaded : nullptr;
+            }
+            return current != nullptr;
+        }
+    };
+
+    // k-way merge over a min-heap of the cursors' current entries
+    void mergeCursors(std::vector<Cursor>& cursors, const std::function<bool(const SortEntry&)>& visit) {
+        std::vector<Cursor*> heap;
+        auto later = [](const Cursor* a, const Cursor* b) { return b->current->key < a->current->key; };
+        for (auto& cursor : cursors) {
+            if (cursor.advance()) heap.push_back(&cursor);
+        }
+        std::make_heap(heap.begin(), heap.end(), later);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Cursor* cursor = heap.back();
+            if (!visit(*cursor->current)) return;
+            if (cursor->advance()) {
+                std::push_heap(heap.begin(), heap.end(), later);
+            } else {
+                heap.pop_back();
+            }
+        }
+    }
+}
+
+std::string newRunPath(const std::string& dir, std::string_view kind) {
+    return dir + "/" + std::string(kind) + "-" + std::to_string(run_serial++) + kRunSuffix;
+}
+
+void removeStaleRuns(const std::string& dir) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.path().extension() == kRunSuffix) {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+RunWriter::RunWriter(const std::string& path) : path_(path), buffer_(std::make_unique<char[]>(kFileBufferSize)) {
+    file_.rdbuf()->pubsetbuf(buffer_.get(), kFileBufferSize);
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        throw std::runtime_error("Failed to create run file: " + path);
+    }
+}
+
+void RunWriter::write(std::string_view key, std::string_view row) {
+    uint32_t sizes[2] = {static_cast<uint32_t>(key.size()), static_cast<uint32_t>(row.size())};
+    file_.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    file_.write(key.data(), static_cast<std::streamsize>(key.size()));
+    file_.write(row.data(), static_cast<std::streamsize>(row.size()));
+}
+
+void RunWriter::close() {
+    file_.close();
+    if (!file_) {
+        throw std::runtime_error("Failed to write run file: " + path_);
+    }
+}
+
+RunReader::RunReader(const std::string& path) : buffer_(std::make_unique<char[]>(kFileBufferSize)) {
+    file_.rdbuf()->pubsetbuf(buffer_.get(), kFileBufferSize);
+    file_.open(path, std::ios::binary);
+    if (!file_) {
+        throw std::runtime_error("Failed to open run file: " + path);
+    }
+}
+
+bool RunReader::next(SortEntry& entry) {
+    uint32_t sizes[2];
+    if (!file_.read(reinterpret_cast<char*>(sizes), sizeof(sizes))) return false;
+    entry.key.resize(sizes[0]);
+    entry.row.resize(sizes[1]);
+    file_.read(entry.key.data(), sizes[0]);
+    file_.read(entry.row.data(), sizes[1]);
+    if (!file_) {
+        throw std::runtime_error("Truncated run file");
+    }
+    return true;
+}
+
+void encodeSortKey(const TupleView& row, const std::vector<SortKey>& keys, const RecordId& rid, std::string& out) {
+    out.clear();
+    for (const auto& key : keys) {
+        size_t start = out.size();
+        FieldValue value = row.get(key.field);
+        out.push_back(value ? 1 : 0);
+        if (value) out += SecondaryIndex::encodeValue(*value);
+        if (key.descending) {
+            for (size_t i = start; i < out.size(); ++i) {
+                out[i] = static_cast<char>(~out[i]);
+            }
+        }
+    }
+    // Row groups come before heap pages in a scan, so their ids sort first
+    PageId page_id = rid.page_id ^ ColumnStore::kGroupPageBase;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<char>((page_id >> shift) & 0xFF));
+    }
+    out.push_back(static_cast<char>(rid.slot >> 8));
+    out.push_back(static_cast<char>(rid.slot & 0xFF));
+}
+
+void sortEntries(std::vector<SortEntry>& entries) {
+    std::sort(entries.begin(), entries.end(), keyLess);
+}
+
+bool TopN::accepts(std::string_view key) const {
+    if (heap_.size() < limit_) return true;
+    return limit_ > 0 && key < heap_.front().key;
+}
+
+void TopN::push(SortEntry entry) {
+    if (!accepts(entry.key)) return;
+    if (heap_.size() == limit_) {
+        std::pop_heap(heap_.begin(), heap_.end(), keyLess);
+        heap_.pop_back();
+    }
+    heap_.push_back(std::move(entry));
+    std::push_heap(heap_.begin(), heap_.end(), keyLess);
+}
+
+void TopN::merge(TopN&& other) {
+    for (auto& entry : other.heap_) {
+        push(std::move(entry));
+    }
+    other.heap_.clear();
+}
+
+std::vector<SortEntry> TopN::take() {
+    std::sort_heap(heap_.begin(), heap_.end(), keyLess);
+    return std::move(heap_);
+}
+
+ExternalSorter::ExternalSorter(std::string dir, size_t memory_budget)
+    : dir_(std::move(dir)), memory_budget_(memory_budget) {}
+
+ExternalSorter::~ExternalSorter() {
+    for (const auto& path : files_) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+}
+
+void ExternalSorter::add(std::vector<SortEntry> run) {
+    if (run.empty()) return;
+    for (const auto& entry : run) {
+        memory_used_ += footprint(entry);
+    }
+    runs_.push_back(std::move(run));
+    if (memory_used_ > memory_budget_) {
+        spill();
+    }
+}
+
+void ExternalSorter::spill() {
+    std::string path = newRunPath(dir_, "sort");
+    files_.push_back(path);
+    RunWriter writer(path);
+    std::vector<Cursor> cursors(runs_.size());
+    for (size_t i = 0; i < runs_.size(); ++i) {
+        cursors[i].run = &runs_[i];
+    }
+    mergeCursors(cursors, [&](const SortEntry& entry) {
+        writer.write(entry.key, entry.row);
+        return true;
+    });
+    writer.close();
+    runs_.clear();
+    memory_used_ = 0;
+}
+
+void ExternalSorter::finish(const std::function<bool(const SortEntry&)>& visit) {
+    std::vector<Cursor> cursors(runs_.size() + files_.size());
+    for (size_t i = 0; i < runs_.size(); ++i) {
+        cursors[i].run = &runs_[i];
+    }
+    for (size_t i = 0; i < files_.size(); ++i) {
+        cursors[runs_.size() + i].file = std::make_unique<RunReader>(files_[i]);
+    }
+    mergeCursors(cursors, visit);
+}
+
+} // namespace minisql
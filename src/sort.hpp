@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "page.hpp"
+#include "tuple.hpp"
+
+namespace minisql {
+
+    struct SortKey {
+        size_t field;
+        bool descending = false;
+    };
+
+    // A row to sort: its key, whose memcmp order is the ORDER BY order, and
+    // the payload handed back in that order
+    struct SortEntry {
+        std::string key;
+        std::string row;
+    };
+
+    // Key of a row under keys, built from SecondaryIndex::encodeValue. Each
+    // field is a null flag and the value, with all bytes inverted for DESC, so
+    // NULLs come first (last with DESC). The record id ends the key, so that
+    // ties keep the order of a table scan.
+    void encodeSortKey(const TupleView& row, const std::vector<SortKey>& keys, const RecordId& rid,
+                       std::string& out);
+
+    void sortEntries(std::vector<SortEntry>& entries);
+
+    // Spill files of sorts and joins: files named <kind>-<n>.run in a
+    // database directory, each a sequence of | u32 key size | u32 row size | key | row |
+    std::string newRunPath(const std::string& dir, std::string_view kind);
+    // Deletes run files left behind in dir by a crash
+    void removeStaleRuns(const std::string& dir);
+
+    class RunWriter {
+    public:
+        explicit RunWriter(const std::string& path);
+        void write(std::string_view key, std::string_view row);
+        void close();
+
+    private:
+        std::string path_;
+        std::unique_ptr<char[]> buffer_;
+        std::ofstream file_;
+    };
+
+    class RunReader {
+    public:
+        explicit RunReader(const std::string& path);
+        // False at the end of the run
+        bool next(SortEntry& entry);
+
+    private:
+        std::unique_ptr<char[]> buffer_;
+        std::ifstream file_;
+    };
+
+    // The first limit entries in key order, kept in a max-heap
+    class TopN {
+    public:
+        explicit TopN(size_t limit) : limit_(limit) {}
+
+        // False when an entry with this key would be dropped right away
+        bool accepts(std::string_view key) const;
+        void push(SortEntry entry);
+        void merge(TopN&& other);
+        // The entries in key order; leaves the heap empty
+        std::vector<SortEntry> take();
+
+    private:
+        size_t limit_;
+        std::vector<SortEntry> heap_;
+    };
+
+    // Sort that stays within a memory budget. Entries are added in runs;
+    // once the runs held in memory exceed the budget they are sorted, merged
+    // and written to a run file in dir, and finish() merges the run files
+    // with whatever is still in memory. Run files are removed again by the
+    // destructor.
+    class ExternalSorter {
+    public:
+        ExternalSorter(std::string dir, size_t memory_budget);
+        ~ExternalSorter();
+        ExternalSorter(const ExternalSorter&) = delete;
+        ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+        // Adds a run, which must be in key order (see sortEntries)
+        void add(std::vector<SortEntry> run);
+        // Visits the entries in key order until visit returns false
+        void finish(const std::function<bool(const SortEntry&)>& visit);
+
+        size_t runFiles() const { return files_.size(); }
+
+    private:
+        std::string dir_;
+        size_t memory_budget_;
+        std::vector<std::vector<SortEntry>> runs_;  // in memory, each sorted
+        size_t memory_used_ = 0;
+        std::vector<std::string> files_;
+
+        void spill();
+    };
+
+} // namespace minisql
@@ -0,0 +1,376 @@
+#include "statistics.hpp"
+#include "index.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+namespace minisql {
+
+namespace {
+    using Node = Predicate::Node;
+    using Kind = Predicate::Node::Kind;
+
+    // HyperLogLog with 2^kSketchBits registers: about 1.6% standard error
+    constexpr int kSketchBits = 12;
+    constexpr size_t kRegisters = size_t{1} << kSketchBits;
+
+    // Guesses for tables without statistics
+    constexpr double kDefaultEquals = 0.005;
+    constexpr double kDefaultRange = 1.0 / 3;
+    constexpr double kDefaultBetween = 0.1;
+    constexpr double kDefaultLike = 0.1;
+    // Share of a LIKE prefix range that matches the rest of the pattern
+    constexpr double kLikeRest = 0.2;
+
+    uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    uint64_t hashValue(const DataValue& value) {
+        return mix(std::hash<std::string>{}(SecondaryIndex::encodeValue(value)));
+    }
+
+    void addToSketch(std::vector<uint8_t>& registers, uint64_t hash) {
+        size_t index = hash >> (64 - kSketchBits);
+        uint64_t rest = (hash << kSketchBits) | (uint64_t{1} << (kSketchBits - 1));
+        uint8_t rank = 1;
+        while (!(rest & (uint64_t{1} << 63))) {
+            rest <<= 1;
+            ++rank;
+        }
+        registers[index] = std::max(registers[index], rank);
+    }
+
+    double sketchEstimate(const std::vector<uint8_t>& registers) {
+        double m = static_cast<double>(kRegisters);
+        double sum = 0;
+        size_t zeros = 0;
+        for (uint8_t rank : registers) {
+            sum += std::ldexp(1.0, -rank);
+            zeros += rank == 0;
+        }
+        double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        // Small cardinalities: linear counting over the empty registers
+        if (estimate <= 2.5 * m && zeros > 0) estimate = m * std::log(m / zeros);
+        return estimate;
+    }
+
+    json toJsonValue(const DataValue& value) {
+        return std::visit([](const auto& v) { return json(v); }, value);
+    }
+
+    DataValue fromJsonValue(const json& value, DataType type) {
+        switch (type) {
+            case DataType::INT: return value.get<int>();
+            case DataType::FLOAT: return value.get<float>();
+            case DataType::BOOLEAN: return value.get<bool>();
+            case DataType::STRING: return value.get<std::string>();
+        }
+        throw std::runtime_error("Unknown data type");
+    }
+
+    bool valueLess(const DataValue& a, const DataValue& b) {
+        return compareValues(a, b) < 0;
+    }
+
+    // Where value lies between lo and hi (lo <= value <= hi), from 0 to 1.
+    // Strings are placed by their first bytes after the prefix lo and hi share.
+    double position(const DataValue& value, const DataValue& lo, const DataValue& hi) {
+        if (const auto* text = std::get_if<std::string>(&value)) {
+            const auto& low = std::get<std::string>(lo);
+            const auto& high = std::get<std::string>(hi);
+            size_t common = 0;
+            while (common < low.size() && common < high.size() && low[common] == high[common]) ++common;
+            auto number = [&](const std::string& s) {
+                double result = 0;
+                for (size_t i = common; i < common + 8; ++i) {
+                    result = result * 256 + (i < s.size() ? static_cast<unsigned char>(s[i]) : 0);
+                }
+                return result;
+            };
+            double from = number(low);
+            double width = number(high) - from;
+            return width > 0 ? std::clamp((number(*text) - from) / width, 0.0, 1.0) : 0.5;
+        }
+        auto number = [](const DataValue& v) {
+            return std::visit([](const auto& x) -> double {
+                if constexpr (std::is_same_v<std::decay_t<decltype(x)>, std::string>) {
+                    return 0;
+                } else {
+                    return static_cast<double>(x);
+                }
+            }, v);
+        };
+        double width = number(hi) - number(lo);
+        return width > 0 ? std::clamp((number(value) - number(lo)) / width, 0.0, 1.0) : 0.5;
+    }
+
+    // Estimates over the non-null values of one analyzed column
+    class ColumnEstimate {
+    public:
+        ColumnEstimate(const ColumnStats& column, uint64_t rows)
+            : column_(column), non_null_(1 - static_cast<double>(column.nulls) / rows) {}
+
+        // Share of the rows that are not NULL
+        double nonNull() const { return non_null_; }
+        // Share of the non-null values equal to value
+        double equal(const DataValue& value) const {
+            const auto& bounds = column_.bounds;
+            if (bounds.empty() || valueLess(value, bounds.front()) || valueLess(bounds.back(), value)) return 0;
+            return 1.0 / std::max<uint64_t>(column_.distinct, 1);
+        }
+        // Share of the non-null values below value
+        double below(const DataValue& value) const {
+            const auto& bounds = column_.bounds;
+            if (bounds.empty() || !valueLess(bounds.front(), value)) return 0;
+            if (valueLess(bounds.back(), value)) return 1;
+            // bounds[i - 1] < value <= bounds[i]
+            size_t i = std::lower_bound(bounds.begin(), bounds.end(), value, valueLess) - bounds.begin();
+            double buckets = static_cast<double>(bounds.size() - 1);
+            return (i - 1 + position(value, bounds[i - 1], bounds[i])) / buckets;
+        }
+        // Share of the non-null values in a range
+        double range(const std::optional<IndexBound>& lower, const std::optional<IndexBound>& upper) const {
+            double from = lower ? below(lower->value) + (lower->inclusive ? 0 : equal(lower->value)) : 0;
+            double to = upper ? below(upper->value) + (upper->inclusive ? equal(upper->value) : 0) : 1;
+            return std::clamp(to - from, 0.0, 1.0);
+        }
+
+    private:
+        const ColumnStats& column_;
+        double non_null_;
+    };
+
+    std::optional<ColumnEstimate> columnEstimate(const TableStats* stats, size_t field) {
+        if (!stats || stats->rows == 0 || field >= stats->columns.size()) return std::nullopt;
+        return ColumnEstimate(stats->columns[field], stats->rows);
+    }
+
+    double likeSelectivity(const Node& node, const ColumnEstimate& column) {
+        const std::string& pattern = std::get<std::string>(node.values[0]);
+        size_t wildcard = pattern.find_first_of("%_");
+        std::string prefix = pattern.substr(0, wildcard);
+        if (prefix.empty()) return kDefaultLike;
+        // The values with the prefix lie in [prefix, prefix + 0xFF...]
+        double share = column.range(IndexBound{prefix, true}, IndexBound{prefix + std::string(8, '\xff'), true});
+        if (wildcard + 1 != pattern.size() || pattern[wildcard] != '%') share *= kLikeRest;
+        return share;
+    }
+
+    double selectivity(const Node& node, const TableStats* stats) {
+        switch (node.kind) {
+            case Kind::CONSTANT:
+                return node.value ? 1 : 0;
+            case Kind::AND: {
+                double result = 1;
+                for (const auto& child : node.children) result *= selectivity(child, stats);
+                return result;
+            }
+            case Kind::OR: {
+                double none = 1;
+                for (const auto& child : node.children) none *= 1 - selectivity(child, stats);
+                return 1 - none;
+            }
+            case Kind::LITERALS:
+                break;
+            default: {
+                auto column = columnEstimate(stats, node.field);
+                if (node.kind == Kind::COMPARE && node.other_field) {
+                    auto other = columnEstimate(stats, *node.other_field);
+                    double equal = kDefaultEquals;
+                    if (column && other) {
+                        equal = column->nonNull() * other->nonNull() /
+                                std::max<uint64_t>({stats->columns[node.field].distinct,
+                                                    stats->columns[*node.other_field].distinct, 1});
+                    }
+                    if (node.op == CompareOp::EQ) return equal;
+                    return node.op == CompareOp::NE ? 1 - equal : kDefaultRange;
+                }
+                double share = 0;
+                switch (node.kind) {
+                    case Kind::COMPARE: {
+                        if (!column) {
+                            if (node.op == CompareOp::EQ) return kDefaultEquals;
+                            return node.op == CompareOp::NE ? 1 - kDefaultEquals : kDefaultRange;
+                        }
+                        const DataValue& value = node.values[0];
+                        switch (node.op) {
+                            case CompareOp::EQ: share = column->equal(value); break;
+                            case CompareOp::NE: share = 1 - column->equal(value); break;
+                            case CompareOp::LT: share = column->below(value); break;
+                            case CompareOp::LE: share = column->below(value) + column->equal(value); break;
+                            case CompareOp::GT: share = 1 - column->below(value) - column->equal(value); break;
+                            case CompareOp::GE: share = 1 - column->below(value); break;
+                        }
+                        return column->nonNull() * std::clamp(share, 0.0, 1.0);
+                    }
+                    case Kind::BETWEEN:
+                        if (!column) return node.negated ? 1 - kDefaultBetween : kDefaultBetween;
+                        share = column->range(IndexBound{node.values[0], true}, IndexBound{node.values[1], true});
+                        break;
+                    case Kind::IN:
+                        if (!column) {
+                            share = std::min(1.0, kDefaultEquals * node.values.size());
+                            return node.negated ? 1 - share : share;
+                        }
+                        share = 0;
+                        for (const auto& value : node.values) share += column->equal(value);
+                        share = std::min(share, 1.0);
+                        break;
+                    default:  // LIKE
+                        if (!column) return node.negated ? 1 - kDefaultLike : kDefaultLike;
+                        share = likeSelectivity(node, *column);
+                        break;
+                }
+                return column->nonNull() * (node.negated ? 1 - share : share);
+            }
+        }
+        throw std::runtime_error("WHERE clause evaluated before binding");
+    }
+}
+
+json TableStats::toJson(const TupleLayout& layout) const {
+    json result;
+    result["rows"] = rows;
+    result["columns"] = json::array();
+    for (size_t i = 0; i < columns.size(); ++i) {
+        json histogram = json::array();
+        for (const auto& bound : columns[i].bounds) {
+            histogram.push_back(toJsonValue(bound));
+        }
+        result["columns"].push_back({{"name", layout.fields()[i].name},
+                                     {"nulls", columns[i].nulls},
+                                     {"distinct", columns[i].distinct},
+                                     {"histogram", std::move(histogram)}});
+    }
+    return result;
+}
+
+std::optional<TableStats> TableStats::fromJson(const json& stats, const TupleLayout& layout) {
+    const auto& fields = layout.fields();
+    if (!stats.contains("columns") || stats["columns"].size() != fields.size()) return std::nullopt;
+    TableStats result;
+    result.rows = stats["rows"].get<uint64_t>();
+    for (size_t i = 0; i < fields.size(); ++i) {
+        const json& column = stats["columns"][i];
+        if (column["name"] != fields[i].name) return std::nullopt;
+        ColumnStats parsed;
+        parsed.nulls = column["nulls"].get<uint64_t>();
+        parsed.distinct = column["distinct"].get<uint64_t>();
+        for (const auto& bound : column["histogram"]) {
+            parsed.bounds.push_back(fromJsonValue(bound, fields[i].type));
+        }
+        result.columns.push_back(std::move(parsed));
+    }
+    return result;
+}
+
+StatsCollector::StatsCollector(const TupleLayout& layout, uint64_t expected_rows)
+    : layout_(&layout),
+      sample_below_(0),
+      sample_all_(expected_rows <= kSampleRows),
+      nulls_(layout.fields().size()),
+      sketches_(layout.fields().size(), std::vector<uint8_t>(kRegisters)),
+      min_(layout.fields().size()),
+      max_(layout.fields().size()),
+      samples_(layout.fields().size()) {
+    if (!sample_all_) {
+        double rate = static_cast<double>(kSampleRows) / static_cast<double>(expected_rows);
+        sample_below_ = static_cast<uint64_t>(rate * 18446744073709551615.0);
+    }
+}
+
+void StatsCollector::add(const RecordId& rid, const TupleView& row) {
+    ++rows_;
+    bool sampled = sample_all_ || mix((uint64_t{rid.page_id} << 16) | rid.slot) < sample_below_;
+    for (size_t field = 0; field < nulls_.size(); ++field) {
+        FieldValue value = row.get(field);
+        if (!value) {
+            ++nulls_[field];
+            continue;
+        }
+        addToSketch(sketches_[field], hashValue(*value));
+        if (!min_[field] || valueLess(*value, *min_[field])) min_[field] = *value;
+        if (!max_[field] || valueLess(*max_[field], *value)) max_[field] = *value;
+        if (sampled) samples_[field].push_back(std::move(*value));
+    }
+}
+
+void StatsCollector::merge(StatsCollector&& other) {
+    rows_ += other.rows_;
+    for (size_t field = 0; field < nulls_.size(); ++field) {
+        nulls_[field] += other.nulls_[field];
+        for (size_t i = 0; i < kRegisters; ++i) {
+            sketches_[field][i] = std::max(sketches_[field][i], other.sketches_[field][i]);
+        }
+        const auto& other_min = other.min_[field];
+        const auto& other_max = other.max_[field];
+        if (other_min && (!min_[field] || valueLess(*other_min, *min_[field]))) min_[field] = other_min;
+        if (other_max && (!max_[field] || valueLess(*max_[field], *other_max))) max_[field] = other_max;
+        auto& sample = samples_[field];
+        std::move(other.samples_[field].begin(), other.samples_[field].end(), std::back_inserter(sample));
+    }
+}
+
+TableStats StatsCollector::finish() {
+    TableStats stats;
+    stats.rows = rows_;
+    for (size_t field = 0; field < nulls_.size(); ++field) {
+        ColumnStats column;
+        column.nulls = nulls_[field];
+        auto& sample = samples_[field];
+        std::sort(sample.begin(), sample.end(), valueLess);
+        uint64_t values = rows_ - column.nulls;
+        if (sample_all_ && sample.size() == values) {
+            // Every value was seen: count them exactly
+            column.distinct = values > 0 ? 1 : 0;
+            for (size_t i = 1; i < sample.size(); ++i) {
+                column.distinct += valueLess(sample[i - 1], sample[i]);
+            }
+        } else {
+            double estimate = std::round(sketchEstimate(sketches_[field]));
+            column.distinct = std::clamp<uint64_t>(static_cast<uint64_t>(estimate), values > 0 ? 1 : 0, values);
+        }
+        if (values > 0) {
+            column.bounds.push_back(*min_[field]);
+            for (size_t bucket = 1; bucket < kBuckets && !sample.empty(); ++bucket) {
+                column.bounds.push_back(sample[bucket * (sample.size() - 1) / kBuckets]);
+            }
+            column.bounds.push_back(*max_[field]);
+        }
+        stats.columns.push_back(std::move(column));
+    }
+    return stats;
+}
+
+double estimateSelectivity(const Predicate& predicate, const TableStats* stats) {
+    return std::clamp(selectivity(predicate.root(), stats), 0.0, 1.0);
+}
+
+double estimateSelectivity(const Predicate::Range& range, const TableStats* stats) {
+    auto column = columnEstimate(stats, range.field);
+    if (!column) {
+        if (range.lower && range.upper) {
+            return compareValues(range.lower->value, range.upper->value) == 0 ? kDefaultEquals : kDefaultBetween;
+        }
+        return range.lower || range.upper ? kDefaultRange : 1;
+    }
+    return column->nonNull() * column->range(range.lower, range.upper);
+}
+
+double estimateDistinct(size_t field, double rows, const TableStats* stats) {
+    double distinct = rows;
+    if (stats && stats->rows > 0 && field < stats->columns.size()) {
+        distinct = static_cast<double>(stats->columns[field].distinct);
+    }
+    return std::max(1.0, std::min(distinct, rows));
+}
+
+} // namespace minisql
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "page.hpp"
+#include "predicate.hpp"
+#include "tuple.hpp"
+#include "types.hpp"
+
+namespace minisql {
+
+    // What ANALYZE found out about one column
+    struct ColumnStats {
+        uint64_t nulls = 0;
+        uint64_t distinct = 0;  // non-null values, estimated
+        // Equi-depth histogram of the non-null values: bounds.front() is the
+        // minimum, bounds.back() the maximum, and each bucket between two
+        // neighbouring bounds holds about the same share of a sample of the
+        // values. Empty when the column only holds NULLs.
+        std::vector<DataValue> bounds;
+    };
+
+    // Statistics of one table as of its last ANALYZE, kept in <table>_stats.json
+    struct TableStats {
+        uint64_t rows = 0;
+        std::vector<ColumnStats> columns;  // one per field of the table's layout
+
+        json toJson(const TupleLayout& layout) const;
+        // nullopt when the statistics do not match the layout
+        static std::optional<TableStats> fromJson(const json& stats, const TupleLayout& layout);
+    };
+
+    // Builds TableStats from the rows of a table. Every morsel of the scan
+    // collects into a collector of its own, and the collectors are merged in
+    // any order. Distinct counts come from a HyperLogLog sketch per column;
+    // histograms from a sample of about kSampleRows rows, picked by a hash of
+    // the record id so that ANALYZE is repeatable.
+    class StatsCollector {
+    public:
+        static constexpr size_t kSampleRows = 30000;
+        static constexpr size_t kBuckets = 32;
+
+        // expected_rows sets the sampling rate
+        StatsCollector(const TupleLayout& layout, uint64_t expected_rows);
+        void add(const RecordId& rid, const TupleView& row);
+        void merge(StatsCollector&& other);
+        TableStats finish();
+
+    private:
+        const TupleLayout* layout_;
+        uint64_t sample_below_;  // rows whose record id hash is below are sampled
+        bool sample_all_;
+        uint64_t rows_ = 0;
+        std::vector<uint64_t> nulls_;
+        std::vector<std::vector<uint8_t>> sketches_;  // HyperLogLog registers per column
+        std::vector<std::optional<DataValue>> min_;
+        std::vector<std::optional<DataValue>> max_;
+        std::vector<std::vector<DataValue>> samples_;
+    };
+
+    // Estimated share of a table's rows that satisfy a bound predicate over
+    // the table's layout. Without statistics (stats null, or a table that
+    // was empty when analyzed) fixed guesses stand in for the distributions.
+    double estimateSelectivity(const Predicate& predicate, const TableStats* stats);
+    // The same for the rows in one index range
+    double estimateSelectivity(const Predicate::Range& range, const TableStats* stats);
+    // Estimated distinct non-null values of a field among rows of a table
+    double estimateDistinct(size_t field, double rows, const TableStats* stats);
+
+} // namespace minisql
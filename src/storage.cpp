@@ -1,8 +1,79 @@
 #include "storage.hpp"
+#include <algorithm>
 #include <fstream>
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
 
 namespace minisql {
+
+    namespace {
+        constexpr size_t kCheckpointWalBytes = 64 << 20;
+        constexpr size_t kDefaultBufferPoolBytes = 64 << 20;
+
+        // Members are destroyed bottom-up: tables before the logs, the pool
+        // and the clock they use
+        struct Registry {
+            std::recursive_mutex mutex;  // guards logs and tables
+            BufferPool pool{kDefaultBufferPoolBytes};
+            VersionClock versions;
+            std::map<std::string, std::unique_ptr<WriteAheadLog>> logs;
+            std::map<std::string, std::unique_ptr<Table>> tables;
+        };
+
+        Registry& registry() {
+            static Registry instance;
+            return instance;
+        }
+
+        std::unique_lock<std::recursive_mutex> lockRegistry() {
+            return std::unique_lock<std::recursive_mutex>(registry().mutex);
+        }
+
+        std::map<std::string, std::unique_ptr<Table>>& openTables() {
+            return registry().tables;
+        }
+
+        std::map<std::string, std::unique_ptr<WriteAheadLog>>& openLogs() {
+            return registry().logs;
+        }
+
+        template <typename Fn>
+        void forEachOpenTable(const std::string& prefix, Fn fn) {
+            for (auto& [path, table] : openTables()) {
+                if (path.compare(0, prefix.size(), prefix) == 0) {
+                    fn(*table);
+                }
+            }
+        }
+
+        std::string tablePath(const std::string& db_name, const std::string& table_name, const std::string& base_path) {
+            return base_path + "/" + db_name + "/" + table_name;
+        }
+
+        std::vector<TableField> schemaFields(const json& schema) {
+            std::vector<TableField> fields;
+            for (const auto& field : schema["fields"]) {
+                fields.push_back({field["name"].get<std::string>(), stringToDataType(field["type"].get<std::string>())});
+            }
+            return fields;
+        }
+
+        // An entry of the schema's "indexes" array
+        IndexDef indexDef(const json& schema, const json& index) {
+            std::string column = index["column"].get<std::string>();
+            auto fields = schemaFields(schema);
+            for (size_t i = 0; i < fields.size(); ++i) {
+                if (fields[i].name == column) {
+                    return {index["name"].get<std::string>(), column, i, fields[i].type, index.value("unique", false),
+                            index.value("primary", false)};
+                }
+            }
+            throw std::runtime_error("Unknown field: " + column);
+        }
+    }
+
     nlohmann::json Storage::loadTableSchema(const std::string& db_name, const std::string& table_name, const std::string& base_path) {
         std::ifstream file(base_path + "/" + db_name + "/" + table_name + "_schema.json");
         if (!file.is_open()) {
@@ -16,17 +87,272 @@ namespace minisql {
         file << schema.dump(4);
     }
 
-    nlohmann::json Storage::loadTableData(const std::string& db_name, const std::string& table_name, const std::string& base_path) {
-        std::ifstream file(base_path + "/" + db_name + "/" + table_name + ".json");
+    nlohmann::json Storage::loadTableStats(const std::string& db_name, const std::string& table_name, const std::string& base_path) {
+        std::ifstream file(base_path + "/" + db_name + "/" + table_name + "_stats.json");
         if (!file.is_open()) {
-            return nlohmann::json::array();
+            return nullptr;
         }
         return nlohmann::json::parse(file);
     }
 
+    void Storage::saveTableStats(const std::string& db_name, const std::string& table_name, const nlohmann::json& stats, const std::string& base_path) {
+        std::ofstream file(base_path + "/" + db_name + "/" + table_name + "_stats.json");
+        file << stats.dump(4);
+    }
+
+    std::vector<std::string> Storage::listTables(const std::string& db_name, const std::string& base_path) {
+        const std::string suffix = "_schema.json";
+        std::vector<std::string> tables;
+        for (const auto& entry : std::filesystem::directory_iterator(base_path + "/" + db_name)) {
+            std::string file = entry.path().filename().string();
+            if (file.size() > suffix.size() && file.compare(file.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                tables.push_back(file.substr(0, file.size() - suffix.size()));
+            }
+        }
+        std::sort(tables.begin(), tables.end());
+        return tables;
+    }
+
+    nlohmann::json Storage::loadTableData(const std::string& db_name, const std::string& table_name, const std::string& base_path) {
+        TupleLayout layout(schemaFields(loadTableSchema(db_name, table_name, base_path)));
+        json data = json::array();
+        openTable(db_name, table_name, base_path).scan([&](const RecordId&, std::string_view record) {
+            data.push_back(decodeRow(layout, record));
+            return true;
+        });
+        return data;
+    }
+
     void Storage::saveTableData(const std::string& db_name, const std::string& table_name, const nlohmann::json& data, const std::string& base_path) {
-        std::ofstream file(base_path + "/" + db_name + "/" + table_name + ".json");
-        file << data.dump(4);
+        TupleLayout layout(schemaFields(loadTableSchema(db_name, table_name, base_path)));
+        std::vector<std::string> records;
+        for (const auto& row : data) {
+            records.push_back(encodeRow(layout, row));
+        }
+        Table& table = openTable(db_name, table_name, base_path);
+        table.clear();
+        table.heap().insertRecords(records);
+        table.rebuildIndexes();
+        table.sync();
+    }
+
+    Table& Storage::openTable(const std::string& db_name, const std::string& table_name, const std::string& base_path) {
+        std::string path = tablePath(db_name, table_name, base_path);
+        auto lock = lockRegistry();
+        auto& tables = openTables();
+        auto it = tables.find(path);
+        if (it != tables.end()) {
+            return *it->second;
+        }
+        bool is_new = !std::filesystem::exists(path + ".db");
+        auto& table = tables[path];
+        table = std::make_unique<Table>(path, bufferPool(), &wal(base_path), WalTableRef{db_name, table_name},
+                                        &versions());
+        if (std::filesystem::exists(path + "_schema.json")) {
+            json schema = loadTableSchema(db_name, table_name, base_path);
+            auto layout = std::make_shared<TupleLayout>(schemaFields(schema));
+            table->setLayout(layout);
+            if (schema.value("format", "row") == "columnar") {
+                table->useColumnStore();
+            }
+            for (const auto& index : schema.value("indexes", json::array())) {
+                table->attachIndex(indexDef(schema, index));
+            }
+        }
+        if (is_new && std::filesystem::exists(path + ".json")) {
+            std::ifstream file(path + ".json");
+            json legacy = nlohmann::json::parse(file);
+            if (legacy.is_array()) {
+                TupleLayout layout(schemaFields(loadTableSchema(db_name, table_name, base_path)));
+                std::vector<std::string> records;
+                for (const auto& row : legacy) {
+                    records.push_back(encodeRow(layout, row));
+                }
+                table->heap().insertRecords(records);
+                table->rebuildIndexes();
+            }
+            file.close();
+            std::filesystem::rename(path + ".json", path + ".json.imported");
+        }
+        return *table;
+    }
+
+    BufferPool& Storage::bufferPool() {
+        return registry().pool;
+    }
+
+    VersionClock& Storage::versions() {
+        return registry().versions;
+    }
+
+    WriteAheadLog& Storage::wal(const std::string& base_path) {
+        auto lock = lockRegistry();
+        auto& log = openLogs()[base_path];
+        if (!log) {
+            log = std::make_unique<WriteAheadLog>(base_path + "/wal.log");
+        }
+        return *log;
+    }
+
+    void Storage::recover(const std::string& base_path) {
+        std::map<std::string, Table*> touched;
+        wal(base_path).replay([&](const WalRecord& record) {
+            if (record.type == WalRecordType::GROUP_BEGIN) {
+                // Its pages were never written back, but its tables' index pages may have been
+                for (const auto& ref : record.tables) {
+                    std::string path = tablePath(ref.db, ref.table, base_path);
+                    if (std::filesystem::exists(path + "_schema.json")) {
+                        touched[path] = &openTable(ref.db, ref.table, base_path);
+                    }
+                }
+                return;
+            }
+            std::string path = tablePath(record.ref.db, record.ref.table, base_path);
+            // Records of tables dropped after they were written are obsolete
+            if (!std::filesystem::exists(path + "_schema.json")) {
+                return;
+            }
+            Table& table = openTable(record.ref.db, record.ref.table, base_path);
+            table.redo(record);
+            touched[path] = &table;
+        });
+        for (auto& [path, table] : touched) {
+            table->finishRecovery();
+        }
+        checkpoint(base_path);
+    }
+
+    void Storage::commit(const std::string& base_path) {
+        WriteAheadLog& log = wal(base_path);
+        // Outside the registry lock, so that concurrent commits share a flush
+        log.flushAll();
+        auto lock = lockRegistry();
+        Lsn durable = log.durableLsn();
+        forEachOpenTable(base_path + "/", [&](Table& table) {
+            table.flushPending(durable);
+        });
+        if (log.sizeBytes() >= kCheckpointWalBytes) {
+            checkpoint(base_path);
+        }
+    }
+
+    void Storage::checkpoint(const std::string& base_path) {
+        // Before the latches, which a running group still needs
+        auto groups = wal(base_path).holdOffGroups();
+        auto lock = lockRegistry();
+        // No table may log a change between the flush and the truncation,
+        // or the change would be lost
+        std::vector<std::unique_lock<SharedLatch>> latches;
+        forEachOpenTable(base_path + "/", [&](Table& table) {
+            latches.push_back(table.lockExclusive());
+        });
+        WriteAheadLog& log = wal(base_path);
+        log.flushAll();
+        Lsn durable = log.durableLsn();
+        forEachOpenTable(base_path + "/", [&](Table& table) {
+            table.checkpoint(durable);
+        });
+        log.truncate();
+    }
+
+    void Storage::createIndex(const std::string& db_name, const std::string& table_name, const std::string& index_name,
+                              const std::string& column, const std::string& base_path, bool unique, bool primary) {
+        if (!findIndexTable(db_name, index_name, base_path).empty()) {
+            throw std::runtime_error("Index already exists: " + index_name);
+        }
+        json schema = loadTableSchema(db_name, table_name, base_path);
+        json entry = {{"name", index_name}, {"column", column}};
+        if (unique) entry["unique"] = true;
+        if (primary) entry["primary"] = true;
+        IndexDef def = indexDef(schema, entry);
+        Table& table = openTable(db_name, table_name, base_path);
+        table.createIndex(def);
+        if (!schema.contains("indexes")) {
+            schema["indexes"] = json::array();
+        }
+        schema["indexes"].push_back(entry);
+        saveTableSchema(db_name, table_name, schema, base_path);
+    }
+
+    void Storage::dropIndex(const std::string& db_name, const std::string& table_name, const std::string& index_name,
+                            const std::string& base_path) {
+        json schema = loadTableSchema(db_name, table_name, base_path);
+        auto& indexes = schema["indexes"];
+        auto it = std::find_if(indexes.begin(), indexes.end(), [&](const json& index) {
+            return index["name"] == index_name;
+        });
+        if (it == indexes.end()) {
+            throw std::runtime_error("Index does not exist: " + index_name);
+        }
+        indexes.erase(it);
+        saveTableSchema(db_name, table_name, schema, base_path);
+        openTable(db_name, table_name, base_path).dropIndex(index_name);
+    }
+
+    std::string Storage::findIndexTable(const std::string& db_name, const std::string& index_name, const std::string& base_path) {
+        for (const auto& table_name : listTables(db_name, base_path)) {
+            json schema = loadTableSchema(db_name, table_name, base_path);
+            for (const auto& index : schema.value("indexes", json::array())) {
+                if (index["name"] == index_name) return table_name;
+            }
+        }
+        return "";
+    }
+
+    void Storage::removeTable(const std::string& db_name, const std::string& table_name, const std::string& base_path) {
+        std::string path = tablePath(db_name, table_name, base_path);
+        auto lock = lockRegistry();
+        openTables().erase(path);
+        for (const auto& entry : std::filesystem::directory_iterator(base_path + "/" + db_name)) {
+            std::string file = entry.path().filename().string();
+            std::string extension = entry.path().extension().string();
+            if (file.rfind(table_name + ".", 0) == 0 && (extension == ".idx" || extension == ".col")) {
+                std::filesystem::remove(entry.path());
+            }
+        }
+        for (const char* suffix : {".db", ".fsm", ".log", ".cols", ".cols.tmp", ".json", "_schema.json", "_stats.json"}) {
+            std::filesystem::remove(path + suffix);
+        }
+    }
+
+    void Storage::closeDatabase(const std::string& db_name, const std::string& base_path) {
+        std::string prefix = base_path + "/" + db_name + "/";
+        auto lock = lockRegistry();
+        auto& tables = openTables();
+        for (auto it = tables.begin(); it != tables.end();) {
+            if (it->first.compare(0, prefix.size(), prefix) == 0) {
+                it = tables.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::string Storage::encodeRow(const TupleLayout& layout, const json& row) {
+        const auto& fields = layout.fields();
+        std::vector<FieldValue> values(fields.size());
+        for (size_t i = 0; i < fields.size(); ++i) {
+            auto it = row.find(fields[i].name);
+            if (it == row.end() || it->is_null()) continue;
+            // Numbers and booleans arrive as JSON values, older exports hold literal text
+            std::string text = it->is_string() ? it->get<std::string>() : it->dump();
+            if (!validateValue(text, fields[i].type)) {
+                throw std::runtime_error("Invalid value for field " + fields[i].name);
+            }
+            values[i] = stringToDataValue(text, fields[i].type);
+        }
+        return layout.encode(values);
+    }
+
+    nlohmann::json Storage::decodeRow(const TupleLayout& layout, std::string_view record) {
+        json row = json::object();
+        TupleView view(layout, record);
+        for (size_t i = 0; i < layout.fields().size(); ++i) {
+            auto value = view.get(i);
+            if (!value) continue;
+            std::visit([&](const auto& v) { row[layout.fields()[i].name] = v; }, *value);
+        }
+        return row;
     }
 
-} // namespace minisql
\ No newline at end of file
+} // namespace minisql
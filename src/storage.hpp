@@ -1,15 +1,72 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <vector>
 #include "types.hpp"
+#include "table.hpp"
+#include "tuple.hpp"
 
 namespace minisql {
 
+    // Facade over the on-disk layout of a database directory:
+    //   <table>_schema.json   table schema
+    //   <table>_stats.json    statistics from the last ANALYZE (see TableStats)
+    //   <table>.db/.fsm       paged table heap (see TableHeap)
+    //   <table>.log           append-only insert log (see RowLog)
+    //   <table>.<index>.idx   secondary index: B+tree, or hash table if unique (see SecondaryIndex)
+    //   <table>.cols/.<column>.col  row groups of a columnar table (see ColumnStore)
+    // plus <base>/wal.log, the write-ahead log shared by all databases.
+    // JSON table data is only used as an import/export format.
     class Storage {
     public:
         static json loadTableSchema(const std::string& db_name, const std::string& table_name, const std::string& base_path);
         static void saveTableSchema(const std::string& db_name, const std::string& table_name, const json& schema, const std::string& base_path);
+
+        // Statistics as saved by ANALYZE, or null if the table has none
+        static json loadTableStats(const std::string& db_name, const std::string& table_name, const std::string& base_path);
+        static void saveTableStats(const std::string& db_name, const std::string& table_name, const json& stats, const std::string& base_path);
+        // Names of the tables of a database, sorted
+        static std::vector<std::string> listTables(const std::string& db_name, const std::string& base_path);
+
+        // Export all rows as a JSON array / replace all rows from a JSON array
         static json loadTableData(const std::string& db_name, const std::string& table_name, const std::string& base_path);
         static void saveTableData(const std::string& db_name, const std::string& table_name, const json& data, const std::string& base_path);
+
+        // Open (and cache) a table. A legacy <table>.json data file is imported
+        // the first time the table is opened.
+        static Table& openTable(const std::string& db_name, const std::string& table_name, const std::string& base_path);
+        // Page cache shared by every open table (64 MB unless resized)
+        static BufferPool& bufferPool();
+        // Write versions and snapshots of every open table (see VersionClock)
+        static VersionClock& versions();
+
+        // Write-ahead log for a base directory. recover() replays it into the
+        // tables at startup; commit() makes everything logged so far durable
+        // (group commit) and writes the covered insert log entries; checkpoint()
+        // also writes back dirty pages, syncs the table files and empties the log.
+        // The open tables and logs may be used from several threads.
+        static WriteAheadLog& wal(const std::string& base_path);
+        static void recover(const std::string& base_path);
+        static void commit(const std::string& base_path);
+        static void checkpoint(const std::string& base_path);
+
+        // Index catalog, kept in the "indexes" array of the table schema.
+        // Index names are unique within a database. A unique index backs a
+        // UNIQUE or (if primary) PRIMARY KEY column.
+        static void createIndex(const std::string& db_name, const std::string& table_name, const std::string& index_name,
+                                const std::string& column, const std::string& base_path, bool unique = false,
+                                bool primary = false);
+        static void dropIndex(const std::string& db_name, const std::string& table_name, const std::string& index_name,
+                              const std::string& base_path);
+        // Table owning the named index, or an empty string
+        static std::string findIndexTable(const std::string& db_name, const std::string& index_name, const std::string& base_path);
+
+        static void removeTable(const std::string& db_name, const std::string& table_name, const std::string& base_path);
+        static void closeDatabase(const std::string& db_name, const std::string& base_path);
+
+        // Conversion between a JSON object and the binary row format (see TupleLayout)
+        static std::string encodeRow(const TupleLayout& layout, const json& row);
+        static json decodeRow(const TupleLayout& layout, std::string_view record);
     };
 
-} // namespace minisql
\ No newline at end of file
+} // namespace minisql
@@ -0,0 +1,848 @@
+#include "table.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <shared_mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace minisql {
+
+using SharedLock = std::shared_lock<SharedLatch>;
+using ExclusiveLock = std::unique_lock<SharedLatch>;
+
+Table::Pin::Pin(Table& table) : table_(table) {
+    ExclusiveLock lock(table_.latch_);
+    table_.fold();
+    table_.moveToColumnStore();
+    ++table_.pins_;
+}
+
+Table::Pin::~Pin() {
+    ExclusiveLock lock(table_.latch_);
+    --table_.pins_;
+}
+
+bool Table::Overrides::hides(const RecordId& rid) const {
+    return std::binary_search(hidden.begin(), hidden.end(), rid);
+}
+
+Table::Table(const std::string& path, BufferPool& pool, WriteAheadLog* wal, WalTableRef ref, VersionClock* clock)
+    : heap_(path, pool, wal, ref), log_(path + ".log"), wal_(wal), ref_(std::move(ref)), pool_(pool), path_(path),
+      clock_(clock) {
+    if (wal_) {
+        // The WAL carries durability; the insert log is only synced on checkpoint
+        log_.setSyncPolicy({SIZE_MAX, std::chrono::milliseconds::max()});
+    }
+    reconcileEpochs();
+}
+
+Table::~Table() {
+    if (tracked_) clock_->untrack(this);
+}
+
+void Table::insert(std::string_view record, uint64_t version) {
+    checkSize(record);
+    ExclusiveLock lock(latch_);
+    completePendingMove();
+    // Indexing happens at fold time, when a failure could no longer be reported
+    checkIndexedValues(record);
+    if (hasUniqueIndex()) {
+        fold();
+        checkKeysLocked({record}, {});
+        RecordId rid = heap_.insertRecord(record);
+        indexInsert(record, rid);
+        noteCreated(rid, version, 0);
+        moveToColumnStore();
+        return;
+    }
+    if (wal_) {
+        Lsn lsn = wal_->logRowInsert(ref_, log_.epoch(), record);
+        pending_rows_.push_back({lsn, std::string(record)});
+        pending_bytes_ += record.size();
+    } else {
+        log_.append(record);
+    }
+    if (version != 0 || !unfolded_versions_.empty()) {
+        unfolded_versions_.push_back(version);
+    }
+    if (log_.sizeBytes() + pending_bytes_ >= kMaxLogBytes) {
+        fold();
+        moveToColumnStore();
+    }
+}
+
+std::vector<RecordId> Table::insertBatch(const std::vector<std::string>& records, uint64_t version) {
+    ExclusiveLock lock(latch_);
+    for (const auto& record : records) {
+        checkSize(record);
+        checkIndexedValues(record);
+    }
+    // Earlier inserts go first, so the rows keep their order
+    fold();
+    if (hasUniqueIndex()) {
+        checkKeysLocked(std::vector<std::string_view>(records.begin(), records.end()), {});
+    }
+    std::vector<RecordId> rids = heap_.insertRecords(records);
+    for (size_t i = 0; i < rids.size(); ++i) {
+        indexInsert(records[i], rids[i]);
+        noteCreated(rids[i], version, 0);
+    }
+    if (!wal_) {
+        heap_.sync();
+    }
+    moveToColumnStore();
+    return rids;
+}
+
+bool Table::get(const RecordId& rid, std::string& out, const Snapshot* snapshot) {
+    // A record id comes from a scan or an index, so its row is folded already
+    SharedLock lock(latch_);
+    bool stored = ColumnStore::owns(rid) ? columns_ && columns_->get(rid, out) : heap_.getRecord(rid, out);
+    if (!snapshot || !hasVersions()) return stored;
+    if (stored) {
+        auto it = created_.find(rid);
+        if (it == created_.end() || snapshot->sees(it->second)) return true;
+    }
+    // The stored row is too new for the snapshot, or gone: an older image
+    auto [first, last] = replaced_.equal_range(rid);
+    for (auto it = first; it != last; ++it) {
+        if (snapshot->sees(it->second.created) && !snapshot->sees(it->second.replaced)) {
+            out = it->second.record;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Table::checkRecord(std::string_view record) {
+    checkSize(record);
+    SharedLock lock(latch_);
+    checkIndexedValues(record);
+}
+
+void Table::checkKeys(const std::vector<std::string_view>& records, const std::set<RecordId>& replaced,
+                      const std::vector<std::string_view>& pending) {
+    ExclusiveLock lock(latch_);
+    if (!hasUniqueIndex()) return;
+    fold();
+    checkKeysLocked(records, replaced, pending);
+}
+
+bool Table::changedSince(const RecordId& rid, const Snapshot& snapshot) {
+    SharedLock lock(latch_);
+    std::string record;
+    bool stored = ColumnStore::owns(rid) ? columns_ && columns_->get(rid, record) : heap_.getRecord(rid, record);
+    if (!stored) return true;
+    auto it = created_.find(rid);
+    return it != created_.end() && !snapshot.sees(it->second);
+}
+
+RecordId Table::update(const RecordId& rid, std::string_view record, uint64_t version) {
+    ExclusiveLock lock(latch_);
+    fold();
+    std::string old_record;
+    if (ColumnStore::owns(rid)) {
+        if (!columns_ || !columns_->get(rid, old_record)) {
+            throw std::runtime_error("Invalid record id");
+        }
+        checkIndexedValues(record);
+        if (hasUniqueIndex()) checkKeysLocked({record}, {rid});
+        RecordId new_rid = heap_.insertRecord(record);
+        if (wal_) wal_->logColumnDelete(ref_, rid);
+        columns_->erase(rid);
+        indexErase(old_record, rid);
+        indexInsert(record, new_rid);
+        noteReplaced(rid, std::move(old_record), version);
+        noteCreated(new_rid, version, 0);
+        return new_rid;
+    }
+    bool versioned = clock_ && version != 0;
+    if ((indexes_.empty() && !versioned) || !heap_.getRecord(rid, old_record)) {
+        return heap_.updateRecord(rid, record);
+    }
+    checkIndexedValues(record);
+    if (hasUniqueIndex()) checkKeysLocked({record}, {rid});
+    RecordId new_rid = heap_.updateRecord(rid, record);
+    for (auto& index : indexes_) {
+        DataValue old_value;
+        DataValue new_value;
+        bool had_value = readField(old_record, index->def().field_index, old_value);
+        bool has_value = readField(record, index->def().field_index, new_value);
+        if (had_value == has_value && old_value == new_value && new_rid == rid) continue;
+        if (had_value) index->erase(old_value, rid);
+        if (has_value) index->insert(new_value, new_rid);
+    }
+    noteReplaced(rid, std::move(old_record), version);
+    noteCreated(new_rid, version, 0);
+    return new_rid;
+}
+
+bool Table::erase(const RecordId& rid, uint64_t version) {
+    ExclusiveLock lock(latch_);
+    fold();
+    std::string old_record;
+    if (ColumnStore::owns(rid)) {
+        if (!columns_ || !columns_->get(rid, old_record)) {
+            return false;
+        }
+        if (wal_) wal_->logColumnDelete(ref_, rid);
+        columns_->erase(rid);
+        indexErase(old_record, rid);
+        noteReplaced(rid, std::move(old_record), version);
+        return true;
+    }
+    bool versioned = clock_ && version != 0;
+    if ((indexes_.empty() && !versioned) || !heap_.getRecord(rid, old_record)) {
+        return heap_.deleteRecord(rid);
+    }
+    if (!heap_.deleteRecord(rid)) {
+        return false;
+    }
+    indexErase(old_record, rid);
+    noteReplaced(rid, std::move(old_record), version);
+    return true;
+}
+
+void Table::scan(const TableHeap::Visitor& visitor) {
+    scan(all_fields_, visitor);
+}
+
+void Table::scan(const std::vector<size_t>& fields, const TableHeap::Visitor& visitor) {
+    prepareRead();
+    SharedLock lock(latch_);
+    // Row groups hold the older rows, so they come first
+    bool more = true;
+    if (columns_) {
+        columns_->scan(fields, [&](const RecordId& rid, std::string_view record) {
+            return more = visitor(rid, record);
+        });
+    }
+    if (more) {
+        heap_.scan(visitor);
+    }
+}
+
+void Table::scanBatches(const std::vector<size_t>& fields, const ColumnStore::BatchVisitor& visitor) {
+    if (!layout_) {
+        throw std::runtime_error("No row layout set for table");
+    }
+    RowBatch batch(*layout_, fields);
+    for (const Morsel& morsel : morsels()) {
+        if (!scanMorsel(morsel, batch, visitor)) return;
+    }
+}
+
+std::vector<Table::Morsel> Table::morsels() {
+    prepareRead();
+    SharedLock lock(latch_);
+    std::vector<Morsel> morsels;
+    if (columns_) {
+        for (const auto& slice : columns_->slices()) {
+            Morsel morsel;
+            morsel.columnar = true;
+            morsel.slice = slice;
+            morsels.push_back(morsel);
+        }
+    }
+    PageId end = heap_.dataPageCount() + 1;
+    for (PageId first = 1; first < end; first += kMorselPages) {
+        Morsel morsel;
+        morsel.first_page = first;
+        morsel.end_page = std::min<PageId>(first + kMorselPages, end);
+        morsels.push_back(morsel);
+    }
+    if (morsels.empty() || morsels.back().columnar) {
+        // Somewhere to read the old images of heap rows from
+        Morsel morsel;
+        morsel.first_page = end;
+        morsel.end_page = end;
+        morsels.push_back(morsel);
+    }
+    morsels.back().last_heap = true;
+    return morsels;
+}
+
+uint64_t Table::estimateRows() {
+    uint64_t rows = 0;
+    for (const Morsel& morsel : morsels()) {
+        if (morsel.columnar) rows += morsel.slice.rows;
+    }
+    SharedLock lock(latch_);
+    PageId pages = heap_.dataPageCount();
+    if (pages == 0) return rows;
+    PageId step = std::max<PageId>(1, pages / kSamplePages);
+    uint64_t sampled_pages = 0;
+    uint64_t sampled_rows = 0;
+    for (PageId page = 1; page <= pages; page += step) {
+        heap_.scanPages(page, page + 1, [&](const std::vector<RecordId>& rids, const std::vector<std::string_view>&) {
+            sampled_rows += rids.size();
+            return true;
+        });
+        ++sampled_pages;
+    }
+    return rows + sampled_rows * pages / sampled_pages;
+}
+
+bool Table::scanMorsel(const Morsel& morsel, RowBatch& batch, const ColumnStore::BatchVisitor& visitor,
+                       const Snapshot* snapshot) {
+    SharedLock lock(latch_);
+    Overrides changed;
+    if (snapshot && hasVersions()) {
+        RecordId begin;
+        RecordId end;
+        if (morsel.columnar) {
+            PageId page = ColumnStore::kGroupPageBase + morsel.slice.group;
+            uint32_t stop = morsel.slice.first_row + morsel.slice.rows;
+            begin = {page, static_cast<uint16_t>(morsel.slice.first_row)};
+            end = stop > std::numeric_limits<uint16_t>::max() ? RecordId{page + 1, 0}
+                                                               : RecordId{page, static_cast<uint16_t>(stop)};
+        } else {
+            begin = {morsel.first_page, 0};
+            end = {morsel.last_heap ? ColumnStore::kGroupPageBase : morsel.end_page, 0};
+        }
+        overrides(*snapshot, begin, end, changed);
+    }
+
+    bool more;
+    if (morsel.columnar) {
+        if (changed.hidden.empty()) {
+            more = columns_->scanSlice(morsel.slice, batch, visitor);
+        } else {
+            more = columns_->scanSlice(morsel.slice, batch, [&](RowBatch& batch) {
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    if (changed.hides(batch.rid(i))) batch.exclude(i);
+                }
+                return visitor(batch);
+            });
+        }
+    } else {
+        std::vector<RecordId> seen_rids;
+        std::vector<std::string_view> seen_records;
+        more = heap_.scanPages(morsel.first_page, morsel.end_page,
+                               [&](const std::vector<RecordId>& rids, const std::vector<std::string_view>& records) {
+            if (changed.hidden.empty()) {
+                batch.loadRecords(rids, records);
+                return visitor(batch);
+            }
+            seen_rids.clear();
+            seen_records.clear();
+            for (size_t i = 0; i < rids.size(); ++i) {
+                if (changed.hides(rids[i])) continue;
+                seen_rids.push_back(rids[i]);
+                seen_records.push_back(records[i]);
+            }
+            batch.loadRecords(seen_rids, seen_records);
+            return visitor(batch);
+        });
+    }
+
+    // Then the rows the snapshot sees in an older form
+    std::vector<RecordId> rids;
+    std::vector<std::string_view> records;
+    for (size_t first = 0; more && first < changed.images.size(); first += RowBatch::kBatchSize) {
+        rids.clear();
+        records.clear();
+        for (size_t i = first; i < std::min(first + RowBatch::kBatchSize, changed.images.size()); ++i) {
+            rids.push_back(changed.images[i].first);
+            records.push_back(*changed.images[i].second);
+        }
+        batch.loadRecords(rids, records);
+        more = visitor(batch);
+    }
+    return more;
+}
+
+void Table::clear() {
+    ExclusiveLock lock(latch_);
+    uint64_t new_epoch = log_.epoch() + 1;
+    if (wal_) {
+        // Truncating files cannot wait for the next commit: make the record
+        // durable first so redo knows the earlier pages are gone
+        wal_->flush(wal_->logTableTruncate(ref_, new_epoch));
+    }
+    pending_rows_.clear();
+    pending_bytes_ = 0;
+    log_.reset(new_epoch);
+    heap_.clear();
+    heap_.setFoldedLogEpoch(new_epoch - 1);
+    if (columns_) {
+        columns_->truncateBefore(new_epoch);
+    }
+    for (auto& index : indexes_) {
+        index->clear();
+    }
+    unfolded_versions_.clear();
+    created_.clear();
+    replaced_.clear();
+}
+
+void Table::sync() {
+    ExclusiveLock lock(latch_);
+    syncFiles();
+}
+
+void Table::checkpoint(Lsn durable_lsn) {
+    flushPendingLocked(durable_lsn);
+    syncFiles();
+}
+
+void Table::syncFiles() {
+    completePendingMove();
+    heap_.sync();
+    log_.sync();
+    if (columns_) {
+        columns_->sync();
+    }
+    for (auto& index : indexes_) {
+        index->sync();
+    }
+}
+
+void Table::foldInsertLog() {
+    ExclusiveLock lock(latch_);
+    fold();
+}
+
+void Table::prepareRead() {
+    ExclusiveLock lock(latch_);
+    fold();
+    moveToColumnStore();
+}
+
+void Table::fold() {
+    completePendingMove();
+    if (log_.recordCount() == 0 && pending_rows_.empty()) return;
+    std::vector<std::string> records;
+    records.reserve(log_.recordCount() + pending_rows_.size());
+    log_.forEach([&](std::string_view record) {
+        records.emplace_back(record);
+    });
+    for (auto& row : pending_rows_) {
+        records.push_back(std::move(row.record));
+    }
+    pending_rows_.clear();
+    pending_bytes_ = 0;
+
+    std::vector<RecordId> rids = heap_.insertRecords(records);
+    // The versions belong to the last rows
+    size_t first_versioned = records.size() - unfolded_versions_.size();
+    uint64_t horizon = clock_ && !unfolded_versions_.empty() ? clock_->horizon() : 0;
+    for (size_t i = 0; i < rids.size(); ++i) {
+        indexInsert(records[i], rids[i]);
+        if (i >= first_versioned) noteCreated(rids[i], unfolded_versions_[i - first_versioned], horizon);
+    }
+    unfolded_versions_.clear();
+    // The heap (stamped with this log's epoch) must be durable before the log
+    // is reset, so a crash in between neither loses nor duplicates rows
+    heap_.setFoldedLogEpoch(log_.epoch());
+    if (wal_) {
+        wal_->flushAll();
+    } else {
+        heap_.sync();
+    }
+    log_.reset(log_.epoch() + 1);
+}
+
+void Table::flushPending(Lsn durable_lsn) {
+    ExclusiveLock lock(latch_);
+    flushPendingLocked(durable_lsn);
+}
+
+void Table::flushPendingLocked(Lsn durable_lsn) {
+    size_t written = 0;
+    for (; written < pending_rows_.size() && pending_rows_[written].lsn <= durable_lsn; ++written) {
+        log_.append(pending_rows_[written].record, pending_rows_[written].lsn);
+        pending_bytes_ -= pending_rows_[written].record.size();
+    }
+    pending_rows_.erase(pending_rows_.begin(), pending_rows_.begin() + written);
+}
+
+void Table::redo(const WalRecord& record) {
+    switch (record.type) {
+        case WalRecordType::ROW_INSERT:
+            // Entries of an epoch that was folded or truncated are already gone
+            if (record.epoch < log_.epoch() || record.epoch <= heap_.foldedLogEpoch()) {
+                return;
+            }
+            if (record.epoch > log_.epoch()) {
+                log_.reset(record.epoch);
+            }
+            if (record.lsn > log_.maxLsn()) {
+                log_.append(record.data, record.lsn);
+            }
+            break;
+        case WalRecordType::TABLE_TRUNCATE:
+        case WalRecordType::ROW_GROUP:
+            heap_.redo(record);
+            if (log_.epoch() < record.epoch) {
+                log_.reset(record.epoch);
+            }
+            // Row groups written after the truncation are tagged with a later epoch
+            if (columns_ && record.type == WalRecordType::TABLE_TRUNCATE) {
+                columns_->truncateBefore(record.epoch);
+            }
+            break;
+        case WalRecordType::COLUMN_DELETE:
+            if (columns_) {
+                columns_->erase({record.page_id, record.slot});
+            }
+            break;
+        default:
+            heap_.redo(record);
+            break;
+    }
+}
+
+void Table::finishRecovery() {
+    ExclusiveLock lock(latch_);
+    heap_.rebuildFreeSpaceMap();
+    reconcileEpochs();
+    completePendingMove();
+    // Index pages are not logged, so they may be behind the recovered heap
+    rebuildIndexesLocked();
+    syncFiles();
+}
+
+void Table::setLayout(std::shared_ptr<const TupleLayout> layout) {
+    layout_ = std::move(layout);
+    all_fields_.clear();
+    for (size_t i = 0; i < layout_->fields().size(); ++i) {
+        all_fields_.push_back(i);
+    }
+}
+
+void Table::useColumnStore() {
+    if (!layout_) {
+        throw std::runtime_error("No row layout set for columnar table");
+    }
+    columns_ = std::make_unique<ColumnStore>(path_, layout_, pool_);
+}
+
+void Table::attachIndex(const IndexDef& def) {
+    ExclusiveLock lock(latch_);
+    attachIndexLocked(def);
+}
+
+void Table::attachIndexLocked(const IndexDef& def) {
+    if (!layout_) {
+        throw std::runtime_error("No row layout set for indexed table");
+    }
+    indexes_.push_back(std::make_unique<SecondaryIndex>(def, path_ + "." + def.name + ".idx", pool_));
+    if (indexes_.back()->isStale()) {
+        rebuildIndexesLocked();
+    }
+}
+
+void Table::createIndex(const IndexDef& def) {
+    ExclusiveLock lock(latch_);
+    attachIndexLocked(def);
+    try {
+        fold();
+        std::vector<std::pair<DataValue, RecordId>> entries;
+        std::vector<std::string> stored;
+        scanRows([&](const RecordId& rid, std::string_view record) {
+            DataValue value;
+            if (readField(record, def.field_index, value)) {
+                indexes_.back()->checkValue(value);
+                entries.emplace_back(std::move(value), rid);
+            }
+            if (def.unique) stored.emplace_back(record);
+            return true;
+        });
+        // The rows must already satisfy a unique index, checked against the empty index
+        if (def.unique) {
+            checkKeysLocked(std::vector<std::string_view>(stored.begin(), stored.end()), {});
+        }
+        indexes_.back()->rebuild(entries);
+        indexes_.back()->sync();
+    } catch (...) {
+        std::string path = indexes_.back()->path();
+        indexes_.pop_back();
+        std::filesystem::remove(path);
+        throw;
+    }
+}
+
+void Table::dropIndex(const std::string& name) {
+    ExclusiveLock lock(latch_);
+    auto it = std::find_if(indexes_.begin(), indexes_.end(), [&](const auto& index) {
+        return index->def().name == name;
+    });
+    if (it == indexes_.end()) return;
+    std::string path = (*it)->path();
+    indexes_.erase(it);
+    std::filesystem::remove(path);
+}
+
+SecondaryIndex* Table::findIndex(const std::string& column) {
+    for (auto& index : indexes_) {
+        if (index->def().column == column) return index.get();
+    }
+    return nullptr;
+}
+
+SecondaryIndex* Table::findIndex(const std::string& column, const std::optional<IndexBound>& lower,
+                                 const std::optional<IndexBound>& upper) {
+    bool single = isSingleValue(lower, upper);
+    SecondaryIndex* found = nullptr;
+    for (auto& index : indexes_) {
+        if (index->def().column != column) continue;
+        if (single && !index->ordered()) return index.get();
+        if (index->ordered() && !found) found = index.get();
+    }
+    return found;
+}
+
+void Table::rebuildIndexes() {
+    ExclusiveLock lock(latch_);
+    rebuildIndexesLocked();
+}
+
+void Table::rebuildIndexesLocked() {
+    if (indexes_.empty()) return;
+    std::vector<std::vector<std::pair<DataValue, RecordId>>> entries(indexes_.size());
+    scanRows([&](const RecordId& rid, std::string_view record) {
+        for (size_t i = 0; i < indexes_.size(); ++i) {
+            DataValue value;
+            if (readField(record, indexes_[i]->def().field_index, value)) {
+                entries[i].emplace_back(std::move(value), rid);
+            }
+        }
+        return true;
+    });
+    for (size_t i = 0; i < indexes_.size(); ++i) {
+        indexes_[i]->rebuild(entries[i]);
+    }
+}
+
+std::optional<std::vector<RecordId>> Table::indexLookup(const std::string& column, const DataValue& value,
+                                                        const Snapshot* snapshot) {
+    SecondaryIndex* index = findIndex(column, IndexBound{value, true}, IndexBound{value, true});
+    if (!index) return std::nullopt;
+    prepareRead();
+    SharedLock lock(latch_);
+    if (snapshot && differs(*snapshot)) return std::nullopt;
+    return index->lookup(value);
+}
+
+std::optional<std::vector<RecordId>> Table::indexRange(const std::string& column, const std::optional<IndexBound>& lower,
+                                                       const std::optional<IndexBound>& upper,
+                                                       const Snapshot* snapshot) {
+    SecondaryIndex* index = findIndex(column, lower, upper);
+    if (!index) return std::nullopt;
+    prepareRead();
+    SharedLock lock(latch_);
+    if (snapshot && differs(*snapshot)) return std::nullopt;
+    return index->range(lower, upper);
+}
+
+bool Table::collectVersions(uint64_t horizon, bool wait) {
+    ExclusiveLock lock(latch_, std::defer_lock);
+    if (wait) {
+        lock.lock();
+    } else if (!lock.try_lock()) {
+        return true;
+    }
+    for (auto it = created_.begin(); it != created_.end();) {
+        it = it->second < horizon ? created_.erase(it) : std::next(it);
+    }
+    for (auto it = replaced_.begin(); it != replaced_.end();) {
+        it = it->second.replaced < horizon ? replaced_.erase(it) : std::next(it);
+    }
+    if (hasVersions()) return true;
+    // The clock forgets a table it collects without waiting by itself
+    if (tracked_ && wait) clock_->untrack(this);
+    tracked_ = false;
+    return false;
+}
+
+void Table::noteCreated(const RecordId& rid, uint64_t version, uint64_t horizon) {
+    if (!clock_ || version == 0 || version < horizon) {
+        if (!created_.empty()) created_.erase(rid);
+        return;
+    }
+    created_[rid] = version;
+    track();
+}
+
+void Table::noteReplaced(const RecordId& rid, std::string record, uint64_t version) {
+    uint64_t created = 0;
+    auto it = created_.find(rid);
+    if (it != created_.end()) {
+        created = it->second;
+        created_.erase(it);
+    }
+    if (!clock_ || version == 0) return;
+    replaced_.emplace(rid, OldRow{created, version, std::move(record)});
+    track();
+}
+
+void Table::track() {
+    if (tracked_) return;
+    clock_->track(this);
+    tracked_ = true;
+}
+
+void Table::overrides(const Snapshot& snapshot, const RecordId& begin, const RecordId& end, Overrides& out) const {
+    for (auto it = created_.lower_bound(begin); it != created_.end() && it->first < end; ++it) {
+        if (!snapshot.sees(it->second)) out.hidden.push_back(it->first);
+    }
+    for (auto it = replaced_.lower_bound(begin); it != replaced_.end() && it->first < end; ++it) {
+        if (snapshot.sees(it->second.created) && !snapshot.sees(it->second.replaced)) {
+            out.images.emplace_back(it->first, &it->second.record);
+        }
+    }
+}
+
+bool Table::differs(const Snapshot& snapshot) const {
+    for (const auto& [rid, version] : created_) {
+        if (!snapshot.sees(version)) return true;
+    }
+    for (const auto& [rid, old] : replaced_) {
+        if (snapshot.sees(old.created) && !snapshot.sees(old.replaced)) return true;
+    }
+    return false;
+}
+
+bool Table::readField(std::string_view record, size_t field, DataValue& value) const {
+    auto field_value = TupleView(*layout_, record).get(field);
+    if (!field_value) return false;
+    value = std::move(*field_value);
+    return true;
+}
+
+void Table::checkSize(std::string_view record) const {
+    if (record.size() > SlottedPage::maxRecordSize()) {
+        throw std::runtime_error("Row too large (" + std::to_string(record.size()) + " bytes)");
+    }
+}
+
+void Table::checkIndexedValues(std::string_view record) {
+    for (auto& index : indexes_) {
+        DataValue value;
+        if (readField(record, index->def().field_index, value)) {
+            index->checkValue(value);
+        }
+    }
+}
+
+void Table::checkKeysLocked(const std::vector<std::string_view>& records, const std::set<RecordId>& replaced,
+                            const std::vector<std::string_view>& pending) {
+    for (auto& index : indexes_) {
+        const IndexDef& def = index->def();
+        if (!def.unique) continue;
+        std::set<std::string> values;
+        for (std::string_view record : pending) {
+            DataValue value;
+            if (readField(record, def.field_index, value)) values.insert(SecondaryIndex::encodeValue(value));
+        }
+        for (std::string_view record : records) {
+            DataValue value;
+            if (!readField(record, def.field_index, value)) {
+                if (def.primary) throw std::runtime_error("Primary key " + def.column + " cannot be null");
+                continue;
+            }
+            bool repeated = !values.insert(SecondaryIndex::encodeValue(value)).second;
+            if (!repeated) {
+                for (const auto& rid : index->lookup(value)) {
+                    if (replaced.count(rid) == 0) repeated = true;
+                }
+            }
+            if (repeated) {
+                throw std::runtime_error("Duplicate value " + dataValueToString(value) + " for unique column " +
+                                         def.column + " (index " + def.name + ")");
+            }
+        }
+    }
+}
+
+bool Table::hasUniqueIndex() const {
+    for (const auto& index : indexes_) {
+        if (index->def().unique) return true;
+    }
+    return false;
+}
+
+void Table::indexInsert(std::string_view record, const RecordId& rid) {
+    for (auto& index : indexes_) {
+        DataValue value;
+        if (readField(record, index->def().field_index, value)) {
+            index->insert(value, rid);
+        }
+    }
+}
+
+void Table::indexErase(std::string_view record, const RecordId& rid) {
+    for (auto& index : indexes_) {
+        DataValue value;
+        if (readField(record, index->def().field_index, value)) {
+            index->erase(value, rid);
+        }
+    }
+}
+
+void Table::reconcileEpochs() {
+    // A crash after a fold reached the heap but before the log was reset
+    // leaves entries that are already in the heap
+    if (log_.epoch() <= heap_.foldedLogEpoch()) {
+        log_.reset(heap_.foldedLogEpoch() + 1);
+    }
+}
+
+void Table::scanRows(const TableHeap::Visitor& visitor) {
+    if (columns_) {
+        columns_->scan(all_fields_, visitor);
+    }
+    heap_.scan(visitor);
+}
+
+void Table::moveToColumnStore() {
+    if (!columns_ || pins_ > 0 || heap_.dataPageCount() < kMoveHeapPages) return;
+    std::vector<std::string> records;
+    std::vector<RecordId> heap_rids;
+    heap_.scan([&](const RecordId& rid, std::string_view record) {
+        records.emplace_back(record);
+        heap_rids.push_back(rid);
+        return true;
+    });
+    uint64_t epoch = log_.epoch() + 1;
+    // The directory written with the new groups also carries delete marks,
+    // which must not reach the disk before their log records
+    if (wal_) {
+        wal_->flushAll();
+    }
+    std::vector<RecordId> rids = columns_->append(records, epoch);
+    finishMove(epoch);
+    for (size_t i = 0; i < records.size(); ++i) {
+        indexErase(records[i], heap_rids[i]);
+        indexInsert(records[i], rids[i]);
+        // Row versions move along; old images stay with the heap
+        if (created_.empty()) continue;
+        auto it = created_.find(heap_rids[i]);
+        if (it != created_.end()) {
+            uint64_t version = it->second;
+            created_.erase(it);
+            created_[rids[i]] = version;
+        }
+    }
+}
+
+void Table::finishMove(uint64_t epoch) {
+    if (wal_) {
+        wal_->flush(wal_->logRowGroup(ref_, epoch));
+    }
+    heap_.clear();
+    heap_.setFoldedLogEpoch(epoch - 1);
+    log_.reset(epoch);
+}
+
+void Table::completePendingMove() {
+    // Groups newer than the insert log were written by a move that crashed
+    // before emptying the heap; their rows are still in the heap as well
+    if (!columns_ || columns_->lastEpoch() <= log_.epoch()) return;
+    finishMove(columns_->lastEpoch());
+    rebuildIndexesLocked();
+}
+
+} // namespace minisql
@@ -0,0 +1,270 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "column_store.hpp"
+#include "index.hpp"
+#include "mvcc.hpp"
+#include "table_heap.hpp"
+#include "row_log.hpp"
+#include "wal.hpp"
+
+namespace minisql {
+
+    // Storage for one table: a paged heap plus an append-only insert log.
+    //
+    // INSERT only appends the encoded row to <path>.log. Pending rows are folded
+    // into the heap in one batch (each page written once) before anything that
+    // needs record ids or a complete view of the table, and whenever the log
+    // grows past kMaxLogBytes.
+    //
+    // With a WAL attached every change is logged first; insert log entries are
+    // only written by flushPending() once the WAL is durable (heap pages get the
+    // same treatment from the buffer pool), so the files never hold a change the
+    // WAL could lose.
+    //
+    // Secondary indexes cover every stored row: rows enter them when they are
+    // folded, and index reads fold first. A table with a unique index skips
+    // the insert log, so that every row is indexed before the next one is
+    // checked against it.
+    //
+    // A columnar table also has a ColumnStore. The heap then only collects
+    // recent rows: once it reaches kMoveHeapPages its rows are moved into new
+    // row groups. The groups are written first (tagged with the next insert log
+    // epoch), then the move is logged and the heap emptied; a crash in between
+    // is finished on the next access. Updated group rows are deleted there and
+    // re-inserted into the heap.
+    //
+    // Threads may use a table at once. A latch guards its structures: reads
+    // share it for one morsel, one row or one index lookup at a time, and
+    // changes take it alone, one row at a time. Statements that change the
+    // table also hold writeLock() throughout, so writers take turns while
+    // readers go on.
+    //
+    // Readers see the table as of a Snapshot. Every change names the write
+    // (version) making it; while a snapshot may not see that version, the
+    // table remembers which stored rows it created and keeps the images of
+    // the rows it replaced or deleted, and snapshot reads use those instead.
+    // The images are dropped once every snapshot sees the change (see
+    // VersionClock). Moving heap rows into the column store waits while any
+    // Pin is held, so record ids and morsels stay valid for a statement.
+    class Table {
+    public:
+        static constexpr size_t kMaxLogBytes = 8 << 20;
+        static constexpr PageId kMoveHeapPages = 512;
+        // Heap pages per morsel
+        static constexpr PageId kMorselPages = 64;
+        static constexpr PageId kSamplePages = 64;
+
+        // An independent part of a scan: a slice of a row group, or a run of
+        // heap pages [first_page, end_page)
+        struct Morsel {
+            bool columnar = false;
+            ColumnStore::Slice slice{};
+            PageId first_page = 0;
+            PageId end_page = 0;
+            bool last_heap = false;  // also holds old images of rows past the end of the heap
+        };
+
+        // Keeps the rows where they are while it lives (see above)
+        class Pin {
+        public:
+            explicit Pin(Table& table);
+            ~Pin();
+            Pin(const Pin&) = delete;
+            Pin& operator=(const Pin&) = delete;
+
+        private:
+            Table& table_;
+        };
+
+        Table(const std::string& path, BufferPool& pool, WriteAheadLog* wal = nullptr, WalTableRef ref = {},
+              VersionClock* clock = nullptr);
+        ~Table();
+
+        // version is the write making a change, 0 for one no snapshot needs
+        // to be kept from (such as recovery)
+        void insert(std::string_view record, uint64_t version = 0);
+        // Writes many rows at once straight into heap pages, each page logged
+        // once as a whole, instead of through the insert log. Checks every
+        // row before writing any. The record ids it returns stay valid while
+        // a Pin is held.
+        std::vector<RecordId> insertBatch(const std::vector<std::string>& records, uint64_t version = 0);
+        // The row as the snapshot sees it; the stored row without one
+        bool get(const RecordId& rid, std::string& out, const Snapshot* snapshot = nullptr);
+        // Throws if insert() or update() would refuse the record for its
+        // size or indexed values (uniqueness is checkKeys())
+        void checkRecord(std::string_view record);
+        // Throws if storing the records, once the rows at replaced are gone,
+        // would repeat a value of a unique index or leave a primary key
+        // without one. Pending records are to be stored as well (already
+        // checked themselves). insert(), insertBatch() and update() check
+        // their own.
+        void checkKeys(const std::vector<std::string_view>& records, const std::set<RecordId>& replaced = {},
+                       const std::vector<std::string_view>& pending = {});
+        bool hasUniqueIndex() const;
+        // Whether the stored row at rid is gone or is not the one the
+        // snapshot sees (the snapshot must still be held)
+        bool changedSince(const RecordId& rid, const Snapshot& snapshot);
+        RecordId update(const RecordId& rid, std::string_view record, uint64_t version = 0);
+        bool erase(const RecordId& rid, uint64_t version = 0);
+        void scan(const TableHeap::Visitor& visitor);
+        // Like scan(), but rows from the column store only carry the given
+        // fields (the others read as null); heap rows are always complete
+        void scan(const std::vector<size_t>& fields, const TableHeap::Visitor& visitor);
+        // Same rows and order as scan(fields, ...), a batch at a time: row
+        // groups in slices of RowBatch::kBatchSize, then one batch per heap page
+        void scanBatches(const std::vector<size_t>& fields, const ColumnStore::BatchVisitor& visitor);
+        // The same scan cut into morsels, in scan order. Folds first like
+        // scan(); the morsels stay valid while a Pin is held. scanMorsel()
+        // may run on several threads at once.
+        std::vector<Morsel> morsels();
+        // Row count for planning: row group sizes (deleted rows included) plus
+        // the heap's rows, extrapolated from up to kSamplePages pages
+        uint64_t estimateRows();
+        // Rows a snapshot sees differently come after the others, from their
+        // images
+        bool scanMorsel(const Morsel& morsel, RowBatch& batch, const ColumnStore::BatchVisitor& visitor,
+                        const Snapshot* snapshot = nullptr);
+        // Empties the table, old images included: only while no snapshot is
+        // held (see VersionClock::holdOffSnapshots)
+        void clear();
+        void sync();
+
+        // Moves all logged inserts into the heap
+        void foldInsertLog();
+
+        // Writes buffered insert log entries covered by durable_lsn
+        void flushPending(Lsn durable_lsn);
+        void redo(const WalRecord& record);
+        void finishRecovery();
+
+        // Row format of the records; must be set before indexes or the column store are attached
+        void setLayout(std::shared_ptr<const TupleLayout> layout);
+        // Stores the bulk of the rows column-wise
+        void useColumnStore();
+        bool isColumnar() const { return columns_ != nullptr; }
+
+        // Index management
+        void attachIndex(const IndexDef& def);
+        // Attaches a new index and fills it from the table contents
+        void createIndex(const IndexDef& def);
+        void dropIndex(const std::string& name);
+        SecondaryIndex* findIndex(const std::string& column);
+        // The index to read the bounds with: for a single value preferably a
+        // unique one, otherwise an ordered one; null if there is none
+        SecondaryIndex* findIndex(const std::string& column, const std::optional<IndexBound>& lower,
+                                  const std::optional<IndexBound>& upper);
+        void rebuildIndexes();
+
+        // Record ids through the index on column, or nullopt if it has none.
+        // With a snapshot, also nullopt when the index holds changes the
+        // snapshot does not see; get() then reads the rows as it sees them.
+        std::optional<std::vector<RecordId>> indexLookup(const std::string& column, const DataValue& value,
+                                                         const Snapshot* snapshot = nullptr);
+        std::optional<std::vector<RecordId>> indexRange(const std::string& column, const std::optional<IndexBound>& lower,
+                                                        const std::optional<IndexBound>& upper,
+                                                        const Snapshot* snapshot = nullptr);
+
+        std::mutex& writeLock() { return write_mutex_; }
+        // Excludes every other use of the table while it lives
+        std::unique_lock<SharedLatch> lockExclusive() { return std::unique_lock<SharedLatch>(latch_); }
+        // flushPending() and sync() under lockExclusive()
+        void checkpoint(Lsn durable_lsn);
+        // Drops the images of rows replaced before horizon; skips a busy
+        // table unless wait is set. Returns whether images are left.
+        bool collectVersions(uint64_t horizon, bool wait = true);
+
+        const WalTableRef& walRef() const { return ref_; }
+        TableHeap& heap() { return heap_; }
+        RowLog& insertLog() { return log_; }
+
+    private:
+        struct PendingRow {
+            Lsn lsn;
+            std::string record;
+        };
+
+        // A row image a snapshot may still see: written by version created
+        // (0 if every snapshot sees it) and replaced or deleted by replaced
+        struct OldRow {
+            uint64_t created;
+            uint64_t replaced;
+            std::string record;
+        };
+
+        // How a snapshot sees the rows in a range of record ids where that
+        // differs from what is stored
+        struct Overrides {
+            std::vector<RecordId> hidden;  // sorted; stored rows it does not see
+            std::vector<std::pair<RecordId, const std::string*>> images;  // older rows it sees instead
+
+            bool hides(const RecordId& rid) const;
+        };
+
+        TableHeap heap_;
+        RowLog log_;
+        WriteAheadLog* wal_;
+        WalTableRef ref_;
+        std::vector<PendingRow> pending_rows_;
+        size_t pending_bytes_ = 0;
+        BufferPool& pool_;
+        std::string path_;
+        std::shared_ptr<const TupleLayout> layout_;
+        std::vector<std::unique_ptr<SecondaryIndex>> indexes_;
+        std::unique_ptr<ColumnStore> columns_;
+        std::vector<size_t> all_fields_;
+
+        SharedLatch latch_;
+        std::mutex write_mutex_;
+        size_t pins_ = 0;  // guarded by latch_
+        VersionClock* clock_;
+        bool tracked_ = false;
+        // Versions of the newest rows not folded yet, in fold order (older rows are version 0)
+        std::vector<uint64_t> unfolded_versions_;
+        // Stored rows written by versions some snapshot may not see
+        std::map<RecordId, uint64_t> created_;
+        // Older images, by the record id the row had
+        std::multimap<RecordId, OldRow> replaced_;
+
+        // The unlocked parts of the public methods
+        void fold();
+        void syncFiles();
+        void flushPendingLocked(Lsn durable_lsn);
+        void attachIndexLocked(const IndexDef& def);
+        void rebuildIndexesLocked();
+        // Folds under the exclusive latch (moving heap rows into the column
+        // store unless pinned)
+        void prepareRead();
+        bool hasVersions() const { return !created_.empty() || !replaced_.empty(); }
+        // Version bookkeeping of a change, under the exclusive latch
+        void noteCreated(const RecordId& rid, uint64_t version, uint64_t horizon);
+        void noteReplaced(const RecordId& rid, std::string record, uint64_t version);
+        void track();
+        // The overrides for rows with record ids in [begin, end)
+        void overrides(const Snapshot& snapshot, const RecordId& begin, const RecordId& end, Overrides& out) const;
+        // Whether the snapshot sees any stored row differently
+        bool differs(const Snapshot& snapshot) const;
+        void reconcileEpochs();
+        // Visits heap and column store rows without folding first
+        void scanRows(const TableHeap::Visitor& visitor);
+        void moveToColumnStore();
+        void finishMove(uint64_t epoch);
+        void completePendingMove();
+        // Extracts a field from a record; false if the row has no value
+        bool readField(std::string_view record, size_t field, DataValue& value) const;
+        void checkIndexedValues(std::string_view record);
+        void checkKeysLocked(const std::vector<std::string_view>& records, const std::set<RecordId>& replaced,
+                             const std::vector<std::string_view>& pending = {});
+        void checkSize(std::string_view record) const;
+        void indexInsert(std::string_view record, const RecordId& rid);
+        void indexErase(std::string_view record, const RecordId& rid);
+    };
+
+} // namespace minisql
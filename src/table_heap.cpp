@@ -0,0 +1,376 @@
+#include "table_heap.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace minisql {
+
+namespace {
+    constexpr char kHeapMagic[8] = {'M', 'S', 'Q', 'L', 'H', 'E', 'A', 'P'};
+    constexpr uint32_t kHeapVersion = 2;
+    constexpr size_t kVersionOffset = sizeof(kHeapMagic);
+    constexpr size_t kFoldedEpochOffset = kVersionOffset + sizeof(uint32_t);
+}
+
+TableHeap::TableHeap(const std::string& path, BufferPool& pool, WriteAheadLog* wal, WalTableRef ref)
+    : data_(path + ".db"), fsm_file_(path + ".fsm"), pool_(pool), wal_(wal), ref_(std::move(ref)) {
+    page_count_ = data_.pageCount();
+    if (page_count_ == 0) {
+        initHeader();
+    } else {
+        auto header = fetchPage(0);
+        uint32_t version;
+        std::memcpy(&version, header.data() + kVersionOffset, sizeof(version));
+        if (std::memcmp(header.data(), kHeapMagic, sizeof(kHeapMagic)) != 0) {
+            throw std::runtime_error("Not a table heap file: " + data_.path());
+        }
+        if (version != kHeapVersion) {
+            throw std::runtime_error("Unsupported table heap version " + std::to_string(version) + ": " + data_.path());
+        }
+        std::memcpy(&folded_log_epoch_, header.data() + kFoldedEpochOffset, sizeof(folded_log_epoch_));
+    }
+    loadFreeSpaceMap();
+}
+
+TableHeap::~TableHeap() {
+    try {
+        pool_.flush(data_);
+    } catch (...) {
+    }
+    pool_.discard(data_);
+}
+
+RecordId TableHeap::insertRecord(std::string_view record) {
+    if (record.size() > SlottedPage::maxRecordSize()) {
+        throw std::runtime_error("Row too large (" + std::to_string(record.size()) + " bytes)");
+    }
+    while (true) {
+        PageId page_id = findPageWithSpace(record.size());
+        if (page_id == kInvalidPageId) {
+            page_id = page_count_;
+        }
+        auto handle = fetchDataPage(page_id);
+        SlottedPage page(handle.data());
+        uint16_t slot = page.insert(record);
+        if (slot == SlottedPage::kInvalidSlot) {
+            // Stale FSM entry (the map is only a hint): correct it and retry
+            setFreeSpace(page_id, page.availableSpace());
+            continue;
+        }
+        Lsn lsn = wal_ ? wal_->logPageInsert(ref_, page_id, slot, record) : 0;
+        page.setLsn(lsn);
+        markDirty(handle, page_id, lsn);
+        setFreeSpace(page_id, page.availableSpace());
+        insert_hint_ = page_id;
+        return RecordId{page_id, slot};
+    }
+}
+
+std::vector<RecordId> TableHeap::insertRecords(const std::vector<std::string>& records) {
+    std::vector<RecordId> rids;
+    rids.reserve(records.size());
+    BufferPool::PageHandle handle;
+    PageId page_id = kInvalidPageId;
+
+    auto finishPage = [&] {
+        if (page_id == kInvalidPageId) return;
+        SlottedPage page(handle.data());
+        Lsn lsn = wal_ ? wal_->logPageImage(ref_, page_id, handle.data()) : 0;
+        page.setLsn(lsn);
+        markDirty(handle, page_id, lsn);
+        setFreeSpace(page_id, page.availableSpace());
+        insert_hint_ = page_id;
+        handle.release();
+        page_id = kInvalidPageId;
+    };
+
+    for (const auto& record : records) {
+        if (record.size() > SlottedPage::maxRecordSize()) {
+            finishPage();
+            throw std::runtime_error("Row too large (" + std::to_string(record.size()) + " bytes)");
+        }
+        uint16_t slot = page_id == kInvalidPageId ? SlottedPage::kInvalidSlot
+                                                  : SlottedPage(handle.data()).insert(record);
+        while (slot == SlottedPage::kInvalidSlot) {
+            finishPage();
+            // The page just finished is excluded by its updated FSM entry
+            page_id = findPageWithSpace(record.size());
+            if (page_id == kInvalidPageId) {
+                page_id = page_count_;
+            }
+            handle = fetchDataPage(page_id);
+            SlottedPage page(handle.data());
+            slot = page.insert(record);
+            if (slot == SlottedPage::kInvalidSlot) {
+                setFreeSpace(page_id, page.availableSpace());
+                handle.release();
+                page_id = kInvalidPageId;
+            }
+        }
+        rids.push_back(RecordId{page_id, slot});
+    }
+    finishPage();
+    return rids;
+}
+
+bool TableHeap::getRecord(const RecordId& rid, std::string& out) {
+    if (rid.page_id == 0 || rid.page_id >= page_count_) {
+        return false;
+    }
+    auto handle = fetchPage(rid.page_id);
+    std::string_view record;
+    if (!SlottedPage(handle.data()).get(rid.slot, record)) {
+        return false;
+    }
+    out.assign(record.data(), record.size());
+    return true;
+}
+
+RecordId TableHeap::updateRecord(const RecordId& rid, std::string_view record) {
+    if (rid.page_id == 0 || rid.page_id >= page_count_) {
+        throw std::runtime_error("Invalid record id");
+    }
+    {
+        auto handle = fetchPage(rid.page_id);
+        SlottedPage page(handle.data());
+        if (page.update(rid.slot, record)) {
+            Lsn lsn = wal_ ? wal_->logPageUpdate(ref_, rid.page_id, rid.slot, record) : 0;
+            page.setLsn(lsn);
+            markDirty(handle, rid.page_id, lsn);
+            setFreeSpace(rid.page_id, page.availableSpace());
+            return rid;
+        }
+    }
+    // Does not fit any more: move the record to another page
+    if (!deleteRecord(rid)) {
+        throw std::runtime_error("Invalid record id");
+    }
+    return insertRecord(record);
+}
+
+bool TableHeap::deleteRecord(const RecordId& rid) {
+    if (rid.page_id == 0 || rid.page_id >= page_count_) {
+        return false;
+    }
+    auto handle = fetchPage(rid.page_id);
+    SlottedPage page(handle.data());
+    if (!page.erase(rid.slot)) {
+        return false;
+    }
+    Lsn lsn = wal_ ? wal_->logPageDelete(ref_, rid.page_id, rid.slot) : 0;
+    page.setLsn(lsn);
+    markDirty(handle, rid.page_id, lsn);
+    setFreeSpace(rid.page_id, page.availableSpace());
+    if (rid.page_id < insert_hint_) {
+        insert_hint_ = rid.page_id;
+    }
+    return true;
+}
+
+void TableHeap::scan(const Visitor& visitor) {
+    for (PageId page_id = 1; page_id < page_count_; ++page_id) {
+        auto handle = fetchPage(page_id);
+        SlottedPage page(handle.data());
+        if (!page.isInitialized()) continue;
+        std::string_view record;
+        for (uint16_t slot = 0; slot < page.slotCount(); ++slot) {
+            if (page.get(slot, record) && !visitor(RecordId{page_id, slot}, record)) {
+                return;
+            }
+        }
+    }
+}
+
+bool TableHeap::scanPages(PageId first, PageId end, const PageVisitor& visitor) {
+    std::vector<RecordId> rids;
+    std::vector<std::string_view> records;
+    for (PageId page_id = std::max<PageId>(first, 1); page_id < std::min(end, page_count_); ++page_id) {
+        auto handle = fetchPage(page_id);
+        SlottedPage page(handle.data());
+        if (!page.isInitialized()) continue;
+        rids.clear();
+        records.clear();
+        std::string_view record;
+        for (uint16_t slot = 0; slot < page.slotCount(); ++slot) {
+            if (page.get(slot, record)) {
+                rids.push_back(RecordId{page_id, slot});
+                records.push_back(record);
+            }
+        }
+        if (!records.empty() && !visitor(rids, records)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TableHeap::clear() {
+    pool_.discard(data_);
+    data_.truncate(0);
+    fsm_file_.truncate(0);
+    fsm_.clear();
+    page_count_ = 0;
+    initHeader();
+    loadFreeSpaceMap();
+}
+
+void TableHeap::sync() {
+    pool_.flush(data_);
+    data_.sync();
+    fsm_file_.sync();
+}
+
+void TableHeap::setFoldedLogEpoch(uint64_t epoch) {
+    folded_log_epoch_ = epoch;
+    writeHeader(wal_ ? wal_->logHeapEpoch(ref_, epoch) : 0);
+}
+
+void TableHeap::redo(const WalRecord& record) {
+    if (record.type == WalRecordType::HEAP_EPOCH) {
+        if (record.epoch > folded_log_epoch_) {
+            folded_log_epoch_ = record.epoch;
+            writeHeader(record.lsn);
+        }
+        return;
+    }
+    if (record.type == WalRecordType::TABLE_TRUNCATE || record.type == WalRecordType::ROW_GROUP) {
+        clear();
+        folded_log_epoch_ = record.epoch - 1;
+        writeHeader(record.lsn);
+        return;
+    }
+
+    auto handle = fetchPage(record.page_id);
+    SlottedPage page(handle.data());
+    if (!page.isInitialized()) {
+        page.init(record.page_id);
+    } else if (page.lsn() >= record.lsn) {
+        return;
+    }
+    bool applied = true;
+    switch (record.type) {
+        case WalRecordType::PAGE_INSERT:
+            applied = page.insertAt(record.slot, record.data);
+            break;
+        case WalRecordType::PAGE_UPDATE:
+            applied = page.update(record.slot, record.data);
+            break;
+        case WalRecordType::PAGE_DELETE:
+            applied = page.erase(record.slot);
+            break;
+        case WalRecordType::PAGE_IMAGE:
+            std::memcpy(handle.data(), record.data.data(), kPageSize);
+            break;
+        default:
+            throw std::runtime_error("Unexpected WAL record for table heap");
+    }
+    if (!applied) {
+        throw std::runtime_error("WAL redo does not match page " + std::to_string(record.page_id) +
+                                 " of " + data_.path());
+    }
+    page.setLsn(record.lsn);
+    // The record is already durable, so the page may be written back freely
+    markDirty(handle, record.page_id, 0);
+}
+
+void TableHeap::rebuildFreeSpaceMap() {
+    fsm_.assign(page_count_, 0);
+    for (PageId page_id = 1; page_id < page_count_; ++page_id) {
+        auto handle = fetchPage(page_id);
+        SlottedPage page(handle.data());
+        size_t available = page.isInitialized() ? page.availableSpace() : SlottedPage::maxRecordSize();
+        fsm_[page_id] = static_cast<uint8_t>(std::min<size_t>(available / kFsmGranularity, 255));
+    }
+    fsm_file_.truncate(0);
+    for (size_t begin = 0; begin < fsm_.size(); begin += kPageSize) {
+        std::vector<char> chunk(kPageSize, 0);
+        std::memcpy(chunk.data(), fsm_.data() + begin, std::min(kPageSize, fsm_.size() - begin));
+        fsm_file_.writePage(static_cast<PageId>(begin / kPageSize), chunk.data());
+    }
+    insert_hint_ = 1;
+}
+
+BufferPool::PageHandle TableHeap::fetchPage(PageId page_id) {
+    return pool_.fetch(data_, page_id);
+}
+
+BufferPool::PageHandle TableHeap::fetchDataPage(PageId page_id) {
+    auto handle = pool_.fetch(data_, page_id);
+    SlottedPage page(handle.data());
+    if (!page.isInitialized()) {
+        page.init(page_id);
+    }
+    return handle;
+}
+
+void TableHeap::markDirty(BufferPool::PageHandle& handle, PageId page_id, Lsn lsn) {
+    page_count_ = std::max(page_count_, page_id + 1);
+    handle.markDirty(lsn, lsn == 0 ? nullptr : wal_);
+}
+
+void TableHeap::initHeader() {
+    writeHeader(0);
+    insert_hint_ = 1;
+}
+
+void TableHeap::writeHeader(Lsn lsn) {
+    auto handle = fetchPage(0);
+    char* header = handle.data();
+    std::memset(header, 0, kPageSize);
+    std::memcpy(header, kHeapMagic, sizeof(kHeapMagic));
+    std::memcpy(header + kVersionOffset, &kHeapVersion, sizeof(kHeapVersion));
+    std::memcpy(header + kFoldedEpochOffset, &folded_log_epoch_, sizeof(folded_log_epoch_));
+    markDirty(handle, 0, lsn);
+}
+
+void TableHeap::loadFreeSpaceMap() {
+    fsm_.assign(page_count_, 0);
+    std::vector<char> buffer(kPageSize);
+    PageId covered = 0;
+    for (PageId fsm_page = 0; fsm_page < fsm_file_.pageCount() && covered < fsm_.size(); ++fsm_page) {
+        fsm_file_.readPage(fsm_page, buffer.data());
+        size_t count = std::min(kPageSize, fsm_.size() - covered);
+        std::memcpy(fsm_.data() + covered, buffer.data(), count);
+        covered += static_cast<PageId>(count);
+    }
+    // Pages written after the last FSM update (e.g. a crash in between) are
+    // measured directly
+    for (PageId page_id = std::max<PageId>(covered, 1); page_id < page_count_; ++page_id) {
+        auto handle = fetchPage(page_id);
+        SlottedPage page(handle.data());
+        setFreeSpace(page_id, page.isInitialized() ? page.availableSpace() : SlottedPage::maxRecordSize());
+    }
+    insert_hint_ = 1;
+}
+
+void TableHeap::setFreeSpace(PageId page_id, size_t available) {
+    uint8_t bucket = static_cast<uint8_t>(std::min<size_t>(available / kFsmGranularity, 255));
+    if (page_id >= fsm_.size()) {
+        fsm_.resize(page_id + 1, 0);
+    }
+    if (fsm_[page_id] == bucket && page_id / kPageSize < fsm_file_.pageCount()) {
+        return;
+    }
+    fsm_[page_id] = bucket;
+    PageId fsm_page = static_cast<PageId>(page_id / kPageSize);
+    std::vector<char> buffer(kPageSize, 0);
+    size_t begin = static_cast<size_t>(fsm_page) * kPageSize;
+    size_t count = std::min(kPageSize, fsm_.size() - begin);
+    std::memcpy(buffer.data(), fsm_.data() + begin, count);
+    fsm_file_.writePage(fsm_page, buffer.data());
+}
+
+PageId TableHeap::findPageWithSpace(size_t needed) {
+    size_t bucket = std::max<size_t>(1, (needed + kFsmGranularity - 1) / kFsmGranularity);
+    PageId count = static_cast<PageId>(fsm_.size());
+    for (PageId i = 0; i + 1 < count; ++i) {
+        // Start at the hint and wrap around so inserts keep filling the same page
+        PageId page_id = 1 + (insert_hint_ - 1 + i) % (count - 1);
+        if (fsm_[page_id] >= bucket) {
+            return page_id;
+        }
+    }
+    return kInvalidPageId;
+}
+
+} // namespace minisql
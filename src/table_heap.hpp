@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "buffer_pool.hpp"
+#include "disk_manager.hpp"
+#include "wal.hpp"
+
+namespace minisql {
+
+    // Unordered collection of variable-length records stored in slotted pages.
+    //
+    // Files:
+    //   <path>.db   page 0 is a header (magic, format version, folded log epoch),
+    //               pages 1..N hold records
+    //   <path>.fsm  free-space map, one byte per data page (free bytes / 16)
+    //
+    // Pages are accessed through the shared BufferPool, and every mutation
+    // dirties only the page holding the record (plus the FSM page covering it
+    // when its bucket changes). With a WAL attached each change is logged and
+    // stamped with its LSN, so the pool writes the page back only once the
+    // change is durable.
+    class TableHeap {
+    public:
+        using Visitor = std::function<bool(const RecordId&, std::string_view)>;
+        // Record ids and records of one page; the records point into the page
+        using PageVisitor = std::function<bool(const std::vector<RecordId>&, const std::vector<std::string_view>&)>;
+
+        TableHeap(const std::string& path, BufferPool& pool, WriteAheadLog* wal = nullptr, WalTableRef ref = {});
+        ~TableHeap();
+
+        RecordId insertRecord(std::string_view record);
+        // Bulk insert that fills each page in memory and logs/writes it once
+        std::vector<RecordId> insertRecords(const std::vector<std::string>& records);
+        bool getRecord(const RecordId& rid, std::string& out);
+        // Returns the record's new location, which differs from rid when the
+        // grown record no longer fits in its page
+        RecordId updateRecord(const RecordId& rid, std::string_view record);
+        bool deleteRecord(const RecordId& rid);
+        // Visits records in physical order until the visitor returns false
+        void scan(const Visitor& visitor);
+        // Visits the non-empty pages among data pages [first, end) in order
+        // until the visitor returns false; data pages are numbered from 1.
+        // Ranges can be scanned concurrently while the heap is not modified.
+        bool scanPages(PageId first, PageId end, const PageVisitor& visitor);
+        // Drops every page; callers log the truncation themselves
+        void clear();
+        // Writes back committed dirty pages and fsyncs the files
+        void sync();
+
+        // Epoch of the last insert log folded into this heap (kept in the header page)
+        uint64_t foldedLogEpoch() const { return folded_log_epoch_; }
+        void setFoldedLogEpoch(uint64_t epoch);
+
+        // Redo of logged changes; a no-op when the page is already newer
+        void redo(const WalRecord& record);
+        void rebuildFreeSpaceMap();
+
+        PageId dataPageCount() const { return page_count_ > 0 ? page_count_ - 1 : 0; }
+
+    private:
+        static constexpr size_t kFsmGranularity = 16;
+
+        DiskManager data_;
+        DiskManager fsm_file_;
+        BufferPool& pool_;
+        WriteAheadLog* wal_;
+        WalTableRef ref_;
+        std::vector<uint8_t> fsm_;
+        PageId page_count_ = 0;
+        PageId insert_hint_ = 1;
+        uint64_t folded_log_epoch_ = 0;
+
+        BufferPool::PageHandle fetchPage(PageId page_id);
+        // Fetches a page for an insert, formatting it if it was never written
+        BufferPool::PageHandle fetchDataPage(PageId page_id);
+        void markDirty(BufferPool::PageHandle& handle, PageId page_id, Lsn lsn);
+        void initHeader();
+        void writeHeader(Lsn lsn);
+        void loadFreeSpaceMap();
+        void setFreeSpace(PageId page_id, size_t available);
+        PageId findPageWithSpace(size_t needed);
+    };
+
+} // namespace minisql
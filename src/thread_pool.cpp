@@ -0,0 +1,160 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace minisql {
+
+struct ThreadPool::Job {
+    const std::function<void(size_t)>* work;
+    std::unique_ptr<std::atomic<bool>[]> done;
+    size_t remaining;
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+    std::mutex mutex;  // guards remaining and error
+    std::condition_variable changed;
+};
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i + 1 < threads; ++i) {
+        workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)>& work,
+                     const std::function<void(size_t)>& consume) {
+    if (count == 0) return;
+    if (workers_.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            work(i);
+            if (consume) consume(i);
+        }
+        return;
+    }
+
+    Job job;
+    job.work = &work;
+    job.done = std::make_unique<std::atomic<bool>[]>(count);
+    for (size_t i = 0; i < count; ++i) {
+        job.done[i].store(false, std::memory_order_relaxed);
+    }
+    job.remaining = count;
+    // Contiguous runs keep neighbouring morsels on one thread; the caller's
+    // own queue is last, since it is also busy consuming the early results
+    for (size_t q = 0; q < queues_.size(); ++q) {
+        std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+        for (size_t i = q * count / queues_.size(); i < (q + 1) * count / queues_.size(); ++i) {
+            queues_[q]->tasks.push_back(Task{&job, i});
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++job_serial_;
+    }
+    wake_.notify_all();
+
+    size_t caller = queues_.size() - 1;
+    size_t next = 0;
+    std::exception_ptr consume_error;
+    auto canConsume = [&] {
+        return consume && !consume_error && next < count && job.done[next].load(std::memory_order_acquire) &&
+               !job.failed.load();
+    };
+    for (;;) {
+        if (canConsume()) {
+            try {
+                consume(next++);
+            } catch (...) {
+                consume_error = std::current_exception();
+                job.failed = true;
+            }
+            continue;
+        }
+        Task task;
+        if (takeTask(caller, task)) {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(job.mutex);
+        if (job.remaining == 0 && !canConsume()) break;
+        job.changed.wait(lock, [&] { return job.remaining == 0 || canConsume(); });
+    }
+    if (job.error) std::rethrow_exception(job.error);
+    if (consume_error) std::rethrow_exception(consume_error);
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || job_serial_ != seen; });
+            if (stopping_) return;
+            seen = job_serial_;
+        }
+        Task task;
+        while (takeTask(index, task)) {
+            runTask(task);
+        }
+    }
+}
+
+bool ThreadPool::takeTask(size_t queue, Task& task) {
+    {
+        Queue& own = *queues_[queue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        Queue& victim = *queues_[(queue + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTask(const Task& task) {
+    Job& job = *task.job;
+    std::exception_ptr error;
+    if (!job.failed.load()) {
+        try {
+            (*job.work)(task.index);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    job.done[task.index].store(true, std::memory_order_release);
+    // Notify under the lock: run() may destroy the job as soon as it is released
+    std::lock_guard<std::mutex> lock(job.mutex);
+    if (error && !job.error) {
+        job.error = error;
+        job.failed = true;
+    }
+    --job.remaining;
+    job.changed.notify_all();
+}
+
+} // namespace minisql
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace minisql {
+
+    // Fixed set of worker threads for running a job's independent tasks
+    // (such as the morsels of a table scan) in parallel.
+    //
+    // Every worker has its own task deque. A job's tasks are dealt out over
+    // the deques in contiguous runs; a worker takes tasks from the front of
+    // its own deque and, once that is empty, steals from the back of the
+    // others, so a worker that drew slow tasks is helped by the rest. The
+    // thread that started the job runs tasks too while it waits. Several
+    // threads may run jobs at once; their tasks share the workers.
+    class ThreadPool {
+    public:
+        // threads = 0 uses one thread per hardware thread (the caller counts as one)
+        explicit ThreadPool(size_t threads = 0);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Threads available to a job, including the caller
+        size_t size() const { return workers_.size() + 1; }
+
+        // Runs work(i) for every i in [0, count) and returns once all have run.
+        // consume(i), when given, is called on this thread in order of i as
+        // soon as work(i) is done. The first exception thrown by a task is
+        // rethrown here, after the other tasks have finished.
+        void run(size_t count, const std::function<void(size_t)>& work,
+                 const std::function<void(size_t)>& consume = {});
+
+    private:
+        struct Job;
+        struct Task {
+            Job* job;
+            size_t index;
+        };
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::thread> workers_;
+        std::vector<std::unique_ptr<Queue>> queues_;  // one per worker, then one for the caller
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        uint64_t job_serial_ = 0;  // bumped when a job's tasks are queued
+        bool stopping_ = false;
+
+        void workerLoop(size_t index);
+        // Takes a task of the job, own queue first; false when none are left
+        bool takeTask(size_t queue, Task& task);
+        void runTask(const Task& task);
+    };
+
+} // namespace minisql
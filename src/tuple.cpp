@@ -0,0 +1,238 @@
+#include "tuple.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace minisql {
+
+namespace {
+    constexpr uint16_t kTupleTag = 0xFFFF;
+    constexpr uint16_t kLegacyMissing = 0xFFFF;
+    constexpr size_t kHeaderSize = 4;
+
+    size_t slotSize(DataType type) {
+        switch (type) {
+            case DataType::INT: return sizeof(int32_t);
+            case DataType::FLOAT: return sizeof(float);
+            case DataType::BOOLEAN: return 1;
+            case DataType::STRING: return 2 * sizeof(uint16_t);
+        }
+        return 0;
+    }
+
+    template <typename T>
+    T load(const char* data) {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void store(char* data, T value) {
+        std::memcpy(data, &value, sizeof(T));
+    }
+
+    uint16_t readU16(std::string_view in, size_t& pos) {
+        if (pos + 2 > in.size()) {
+            throw std::runtime_error("Corrupt row record");
+        }
+        uint16_t value = load<uint16_t>(in.data() + pos);
+        pos += 2;
+        return value;
+    }
+}
+
+TupleLayout::TupleLayout(std::vector<TableField> fields) : fields_(std::move(fields)) {
+    size_t offset = 0;
+    for (const auto& field : fields_) {
+        offsets_.push_back(static_cast<uint16_t>(offset));
+        offset += slotSize(field.type);
+    }
+    offsets_.push_back(static_cast<uint16_t>(offset));
+}
+
+size_t TupleLayout::fieldIndex(const std::string& name) const {
+    if (auto field = findField(name)) return *field;
+    throw std::runtime_error("Unknown field: " + name);
+}
+
+std::optional<size_t> TupleLayout::findField(const std::string& name) const {
+    for (size_t i = 0; i < fields_.size(); ++i) {
+        if (fields_[i].name == name) return i;
+    }
+    return std::nullopt;
+}
+
+std::string TupleLayout::encode(const std::vector<FieldValue>& values) const {
+    size_t count = fields_.size();
+    size_t bitmap_size = (count + 7) / 8;
+    size_t fixed_start = kHeaderSize + bitmap_size;
+    size_t var_start = fixed_start + offsets_[count];
+    size_t var_size = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (values[i] && fields_[i].type == DataType::STRING) {
+            var_size += std::get<std::string>(*values[i]).size();
+        }
+    }
+    if (var_start + var_size > 0xFFFF) {
+        throw std::runtime_error("Row too large (" + std::to_string(var_start + var_size) + " bytes)");
+    }
+
+    std::string out(var_start + var_size, '\0');
+    char* data = out.data();
+    store<uint16_t>(data, kTupleTag);
+    store<uint16_t>(data + 2, static_cast<uint16_t>(count));
+    size_t var_pos = var_start;
+    for (size_t i = 0; i < count; ++i) {
+        if (!values[i]) {
+            data[kHeaderSize + i / 8] |= static_cast<char>(1 << (i % 8));
+            continue;
+        }
+        char* slot = data + fixed_start + offsets_[i];
+        switch (fields_[i].type) {
+            case DataType::INT:
+                store<int32_t>(slot, std::get<int>(*values[i]));
+                break;
+            case DataType::FLOAT:
+                store<float>(slot, std::get<float>(*values[i]));
+                break;
+            case DataType::BOOLEAN:
+                *slot = std::get<bool>(*values[i]) ? 1 : 0;
+                break;
+            case DataType::STRING: {
+                const auto& text = std::get<std::string>(*values[i]);
+                store<uint16_t>(slot, static_cast<uint16_t>(var_pos));
+                store<uint16_t>(slot + 2, static_cast<uint16_t>(text.size()));
+                std::memcpy(data + var_pos, text.data(), text.size());
+                var_pos += text.size();
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+bool TupleLayout::isLegacy(std::string_view record) {
+    return record.size() < 2 || load<uint16_t>(record.data()) != kTupleTag;
+}
+
+std::string TupleLayout::upgrade(std::string_view record) const {
+    std::vector<FieldValue> values(fields_.size());
+    size_t pos = 0;
+    uint16_t count = readU16(record, pos);
+    for (uint16_t i = 0; i < count; ++i) {
+        uint16_t length = readU16(record, pos);
+        if (length == kLegacyMissing) continue;
+        if (pos + length > record.size()) {
+            throw std::runtime_error("Corrupt row record");
+        }
+        if (i < fields_.size()) {
+            std::string text(record.substr(pos, length));
+            if (validateValue(text, fields_[i].type)) {
+                values[i] = stringToDataValue(text, fields_[i].type);
+            }
+        }
+        pos += length;
+    }
+    return encode(values);
+}
+
+TupleBuilder::TupleBuilder(const TupleLayout& layout) : layout_(&layout) {
+    empty_ = layout.encode(std::vector<FieldValue>(layout.fields().size()));
+    fixed_start_ = kHeaderSize + (layout.fields().size() + 7) / 8;
+    record_.reserve(empty_.size());
+}
+
+void TupleBuilder::reset() {
+    record_.assign(empty_);
+}
+
+void TupleBuilder::setFixed(size_t field, const char* data) {
+    record_[kHeaderSize + field / 8] &= static_cast<char>(~(1 << (field % 8)));
+    size_t size = layout_->fields()[field].type == DataType::BOOLEAN ? 1 : 4;
+    std::memcpy(record_.data() + fixed_start_ + layout_->slotOffset(field), data, size);
+}
+
+void TupleBuilder::setString(size_t field, std::string_view value) {
+    if (record_.size() + value.size() > 0xFFFF) {
+        throw std::runtime_error("Row too large (" + std::to_string(record_.size() + value.size()) + " bytes)");
+    }
+    record_[kHeaderSize + field / 8] &= static_cast<char>(~(1 << (field % 8)));
+    char* slot = record_.data() + fixed_start_ + layout_->slotOffset(field);
+    store<uint16_t>(slot, static_cast<uint16_t>(record_.size()));
+    store<uint16_t>(slot + 2, static_cast<uint16_t>(value.size()));
+    record_.append(value);
+}
+
+TupleView::TupleView(const TupleLayout& layout, std::string_view record) : layout_(&layout), data_(record) {
+    if (TupleLayout::isLegacy(record)) {
+        converted_ = layout.upgrade(record);
+        data_ = converted_;
+    }
+    if (data_.size() < kHeaderSize) {
+        throw std::runtime_error("Corrupt row record");
+    }
+    count_ = load<uint16_t>(data_.data() + 2);
+    fixed_start_ = kHeaderSize + (count_ + 7) / 8;
+    size_t known = std::min<size_t>(count_, layout.fields().size());
+    if (fixed_start_ + layout.slotOffset(known) > data_.size()) {
+        throw std::runtime_error("Corrupt row record");
+    }
+}
+
+bool TupleView::isNull(size_t field) const {
+    if (field >= count_ || field >= layout_->fields().size()) return true;
+    return (data_[kHeaderSize + field / 8] >> (field % 8)) & 1;
+}
+
+FieldValue TupleView::get(size_t field) const {
+    if (isNull(field)) return std::nullopt;
+    switch (layout_->fields()[field].type) {
+        case DataType::INT: return DataValue(getInt(field));
+        case DataType::FLOAT: return DataValue(getFloat(field));
+        case DataType::BOOLEAN: return DataValue(getBool(field));
+        case DataType::STRING: return DataValue(std::string(getString(field)));
+    }
+    return std::nullopt;
+}
+
+int32_t TupleView::getInt(size_t field) const {
+    return load<int32_t>(slot(field));
+}
+
+float TupleView::getFloat(size_t field) const {
+    return load<float>(slot(field));
+}
+
+bool TupleView::getBool(size_t field) const {
+    return *slot(field) != 0;
+}
+
+std::string_view TupleView::getString(size_t field) const {
+    uint16_t offset = load<uint16_t>(slot(field));
+    uint16_t length = load<uint16_t>(slot(field) + 2);
+    if (static_cast<size_t>(offset) + length > data_.size()) {
+        throw std::runtime_error("Corrupt row record");
+    }
+    return data_.substr(offset, length);
+}
+
+int TupleView::compare(size_t field, const DataValue& value) const {
+    auto order = [](const auto& a, const auto& b) { return a < b ? -1 : (b < a ? 1 : 0); };
+    switch (layout_->fields()[field].type) {
+        case DataType::INT: return order(getInt(field), std::get<int>(value));
+        case DataType::FLOAT: return order(getFloat(field), std::get<float>(value));
+        case DataType::BOOLEAN: return order(getBool(field), std::get<bool>(value));
+        case DataType::STRING: return order(getString(field), std::string_view(std::get<std::string>(value)));
+    }
+    return 0;
+}
+
+std::vector<FieldValue> TupleView::values() const {
+    std::vector<FieldValue> result(layout_->fields().size());
+    for (size_t i = 0; i < result.size(); ++i) {
+        result[i] = get(i);
+    }
+    return result;
+}
+
+} // namespace minisql
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+
+namespace minisql {
+
+    // A column value; nullopt when the row has none
+    using FieldValue = std::optional<DataValue>;
+
+    // Binary row ("tuple") format for one table schema:
+    //
+    //   | u16 tag 0xFFFF | u16 field count | null bitmap | fixed slots | string bytes |
+    //
+    // Fixed slots hold INT as int32, FLOAT as float (4 bytes each), BOOLEAN as
+    // one byte and STRING as a u16 offset + u16 length into the string bytes.
+    // Slot offsets depend only on the schema, so a field is read with one
+    // lookup and no parsing. Rows written before a column was added carry a
+    // smaller field count and read the missing columns as null.
+    //
+    // Records without the tag are in the original text format (u16 count, then
+    // a u16 length and the literal text per field) and are converted on read.
+    class TupleLayout {
+    public:
+        explicit TupleLayout(std::vector<TableField> fields);
+
+        const std::vector<TableField>& fields() const { return fields_; }
+        size_t fieldIndex(const std::string& name) const;  // throws for unknown fields
+        std::optional<size_t> findField(const std::string& name) const;
+
+        // values[i] is the value of fields()[i]
+        std::string encode(const std::vector<FieldValue>& values) const;
+        // Converts a record in the original text format
+        std::string upgrade(std::string_view record) const;
+        static bool isLegacy(std::string_view record);
+
+        uint16_t slotOffset(size_t field) const { return offsets_[field]; }
+
+    private:
+        std::vector<TableField> fields_;
+        std::vector<uint16_t> offsets_;  // slot offsets within the fixed area
+    };
+
+    // Builds records of one layout field by field in a reusable buffer, for
+    // callers that already hold values in their binary form (column chunks)
+    class TupleBuilder {
+    public:
+        explicit TupleBuilder(const TupleLayout& layout);
+
+        // Starts a new record with every field null
+        void reset();
+        // Slot bytes of an INT/FLOAT (4 bytes) or BOOLEAN (1 byte) field
+        void setFixed(size_t field, const char* data);
+        void setString(size_t field, std::string_view value);
+        // Valid until the next reset()
+        std::string_view record() const { return record_; }
+
+    private:
+        const TupleLayout* layout_;
+        std::string empty_;  // all-null record
+        std::string record_;
+        size_t fixed_start_;
+    };
+
+    // Typed read access to one encoded row. Views over current-format records
+    // do not copy; legacy records are converted into a private buffer.
+    class TupleView {
+    public:
+        TupleView(const TupleLayout& layout, std::string_view record);
+        TupleView(const TupleView&) = delete;
+        TupleView& operator=(const TupleView&) = delete;
+
+        bool isNull(size_t field) const;
+        FieldValue get(size_t field) const;
+        // The accessors below require a non-null field of the matching type
+        int32_t getInt(size_t field) const;
+        float getFloat(size_t field) const;
+        bool getBool(size_t field) const;
+        std::string_view getString(size_t field) const;
+        // Orders a non-null field against a value of its type without copying: <0, 0 or >0
+        int compare(size_t field, const DataValue& value) const;
+
+        std::vector<FieldValue> values() const;
+        std::string_view record() const { return data_; }
+
+    private:
+        const TupleLayout* layout_;
+        std::string converted_;
+        std::string_view data_;
+        uint16_t count_ = 0;
+        size_t fixed_start_ = 0;
+
+        const char* slot(size_t field) const { return data_.data() + fixed_start_ + layout_->slotOffset(field); }
+    };
+
+} // namespace minisql
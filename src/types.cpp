@@ -1,5 +1,6 @@
 #include "types.hpp"
 #include "utils.hpp"
+#include <charconv>
 
 namespace minisql {
 
@@ -23,25 +24,23 @@ DataType stringToDataType(const std::string& str) {
 }
 
 bool validateValue(const std::string& value, DataType type) {
-    try {
-        switch (type) {
-            case DataType::STRING:
-                return !value.empty();
-            case DataType::INT:
-                std::stoi(value);
-                return true;
-            case DataType::FLOAT:
-                std::stof(value);
-                return true;
-            case DataType::BOOLEAN: {
-                auto upper = toUpper(value);
-                return upper == "TRUE" || upper == "FALSE";
-            }
-            default:
-                return false;
+    switch (type) {
+        case DataType::STRING:
+            return !value.empty();
+        case DataType::INT: {
+            int number;
+            return parseNumber(value, number);
         }
-    } catch (...) {
-        return false;
+        case DataType::FLOAT: {
+            float number;
+            return parseNumber(value, number);
+        }
+        case DataType::BOOLEAN: {
+            auto upper = toUpper(value);
+            return upper == "TRUE" || upper == "FALSE";
+        }
+        default:
+            return false;
     }
 }
 
@@ -50,6 +49,12 @@ std::string dataValueToString(const DataValue& value) {
         using T = std::decay_t<decltype(v)>;
         if constexpr (std::is_same_v<T, std::string>) return v;
         else if constexpr (std::is_same_v<T, bool>) return v ? "true" : "false";
+        else if constexpr (std::is_same_v<T, float>) {
+            // Shortest text that reads back as the same float
+            char buffer[32];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+            return std::string(buffer, result.ptr);
+        }
         else return std::to_string(v);
     }, value);
 }
@@ -57,11 +62,26 @@ std::string dataValueToString(const DataValue& value) {
 DataValue stringToDataValue(const std::string& str, DataType type) {
     switch (type) {
         case DataType::STRING:
+            if (str.size() >= 2 && (str.front() == '\'' || str.front() == '"') && str.back() == str.front()) {
+                // Doubled quotes inside the literal stand for one quote
+                std::string value;
+                for (size_t i = 1; i + 1 < str.size(); ++i) {
+                    value += str[i];
+                    if (str[i] == str.front() && str[i + 1] == str.front()) ++i;
+                }
+                return value;
+            }
             return str;
-        case DataType::INT:
-            return std::stoi(str);
-        case DataType::FLOAT:
-            return std::stof(str);
+        case DataType::INT: {
+            int value;
+            if (!parseNumber(str, value)) throw std::runtime_error("Invalid INT value: " + str);
+            return value;
+        }
+        case DataType::FLOAT: {
+            float value;
+            if (!parseNumber(str, value)) throw std::runtime_error("Invalid FLOAT value: " + str);
+            return value;
+        }
         case DataType::BOOLEAN:
             return toUpper(str) == "TRUE";
         default:
@@ -69,4 +89,9 @@ DataValue stringToDataValue(const std::string& str, DataType type) {
     }
 }
 
+int compareValues(const DataValue& a, const DataValue& b) {
+    if (a < b) return -1;
+    return b < a ? 1 : 0;
+}
+
 } // namespace minisql
\ No newline at end of file
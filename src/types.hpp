@@ -1,5 +1,7 @@
 #pragma once
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <nlohmann/json.hpp>
 
@@ -13,11 +15,28 @@ namespace minisql {
     // Data value (variant to hold any supported type)
     using DataValue = std::variant<std::string, int, float, bool>;
 
+    struct TableField {
+        std::string name;
+        DataType type;
+    };
+
     // Function declarations
     std::string dataTypeToString(DataType type);
     DataType stringToDataType(const std::string& str);
     bool validateValue(const std::string& value, DataType type);
     std::string dataValueToString(const DataValue& value);
+    // Converts a literal of the given type; quoted string literals are unquoted
     DataValue stringToDataValue(const std::string& str, DataType type);
+    // Orders two values of the same type: <0, 0 or >0
+    int compareValues(const DataValue& a, const DataValue& b);
+
+    // Reads a number from the whole text (a leading '+' is allowed); false
+    // if any text is left over or the value does not fit
+    template <typename T>
+    bool parseNumber(std::string_view text, T& value) {
+        if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size();
+    }
 
 } // namespace minisql
\ No newline at end of file
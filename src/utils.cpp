@@ -1,5 +1,6 @@
 #include "utils.hpp"
 #include <algorithm>
+#include <array>
 #include <cctype>
 
 namespace minisql {
@@ -43,4 +44,23 @@ namespace minisql {
         return result;
     }
 
+    uint32_t crc32(const char* data, size_t size, uint32_t crc) {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                t[i] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
 } // namespace minisql
\ No newline at end of file
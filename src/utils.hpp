@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 #include "types.hpp"
@@ -9,5 +10,6 @@ namespace minisql {
     std::string trim(const std::string& str);
     bool isValidIdentifier(const std::string& str);
     std::string toUpper(const std::string& str);
+    uint32_t crc32(const char* data, size_t size, uint32_t crc = 0);
 
 } // namespace minisql
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include "wal.hpp"
+#include "bytes.hpp"
+#include "utils.hpp"
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace minisql {
+
+namespace {
+    constexpr char kWalMagic[8] = {'M', 'S', 'Q', 'L', 'W', 'A', 'L', '1'};
+    constexpr size_t kWalHeaderSize = sizeof(kWalMagic) + sizeof(Lsn);
+    constexpr size_t kFrameHeader = 8;
+
+    std::string errnoMessage(const std::string& what, const std::string& path) {
+        return what + " '" + path + "': " + std::strerror(errno);
+    }
+
+    void writeAll(int fd, const char* data, size_t size, const std::string& path) {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error(errnoMessage("Failed to write", path));
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+    std::vector<char> readAll(int fd, const std::string& path) {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            throw std::runtime_error(errnoMessage("Failed to stat", path));
+        }
+        std::vector<char> buffer(static_cast<size_t>(st.st_size));
+        size_t done = 0;
+        while (done < buffer.size()) {
+            ssize_t n = ::pread(fd, buffer.data() + done, buffer.size() - done, static_cast<off_t>(done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error(errnoMessage("Failed to read", path));
+            if (n == 0) break;
+            done += static_cast<size_t>(n);
+        }
+        buffer.resize(done);
+        return buffer;
+    }
+
+    // Walks the intact frames of a WAL image; returns the end of the last one
+    size_t forEachFrame(const std::vector<char>& buffer, const std::function<void(std::string_view)>& visitor) {
+        size_t pos = kWalHeaderSize;
+        while (pos + kFrameHeader <= buffer.size()) {
+            uint32_t length, crc;
+            std::memcpy(&length, buffer.data() + pos, 4);
+            std::memcpy(&crc, buffer.data() + pos + 4, 4);
+            if (pos + kFrameHeader + length > buffer.size() ||
+                crc32(buffer.data() + pos + kFrameHeader, length) != crc) {
+                break;
+            }
+            visitor(std::string_view(buffer.data() + pos + kFrameHeader, length));
+            pos += kFrameHeader + length;
+        }
+        return pos;
+    }
+
+    WalRecordType recordType(std::string_view payload) {
+        return static_cast<WalRecordType>(payload[sizeof(Lsn)]);
+    }
+
+    WalRecord decodeRecord(std::string_view payload) {
+        ByteReader in(payload);
+        WalRecord record;
+        record.lsn = in.get<Lsn>();
+        record.type = static_cast<WalRecordType>(in.get<uint8_t>());
+        record.ref.db = std::string(in.getString16());
+        record.ref.table = std::string(in.getString16());
+        switch (record.type) {
+            case WalRecordType::ROW_INSERT:
+                record.epoch = in.get<uint64_t>();
+                record.data = std::string(in.getBytes32());
+                break;
+            case WalRecordType::PAGE_INSERT:
+            case WalRecordType::PAGE_UPDATE:
+                record.page_id = in.get<PageId>();
+                record.slot = in.get<uint16_t>();
+                record.data = std::string(in.getBytes32());
+                break;
+            case WalRecordType::PAGE_DELETE:
+            case WalRecordType::COLUMN_DELETE:
+                record.page_id = in.get<PageId>();
+                record.slot = in.get<uint16_t>();
+                break;
+            case WalRecordType::PAGE_IMAGE:
+                record.page_id = in.get<PageId>();
+                record.data = std::string(in.take(kPageSize));
+                break;
+            case WalRecordType::HEAP_EPOCH:
+            case WalRecordType::TABLE_TRUNCATE:
+            case WalRecordType::ROW_GROUP:
+            case WalRecordType::GROUP_END:
+                record.epoch = in.get<uint64_t>();
+                break;
+            case WalRecordType::GROUP_BEGIN:
+                record.tables.resize(in.get<uint32_t>());
+                for (auto& table : record.tables) {
+                    table.db = std::string(in.getString16());
+                    table.table = std::string(in.getString16());
+                }
+                break;
+            default:
+                throw std::runtime_error("Unknown WAL record type");
+        }
+        return record;
+    }
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& path) : path_(path) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error(errnoMessage("Failed to open", path));
+    }
+    recoverTail();
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    try {
+        flushAll();
+    } catch (...) {
+    }
+    ::close(fd_);
+}
+
+Lsn WriteAheadLog::logRowInsert(const WalTableRef& ref, uint64_t epoch, std::string_view row) {
+    return append(WalRecordType::ROW_INSERT, ref, [&](std::string& out) {
+        ByteWriter w(out);
+        w.put<uint64_t>(epoch);
+        w.putBytes32(row);
+    });
+}
+
+Lsn WriteAheadLog::logPageInsert(const WalTableRef& ref, PageId page_id, uint16_t slot, std::string_view record) {
+    return append(WalRecordType::PAGE_INSERT, ref, [&](std::string& out) {
+        ByteWriter w(out);
+        w.put<PageId>(page_id);
+        w.put<uint16_t>(slot);
+        w.putBytes32(record);
+    });
+}
+
+Lsn WriteAheadLog::logPageUpdate(const WalTableRef& ref, PageId page_id, uint16_t slot, std::string_view record) {
+    return append(WalRecordType::PAGE_UPDATE, ref, [&](std::string& out) {
+        ByteWriter w(out);
+        w.put<PageId>(page_id);
+        w.put<uint16_t>(slot);
+        w.putBytes32(record);
+    });
+}
+
+Lsn WriteAheadLog::logPageDelete(const WalTableRef& ref, PageId page_id, uint16_t slot) {
+    return append(WalRecordType::PAGE_DELETE, ref, [&](std::string& out) {
+        ByteWriter w(out);
+        w.put<PageId>(page_id);
+        w.put<uint16_t>(slot);
+    });
+}
+
+Lsn WriteAheadLog::logPageImage(const WalTableRef& ref, PageId page_id, const char* page) {
+    return append(WalRecordType::PAGE_IMAGE, ref, [&](std::string& out) {
+        ByteWriter w(out);
+        w.put<PageId>(page_id);
+        w.putRaw(page, kPageSize);
+    });
+}
+
+Lsn WriteAheadLog::logHeapEpoch(const WalTableRef& ref, uint64_t epoch) {
+    return append(WalRecordType::HEAP_EPOCH, ref, [&](std::string& out) {
+        ByteWriter(out).put<uint64_t>(epoch);
+    });
+}
+
+Lsn WriteAheadLog::logTableTruncate(const WalTableRef& ref, uint64_t new_epoch) {
+    return append(WalRecordType::TABLE_TRUNCATE, ref, [&](std::string& out) {
+        ByteWriter(out).put<uint64_t>(new_epoch);
+    });
+}
+
+Lsn WriteAheadLog::logRowGroup(const WalTableRef& ref, uint64_t new_epoch) {
+    return append(WalRecordType::ROW_GROUP, ref, [&](std::string& out) {
+        ByteWriter(out).put<uint64_t>(new_epoch);
+    });
+}
+
+Lsn WriteAheadLog::logColumnDelete(const WalTableRef& ref, const RecordId& rid) {
+    return append(WalRecordType::COLUMN_DELETE, ref, [&](std::string& out) {
+        ByteWriter w(out);
+        w.put<PageId>(rid.page_id);
+        w.put<uint16_t>(rid.slot);
+    });
+}
+
+WriteAheadLog::Group::Group(WriteAheadLog& log, const std::vector<WalTableRef>& tables)
+    : log_(log), running_(log.groups_running_) {
+    begin_ = log_.append(WalRecordType::GROUP_BEGIN, {}, [&](std::string& out) {
+        ByteWriter w(out);
+        w.put<uint32_t>(static_cast<uint32_t>(tables.size()));
+        for (const auto& table : tables) {
+            w.putString16(table.db);
+            w.putString16(table.table);
+        }
+    });
+    std::lock_guard<std::mutex> lock(log_.mutex_);
+    log_.groups_[begin_] = 0;
+}
+
+WriteAheadLog::Group::~Group() {
+    if (!ended_) log_.fail("a group of changes did not end");
+}
+
+Lsn WriteAheadLog::Group::end() {
+    Lsn end = log_.append(WalRecordType::GROUP_END, {}, [&](std::string& out) {
+        ByteWriter(out).put<uint64_t>(begin_);
+    });
+    std::lock_guard<std::mutex> lock(log_.mutex_);
+    log_.groups_[begin_] = end;
+    ended_ = true;
+    return end;
+}
+
+void WriteAheadLog::flush(Lsn lsn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (durable_lsn_ < lsn) {
+        checkUsableLocked();
+        if (flushing_) {
+            flushed_cv_.wait(lock);
+            continue;
+        }
+        flushing_ = true;
+        if (commit_delay_.count() > 0) {
+            lock.unlock();
+            std::this_thread::sleep_for(commit_delay_);
+            lock.lock();
+        }
+        std::string batch;
+        batch.swap(buffer_);
+        Lsn target = next_lsn_ - 1;
+        lock.unlock();
+        try {
+            writeAll(fd_, batch.data(), batch.size(), path_);
+            if (::fdatasync(fd_) != 0) {
+                throw std::runtime_error(errnoMessage("Failed to sync", path_));
+            }
+        } catch (const std::exception& e) {
+            // The batch may be partly on disk, and a failed fdatasync can
+            // lose pages that a retry would report as synced, so nothing
+            // after it may be called durable
+            lock.lock();
+            failure_ = e.what();
+            flushing_ = false;
+            flushed_cv_.notify_all();
+            throw;
+        }
+        lock.lock();
+        file_size_ += batch.size();
+        durable_lsn_ = target;
+        for (auto it = groups_.begin(); it != groups_.end();) {
+            it = it->second != 0 && it->second <= durable_lsn_ ? groups_.erase(it) : std::next(it);
+        }
+        flushing_ = false;
+        flushed_cv_.notify_all();
+    }
+}
+
+Lsn WriteAheadLog::appendedLsn() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return next_lsn_ - 1;
+}
+
+Lsn WriteAheadLog::durableLsn() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return groups_.empty() ? durable_lsn_ : std::min(durable_lsn_, groups_.begin()->first - 1);
+}
+
+bool WriteAheadLog::isDurable(Lsn lsn) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return durable_lsn_ >= lsn;
+}
+
+bool WriteAheadLog::failed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !failure_.empty();
+}
+
+void WriteAheadLog::fail(const std::string& reason) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failure_.empty()) failure_ = reason;
+}
+
+size_t WriteAheadLog::sizeBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_size_ + buffer_.size();
+}
+
+void WriteAheadLog::replay(const std::function<void(const WalRecord&)>& visitor) {
+    flushAll();
+    std::vector<char> buffer = readAll(fd_, path_);
+    std::set<Lsn> ended;
+    forEachFrame(buffer, [&](std::string_view payload) {
+        if (recordType(payload) == WalRecordType::GROUP_END) ended.insert(decodeRecord(payload).epoch);
+    });
+    // The tables of a group that did not end, whose later records are dropped
+    std::set<std::pair<std::string, std::string>> dropped;
+    forEachFrame(buffer, [&](std::string_view payload) {
+        WalRecordType type = recordType(payload);
+        if (type == WalRecordType::GROUP_END) return;
+        WalRecord record = decodeRecord(payload);
+        if (type == WalRecordType::GROUP_BEGIN) {
+            if (ended.count(record.lsn)) return;
+            for (const auto& table : record.tables) dropped.emplace(table.db, table.table);
+        } else if (dropped.count({record.ref.db, record.ref.table})) {
+            return;
+        }
+        visitor(record);
+    });
+}
+
+void WriteAheadLog::truncate() {
+    flushAll();
+    std::lock_guard<std::mutex> lock(mutex_);
+    checkUsableLocked();
+    if (::ftruncate(fd_, 0) != 0) {
+        throw std::runtime_error(errnoMessage("Failed to truncate", path_));
+    }
+    writeHeader(next_lsn_);
+}
+
+Lsn WriteAheadLog::append(WalRecordType type, const WalTableRef& ref, const std::function<void(std::string&)>& body) {
+    std::string payload;
+    std::lock_guard<std::mutex> lock(mutex_);
+    checkUsableLocked();
+    Lsn lsn = next_lsn_++;
+    ByteWriter w(payload);
+    w.put<Lsn>(lsn);
+    w.put<uint8_t>(static_cast<uint8_t>(type));
+    w.putString16(ref.db);
+    w.putString16(ref.table);
+    body(payload);
+
+    ByteWriter frame(buffer_);
+    frame.put<uint32_t>(static_cast<uint32_t>(payload.size()));
+    frame.put<uint32_t>(crc32(payload.data(), payload.size()));
+    buffer_ += payload;
+    return lsn;
+}
+
+void WriteAheadLog::checkUsable() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    checkUsableLocked();
+}
+
+void WriteAheadLog::checkUsableLocked() const {
+    if (!failure_.empty()) {
+        throw std::runtime_error("Write-ahead log unusable after a failed flush (" + failure_ + ")");
+    }
+}
+
+void WriteAheadLog::writeHeader(Lsn base_lsn) {
+    std::string header(kWalMagic, sizeof(kWalMagic));
+    ByteWriter(header).put<Lsn>(base_lsn);
+    writeAll(fd_, header.data(), header.size(), path_);
+    if (::fdatasync(fd_) != 0) {
+        throw std::runtime_error(errnoMessage("Failed to sync", path_));
+    }
+    file_size_ = header.size();
+}
+
+void WriteAheadLog::recoverTail() {
+    std::vector<char> buffer = readAll(fd_, path_);
+    if (buffer.size() < kWalHeaderSize) {
+        if (::ftruncate(fd_, 0) != 0) {
+            throw std::runtime_error(errnoMessage("Failed to truncate", path_));
+        }
+        writeHeader(1);
+        return;
+    }
+    if (std::memcmp(buffer.data(), kWalMagic, sizeof(kWalMagic)) != 0) {
+        throw std::runtime_error("Not a write-ahead log: " + path_);
+    }
+    std::memcpy(&next_lsn_, buffer.data() + sizeof(kWalMagic), sizeof(Lsn));
+    size_t end = forEachFrame(buffer, [&](std::string_view payload) {
+        Lsn lsn;
+        std::memcpy(&lsn, payload.data(), sizeof(lsn));
+        next_lsn_ = lsn + 1;
+    });
+    // Cut off a torn record left by a crash in the middle of a group write
+    if (end != buffer.size() && ::ftruncate(fd_, static_cast<off_t>(end)) != 0) {
+        throw std::runtime_error(errnoMessage("Failed to truncate", path_));
+    }
+    file_size_ = end;
+    durable_lsn_ = next_lsn_ - 1;
+}
+
+} // namespace minisql
@@ -0,0 +1,153 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "page.hpp"
+
+namespace minisql {
+
+    enum class WalRecordType : uint8_t {
+        ROW_INSERT = 1,     // row appended to a table's insert log
+        PAGE_INSERT = 2,    // record placed in a heap page slot
+        PAGE_UPDATE = 3,    // record in a heap page slot rewritten
+        PAGE_DELETE = 4,    // record in a heap page slot removed
+        PAGE_IMAGE = 5,     // full heap page after a batch fold
+        HEAP_EPOCH = 6,     // insert log epoch folded into the heap
+        TABLE_TRUNCATE = 7, // heap emptied and insert log moved to a new epoch
+        ROW_GROUP = 8,      // heap rows moved into column store row groups (heap emptied as above)
+        COLUMN_DELETE = 9,  // row of a column store row group marked deleted
+        GROUP_BEGIN = 10,   // the tables of a group follow (see WriteAheadLog::Group)
+        GROUP_END = 11      // the group that began at epoch (its LSN) is complete
+    };
+
+    struct WalTableRef {
+        std::string db;
+        std::string table;
+    };
+
+    struct WalRecord {
+        Lsn lsn = 0;
+        WalRecordType type = WalRecordType::ROW_INSERT;
+        WalTableRef ref;
+        PageId page_id = kInvalidPageId;
+        uint16_t slot = 0;
+        uint64_t epoch = 0;
+        std::string data;
+        std::vector<WalTableRef> tables;  // GROUP_BEGIN
+    };
+
+    // Redo log shared by every table under one base directory (<base>/wal.log).
+    //
+    // Records are appended to an in-memory buffer and become durable in
+    // flush(). Concurrent flushers are batched (group commit): the first caller
+    // becomes the leader and writes + fdatasyncs everything appended so far,
+    // the others wait for it and return without issuing their own sync.
+    // After a failed write or sync the log refuses every later append and
+    // flush, since it can no longer tell which records are durable.
+    //
+    // A Group brackets the records of changes that must survive a crash
+    // together. replay() skips the records a group's tables logged after its
+    // begin if the end is missing, and durableLsn() stays below the begin
+    // until the end is durable, so no page the group changed is written back
+    // before then. Nothing else may log for the tables while the group runs,
+    // and checkpoints wait for running groups (holdOffGroups()).
+    //
+    // Heap pages carry the LSN of their last change and may only be written
+    // once the WAL is durable up to that LSN; redo skips records whose LSN is
+    // not newer than the page. checkpoint() callers make the data files
+    // durable and then truncate() the log.
+    class WriteAheadLog {
+    public:
+        class Group {
+        public:
+            Group(WriteAheadLog& log, const std::vector<WalTableRef>& tables);
+            // A group left without end() makes the log unusable: its changes
+            // can then only be dropped by recovery
+            ~Group();
+            Group(const Group&) = delete;
+            Group& operator=(const Group&) = delete;
+
+            // Returns the LSN of the end record
+            Lsn end();
+
+        private:
+            WriteAheadLog& log_;
+            std::shared_lock<std::shared_mutex> running_;
+            Lsn begin_;
+            bool ended_ = false;
+        };
+
+        explicit WriteAheadLog(const std::string& path);
+        ~WriteAheadLog();
+        WriteAheadLog(const WriteAheadLog&) = delete;
+        WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+        Lsn logRowInsert(const WalTableRef& ref, uint64_t epoch, std::string_view row);
+        Lsn logPageInsert(const WalTableRef& ref, PageId page_id, uint16_t slot, std::string_view record);
+        Lsn logPageUpdate(const WalTableRef& ref, PageId page_id, uint16_t slot, std::string_view record);
+        Lsn logPageDelete(const WalTableRef& ref, PageId page_id, uint16_t slot);
+        Lsn logPageImage(const WalTableRef& ref, PageId page_id, const char* page);
+        Lsn logHeapEpoch(const WalTableRef& ref, uint64_t epoch);
+        Lsn logTableTruncate(const WalTableRef& ref, uint64_t new_epoch);
+        Lsn logRowGroup(const WalTableRef& ref, uint64_t new_epoch);
+        Lsn logColumnDelete(const WalTableRef& ref, const RecordId& rid);
+
+        // Blocks until every record up to lsn is on stable storage
+        void flush(Lsn lsn);
+        void flushAll() { flush(appendedLsn()); }
+
+        Lsn appendedLsn() const;
+        // Durable LSN below which pages may be written back: short of the
+        // first group whose end is not durable yet
+        Lsn durableLsn() const;
+        // Whether the record at lsn is on stable storage, whatever the groups
+        bool isDurable(Lsn lsn) const;
+        size_t sizeBytes() const;
+
+        // Calls visitor for every intact record in LSN order, except group
+        // ends and the records dropped with a group that did not end (whose
+        // begin is passed on)
+        void replay(const std::function<void(const WalRecord&)>& visitor);
+        // Drops all records; only valid once the data files are durable
+        void truncate();
+        // Waits for the running groups and keeps new ones from starting
+        std::unique_lock<std::shared_mutex> holdOffGroups() { return std::unique_lock<std::shared_mutex>(groups_running_); }
+        // Refuses every later append and flush, as after a failed flush
+        void fail(const std::string& reason);
+        bool failed() const;
+        // Throws once a flush has failed; the process must restart and recover
+        void checkUsable() const;
+
+        // Time a group-commit leader waits for more records before syncing
+        void setCommitDelay(std::chrono::microseconds delay) { commit_delay_ = delay; }
+
+    private:
+        std::string path_;
+        int fd_;
+        mutable std::mutex mutex_;
+        std::condition_variable flushed_cv_;
+        std::string buffer_;
+        Lsn next_lsn_ = 1;
+        Lsn durable_lsn_ = 0;
+        size_t file_size_ = 0;
+        bool flushing_ = false;
+        std::string failure_;  // why a flush failed; set for good
+        // Begin LSN of each group whose end is not durable, with the end's LSN (0 while running)
+        std::map<Lsn, Lsn> groups_;
+        std::shared_mutex groups_running_;
+        std::chrono::microseconds commit_delay_{0};
+
+        Lsn append(WalRecordType type, const WalTableRef& ref, const std::function<void(std::string&)>& body);
+        void checkUsableLocked() const;
+        void writeHeader(Lsn base_lsn);
+        void recoverTail();
+    };
+
+} // namespace minisql
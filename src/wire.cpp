@@ -0,0 +1,185 @@
+#include "wire.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace minisql {
+
+namespace wire {
+
+void appendFrame(std::string& out, std::string_view payload) {
+    uint32_t length = htonl(static_cast<uint32_t>(payload.size()));
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.append(payload.data(), payload.size());
+}
+
+void appendResponse(std::string& out, uint8_t status, std::string_view body) {
+    uint32_t length = htonl(static_cast<uint32_t>(body.size() + 1));
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.push_back(static_cast<char>(status));
+    out.append(body.data(), body.size());
+}
+
+std::optional<uint32_t> frameLength(std::string_view buffer, size_t pos) {
+    if (buffer.size() - pos < sizeof(uint32_t)) return std::nullopt;
+    uint32_t length;
+    std::memcpy(&length, buffer.data() + pos, sizeof(length));
+    return ntohl(length);
+}
+
+std::optional<std::string_view> nextFrame(std::string_view buffer, size_t& pos) {
+    auto length = frameLength(buffer, pos);
+    if (!length || buffer.size() - pos - sizeof(uint32_t) < *length) return std::nullopt;
+    std::string_view payload = buffer.substr(pos + sizeof(uint32_t), *length);
+    pos += sizeof(uint32_t) + *length;
+    return payload;
+}
+
+} // namespace wire
+
+namespace {
+
+    std::runtime_error socketError(const std::string& what, const Endpoint& endpoint) {
+        return std::runtime_error(what + " " + endpoint.toString() + ": " + std::strerror(errno));
+    }
+
+    sockaddr_un unixAddress(const Endpoint& endpoint) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (endpoint.path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Socket path too long: " + endpoint.path);
+        }
+        std::memcpy(address.sun_path, endpoint.path.c_str(), endpoint.path.size() + 1);
+        return address;
+    }
+
+    // Runs open(address) on each address of a TCP endpoint until it gives a socket
+    template <typename Open>
+    int openTcp(const Endpoint& endpoint, const char* what, Open open) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        std::string port = std::to_string(endpoint.port);
+        int status = getaddrinfo(endpoint.host.c_str(), port.c_str(), &hints, &addresses);
+        if (status != 0) {
+            throw std::runtime_error("Cannot resolve " + endpoint.host + ": " + gai_strerror(status));
+        }
+        int fd = -1;
+        int error = 0;
+        for (addrinfo* address = addresses; address && fd < 0; address = address->ai_next) {
+            fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+            if (fd < 0) {
+                error = errno;
+                continue;
+            }
+            if (!open(fd, *address)) {
+                error = errno;
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+        if (fd < 0) {
+            errno = error;
+            throw socketError(what, endpoint);
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return fd;
+    }
+
+} // namespace
+
+Endpoint Endpoint::parse(const std::string& address) {
+    Endpoint endpoint;
+    if (address.compare(0, 5, "unix:") == 0) {
+        endpoint.path = address.substr(5);
+        if (endpoint.path.empty()) throw std::runtime_error("Missing socket path in: " + address);
+        return endpoint;
+    }
+    size_t colon = address.rfind(':');
+    endpoint.host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+    std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+    if (endpoint.host.size() >= 2 && endpoint.host.front() == '[' && endpoint.host.back() == ']') {
+        endpoint.host = endpoint.host.substr(1, endpoint.host.size() - 2);
+    }
+    unsigned long number = 0;
+    try {
+        size_t used = 0;
+        number = std::stoul(port, &used);
+        if (used != port.size()) number = 0;
+    } catch (const std::exception&) {
+        number = 0;
+    }
+    if (endpoint.host.empty() || number == 0 || number > 65535) {
+        throw std::runtime_error("Invalid address: " + address);
+    }
+    endpoint.port = static_cast<uint16_t>(number);
+    return endpoint;
+}
+
+std::string Endpoint::toString() const {
+    if (!path.empty()) return "unix:" + path;
+    if (host.find(':') != std::string::npos) return "[" + host + "]:" + std::to_string(port);
+    return host + ":" + std::to_string(port);
+}
+
+int Endpoint::listen() const {
+    int fd;
+    if (!path.empty()) {
+        sockaddr_un address = unixAddress(*this);
+        // A socket file left behind by an earlier server would fail the bind
+        struct stat st;
+        if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw socketError("Cannot listen on", *this);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            int error = errno;
+            close(fd);
+            errno = error;
+            throw socketError("Cannot listen on", *this);
+        }
+    } else {
+        fd = openTcp(*this, "Cannot listen on", [](int fd, const addrinfo& address) {
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            return bind(fd, address.ai_addr, address.ai_addrlen) == 0;
+        });
+    }
+    if (::listen(fd, SOMAXCONN) < 0 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        throw socketError("Cannot listen on", *this);
+    }
+    return fd;
+}
+
+int Endpoint::connect() const {
+    if (path.empty()) {
+        return openTcp(*this, "Cannot connect to", [](int fd, const addrinfo& address) {
+            return ::connect(fd, address.ai_addr, address.ai_addrlen) == 0;
+        });
+    }
+    sockaddr_un address = unixAddress(*this);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        int error = errno;
+        if (fd >= 0) close(fd);
+        errno = error;
+        throw socketError("Cannot connect to", *this);
+    }
+    return fd;
+}
+
+} // namespace minisql
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace minisql {
+
+    // The client/server protocol. Every message is a frame: a 4-byte length
+    // in network byte order, then that many bytes of payload. A request frame
+    // holds one statement as SQL text; the server answers each request, in the
+    // order they came, with a frame holding a status byte (kOk or kError) and
+    // then the statement's output or the error message. Before it, frames
+    // with kMore may carry the output so far of a statement still running. A
+    // client may send further requests before the answers to earlier ones
+    // arrive.
+    namespace wire {
+        constexpr uint8_t kOk = 0;
+        constexpr uint8_t kError = 1;
+        constexpr uint8_t kMore = 2;
+        constexpr uint32_t kMaxRequest = 64 << 20;
+
+        void appendFrame(std::string& out, std::string_view payload);
+        void appendResponse(std::string& out, uint8_t status, std::string_view body);
+        // The payload of the frame at pos in buffer, moving pos past it;
+        // nullopt while the frame is incomplete
+        std::optional<std::string_view> nextFrame(std::string_view buffer, size_t& pos);
+        // The length of the frame at pos, if its header is complete
+        std::optional<uint32_t> frameLength(std::string_view buffer, size_t pos);
+    } // namespace wire
+
+    // Where a server listens or a client connects: "unix:PATH" for a Unix
+    // socket, "HOST:PORT" or just "PORT" (on 127.0.0.1) for TCP
+    struct Endpoint {
+        static constexpr const char* kDefault = "127.0.0.1:7432";
+
+        std::string path;  // of the Unix socket; empty for TCP
+        std::string host;
+        uint16_t port = 0;
+
+        static Endpoint parse(const std::string& address);
+        std::string toString() const;
+        // A nonblocking listening socket
+        int listen() const;
+        // A blocking socket connected to the endpoint
+        int connect() const;
+    };
+
+} // namespace minisql
@@ -0,0 +1,19 @@
+CREATE DATABASE shop;
+USE shop;
+CREATE TABLE items (id INT, price FLOAT, name STRING);
+INSERT INTO items (id, price, name) VALUES (1, 1.5, 'apple'), (2, 2.5, 'pear'), (3, 3.5, 'plum');
+INSERT INTO items (name) VALUES ('unknown');
+INSERT INTO items (id, price, name) VALUES (1.5, 1, 'fig');
+INSERT INTO items (id, price, name) VALUES (4, 1x, 'fig');
+SELECT id FROM items WHERE id = 1.5;
+SELECT id FROM items WHERE id <> 1.5;
+SELECT id FROM items WHERE id < 2.5;
+SELECT id FROM items WHERE NOT id >= 1.5;
+SELECT id FROM items WHERE id BETWEEN 0.5 AND 2.9;
+SELECT id FROM items WHERE id NOT BETWEEN 1.2 AND 1.8;
+SELECT id FROM items WHERE id IN (1.5, 3, 2.0);
+SELECT id FROM items WHERE id NOT IN (1.5, 2.5);
+SELECT id FROM items WHERE id > 1e20;
+SELECT id FROM items WHERE id > -3000000000;
+UPDATE items SET id = 2.5 WHERE id = 1;
+SELECT id, price, name FROM items;
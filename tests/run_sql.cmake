@@ -0,0 +1,20 @@
+# Runs a SQL script through the REPL in an empty directory and compares
+# what it prints with the expected output.
+#
+# usage: cmake -DMINISQL=<binary> -DSCRIPT=<file.sql> -DEXPECTED=<file.out> -DWORK_DIR=<dir> -P run_sql.cmake
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+execute_process(COMMAND ${MINISQL} --threads=2
+                WORKING_DIRECTORY ${WORK_DIR}
+                INPUT_FILE ${SCRIPT}
+                OUTPUT_VARIABLE actual
+                ERROR_VARIABLE actual
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${MINISQL} exited with ${result}:\n${actual}")
+endif()
+file(READ ${EXPECTED} expected)
+if(NOT actual STREQUAL expected)
+    file(WRITE ${WORK_DIR}/actual.out "${actual}")
+    message(FATAL_ERROR "Output differs from ${EXPECTED} (see ${WORK_DIR}/actual.out):\n${actual}")
+endif()
@@ -0,0 +1,17 @@
+CREATE DATABASE shop;
+USE shop;
+CREATE TABLE items (id INT PRIMARY KEY, name STRING UNIQUE, qty INT);
+INSERT INTO items (id, name, qty) VALUES (1, 'apple', 5), (2, 'pear', 7);
+BEGIN;
+INSERT INTO items (id, name, qty) VALUES (3, 'plum', 1);
+INSERT INTO items (id, name, qty) VALUES (3, 'fig', 2);
+INSERT INTO items (id, name, qty) VALUES (4, 'plum', 2);
+UPDATE items SET name = 'kiwi' WHERE id = 1;
+INSERT INTO items (id, name, qty) VALUES (5, 'kiwi', 3);
+UPDATE items SET id = 3 WHERE id = 2;
+UPDATE items SET name = 'apple' WHERE id = 3;
+INSERT INTO items (id, name, qty) VALUES (6, 'plum', 4);
+INSERT INTO items (id, name, qty) VALUES (7, 'apple', 4);
+SELECT id, name, qty FROM items;
+COMMIT;
+SELECT id, name, qty FROM items;